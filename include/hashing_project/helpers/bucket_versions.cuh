@@ -0,0 +1,154 @@
+#ifndef HT_BUCKET_VERSIONS
+#define HT_BUCKET_VERSIONS
+
+//per-bucket version counters for optimistic queries (a seqlock per lock bucket).
+//
+//With STABLE_HT_LOCKLESS_QUERY set, every lock-based table keeps one uint32_t beside each lock bit.
+//The lock holder makes the version odd right after acquiring and even again right before releasing.
+//find_with_reference then snapshots the version of the key's lock bucket, probes without the
+//lock, and retries if the version was odd or moved - queries never write memory.
+//
+//With the policy off no array is allocated and every hook compiles to nothing, so the
+//default build is unchanged.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_load.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   //one counter per lock bucket, zeroed. nullptr when the policy is off.
+   static __host__ uint32_t * generate_bucket_versions(uint64_t n_lock_buckets){
+
+      #if STABLE_HT_LOCKLESS_QUERY
+
+      uint32_t * versions = gallatin::utils::get_device_version<uint32_t>(n_lock_buckets);
+
+      cudaMemset(versions, 0, sizeof(uint32_t)*n_lock_buckets);
+
+      return versions;
+
+      #else
+
+      return nullptr;
+
+      #endif
+
+   }
+
+   static __host__ void free_bucket_versions(uint32_t * versions){
+
+      if (versions != nullptr) cudaFree(versions);
+
+   }
+
+
+   //writer side - only the lock holder writes a version, so no atomics are needed.
+   //odd version = write in progress.
+   __device__ inline void begin_bucket_write(uint32_t * versions, uint64_t bucket){
+
+      #if STABLE_HT_LOCKLESS_QUERY && !LOAD_CHEAP
+
+      ht_store(&versions[bucket], hash_table_load(&versions[bucket]) | 1U);
+
+      //version must be visible before any slot write.
+      __threadfence();
+
+      #endif
+
+   }
+
+   //the init kernels release every lock once without taking it - only odd versions advance,
+   //so those unlocks leave the version at 0.
+   __device__ inline void end_bucket_write(uint32_t * versions, uint64_t bucket){
+
+      #if STABLE_HT_LOCKLESS_QUERY && !LOAD_CHEAP
+
+      //slot writes must be visible before the version goes even.
+      __threadfence();
+
+      uint32_t version = hash_table_load(&versions[bucket]);
+
+      if (version & 1U) ht_store(&versions[bucket], version+1);
+
+      #endif
+
+   }
+
+
+   //reader side - thread 0 samples the version and the tile agrees on it with a shfl.
+   //waits out odd versions instead of probing a bucket mid-write.
+   template <typename tile_type>
+   __device__ inline uint32_t read_bucket_version(const tile_type & my_tile, uint32_t * versions, uint64_t bucket){
+
+      uint32_t version = 0;
+
+      if (my_tile.thread_rank() == 0){
+
+         do {
+            version = hash_table_load(&versions[bucket]);
+         } while (version & 1U);
+
+      }
+
+      return my_tile.shfl(version, 0);
+
+   }
+
+
+   //run query() until it completes without a concurrent write to bucket.
+   //query must be side-effect free apart from its output arguments - it may run more than once.
+   //returns query's result, so counting queries work too.
+   template <typename tile_type, typename query_type>
+   __device__ inline auto optimistic_query(const tile_type & my_tile, uint32_t * versions, uint64_t bucket, query_type query) -> decltype(query()){
+
+      #if STABLE_HT_LOCKLESS_QUERY && !LOAD_CHEAP
+
+      while (true){
+
+         uint32_t start_version = read_bucket_version(my_tile, versions, bucket);
+
+         auto found = query();
+
+         //probe loads must complete before the version is re-read.
+         __threadfence();
+
+         uint32_t end_version = 0;
+
+         if (my_tile.thread_rank() == 0){
+            end_version = hash_table_load(&versions[bucket]);
+         }
+
+         end_version = my_tile.shfl(end_version, 0);
+
+         if (start_version == end_version) return found;
+
+      }
+
+      #else
+
+      return query();
+
+      #endif
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_BUCKET_VERSIONS
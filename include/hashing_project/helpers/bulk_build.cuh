@@ -0,0 +1,206 @@
+#ifndef HT_BULK_BUILD
+#define HT_BULK_BUILD
+
+//bottom-up build of an empty table from a batch of n pairs.
+//
+// - bulk_build<tile_size>(table, keys, vals, n)     keys / vals in device memory
+//
+// 1) each key's target bucket comes from table->get_bulk_bucket(key),
+// 2) thrust::sort_by_key (a radix sort for integer keys) orders the batch by bucket, and
+//    thrust::lower_bound finds each bucket's range,
+// 3) one tile per bucket writes its first bucket_size pairs with plain coalesced stores
+//    (table->bulk_fill_bucket) - no locks, no CAS,
+// 4) the pairs that did not fit their bucket are inserted with upsert_replace afterwards.
+//
+//The table must be freshly generated and nothing else may touch it until bulk_build returns.
+//Keys must be distinct and not the sentinel / tombstone keys - duplicates are not merged in step 3.
+//The batch does not need to be sorted on entry.
+//
+//Supported: p2_ext (first p2 choice), double (start of the probe sequence), iht_p2 (frontyard
+//bucket), cuckoo (bucket of the first hash).
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+#include <thrust/execution_policy.h>
+#include <thrust/sort.h>
+#include <thrust/binary_search.h>
+#include <thrust/gather.h>
+#include <thrust/sequence.h>
+#include <thrust/iterator/counting_iterator.h>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   struct bulk_build_result {
+
+      //pairs written by the bucket pass.
+      uint64_t n_placed;
+
+      //pairs that overflowed their bucket and went through upsert_replace.
+      uint64_t n_overflow;
+
+      //overflow pairs upsert_replace could not place.
+      uint64_t n_failed;
+
+   };
+
+
+   template <typename ht_type, typename Key>
+   __global__ void bulk_bucket_kernel(ht_type * table, const Key * keys, uint64_t n, uint64_t * bucket_ids){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      if (tid >= n) return;
+
+      bucket_ids[tid] = table->get_bulk_bucket(keys[tid]);
+
+   }
+
+
+   template <typename ht_type, uint tile_size, uint64_t bucket_size, typename Key, typename Val>
+   __global__ void bulk_fill_kernel(ht_type * table, uint64_t n_buckets, uint64_t * offsets, const Key * sorted_keys, const Val * sorted_vals, uint64_t * n_overflow){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t start = offsets[tid];
+
+      uint64_t n_pairs = offsets[tid+1]-start;
+
+      uint64_t n_fit = n_pairs < bucket_size ? n_pairs : bucket_size;
+
+      table->bulk_fill_bucket(my_tile, tid, sorted_keys+start, sorted_vals+start, n_fit);
+
+      if (my_tile.thread_rank() == 0 && n_pairs > n_fit){
+         atomicAdd((unsigned long long int *)n_overflow, (unsigned long long int) (n_pairs-n_fit));
+      }
+
+
+   }
+
+
+   //overflow pairs sit at [offsets[b]+bucket_size, offsets[b+1]) of the sorted batch - one tile per bucket
+   //walks them, so buckets with no overflow exit immediately.
+   template <typename ht_type, uint tile_size, uint64_t bucket_size, typename Key, typename Val>
+   __global__ void bulk_overflow_kernel(ht_type * table, uint64_t n_buckets, uint64_t * offsets, const Key * sorted_keys, const Val * sorted_vals, uint64_t * n_failed){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t end = offsets[tid+1];
+
+      for (uint64_t i = offsets[tid]+bucket_size; i < end; i++){
+
+         if (!table->upsert_replace(my_tile, sorted_keys[i], sorted_vals[i]) && my_tile.thread_rank() == 0){
+            atomicAdd((unsigned long long int *)n_failed, 1ULL);
+         }
+
+      }
+
+
+   }
+
+
+   template <uint tile_size, typename ht_type, typename Key, typename Val>
+   __host__ bulk_build_result bulk_build(ht_type * table, const Key * keys, const Val * vals, uint64_t n){
+
+      static const uint64_t bucket_size = ht_type::bulk_bucket_size;
+
+      bulk_build_result result {0, 0, 0};
+
+      if (n == 0) return result;
+
+      uint64_t n_buckets = table->get_n_bulk_buckets();
+
+      uint64_t * bucket_ids;
+      uint64_t * permutation;
+      uint64_t * offsets;
+
+      Key * sorted_keys;
+      Val * sorted_vals;
+
+      cudaMalloc((void **)&bucket_ids, sizeof(uint64_t)*n);
+      cudaMalloc((void **)&permutation, sizeof(uint64_t)*n);
+      cudaMalloc((void **)&offsets, sizeof(uint64_t)*(n_buckets+1));
+
+      cudaMalloc((void **)&sorted_keys, sizeof(Key)*n);
+      cudaMalloc((void **)&sorted_vals, sizeof(Val)*n);
+
+      bulk_bucket_kernel<ht_type, Key><<<(n-1)/256+1,256>>>(table, keys, n, bucket_ids);
+
+      thrust::sequence(thrust::device, permutation, permutation+n);
+
+      thrust::sort_by_key(thrust::device, bucket_ids, bucket_ids+n, permutation);
+
+      thrust::lower_bound(thrust::device, bucket_ids, bucket_ids+n, thrust::counting_iterator<uint64_t>(0), thrust::counting_iterator<uint64_t>(n_buckets+1), offsets);
+
+      thrust::gather(thrust::device, permutation, permutation+n, keys, sorted_keys);
+      thrust::gather(thrust::device, permutation, permutation+n, vals, sorted_vals);
+
+      uint64_t * counters;
+
+      cudaMallocManaged((void **)&counters, sizeof(uint64_t)*2);
+
+      counters[0] = 0;
+      counters[1] = 0;
+
+      bulk_fill_kernel<ht_type, tile_size, bucket_size, Key, Val><<<(n_buckets*tile_size-1)/256+1,256>>>(table, n_buckets, offsets, sorted_keys, sorted_vals, &counters[0]);
+
+      cudaDeviceSynchronize();
+
+      if (counters[0] != 0){
+
+         bulk_overflow_kernel<ht_type, tile_size, bucket_size, Key, Val><<<(n_buckets*tile_size-1)/256+1,256>>>(table, n_buckets, offsets, sorted_keys, sorted_vals, &counters[1]);
+
+         cudaDeviceSynchronize();
+
+      }
+
+      result.n_overflow = counters[0];
+      result.n_placed = n - counters[0];
+      result.n_failed = counters[1];
+
+      cudaFree(counters);
+
+      cudaFree(sorted_vals);
+      cudaFree(sorted_keys);
+      cudaFree(offsets);
+      cudaFree(permutation);
+      cudaFree(bucket_ids);
+
+      return result;
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_BULK_BUILD
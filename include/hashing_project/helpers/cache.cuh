@@ -16,6 +16,7 @@
 #include <hashing_project/helpers/ht_pairs.cuh>
 #include<hashing_project/helpers/cache_counters.cuh>
 #include <hashing_project/helpers/cache_cycle_counters.cuh>
+#include <hashing_project/helpers/pinned_pages.cuh>
 
 #include "assert.h"
 #include "stdio.h"
@@ -161,8 +162,8 @@ namespace hashing_project {
 
          host_version->fifo_queue = queue_type::generate_on_device(ext_cache_capacity);
 
-         //this uses cudaMallocHost in the backend so safe.
-         host_version->host_items = gallatin::utils::get_host_version<uint64_t>(ext_host_capacity);
+         //pinned - cudaMallocHost, or huge pages + cudaHostRegister under a huge page policy (helpers/pinned_pages.cuh).
+         host_version->host_items = hashing_project::helpers::get_host_version_paged<uint64_t>(ext_host_capacity);
 
          cudaMemset(host_version->host_items, 0, sizeof(uint64_t)*ext_host_capacity);
 
@@ -189,7 +190,7 @@ namespace hashing_project {
 
          ht_type::free_on_device(host_version->map);
 
-         cudaFreeHost(host_version->host_items);
+         hashing_project::helpers::free_host_paged(host_version->host_items);
 
          cudaFreeHost(host_version);
 
@@ -374,13 +375,15 @@ namespace hashing_project {
 
         uint64_t return_val;
 
-        map->stall_lock(my_tile, index_bucket);
+        //hits only read the bucket - shared mode lets hits on a hot key run together.
+        //insertion and eviction below still take the bucket exclusively.
+        map->stall_lock_shared(my_tile, index_bucket);
 
         if (map->find_with_reference_no_lock(my_tile, index, return_val)){
 
           ADD_QUERY
 
-          map->unlock(my_tile, index_bucket);
+          map->unlock_shared(my_tile, index_bucket);
 
           END_FAST_THROUGHPUT
 
@@ -390,7 +393,7 @@ namespace hashing_project {
 
         ADD_QUERY_NEGATIVE
 
-        map->unlock(my_tile, index_bucket);
+        map->unlock_shared(my_tile, index_bucket);
 
 
         uint64_t replace_index;
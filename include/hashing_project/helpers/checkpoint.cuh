@@ -0,0 +1,356 @@
+#ifndef HT_CHECKPOINT
+#define HT_CHECKPOINT
+
+//on-disk checkpoint format shared by every table's save_checkpoint(path) / load_checkpoint(path).
+//
+//  checkpoint_header                      - magic, format version, table name, key/val bytes,
+//                                           tile and bucket size, seed, bucket counts
+//  region 0 .. n                          - each a 64-byte aligned uint64_t byte count followed by
+//                                           the raw array, also 64-byte aligned
+//
+//Regions are the table's bucket / metadata arrays in a fixed per-table order (chaining writes
+//chain lengths plus the packed chain blocks, the iceberg tables add the backyard arrays).
+//Locks and seqlock versions are not stored: a checkpoint is taken from a quiescent table, so
+//load_checkpoint() generates fresh unlocked locks instead of copying them.
+//
+//checkpoint_reader mmaps the file (MAP_PRIVATE) and hands out pointers into the mapping. Host tables
+//point their arrays straight into it, writes go copy-on-write and the file is never modified.
+//Device tables copy each region with one cudaMemcpy (helpers/device_checkpoint.cuh).
+//
+//Mismatched magic, version, table name, key/val size, tile or bucket size fail the load, as does a
+//truncated file. save_checkpoint / load_checkpoint return false / nullptr and print the reason to stderr.
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   //"HTCHKPT\0"
+   static const uint64_t checkpoint_magic = 0x0054504B48435448ULL;
+
+   //bump when the header or any table's region order changes.
+   static const uint32_t checkpoint_version = 1;
+
+   static const uint64_t checkpoint_alignment = 64;
+
+
+   struct checkpoint_header {
+
+      uint64_t magic;
+      uint32_t version;
+      uint32_t header_bytes;
+
+      char table_name[64];
+
+      uint32_t key_bytes;
+      uint32_t val_bytes;
+      uint32_t tile_size;
+      uint32_t bucket_size;
+
+      uint64_t seed;
+      uint64_t n_buckets_primary;
+      uint64_t n_buckets_alt;
+
+   };
+
+
+   inline checkpoint_header make_checkpoint_header(const std::string & table_name, uint32_t key_bytes, uint32_t val_bytes, uint32_t tile_size, uint32_t bucket_size, uint64_t seed, uint64_t n_buckets_primary, uint64_t n_buckets_alt){
+
+      checkpoint_header header;
+
+      std::memset(&header, 0, sizeof(checkpoint_header));
+
+      header.magic = checkpoint_magic;
+      header.version = checkpoint_version;
+      header.header_bytes = sizeof(checkpoint_header);
+
+      std::strncpy(header.table_name, table_name.c_str(), sizeof(header.table_name)-1);
+
+      header.key_bytes = key_bytes;
+      header.val_bytes = val_bytes;
+      header.tile_size = tile_size;
+      header.bucket_size = bucket_size;
+
+      header.seed = seed;
+      header.n_buckets_primary = n_buckets_primary;
+      header.n_buckets_alt = n_buckets_alt;
+
+      return header;
+
+   }
+
+
+   //mapping owned by a host table restored with zero copy - released in free_on_host.
+   struct checkpoint_mapping {
+
+      void * base = nullptr;
+      uint64_t n_bytes = 0;
+
+      bool is_mapped() const {
+         return base != nullptr;
+      }
+
+      void unmap(){
+
+         if (base != nullptr) munmap(base, n_bytes);
+
+         base = nullptr;
+         n_bytes = 0;
+
+      }
+
+   };
+
+
+   struct checkpoint_writer {
+
+      FILE * file = nullptr;
+
+      uint64_t offset = 0;
+
+      std::string path;
+
+
+      bool fail(const char * reason){
+
+         fprintf(stderr, "checkpoint save %s: %s\n", path.c_str(), reason);
+
+         if (file != nullptr) fclose(file);
+
+         file = nullptr;
+
+         return false;
+
+      }
+
+      bool open(const std::string & ext_path, const checkpoint_header & header){
+
+         path = ext_path;
+
+         file = fopen(path.c_str(), "wb");
+
+         if (file == nullptr) return fail("could not open file");
+
+         offset = 0;
+
+         return write(&header, sizeof(checkpoint_header));
+
+      }
+
+      //raw append - regions larger than a staging buffer are written in pieces.
+      bool write(const void * data, uint64_t n_bytes){
+
+         if (file == nullptr) return false;
+
+         if (n_bytes != 0 && fwrite(data, 1, n_bytes, file) != n_bytes) return fail("short write");
+
+         offset += n_bytes;
+
+         return true;
+
+      }
+
+      bool pad(){
+
+         static const char zeros[checkpoint_alignment] = {0};
+
+         uint64_t n_pad = (checkpoint_alignment - offset % checkpoint_alignment) % checkpoint_alignment;
+
+         return write(zeros, n_pad);
+
+      }
+
+      //size prefix of the next region - follow with write() calls totalling n_bytes.
+      bool begin_region(uint64_t n_bytes){
+
+         return pad() && write(&n_bytes, sizeof(uint64_t)) && pad();
+
+      }
+
+      bool write_region(const void * data, uint64_t n_bytes){
+
+         return begin_region(n_bytes) && write(data, n_bytes);
+
+      }
+
+      bool close(){
+
+         if (file == nullptr) return false;
+
+         bool flushed = (fflush(file) == 0);
+
+         bool closed = (fclose(file) == 0);
+
+         file = nullptr;
+
+         if (!flushed || !closed){
+            fprintf(stderr, "checkpoint save %s: flush failed\n", path.c_str());
+            return false;
+         }
+
+         return true;
+
+      }
+
+   };
+
+
+   struct checkpoint_reader {
+
+      checkpoint_header header;
+
+      char * base = nullptr;
+
+      uint64_t file_bytes = 0;
+
+      uint64_t offset = 0;
+
+      std::string path;
+
+
+      bool fail(const char * reason){
+
+         fprintf(stderr, "checkpoint load %s: %s\n", path.c_str(), reason);
+
+         close();
+
+         return false;
+
+      }
+
+      //maps the file and checks the header against the table being loaded.
+      bool open(const std::string & ext_path, const std::string & table_name, uint32_t key_bytes, uint32_t val_bytes, uint32_t tile_size, uint32_t bucket_size){
+
+         path = ext_path;
+
+         int fd = ::open(path.c_str(), O_RDONLY);
+
+         if (fd < 0) return fail("could not open file");
+
+         struct stat file_stat;
+
+         if (fstat(fd, &file_stat) != 0){
+            ::close(fd);
+            return fail("could not stat file");
+         }
+
+         file_bytes = file_stat.st_size;
+
+         if (file_bytes < sizeof(checkpoint_header)){
+            ::close(fd);
+            return fail("file too small for a header");
+         }
+
+         void * mapped = mmap(nullptr, file_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+
+         ::close(fd);
+
+         if (mapped == MAP_FAILED) return fail("mmap failed");
+
+         base = (char *) mapped;
+
+         std::memcpy(&header, base, sizeof(checkpoint_header));
+
+         offset = sizeof(checkpoint_header);
+
+         if (header.magic != checkpoint_magic) return fail("not a table checkpoint");
+
+         if (header.version != checkpoint_version || header.header_bytes != sizeof(checkpoint_header)) return fail("unsupported checkpoint version");
+
+         if (std::strncmp(header.table_name, table_name.c_str(), sizeof(header.table_name)) != 0) return fail("checkpoint is for a different table");
+
+         if (header.key_bytes != key_bytes || header.val_bytes != val_bytes || header.tile_size != tile_size || header.bucket_size != bucket_size) return fail("key/val, tile or bucket size differs");
+
+         return true;
+
+      }
+
+      void skip_pad(){
+         offset += (checkpoint_alignment - offset % checkpoint_alignment) % checkpoint_alignment;
+      }
+
+      //pointer to the next region's data inside the mapping, nullptr if its size is not n_bytes.
+      char * next_region(uint64_t n_bytes){
+
+         if (base == nullptr) return nullptr;
+
+         skip_pad();
+
+         if (offset + sizeof(uint64_t) > file_bytes){
+            fail("truncated region header");
+            return nullptr;
+         }
+
+         uint64_t region_bytes;
+
+         std::memcpy(&region_bytes, base+offset, sizeof(uint64_t));
+
+         offset += sizeof(uint64_t);
+
+         skip_pad();
+
+         if (region_bytes != n_bytes){
+            fail("region size does not match the header");
+            return nullptr;
+         }
+
+         if (offset + n_bytes > file_bytes){
+            fail("truncated region");
+            return nullptr;
+         }
+
+         char * region = base + offset;
+
+         offset += n_bytes;
+
+         return region;
+
+      }
+
+      //zero copy restore - the table keeps the mapping and unmaps it when freed.
+      checkpoint_mapping release(){
+
+         checkpoint_mapping mapping;
+
+         mapping.base = base;
+         mapping.n_bytes = file_bytes;
+
+         base = nullptr;
+         file_bytes = 0;
+
+         return mapping;
+
+      }
+
+      void close(){
+
+         if (base != nullptr) munmap(base, file_bytes);
+
+         base = nullptr;
+         file_bytes = 0;
+
+      }
+
+      ~checkpoint_reader(){
+         close();
+      }
+
+   };
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_CHECKPOINT
@@ -0,0 +1,198 @@
+#ifndef HT_CONDITIONAL_OPS
+#define HT_CONDITIONAL_OPS
+
+//conditional and read-modify-write ops for the key-value tables.
+//
+// - insert_if_absent(tile, table, key, val)
+// - fetch_add / fetch_or(tile, table, key, delta, old_val)
+// - compare_exchange(tile, table, key, expected, desired, current_val)
+// - erase_if_value(tile, table, key, expected)
+// - erase_key_if(tile, table, key, pred)
+//
+//insert_if_absent and fetch_* run through the table's upsert_function: one traversal under one lock.
+//The functor tells the caller whether it ran on an existing pair (and what value it saw).
+//compare_exchange and erase_key_if must not insert, so they take the key's lock and probe with
+//find_pair_no_lock. erase_key_if removes with remove_no_lock under the same lock, so only a
+//successful erase traverses a second time.
+//
+//Works with every table that has upsert_function, find_pair_no_lock and remove_no_lock:
+//p2_ext, p2_inv, md_p2, double, md_double, iht_p2, iht_p2_metadata_full, iht_p2_metadata_quotient,
+//cuckoo, hopscotch, chaining. The quotient iceberg has no pair in its frontyard, so its
+//find_pair_no_lock and upsert_function hand out a value slot - these ops only touch ->val.
+//
+//Every lane of the tile must call these and gets the same result.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+#include <hashing_project/helpers/ht_load.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   //true if (key, val) was inserted. False if key was already present (its value is untouched)
+   //or the table had no room.
+   template <typename ht_type, typename tile_type, typename Key, typename Val>
+   __device__ bool insert_if_absent(const tile_type & my_tile, ht_type * table, const Key & key, const Val & val){
+
+      bool existed = false;
+
+      bool upserted = table->upsert_function(my_tile, key, val, [&](auto * pair, Key, Val){
+         existed = true;
+      });
+
+      return upserted && !my_tile.ballot(existed);
+
+   }
+
+
+   //runs under the key's lock, so a load and a release store are enough. Version bumps from
+   //the lock keep lock-free readers coherent.
+   template <typename ht_type, typename tile_type, typename Key, typename Val, typename modify_type>
+   __device__ bool fetch_modify(const tile_type & my_tile, ht_type * table, const Key & key, const Val & operand, Val & old_val, modify_type modify){
+
+      bool existed = false;
+
+      Val prior {};
+
+      table->upsert_function(my_tile, key, operand, [&](auto * pair, Key, Val){
+
+         prior = hash_table_load(&pair->val);
+
+         ht_store(&pair->val, modify(prior, operand));
+
+         existed = true;
+
+      });
+
+      auto existed_ballot = my_tile.ballot(existed);
+
+      if (!existed_ballot) return false;
+
+      old_val = my_tile.shfl(prior, __ffs(existed_ballot)-1);
+
+      return true;
+
+   }
+
+
+   //old_val is the value before the add. A missing key is inserted with delta and false is
+   //returned (old_val untouched) - same if the table is full.
+   template <typename ht_type, typename tile_type, typename Key, typename Val>
+   __device__ bool fetch_add(const tile_type & my_tile, ht_type * table, const Key & key, const Val & delta, Val & old_val){
+
+      return fetch_modify(my_tile, table, key, delta, old_val, [](Val current, Val operand){
+         return (Val) (current + operand);
+      });
+
+   }
+
+
+   template <typename ht_type, typename tile_type, typename Key, typename Val>
+   __device__ bool fetch_or(const tile_type & my_tile, ht_type * table, const Key & key, const Val & bits, Val & old_val){
+
+      return fetch_modify(my_tile, table, key, bits, old_val, [](Val current, Val operand){
+         return (Val) (current | operand);
+      });
+
+   }
+
+
+   //key's value becomes desired if it equals expected. current_val gets the value seen, so a
+   //failed exchange can retry from it. A missing key returns false with current_val untouched.
+   template <typename ht_type, typename tile_type, typename Key, typename Val>
+   __device__ bool compare_exchange(const tile_type & my_tile, ht_type * table, const Key & key, const Val & expected, const Val & desired, Val & current_val){
+
+      uint64_t lock_bucket = table->get_lock_bucket(my_tile, key);
+
+      table->stall_lock(my_tile, lock_bucket);
+
+      auto * pair = table->find_pair_no_lock(my_tile, key);
+
+      bool exchanged = false;
+
+      if (pair != nullptr){
+
+         Val seen {};
+
+         if (my_tile.thread_rank() == 0){
+
+            seen = hash_table_load(&pair->val);
+
+            if (seen == expected){
+               ht_store(&pair->val, desired);
+               exchanged = true;
+            }
+
+         }
+
+         current_val = my_tile.shfl(seen, 0);
+
+         exchanged = my_tile.shfl(exchanged, 0);
+
+      }
+
+      table->unlock(my_tile, lock_bucket);
+
+      return exchanged;
+
+   }
+
+
+   //removes key only if pred(key, val) holds for its current value. pred runs on one lane.
+   template <typename ht_type, typename tile_type, typename Key, typename pred_type>
+   __device__ bool erase_key_if(const tile_type & my_tile, ht_type * table, const Key & key, pred_type pred){
+
+      uint64_t lock_bucket = table->get_lock_bucket(my_tile, key);
+
+      table->stall_lock(my_tile, lock_bucket);
+
+      auto * pair = table->find_pair_no_lock(my_tile, key);
+
+      bool erased = false;
+
+      if (pair != nullptr){
+
+         bool matches = false;
+
+         if (my_tile.thread_rank() == 0){
+            matches = pred(key, hash_table_load(&pair->val));
+         }
+
+         if (my_tile.shfl(matches, 0)){
+            erased = table->remove_no_lock(my_tile, key);
+         }
+
+      }
+
+      table->unlock(my_tile, lock_bucket);
+
+      return erased;
+
+   }
+
+
+   //removes key only if its value equals expected.
+   template <typename ht_type, typename tile_type, typename Key, typename Val>
+   __device__ bool erase_if_value(const tile_type & my_tile, ht_type * table, const Key & key, const Val & expected){
+
+      return erase_key_if(my_tile, table, key, [&](const Key &, const Val & current){
+         return current == expected;
+      });
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_CONDITIONAL_OPS
@@ -0,0 +1,78 @@
+#ifndef HT_DEVICE_CHECKPOINT
+#define HT_DEVICE_CHECKPOINT
+
+//device side of helpers/checkpoint.cuh.
+//
+// - write_device_region(writer, dev_ptr, n_bytes)   stages the array through a pinned buffer, chunk by chunk
+// - read_device_region(reader, dev_ptr, n_bytes)    one cudaMemcpy straight from the mmapped file
+//
+//On restore the page cache backs the mapping, so a warm checkpoint is a single host to device copy
+//per region.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <hashing_project/helpers/checkpoint.cuh>
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   static const uint64_t checkpoint_staging_bytes = 64ULL*1024*1024;
+
+
+   __host__ inline bool write_device_region(checkpoint_writer & writer, const void * dev_ptr, uint64_t n_bytes){
+
+      if (!writer.begin_region(n_bytes)) return false;
+
+      uint64_t staging_bytes = n_bytes < checkpoint_staging_bytes ? n_bytes : checkpoint_staging_bytes;
+
+      if (staging_bytes == 0) return true;
+
+      char * staging;
+
+      if (cudaMallocHost((void **)&staging, staging_bytes) != cudaSuccess) return writer.fail("could not allocate staging buffer");
+
+      bool ok = true;
+
+      for (uint64_t offset = 0; offset < n_bytes && ok; offset += staging_bytes){
+
+         uint64_t chunk = n_bytes - offset < staging_bytes ? n_bytes - offset : staging_bytes;
+
+         if (cudaMemcpy(staging, (const char *) dev_ptr + offset, chunk, cudaMemcpyDeviceToHost) != cudaSuccess){
+            ok = writer.fail("device copy failed");
+            break;
+         }
+
+         ok = writer.write(staging, chunk);
+
+      }
+
+      cudaFreeHost(staging);
+
+      return ok;
+
+   }
+
+
+   __host__ inline bool read_device_region(checkpoint_reader & reader, void * dev_ptr, uint64_t n_bytes){
+
+      char * region = reader.next_region(n_bytes);
+
+      if (region == nullptr) return false;
+
+      if (cudaMemcpy(dev_ptr, region, n_bytes, cudaMemcpyHostToDevice) != cudaSuccess) return reader.fail("device copy failed");
+
+      return true;
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_DEVICE_CHECKPOINT
@@ -0,0 +1,137 @@
+#ifndef HT_HOST_AGGREGATION
+#define HT_HOST_AGGREGATION
+
+//host equivalent of helpers/key_aggregation.cuh.
+//
+//host_batch_upsert splits the batch into blocks of block_size ops, one block per task.
+//With aggregation on, each block is sorted by key (stable, so batch order survives within a key).
+//Duplicates are folded and only one table op is issued per distinct key in the block.
+//
+//Only the C++ standard library is used, same as the host tables.
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/ht_pairs.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   //last writer (highest batch index) wins.
+   struct host_replace_aggregation {
+
+      template <typename Val>
+      static Val combine(Val older, Val newer){
+         return newer;
+      }
+
+      template <typename table_type, typename Key, typename Val>
+      static bool issue(table_type * table, const Key & key, const Val & val){
+         return table->upsert_replace(key, val);
+      }
+
+   };
+
+
+   template <typename Key, typename Val>
+   struct host_add_aggregation {
+
+      static Val combine(Val older, Val newer){
+         return older + newer;
+      }
+
+      //runs under the stripe lock - the release store keeps lock-free readers coherent.
+      static void add_to_pair(hashing_project::tables::ht_pair<Key, Val> * location, Key key, Val val){
+         ht_store_rel(&location->val, (Val) (location->val + val));
+      }
+
+      template <typename table_type>
+      static bool issue(table_type * table, const Key & key, const Val & val){
+         return table->upsert_function(key, val, &add_to_pair);
+      }
+
+   };
+
+
+   //returns the number of table ops issued - n_ops minus that is the lock acquisitions saved.
+   template <typename aggregation, typename table_type, typename Key, typename Val>
+   inline uint64_t host_batch_upsert(table_type * table, const Key * keys, const Val * vals, uint64_t n_ops, uint32_t n_threads, bool aggregate = true, uint64_t block_size = 1024){
+
+      if (n_ops == 0) return 0;
+
+      if (block_size == 0) block_size = 1;
+
+      std::atomic<uint64_t> n_issued(0);
+
+      uint64_t n_blocks = (n_ops-1)/block_size+1;
+
+      parallel_for(n_threads, n_blocks, [&](uint64_t block){
+
+         uint64_t start = block*block_size;
+         uint64_t end = std::min(start+block_size, n_ops);
+
+         if (!aggregate){
+
+            for (uint64_t i = start; i < end; i++){
+               aggregation::issue(table, keys[i], vals[i]);
+            }
+
+            n_issued.fetch_add(end-start, std::memory_order_relaxed);
+
+            return;
+
+         }
+
+         std::vector<uint64_t> order(end-start);
+
+         for (uint64_t i = start; i < end; i++){
+            order[i-start] = i;
+         }
+
+         std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b){
+            return keys[a] < keys[b];
+         });
+
+         uint64_t issued = 0;
+
+         uint64_t run_start = 0;
+
+         while (run_start < order.size()){
+
+            Key key = keys[order[run_start]];
+            Val folded = vals[order[run_start]];
+
+            uint64_t run_end = run_start+1;
+
+            while (run_end < order.size() && keys[order[run_end]] == key){
+               folded = aggregation::combine(folded, vals[order[run_end]]);
+               run_end++;
+            }
+
+            aggregation::issue(table, key, folded);
+            issued++;
+
+            run_start = run_end;
+
+         }
+
+         n_issued.fetch_add(issued, std::memory_order_relaxed);
+
+      });
+
+      return n_issued.load();
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_AGGREGATION
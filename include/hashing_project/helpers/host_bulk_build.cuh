@@ -0,0 +1,123 @@
+#ifndef HT_HOST_BULK_BUILD
+#define HT_HOST_BULK_BUILD
+
+//host equivalent of helpers/bulk_build.cuh, for the host swiss table.
+//
+//The sort by bucket is a single-digit radix (counting) sort: parallel histogram of the target
+//buckets, exclusive scan, parallel scatter of the batch indices. Each worker then fills whole
+//groups with plain stores, and a second pass inserts the overflow with upsert_replace.
+//Same preconditions as the device build: fresh table, distinct keys, no concurrent access.
+
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <atomic>
+
+#include <hashing_project/helpers/host_utils.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   struct bulk_build_result {
+
+      uint64_t n_placed;
+      uint64_t n_overflow;
+      uint64_t n_failed;
+
+   };
+
+
+   template <typename table_type, typename Key, typename Val>
+   inline bulk_build_result bulk_build(table_type * table, const Key * keys, const Val * vals, uint64_t n, uint32_t n_threads = get_default_n_threads()){
+
+      static const uint64_t bucket_size = table_type::bulk_bucket_size;
+
+      uint64_t n_buckets = table->get_n_bulk_buckets();
+
+      std::vector<uint64_t> bucket_ids(n);
+
+      std::vector<std::atomic<uint64_t>> cursors(n_buckets);
+
+      parallel_for(n_threads, n_buckets, [&](uint64_t bucket){
+         cursors[bucket].store(0, std::memory_order_relaxed);
+      });
+
+      parallel_for(n_threads, n, [&](uint64_t i){
+
+         bucket_ids[i] = table->get_bulk_bucket(keys[i]);
+
+         cursors[bucket_ids[i]].fetch_add(1, std::memory_order_relaxed);
+
+      });
+
+      std::vector<uint64_t> offsets(n_buckets+1, 0);
+
+      for (uint64_t bucket = 0; bucket < n_buckets; bucket++){
+         offsets[bucket] = cursors[bucket].load(std::memory_order_relaxed);
+      }
+
+      std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), (uint64_t) 0);
+
+      for (uint64_t bucket = 0; bucket < n_buckets; bucket++){
+         cursors[bucket].store(offsets[bucket], std::memory_order_relaxed);
+      }
+
+      std::vector<uint64_t> permutation(n);
+
+      parallel_for(n_threads, n, [&](uint64_t i){
+         permutation[cursors[bucket_ids[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+      });
+
+      std::atomic<uint64_t> n_overflow(0);
+
+      parallel_for(n_threads, n_buckets, [&](uint64_t bucket){
+
+         Key bucket_keys[bucket_size];
+         Val bucket_vals[bucket_size];
+
+         uint64_t n_pairs = offsets[bucket+1]-offsets[bucket];
+
+         uint64_t n_fit = n_pairs < bucket_size ? n_pairs : bucket_size;
+
+         for (uint64_t i = 0; i < n_fit; i++){
+            bucket_keys[i] = keys[permutation[offsets[bucket]+i]];
+            bucket_vals[i] = vals[permutation[offsets[bucket]+i]];
+         }
+
+         table->bulk_fill_bucket(bucket, bucket_keys, bucket_vals, n_fit);
+
+         if (n_pairs > n_fit) n_overflow.fetch_add(n_pairs-n_fit, std::memory_order_relaxed);
+
+      });
+
+      std::atomic<uint64_t> n_failed(0);
+
+      if (n_overflow.load() != 0){
+
+         parallel_for(n_threads, n_buckets, [&](uint64_t bucket){
+
+            for (uint64_t i = offsets[bucket]+bucket_size; i < offsets[bucket+1]; i++){
+
+               uint64_t index = permutation[i];
+
+               if (!table->upsert_replace(keys[index], vals[index])) n_failed.fetch_add(1, std::memory_order_relaxed);
+
+            }
+
+         });
+
+      }
+
+      return bulk_build_result{n - n_overflow.load(), n_overflow.load(), n_failed.load()};
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_BULK_BUILD
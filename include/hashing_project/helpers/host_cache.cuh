@@ -15,6 +15,7 @@
 
 #include<hashing_project/helpers/cache_counters.cuh>
 #include <hashing_project/helpers/cache_cycle_counters.cuh>
+#include <hashing_project/helpers/pinned_pages.cuh>
 
 #include "assert.h"
 #include "stdio.h"
@@ -81,8 +82,8 @@ namespace hashing_project {
 
          printf("Starting test with hash table host cache\n");
 
-         //this uses cudaMallocHost in the backend so safe.
-         host_version->host_items = gallatin::utils::get_host_version<uint64_t>(ext_host_capacity);
+         //pinned - cudaMallocHost, or huge pages + cudaHostRegister under a huge page policy (helpers/pinned_pages.cuh).
+         host_version->host_items = hashing_project::helpers::get_host_version_paged<uint64_t>(ext_host_capacity);
 
          cudaMemset(host_version->host_items, 0, sizeof(uint64_t)*ext_host_capacity);
 
@@ -105,7 +106,7 @@ namespace hashing_project {
 
          my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
 
-         cudaFreeHost(host_version->host_items);
+         hashing_project::helpers::free_host_paged(host_version->host_items);
 
          cudaFreeHost(host_version);
 
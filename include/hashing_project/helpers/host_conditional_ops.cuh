@@ -0,0 +1,142 @@
+#ifndef HT_HOST_CONDITIONAL_OPS
+#define HT_HOST_CONDITIONAL_OPS
+
+//host equivalent of helpers/conditional_ops.cuh, for the host tables with upsert_function,
+//find_pair_no_lock and remove_no_lock (swiss, hopscotch).
+//
+//insert_if_absent and fetch_* are one upsert_function call. compare_exchange takes the key's stripe
+//lock and probes with find_pair_no_lock. erase_key_if / erase_if_value only need
+//find_with_reference_no_lock and remove_no_lock, so they also work on the quotient iceberg.
+
+#include <cstdint>
+
+#include <hashing_project/helpers/host_utils.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   template <typename table_type, typename Key, typename Val>
+   inline bool insert_if_absent(table_type * table, const Key & key, const Val & val){
+
+      bool existed = false;
+
+      bool upserted = table->upsert_function(key, val, [&](auto * pair, Key, Val){
+         existed = true;
+      });
+
+      return upserted && !existed;
+
+   }
+
+
+   template <typename table_type, typename Key, typename Val, typename modify_type>
+   inline bool fetch_modify(table_type * table, const Key & key, const Val & operand, Val & old_val, modify_type modify){
+
+      bool existed = false;
+
+      table->upsert_function(key, operand, [&](auto * pair, Key, Val){
+
+         old_val = ht_load_acq(&pair->val);
+
+         ht_store_rel(&pair->val, modify(old_val, operand));
+
+         existed = true;
+
+      });
+
+      return existed;
+
+   }
+
+
+   //missing key: inserted with delta, returns false.
+   template <typename table_type, typename Key, typename Val>
+   inline bool fetch_add(table_type * table, const Key & key, const Val & delta, Val & old_val){
+
+      return fetch_modify(table, key, delta, old_val, [](Val current, Val operand){
+         return (Val) (current + operand);
+      });
+
+   }
+
+
+   template <typename table_type, typename Key, typename Val>
+   inline bool fetch_or(table_type * table, const Key & key, const Val & bits, Val & old_val){
+
+      return fetch_modify(table, key, bits, old_val, [](Val current, Val operand){
+         return (Val) (current | operand);
+      });
+
+   }
+
+
+   template <typename table_type, typename Key, typename Val>
+   inline bool compare_exchange(table_type * table, const Key & key, const Val & expected, const Val & desired, Val & current_val){
+
+      uint64_t lock_bucket = table->get_lock_bucket(key);
+
+      table->stall_lock(lock_bucket);
+
+      auto * pair = table->find_pair_no_lock(key);
+
+      bool exchanged = false;
+
+      if (pair != nullptr){
+
+         current_val = ht_load_acq(&pair->val);
+
+         if (current_val == expected){
+            ht_store_rel(&pair->val, desired);
+            exchanged = true;
+         }
+
+      }
+
+      table->unlock(lock_bucket);
+
+      return exchanged;
+
+   }
+
+
+   //removes key only if pred(key, val) holds for its current value.
+   template <typename table_type, typename Key, typename pred_type>
+   inline bool erase_key_if(table_type * table, const Key & key, pred_type pred){
+
+      uint64_t lock_bucket = table->get_lock_bucket(key);
+
+      table->stall_lock(lock_bucket);
+
+      bool erased = false;
+
+      typename table_type::packed_pair_type current {};
+
+      if (table->find_with_reference_no_lock(key, current.val) && pred(key, current.val)){
+         erased = table->remove_no_lock(key);
+      }
+
+      table->unlock(lock_bucket);
+
+      return erased;
+
+   }
+
+
+   template <typename table_type, typename Key, typename Val>
+   inline bool erase_if_value(table_type * table, const Key & key, const Val & expected){
+
+      return erase_key_if(table, key, [&](const Key &, const Val & current){
+         return current == expected;
+      });
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_CONDITIONAL_OPS
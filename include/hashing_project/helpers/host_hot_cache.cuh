@@ -0,0 +1,155 @@
+#ifndef HT_HOST_HOT_CACHE
+#define HT_HOST_HOT_CACHE
+
+//host equivalent of helpers/hot_key_cache.cuh.
+//
+//host_space_saving_sketch - shared heavy hitter sketch, fed by sampled lookups from every thread.
+//host_hot_cache           - per-thread copy of the hot pairs. Each entry remembers the seqlock version
+//                           of its lock stripe (helpers/host_locks.cuh) and is only trusted while it is unchanged.
+//
+//Stripe versions only move with STABLE_HT_LOCKLESS_QUERY, so without it the cache never fills
+//and every lookup goes to the table.
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <hashing_project/helpers/host_locks.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   //sampled, so a mutex is cheaper than keeping the counters lock-free.
+   template <typename Key, uint32_t n_counters>
+   struct host_space_saving_sketch {
+
+      std::mutex sketch_lock;
+
+      Key keys[n_counters];
+      uint64_t counts[n_counters] = {};
+
+      void offer(Key key){
+
+         std::lock_guard<std::mutex> guard(sketch_lock);
+
+         uint32_t min_index = 0;
+
+         for (uint32_t i = 0; i < n_counters; i++){
+
+            if (counts[i] != 0 && keys[i] == key){
+               counts[i]++;
+               return;
+            }
+
+            if (counts[i] < counts[min_index]) min_index = i;
+
+         }
+
+         //space saving - the new key inherits the evicted count.
+         keys[min_index] = key;
+         counts[min_index]++;
+
+      }
+
+      //the n_hot most counted keys, hottest first.
+      std::vector<Key> get_hot_keys(uint32_t n_hot){
+
+         std::lock_guard<std::mutex> guard(sketch_lock);
+
+         std::vector<std::pair<uint64_t, Key>> ranked;
+
+         for (uint32_t i = 0; i < n_counters; i++){
+            if (counts[i] != 0) ranked.push_back(std::make_pair(counts[i], keys[i]));
+         }
+
+         std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint64_t, Key> & a, const std::pair<uint64_t, Key> & b){ return a.first > b.first; });
+
+         std::vector<Key> hot_keys;
+
+         for (uint32_t i = 0; i < n_hot && i < ranked.size(); i++){
+            hot_keys.push_back(ranked[i].second);
+         }
+
+         return hot_keys;
+
+      }
+
+   };
+
+
+   //one per thread - not thread safe.
+   template <typename Key, typename Val, uint32_t n_entries>
+   struct host_hot_cache {
+
+      Key keys[n_entries];
+      Val vals[n_entries];
+      host_spin_lock * stripes[n_entries];
+      uint32_t versions[n_entries];
+      bool valid[n_entries] = {};
+
+      //table needs get_lock_bucket(key) and a host_striped_locks member named locks.
+      template <typename table_type>
+      void fill(table_type * table, const std::vector<Key> & hot_keys){
+
+         for (uint32_t i = 0; i < n_entries; i++){
+
+            valid[i] = false;
+
+            #if STABLE_HT_LOCKLESS_QUERY
+
+            if (i >= hot_keys.size()) continue;
+
+            keys[i] = hot_keys[i];
+
+            uint64_t bucket = table->get_lock_bucket(keys[i]);
+
+            stripes[i] = &table->locks.locks[table->locks.get_stripe(bucket)];
+
+            versions[i] = stripes[i]->read_begin();
+
+            bool found = table->find_with_reference(keys[i], vals[i]);
+
+            //a write raced the load - leave the entry out.
+            valid[i] = found && stripes[i]->read_validate(versions[i]);
+
+            #endif
+
+         }
+
+      }
+
+      template <typename table_type>
+      bool find_with_reference(table_type * table, const Key & key, Val & val){
+
+         for (uint32_t i = 0; i < n_entries; i++){
+
+            if (!valid[i] || keys[i] != key) continue;
+
+            if (stripes[i]->version.load(std::memory_order_acquire) == versions[i]){
+               val = vals[i];
+               return true;
+            }
+
+            valid[i] = false;
+
+            break;
+
+         }
+
+         return table->find_with_reference(key, val);
+
+      }
+
+   };
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_HOT_CACHE
@@ -0,0 +1,205 @@
+#ifndef HT_HOST_LOCKS
+#define HT_HOST_LOCKS
+
+//host-side lock stripes for the CPU tables.
+//the device tables keep one bit per bucket in a packed uint64_t array, which is the
+//right call on the GPU but causes false sharing on a CPU. Here every stripe lives on
+//its own cache line and many buckets map to one stripe.
+//
+//Each stripe also carries a seqlock version, the host side of helpers/bucket_versions.cuh.
+//With STABLE_HT_LOCKLESS_QUERY set the holder makes it odd while holding the stripe and
+//optimistic_query re-runs a lock-free probe until it sees the same even version on both sides.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include <hashing_project/helpers/host_utils.cuh>
+
+#define HOST_LOCK_LINE 64
+
+//same switch as helpers/ht_load.cuh - host-only builds don't include the device helpers.
+#ifndef STABLE_HT_LOCKLESS_QUERY
+#define STABLE_HT_LOCKLESS_QUERY 0
+#endif
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   struct alignas(HOST_LOCK_LINE) host_spin_lock {
+
+      std::atomic<uint32_t> word;
+
+      //even = stable, odd = holder is writing. Only moves with STABLE_HT_LOCKLESS_QUERY.
+      std::atomic<uint32_t> version;
+
+      char padding[HOST_LOCK_LINE-2*sizeof(std::atomic<uint32_t>)];
+
+      void init(){
+         word.store(0, std::memory_order_relaxed);
+         version.store(0, std::memory_order_relaxed);
+      }
+
+      bool try_lock(){
+
+         if (word.exchange(1, std::memory_order_acquire) != 0) return false;
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //only the holder writes the version.
+         version.store(version.load(std::memory_order_relaxed)+1, std::memory_order_relaxed);
+
+         //odd version must be visible before any slot write.
+         std::atomic_thread_fence(std::memory_order_release);
+
+         #endif
+
+         return true;
+
+      }
+
+      void lock(){
+
+         while (true){
+
+            if (try_lock()) return;
+
+            //spin on a plain load so waiting threads don't bounce the line.
+            while (word.load(std::memory_order_relaxed) != 0){
+               cpu_relax();
+            }
+
+         }
+
+      }
+
+      void unlock(){
+
+         #if STABLE_HT_LOCKLESS_QUERY
+         version.store(version.load(std::memory_order_relaxed)+1, std::memory_order_release);
+         #endif
+
+         word.store(0, std::memory_order_release);
+
+      }
+
+      //reader side - wait out a write in progress, return the even version.
+      uint32_t read_begin(){
+
+         while (true){
+
+            uint32_t current = version.load(std::memory_order_acquire);
+
+            if (!(current & 1U)) return current;
+
+            cpu_relax();
+
+         }
+
+      }
+
+      //true if no writer held the stripe since read_begin returned start_version.
+      bool read_validate(uint32_t start_version){
+
+         //probe loads must complete before the version is re-read.
+         std::atomic_thread_fence(std::memory_order_acquire);
+
+         return version.load(std::memory_order_relaxed) == start_version;
+
+      }
+
+   };
+
+
+   //fixed pool of lock stripes, bucket -> bucket % n_locks.
+   struct host_striped_locks {
+
+      host_spin_lock * locks;
+      uint64_t n_locks;
+
+      void init(uint64_t ext_n_locks){
+
+         n_locks = ext_n_locks;
+
+         if (n_locks == 0) n_locks = 1;
+
+         locks = (host_spin_lock *) std::aligned_alloc(HOST_LOCK_LINE, sizeof(host_spin_lock)*n_locks);
+
+         if (locks == nullptr) throw std::bad_alloc();
+
+         for (uint64_t i = 0; i < n_locks; i++){
+            locks[i].init();
+         }
+
+      }
+
+      void free_locks(){
+         std::free(locks);
+         locks = nullptr;
+      }
+
+      uint64_t get_stripe(uint64_t bucket){
+         return bucket % n_locks;
+      }
+
+      void lock(uint64_t bucket){
+         locks[get_stripe(bucket)].lock();
+      }
+
+      void unlock(uint64_t bucket){
+         locks[get_stripe(bucket)].unlock();
+      }
+
+      bool try_lock(uint64_t bucket){
+         return locks[get_stripe(bucket)].try_lock();
+      }
+
+      //run query() until it completes without a writer holding bucket's stripe.
+      //query may run more than once, so it must only write its output arguments.
+      //with the policy off this is a plain call.
+      template <typename query_type>
+      bool optimistic_query(uint64_t bucket, query_type && query){
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         host_spin_lock * stripe = &locks[get_stripe(bucket)];
+
+         while (true){
+
+            uint32_t start_version = stripe->read_begin();
+
+            bool found = query();
+
+            if (stripe->read_validate(start_version)) return found;
+
+         }
+
+         #else
+
+         return query();
+
+         #endif
+
+      }
+
+      //buckets sharing a stripe share a lock - a holder of one must not re-acquire for the other.
+      bool same_stripe(uint64_t bucket_a, uint64_t bucket_b){
+         return get_stripe(bucket_a) == get_stripe(bucket_b);
+      }
+
+      uint64_t get_space_usage(){
+         return n_locks*sizeof(host_spin_lock);
+      }
+
+   };
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_LOCKS
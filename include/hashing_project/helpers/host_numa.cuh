@@ -0,0 +1,266 @@
+#ifndef HT_HOST_NUMA
+#define HT_HOST_NUMA
+
+//NUMA placement helpers for the host tables, Linux only and without libnuma.
+//
+// - numa_topology: online nodes and their CPUs from /sys/devices/system/node, restricted to the
+//   CPUs this process may run on. If sysfs is missing or no node has usable CPUs, this falls
+//   back to a single node holding every allowed CPU, so everything below still works on one node.
+// - pin_thread_to_node: sets the calling thread's affinity to the node's CPUs.
+// - parallel_for_on_node: parallel_for whose workers are pinned to one node.
+// - bind_memory_to_node: mbind(MPOL_BIND) over a range. Pages touched afterwards are placed on
+//   the node, and pages already placed are migrated.
+// - get_memory_node: the node that currently backs a page (move_pages query), -1 if unknown.
+//
+//Memory placement is first-touch: a table generated on a pinned thread is initialized by that
+//thread, so its pages land on that node. bind_memory_to_node is for memory that was already touched
+//somewhere else, such as a checkpoint mapping.
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include <hashing_project/helpers/host_utils.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   //"0-3,8-11" -> {0,1,2,3,8,9,10,11}
+   inline std::vector<int> parse_cpu_list(const std::string & list){
+
+      std::vector<int> cpus;
+
+      std::stringstream stream(list);
+
+      std::string range;
+
+      while (std::getline(stream, range, ',')){
+
+         if (range.empty() || range == "\n") continue;
+
+         size_t dash = range.find('-');
+
+         int first = std::stoi(range.substr(0, dash));
+         int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash+1));
+
+         for (int cpu = first; cpu <= last; cpu++){
+            cpus.push_back(cpu);
+         }
+
+      }
+
+      return cpus;
+
+   }
+
+
+   struct numa_topology {
+
+      //node_ids[i] is the OS node number of the i'th node, node_cpus[i] its usable CPUs.
+      std::vector<int> node_ids;
+      std::vector<std::vector<int>> node_cpus;
+
+      uint32_t get_n_nodes() const {
+         return node_ids.size();
+      }
+
+      static numa_topology detect(){
+
+         numa_topology topology;
+
+         cpu_set_t allowed;
+
+         CPU_ZERO(&allowed);
+
+         bool have_mask = (sched_getaffinity(0, sizeof(allowed), &allowed) == 0);
+
+         auto is_allowed = [&](int cpu){
+            return !have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+         };
+
+         std::ifstream online_file("/sys/devices/system/node/online");
+
+         std::string online;
+
+         if (online_file && std::getline(online_file, online)){
+
+            for (int node : parse_cpu_list(online)){
+
+               std::ifstream cpu_file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+
+               std::string cpu_list;
+
+               if (!cpu_file || !std::getline(cpu_file, cpu_list)) continue;
+
+               std::vector<int> cpus;
+
+               for (int cpu : parse_cpu_list(cpu_list)){
+                  if (is_allowed(cpu)) cpus.push_back(cpu);
+               }
+
+               //memory-only nodes (CXL, HBM) and nodes outside our cpuset get no workers.
+               if (cpus.empty()) continue;
+
+               topology.node_ids.push_back(node);
+               topology.node_cpus.push_back(cpus);
+
+            }
+
+         }
+
+         if (topology.node_ids.empty()){
+
+            std::vector<int> cpus;
+
+            uint32_t n_cpus = get_default_n_threads();
+
+            for (int cpu = 0; cpu < CPU_SETSIZE && cpus.size() < n_cpus; cpu++){
+               if (is_allowed(cpu)) cpus.push_back(cpu);
+            }
+
+            topology.node_ids.push_back(0);
+            topology.node_cpus.push_back(cpus);
+
+         }
+
+         return topology;
+
+      }
+
+      void print(){
+
+         for (uint32_t i = 0; i < get_n_nodes(); i++){
+            printf("numa node %d: %lu cpus\n", node_ids[i], node_cpus[i].size());
+         }
+
+      }
+
+   };
+
+
+   //node is an index into the topology, not the OS node number. Returns false if the affinity could not be set.
+   inline bool pin_thread_to_node(const numa_topology & topology, uint32_t node){
+
+      cpu_set_t cpus;
+
+      CPU_ZERO(&cpus);
+
+      for (int cpu : topology.node_cpus[node]){
+         CPU_SET(cpu, &cpus);
+      }
+
+      return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+
+   }
+
+
+   //parallel_for with every worker pinned to node. Always spawns threads, even for one item,
+   //so the caller's own affinity is never changed.
+   template <typename func_type>
+   inline void parallel_for_on_node(const numa_topology & topology, uint32_t node, uint32_t n_threads, uint64_t n_items, func_type func){
+
+      if (n_threads == 0) n_threads = 1;
+
+      std::vector<std::thread> workers;
+      workers.reserve(n_threads);
+
+      uint64_t items_per_thread = n_items == 0 ? 0 : (n_items-1)/n_threads+1;
+
+      for (uint32_t t = 0; t < n_threads; t++){
+
+         uint64_t start = t*items_per_thread;
+         uint64_t end = start + items_per_thread;
+
+         if (end > n_items) end = n_items;
+         if (start >= end) break;
+
+         workers.emplace_back([start, end, node, &topology, &func](){
+
+            pin_thread_to_node(topology, node);
+
+            for (uint64_t i = start; i < end; i++){
+               func(i);
+            }
+
+         });
+
+      }
+
+      for (auto & worker : workers){
+         worker.join();
+      }
+
+   }
+
+
+   //MPOL_BIND / MPOL_MF_MOVE from <numaif.h>, spelled out so libnuma headers are not needed.
+   inline bool bind_memory_to_node(const numa_topology & topology, void * address, uint64_t n_bytes, uint32_t node){
+
+      #if defined(SYS_mbind)
+
+      const int mpol_bind = 2;
+      const unsigned mpol_mf_move = (1 << 1);
+
+      int os_node = topology.node_ids[node];
+
+      std::vector<unsigned long> node_mask(os_node/(8*sizeof(unsigned long))+1, 0);
+
+      node_mask[os_node/(8*sizeof(unsigned long))] |= 1UL << (os_node % (8*sizeof(unsigned long)));
+
+      uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+      uint64_t start = ((uint64_t) address) & ~(page_size-1);
+      uint64_t end = (uint64_t) address + n_bytes;
+
+      return syscall(SYS_mbind, start, end-start, mpol_bind, node_mask.data(), node_mask.size()*8*sizeof(unsigned long)+1, mpol_mf_move) == 0;
+
+      #else
+
+      return false;
+
+      #endif
+
+   }
+
+
+   //OS node backing the page at address, -1 if not resident or unknown.
+   inline int get_memory_node(const void * address){
+
+      #if defined(SYS_move_pages)
+
+      uint64_t page_size = sysconf(_SC_PAGESIZE);
+
+      void * page = (void *) (((uint64_t) address) & ~(page_size-1));
+
+      int status = -1;
+
+      if (syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) != 0) return -1;
+
+      return status < 0 ? -1 : status;
+
+      #else
+
+      return -1;
+
+      #endif
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_NUMA
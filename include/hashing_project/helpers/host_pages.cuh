@@ -0,0 +1,257 @@
+#ifndef HT_HOST_PAGES
+#define HT_HOST_PAGES
+
+//page size policy for large host allocations - table arrays, cache host_items, benchmark buffers.
+//
+// - host_alloc(n_bytes[, alignment, policy]) / host_free(ptr): drop-in for std::aligned_alloc / std::free.
+//   alignment defaults to a cache line and must be at most 4KB.
+// - page_policy:
+//      base_pages   std::aligned_alloc, the old behavior and the default,
+//      transparent  2MB aligned anonymous mmap + madvise(MADV_HUGEPAGE), huge pages if THP allows,
+//      huge_2mb     mmap(MAP_HUGETLB | MAP_HUGE_2MB) from the preallocated hugetlbfs pool,
+//      huge_1gb     mmap(MAP_HUGETLB | MAP_HUGE_1GB).
+//   Each one falls back to the next weaker one (1gb -> 2mb -> transparent -> base) if the kernel
+//   refuses, e.g. when the pool is empty.
+//   Allocations under 2MB always use base pages.
+// - the process default comes from set_host_page_policy() or the HT_HOST_PAGES environment variable
+//   (base, thp, 2mb, 1gb), read on first use.
+// - get_host_page_backing(ptr): the policy an allocation actually got.
+// - get_thp_bytes(): AnonHugePages of this process, i.e. how much THP actually delivered.
+//
+//Random probes over tens of GB miss the TLB on nearly every access with 4KB pages. A 2MB page covers
+//512x the memory per TLB entry.
+//mmap'd memory is zeroed by the kernel. Base pages are not - the tables initialize their arrays anyway.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include <unordered_map>
+#include <fstream>
+
+#include <sys/mman.h>
+
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT 26
+#endif
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   enum class page_policy {base_pages, transparent, huge_2mb, huge_1gb};
+
+
+   inline const char * get_page_policy_name(page_policy policy){
+
+      switch (policy){
+         case page_policy::transparent: return "thp";
+         case page_policy::huge_2mb: return "2mb";
+         case page_policy::huge_1gb: return "1gb";
+         default: return "base";
+      }
+
+   }
+
+   inline page_policy parse_page_policy(std::string name){
+
+      if (name == "thp") return page_policy::transparent;
+      if (name == "2mb") return page_policy::huge_2mb;
+      if (name == "1gb") return page_policy::huge_1gb;
+
+      return page_policy::base_pages;
+
+   }
+
+
+   inline page_policy & host_page_policy_storage(){
+
+      static page_policy policy = []{
+
+         const char * env = std::getenv("HT_HOST_PAGES");
+
+         return env == nullptr ? page_policy::base_pages : parse_page_policy(env);
+
+      }();
+
+      return policy;
+
+   }
+
+   inline page_policy get_host_page_policy(){
+      return host_page_policy_storage();
+   }
+
+   //affects allocations made afterwards - set it before generating tables.
+   inline void set_host_page_policy(page_policy policy){
+      host_page_policy_storage() = policy;
+   }
+
+
+   struct page_allocation {
+
+      //start and length of the whole mapping, which may begin before the returned pointer.
+      void * mapping;
+      uint64_t mapped_bytes;
+
+      page_policy backing;
+
+   };
+
+   //mmap'd allocations by returned pointer. Untracked pointers came from std::aligned_alloc.
+   inline std::unordered_map<void *, page_allocation> & page_allocations(){
+      static std::unordered_map<void *, page_allocation> allocations;
+      return allocations;
+   }
+
+   inline std::mutex & page_allocations_lock(){
+      static std::mutex lock;
+      return lock;
+   }
+
+
+   inline void * host_alloc(uint64_t n_bytes, uint64_t alignment = 64, page_policy policy = get_host_page_policy()){
+
+      const uint64_t huge_2mb = (1ULL << 21);
+      const uint64_t huge_1gb = (1ULL << 30);
+
+      if (policy == page_policy::base_pages || n_bytes < huge_2mb){
+         return std::aligned_alloc(alignment, ((n_bytes-1)/alignment+1)*alignment);
+      }
+
+      page_allocation allocation {MAP_FAILED, 0, policy};
+
+      void * ptr = nullptr;
+
+      if (allocation.backing == page_policy::huge_1gb){
+
+         allocation.mapped_bytes = ((n_bytes-1)/huge_1gb+1)*huge_1gb;
+
+         allocation.mapping = mmap(nullptr, allocation.mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+
+         if (allocation.mapping == MAP_FAILED) allocation.backing = page_policy::huge_2mb;
+
+      }
+
+      if (allocation.backing == page_policy::huge_2mb){
+
+         allocation.mapped_bytes = ((n_bytes-1)/huge_2mb+1)*huge_2mb;
+
+         allocation.mapping = mmap(nullptr, allocation.mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << MAP_HUGE_SHIFT), -1, 0);
+
+         if (allocation.mapping == MAP_FAILED) allocation.backing = page_policy::transparent;
+
+      }
+
+      if (allocation.backing == page_policy::transparent){
+
+         //over-map by 2MB so the returned range can start on a 2MB boundary - THP only maps aligned 2MB extents.
+         allocation.mapped_bytes = ((n_bytes-1)/huge_2mb+1)*huge_2mb + huge_2mb;
+
+         allocation.mapping = mmap(nullptr, allocation.mapped_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+         if (allocation.mapping == MAP_FAILED){
+            return std::aligned_alloc(alignment, ((n_bytes-1)/alignment+1)*alignment);
+         }
+
+         ptr = (void *) ((((uint64_t) allocation.mapping) + huge_2mb - 1) & ~(huge_2mb-1));
+
+         #ifdef MADV_HUGEPAGE
+         madvise(ptr, ((n_bytes-1)/huge_2mb+1)*huge_2mb, MADV_HUGEPAGE);
+         #endif
+
+      } else {
+         ptr = allocation.mapping;
+      }
+
+      std::lock_guard<std::mutex> guard(page_allocations_lock());
+
+      page_allocations()[ptr] = allocation;
+
+      return ptr;
+
+   }
+
+   template <typename T>
+   inline T * host_alloc_typed(uint64_t n_items, page_policy policy = get_host_page_policy()){
+      return (T *) host_alloc(sizeof(T)*n_items, alignof(T) > 64 ? alignof(T) : 64, policy);
+   }
+
+
+   inline void host_free(void * ptr){
+
+      if (ptr == nullptr) return;
+
+      {
+
+         std::lock_guard<std::mutex> guard(page_allocations_lock());
+
+         auto allocation = page_allocations().find(ptr);
+
+         if (allocation != page_allocations().end()){
+
+            munmap(allocation->second.mapping, allocation->second.mapped_bytes);
+
+            page_allocations().erase(allocation);
+
+            return;
+
+         }
+
+      }
+
+      std::free(ptr);
+
+   }
+
+
+   //what ptr (as returned by host_alloc) is backed by after fallbacks. transparent only means
+   //MADV_HUGEPAGE was applied - see AnonHugePages in /proc/self/smaps for what THP delivered.
+   inline page_policy get_host_page_backing(void * ptr){
+
+      std::lock_guard<std::mutex> guard(page_allocations_lock());
+
+      auto allocation = page_allocations().find(ptr);
+
+      if (allocation == page_allocations().end()) return page_policy::base_pages;
+
+      return allocation->second.backing;
+
+   }
+
+
+   //bytes of this process backed by transparent huge pages, 0 if /proc is unavailable.
+   inline uint64_t get_thp_bytes(){
+
+      std::ifstream smaps("/proc/self/smaps_rollup");
+
+      std::string field;
+
+      while (smaps >> field){
+
+         if (field == "AnonHugePages:"){
+
+            uint64_t kb = 0;
+
+            smaps >> kb;
+
+            return kb*1024;
+
+         }
+
+      }
+
+      return 0;
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_PAGES
@@ -0,0 +1,102 @@
+#ifndef HT_HOST_PERF
+#define HT_HOST_PERF
+
+//minimal perf_event_open counter for the host benchmarks, counting the calling process on all its threads.
+//
+// - perf_counter::dtlb_load_misses(): data TLB read misses,
+// - perf_counter::dtlb_loads(): data TLB read accesses.
+//
+//is_valid() is false when the kernel refuses the event (perf_event_paranoid, containers, VMs
+//without a PMU); start/stop are then no-ops and read() returns 0, so callers only need to check
+//is_valid() before printing.
+
+#include <cstdint>
+#include <cstring>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   struct perf_counter {
+
+      int fd;
+
+      perf_counter(uint32_t type, uint64_t config){
+
+         perf_event_attr attr;
+
+         std::memset(&attr, 0, sizeof(attr));
+
+         attr.size = sizeof(attr);
+         attr.type = type;
+         attr.config = config;
+         attr.disabled = 1;
+         attr.inherit = 1;
+         attr.exclude_kernel = 1;
+         attr.exclude_hv = 1;
+
+         fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+      }
+
+      ~perf_counter(){
+         if (fd >= 0) close(fd);
+      }
+
+      perf_counter(const perf_counter &) = delete;
+      perf_counter & operator=(const perf_counter &) = delete;
+
+      static uint64_t dtlb_config(uint64_t result){
+         return PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+      }
+
+      static perf_counter * dtlb_load_misses(){
+         return new perf_counter(PERF_TYPE_HW_CACHE, dtlb_config(PERF_COUNT_HW_CACHE_RESULT_MISS));
+      }
+
+      static perf_counter * dtlb_loads(){
+         return new perf_counter(PERF_TYPE_HW_CACHE, dtlb_config(PERF_COUNT_HW_CACHE_RESULT_ACCESS));
+      }
+
+      bool is_valid(){
+         return fd >= 0;
+      }
+
+      void start(){
+
+         if (fd < 0) return;
+
+         ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+         ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+
+      }
+
+      void stop(){
+         if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+      }
+
+      uint64_t read_count(){
+
+         uint64_t count = 0;
+
+         if (fd < 0 || ::read(fd, &count, sizeof(count)) != sizeof(count)) return 0;
+
+         return count;
+
+      }
+
+   };
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_PERF
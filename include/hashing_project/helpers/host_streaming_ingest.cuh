@@ -0,0 +1,84 @@
+#ifndef HT_HOST_STREAMING_INGEST
+#define HT_HOST_STREAMING_INGEST
+
+//host equivalent of helpers/streaming_ingest.cuh for the host tables.
+//
+//There is no transfer to hide on the host, so the stage that overlaps the inserts is the input
+//itself: produce(start, n_chunk, keys, vals) fills a chunk buffer (read a file, parse, generate).
+//One producer thread fills chunk i+1 while n_threads workers insert chunk i, double buffered.
+//Only two chunks are resident, so the input never has to be materialized in full.
+//Call as stream_ingest<Key, Val>(table, n, produce, ...). Returns the number of pairs upsert_replace placed.
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+#include <future>
+
+#include <hashing_project/helpers/host_utils.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   template <typename Key, typename Val, typename table_type, typename produce_type>
+   inline uint64_t stream_ingest(table_type * table, uint64_t n, produce_type produce, uint64_t chunk_size = (1ULL << 20), uint32_t n_threads = get_default_n_threads()){
+
+      if (n == 0) return 0;
+
+      if (chunk_size > n) chunk_size = n;
+
+      std::vector<Key> key_buffers[2] = {std::vector<Key>(chunk_size), std::vector<Key>(chunk_size)};
+      std::vector<Val> val_buffers[2] = {std::vector<Val>(chunk_size), std::vector<Val>(chunk_size)};
+
+      uint64_t n_chunks = (n-1)/chunk_size+1;
+
+      auto chunk_length = [&](uint64_t chunk){
+         return (n - chunk*chunk_size < chunk_size) ? n - chunk*chunk_size : chunk_size;
+      };
+
+      std::atomic<uint64_t> n_inserted(0);
+
+      std::future<void> pending = std::async(std::launch::async, [&](){
+         produce(0, chunk_length(0), key_buffers[0].data(), val_buffers[0].data());
+      });
+
+      for (uint64_t chunk = 0; chunk < n_chunks; chunk++){
+
+         uint slot = chunk % 2;
+
+         pending.wait();
+
+         if (chunk+1 < n_chunks){
+
+            uint next_slot = 1-slot;
+
+            //chunk and next_slot by value - the producer may start after this iteration's locals are gone.
+            pending = std::async(std::launch::async, [&, chunk, next_slot](){
+               produce((chunk+1)*chunk_size, chunk_length(chunk+1), key_buffers[next_slot].data(), val_buffers[next_slot].data());
+            });
+
+         }
+
+         Key * keys = key_buffers[slot].data();
+         Val * vals = val_buffers[slot].data();
+
+         parallel_for(n_threads, chunk_length(chunk), [&](uint64_t i){
+
+            if (table->upsert_replace(keys[i], vals[i])) n_inserted.fetch_add(1, std::memory_order_relaxed);
+
+         });
+
+      }
+
+      return n_inserted.load();
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_STREAMING_INGEST
@@ -0,0 +1,105 @@
+#ifndef HT_HOST_TABLE_EXPORT
+#define HT_HOST_TABLE_EXPORT
+
+//host equivalent of helpers/table_export.cuh, for the host tables (swiss, hopscotch, quotient iceberg).
+//
+//Count pass and write pass are parallel_for over the sweep buckets, with an exclusive scan of the
+//per-bucket counts in between. Each worker writes one contiguous range of the output.
+//Same quiescence rule and return values as the device export.
+
+#include <cstdint>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_table_sweep.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   static const uint64_t export_changed = ~0ULL;
+
+
+   template <typename table_type, typename Key, typename Val>
+   inline uint64_t export_pairs(table_type * table, Key * keys_out, Val * vals_out, uint64_t capacity, bool sort_by_key = false, uint32_t n_threads = get_default_n_threads()){
+
+      uint64_t n_buckets = table->get_n_sweep_buckets();
+
+      std::vector<uint64_t> offsets(n_buckets+1, 0);
+
+      parallel_for(n_threads, n_buckets, [&](uint64_t bucket){
+
+         uint64_t n_live = 0;
+
+         table->for_each_in_bucket(bucket, [&](const Key &, const Val &){
+            n_live++;
+         });
+
+         offsets[bucket] = n_live;
+
+      });
+
+      std::exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), (uint64_t) 0);
+
+      uint64_t total = offsets[n_buckets];
+
+      if (total > capacity) return total;
+
+      std::atomic<bool> changed(false);
+
+      parallel_for(n_threads, n_buckets, [&](uint64_t bucket){
+
+         uint64_t write_index = offsets[bucket];
+
+         table->for_each_in_bucket(bucket, [&](const Key & key, const Val & val){
+
+            //pairs added since the count pass don't fit.
+            if (write_index < offsets[bucket+1]){
+               keys_out[write_index] = key;
+               vals_out[write_index] = val;
+               write_index++;
+            }
+
+         });
+
+         if (write_index < offsets[bucket+1]) changed = true;
+
+      });
+
+      if (changed) return export_changed;
+
+      if (sort_by_key){
+
+         std::vector<std::pair<Key, Val>> sorted_pairs(total);
+
+         for (uint64_t i = 0; i < total; i++){
+            sorted_pairs[i] = {keys_out[i], vals_out[i]};
+         }
+
+         std::sort(sorted_pairs.begin(), sorted_pairs.end(), [](const std::pair<Key, Val> & a, const std::pair<Key, Val> & b){
+            return a.first < b.first;
+         });
+
+         for (uint64_t i = 0; i < total; i++){
+            keys_out[i] = sorted_pairs[i].first;
+            vals_out[i] = sorted_pairs[i].second;
+         }
+
+      }
+
+      return total;
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_TABLE_EXPORT
@@ -0,0 +1,69 @@
+#ifndef HT_HOST_TABLE_SWEEP
+#define HT_HOST_TABLE_SWEEP
+
+//host equivalent of helpers/table_sweep.cuh, for the host tables (swiss, hopscotch, quotient iceberg).
+//
+// - for_each(table, func, n_threads)   func(key, val) on every live pair
+// - erase_if(table, pred, n_threads)   removes every live pair with pred(key, val), returns the count
+//
+//parallel_for over the table's sweep buckets. Each table's for_each_in_bucket hook matches its
+//control bytes / tags first and only reads live slots, re-validating them like a lock-free reader.
+//No locks are held while sweeping, so queries and upserts can run alongside - same weak
+//consistency as the device sweep. erase_if rechecks each candidate under its stripe lock with
+//erase_key_if.
+//
+//func and pred run on n_threads workers at once and must be thread safe.
+
+#include <cstdint>
+#include <atomic>
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_conditional_ops.cuh>
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   template <typename table_type, typename func_type>
+   inline void for_each(table_type * table, func_type func, uint32_t n_threads = get_default_n_threads()){
+
+      parallel_for(n_threads, table->get_n_sweep_buckets(), [&](uint64_t bucket){
+
+         table->for_each_in_bucket(bucket, func);
+
+      });
+
+   }
+
+
+   template <typename table_type, typename pred_type>
+   inline uint64_t erase_if(table_type * table, pred_type pred, uint32_t n_threads = get_default_n_threads()){
+
+      std::atomic<uint64_t> n_erased {0};
+
+      parallel_for(n_threads, table->get_n_sweep_buckets(), [&](uint64_t bucket){
+
+         uint64_t my_erased = 0;
+
+         table->for_each_in_bucket(bucket, [&](const auto & key, const auto & val){
+
+            if (pred(key, val) && erase_key_if(table, key, pred)) my_erased++;
+
+         });
+
+         if (my_erased != 0) n_erased.fetch_add(my_erased, std::memory_order_relaxed);
+
+      });
+
+      return n_erased.load();
+
+   }
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_TABLE_SWEEP
@@ -0,0 +1,203 @@
+#ifndef HT_HOST_UTILS
+#define HT_HOST_UTILS
+
+//host-side helpers shared by the CPU tables in hashing_project/host_tables.
+//nothing in here touches the CUDA runtime so the host tables can be built
+//for CPU-only services.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+//same switch as ht_load.cuh - 1 = host p2 probes prefetch both candidate buckets up front.
+#ifndef P2_SPECULATIVE_LOAD
+#define P2_SPECULATIVE_LOAD 0
+#endif
+
+
+namespace hashing_project {
+
+namespace host {
+
+
+   //host-side murmurhash64a - bit-identical to the device hash() in each table
+   //so host and device tables place keys the same way for a given seed.
+   inline uint64_t hash(const void * key, int len, uint64_t seed){
+
+      const uint64_t m = 0xc6a4a7935bd1e995;
+      const int r = 47;
+
+      uint64_t h = seed ^ (len * m);
+
+      const uint64_t * data = (const uint64_t *)key;
+      const uint64_t * end = data + (len/8);
+
+      while(data != end)
+      {
+         uint64_t k = *data++;
+
+         k *= m;
+         k ^= k >> r;
+         k *= m;
+
+         h ^= k;
+         h *= m;
+      }
+
+      const unsigned char * data2 = (const unsigned char*)data;
+
+      switch(len & 7)
+      {
+         case 7: h ^= (uint64_t)data2[6] << 48;
+         case 6: h ^= (uint64_t)data2[5] << 40;
+         case 5: h ^= (uint64_t)data2[4] << 32;
+         case 4: h ^= (uint64_t)data2[3] << 24;
+         case 3: h ^= (uint64_t)data2[2] << 16;
+         case 2: h ^= (uint64_t)data2[1] << 8;
+         case 1: h ^= (uint64_t)data2[0];
+                     h *= m;
+      };
+
+      h ^= h >> r;
+      h *= m;
+      h ^= h >> r;
+
+      return h;
+   }
+
+
+   //acquire/release accessors for plain table memory.
+   //equivalent of hash_table_load / ht_store in ht_load.cuh.
+   template <typename T>
+   inline T ht_load_acq(const T * address){
+      return __atomic_load_n(address, __ATOMIC_ACQUIRE);
+   }
+
+   template <typename T>
+   inline void ht_store_rel(T * address, T store_val){
+      __atomic_store_n(address, store_val, __ATOMIC_RELEASE);
+   }
+
+   template <typename T>
+   inline bool ht_cas(T * address, T expected, T desired){
+      return __atomic_compare_exchange_n(address, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+   }
+
+
+   //software prefetch of every cache line in [address, address+n_bytes) - a hint, never faults.
+   inline void prefetch_read(const void * address, uint64_t n_bytes){
+
+      uint64_t start = ((uint64_t) address) & ~63ULL;
+      uint64_t end = (uint64_t) address + n_bytes;
+
+      for (uint64_t line = start; line < end; line += 64){
+         __builtin_prefetch((const void *) line, 0, 3);
+      }
+
+   }
+
+
+   inline void cpu_relax(){
+
+      #if defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+      #elif defined(__aarch64__)
+      asm volatile("yield" ::: "memory");
+      #endif
+
+   }
+
+
+   inline uint32_t get_default_n_threads(){
+
+      uint32_t n_threads = std::thread::hardware_concurrency();
+
+      if (n_threads == 0) return 1;
+
+      return n_threads;
+
+   }
+
+
+   //host equivalent of a kernel launch - split [0, n_items) into contiguous
+   //chunks and run func(tid) on each item with n_threads workers.
+   template <typename func_type>
+   inline void parallel_for(uint32_t n_threads, uint64_t n_items, func_type func){
+
+      if (n_threads <= 1 || n_items < n_threads){
+
+         for (uint64_t i = 0; i < n_items; i++){
+            func(i);
+         }
+
+         return;
+      }
+
+      std::vector<std::thread> workers;
+      workers.reserve(n_threads);
+
+      uint64_t items_per_thread = (n_items-1)/n_threads+1;
+
+      for (uint32_t t = 0; t < n_threads; t++){
+
+         uint64_t start = t*items_per_thread;
+         uint64_t end = start + items_per_thread;
+
+         if (end > n_items) end = n_items;
+         if (start >= end) break;
+
+         workers.emplace_back([start, end, &func](){
+
+            for (uint64_t i = start; i < end; i++){
+               func(i);
+            }
+
+         });
+
+      }
+
+      for (auto & worker : workers){
+         worker.join();
+      }
+
+   }
+
+
+   //matches the gallatin::utils::timer interface used by the device benchmarks.
+   struct timer {
+
+      std::chrono::high_resolution_clock::time_point start;
+      std::chrono::high_resolution_clock::time_point end;
+
+      timer(){
+         start = std::chrono::high_resolution_clock::now();
+      }
+
+      void sync_end(){
+         end = std::chrono::high_resolution_clock::now();
+      }
+
+      double elapsed(){
+         return std::chrono::duration<double>(end-start).count();
+      }
+
+      void print_throughput(std::string operation, uint64_t nitems){
+         printf("%s %lu items in %f seconds, throughput %f ops/s\n", operation.c_str(), nitems, elapsed(), 1.0*nitems/elapsed());
+      }
+
+   };
+
+
+}  // namespace host
+
+}  // namespace hashing_project
+
+#endif  // HT_HOST_UTILS
@@ -0,0 +1,245 @@
+#ifndef HT_HOT_KEY_CACHE
+#define HT_HOT_KEY_CACHE
+
+//read-through hot key cache for skewed lookups.
+//
+//space_saving_sketch - global heavy hitter sketch (space saving, n_counters counters). Lookups feed
+//                      it by sampling, and publish() copies the current top keys into a hot key list.
+//block_hot_cache     - per-block copy of the hot pairs in shared memory. fill() loads every hot key
+//                      from the table and remembers the version of its lock bucket. find_with_reference()
+//                      answers from shared memory while that version is unchanged, else it drops the
+//                      entry and probes the table.
+//
+//Validation uses the per-bucket versions from helpers/bucket_versions.cuh, so the cache only
+//answers lookups when the table was built with STABLE_HT_LOCKLESS_QUERY. Without versions every
+//lookup goes straight to the table.
+//
+//A key's value only changes under its lock bucket, and that bumps the version - entries can't go stale silently.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+#include <algorithm>
+#include <vector>
+#include <utility>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   //counts are approximate under concurrency - a replaced counter's key and count are not
+   //written as one unit. Good enough to rank heavy hitters.
+   template <typename Key, uint n_counters>
+   struct space_saving_sketch {
+
+      using my_type = space_saving_sketch<Key, n_counters>;
+
+      Key keys[n_counters];
+
+      //0 = counter unused.
+      uint64_t counts[n_counters];
+
+      static __host__ my_type * generate_on_device(){
+
+         my_type * sketch = gallatin::utils::get_device_version<my_type>();
+
+         cudaMemset(sketch, 0, sizeof(my_type));
+
+         return sketch;
+
+      }
+
+      static __host__ void free_on_device(my_type * sketch){
+         cudaFree(sketch);
+      }
+
+      //one thread.
+      __device__ void offer(Key key){
+
+         uint min_index = 0;
+         uint64_t min_count = ~0ULL;
+
+         for (uint i = 0; i < n_counters; i++){
+
+            uint64_t count = hash_table_load(&counts[i]);
+
+            if (count != 0 && hash_table_load(&keys[i]) == key){
+               atomicAdd((unsigned long long int *)&counts[i], 1ULL);
+               return;
+            }
+
+            if (count < min_count){
+               min_count = count;
+               min_index = i;
+            }
+
+         }
+
+         //space saving - the new key inherits the evicted count, so it can overtake it.
+         if (atomicCAS((unsigned long long int *)&counts[min_index], (unsigned long long int) min_count, (unsigned long long int) min_count+1) == min_count){
+            ht_store(&keys[min_index], key);
+         }
+
+      }
+
+      //write the n_hot most counted keys into dev_hot_keys (device memory), hottest first.
+      //returns the number written. Run between kernels.
+      __host__ uint publish(Key * dev_hot_keys, uint n_hot){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         std::vector<std::pair<uint64_t, Key>> ranked;
+
+         for (uint i = 0; i < n_counters; i++){
+            if (host_version->counts[i] != 0) ranked.push_back(std::make_pair(host_version->counts[i], host_version->keys[i]));
+         }
+
+         std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint64_t, Key> & a, const std::pair<uint64_t, Key> & b){ return a.first > b.first; });
+
+         uint n_written = std::min<uint64_t>(n_hot, ranked.size());
+
+         std::vector<Key> hot_keys(n_written);
+
+         for (uint i = 0; i < n_written; i++){
+            hot_keys[i] = ranked[i].second;
+         }
+
+         if (n_written != 0) cudaMemcpy(dev_hot_keys, hot_keys.data(), sizeof(Key)*n_written, cudaMemcpyHostToDevice);
+
+         cudaFreeHost(host_version);
+
+         return n_written;
+
+      }
+
+   };
+
+
+   //lives in shared memory - declare it __shared__ in the kernel.
+   template <typename Key, typename Val, uint n_entries>
+   struct block_hot_cache {
+
+      Key keys[n_entries];
+      Val vals[n_entries];
+      uint64_t buckets[n_entries];
+      uint32_t versions[n_entries];
+
+      //entry live - cleared when its version moves.
+      uint32_t valid[n_entries];
+
+      //every tile of the block must call this, then the block must __syncthreads() before
+      //the first lookup. Tiles split the hot keys between them.
+      template <typename ht_type, typename tile_type>
+      __device__ void fill(const tile_type & my_tile, ht_type * table, const Key * hot_keys, uint n_hot){
+
+         uint tile_id = threadIdx.x / my_tile.size();
+         uint n_tiles = blockDim.x / my_tile.size();
+
+         for (uint i = tile_id; i < n_entries; i += n_tiles){
+
+            bool live = false;
+
+            Key key {};
+            Val val {};
+            uint64_t bucket = 0;
+            uint32_t start_version = 0;
+
+            if (i < n_hot && table->versions != nullptr){
+
+               key = hot_keys[i];
+
+               bucket = table->get_lock_bucket(my_tile, key);
+
+               start_version = read_bucket_version(my_tile, table->versions, bucket);
+
+               bool found = table->find_with_reference(my_tile, key, val);
+
+               __threadfence();
+
+               uint32_t end_version = 0;
+
+               if (my_tile.thread_rank() == 0) end_version = hash_table_load(&table->versions[bucket]);
+
+               end_version = my_tile.shfl(end_version, 0);
+
+               //a write raced the load - leave the entry out rather than cache a torn value.
+               live = found && (start_version == end_version);
+
+            }
+
+            if (my_tile.thread_rank() == 0){
+
+               keys[i] = key;
+               if (live) vals[i] = val;
+               buckets[i] = bucket;
+               versions[i] = start_version;
+               valid[i] = live;
+
+            }
+
+         }
+
+      }
+
+
+      //hit: val is filled from shared memory and the table is not probed.
+      //the hit is only trusted if the lock bucket version still matches the one seen at fill.
+      template <typename ht_type, typename tile_type>
+      __device__ bool find_with_reference(const tile_type & my_tile, ht_type * table, const Key & key, Val & val){
+
+         int found_index = -1;
+
+         for (uint i = my_tile.thread_rank(); i < n_entries; i += my_tile.size()){
+
+            if (valid[i] && keys[i] == key) found_index = i;
+
+         }
+
+         auto match = my_tile.ballot(found_index != -1);
+
+         if (match){
+
+            found_index = my_tile.shfl(found_index, __ffs(match)-1);
+
+            bool fresh = false;
+
+            if (my_tile.thread_rank() == 0){
+
+               fresh = (hash_table_load(&table->versions[buckets[found_index]]) == versions[found_index]);
+
+               if (!fresh) valid[found_index] = 0;
+
+            }
+
+            if (my_tile.shfl(fresh, 0)){
+               val = vals[found_index];
+               return true;
+            }
+
+         }
+
+         return table->find_with_reference(my_tile, key, val);
+
+      }
+
+   };
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_HOT_KEY_CACHE
@@ -5,7 +5,17 @@
 #include <gallatin/allocators/alloc_utils.cuh>
 #include <hashing_project/helpers/ht_pairs.cuh>
 
+//query policy for the lock-based tables: 1 = find_with_reference probes without the lock and
+//re-validates against a per-bucket version (helpers/bucket_versions.cuh). Override with -D.
+#ifndef STABLE_HT_LOCKLESS_QUERY
 #define STABLE_HT_LOCKLESS_QUERY 0
+#endif
+
+//p2 tables: 1 = find_with_reference takes the speculative path (both candidate buckets fetched up front)
+//and inserts prefetch bucket 1 while bucket 0 is read. Override with -D.
+#ifndef P2_SPECULATIVE_LOAD
+#define P2_SPECULATIVE_LOAD 0
+#endif
 
 #if LOAD_CHEAP
 
@@ -47,6 +57,14 @@ __device__ inline void ht_store_packed_pair(pair<Key, Val> * address, pair<Key,
 
 }
 
+//16 bytes of key-only slots
+template <typename Key>
+__device__ inline packed_tags ht_load_packed_keys (const Key * address) {
+
+  return ((packed_tags *) address)[0];
+
+}
+
 #else
 
 template <typename T>
@@ -126,6 +144,7 @@ __device__ inline void ht_store(const uint16_t *p, uint16_t store_val) {
 template <template<typename, typename> typename pair, typename Key, typename Val>
 __device__ inline pair<Key, Val> ht_load_packed_pair (pair<Key, Val> * address) {
 
+  static_assert(sizeof(Key) + sizeof(Val) == 16 || sizeof(Key) + sizeof(Val) == 8, "packed pair loads support 64/64 or 32/32 bit pairs");
 
   if constexpr  (sizeof(Key) + sizeof(Val) == 16){
 
@@ -157,6 +176,8 @@ __device__ inline pair<Key, Val> ht_load_packed_pair (pair<Key, Val> * address)
 template <template<typename, typename> typename pair, typename Key, typename Val>
 __device__ inline void ht_store_packed_pair(pair<Key, Val> * address, pair<Key, Val> data) {
 
+  static_assert(sizeof(Key) + sizeof(Val) == 16 || sizeof(Key) + sizeof(Val) == 8, "packed pair stores support 64/64 or 32/32 bit pairs");
+
   if constexpr  (sizeof(Key) + sizeof(Val) == 16){
 
 
@@ -180,6 +201,22 @@ __device__ inline void ht_store_packed_pair(pair<Key, Val> * address, pair<Key,
 }
 
 
+//key-only slots for the set tables - 16 bytes of keys (2 uint64_t or 4 uint32_t) in one vector load.
+//address must be 16-byte aligned.
+template <typename Key>
+__device__ inline packed_tags ht_load_packed_keys (const Key * address) {
+
+  static_assert(sizeof(Key) == 8 || sizeof(Key) == 4, "packed key loads need 4 or 8 byte keys");
+
+  packed_tags loaded_keys;
+
+  asm volatile("ld.gpu.acquire.v2.u64 {%0,%1}, [%2];" : "=l"(loaded_keys.first), "=l"(loaded_keys.second) : "l"(address));
+
+  return loaded_keys;
+
+}
+
+
 template <typename pair>
 __device__ inline pair ht_load_metadata (const uint16_t * address) {
 
@@ -195,4 +232,52 @@ __device__ inline pair ht_load_metadata (const uint16_t * address) {
 
 #endif
 
+
+//L2 prefetch hint. It is not ordered against anything, so it runs ahead of the acquire loads after it.
+__device__ inline void ht_prefetch_l2(const void * address){
+
+  asm volatile("prefetch.global.L2 [%0];" :: "l"(address));
+
+}
+
+
+//whole tile prefetches one bucket - inserts use it on bucket 1 while bucket 0 is being read.
+template <typename tile_type>
+__device__ inline void ht_prefetch_bucket(const tile_type & my_tile, const void * bucket, uint64_t n_bytes){
+
+  uint64_t start = (uint64_t) bucket;
+  uint64_t end = start + n_bytes;
+
+  for (uint64_t line = (start & ~127ULL) + my_tile.thread_rank()*128; line < end; line += my_tile.size()*128){
+    ht_prefetch_l2((const void *) line);
+  }
+
+}
+
+
+//fetch both candidate buckets of a p2 probe at once - the low half of the tile covers bucket_0 and
+//the high half bucket_1, one 128 byte line per lane per step. The probe that follows finds both in L2,
+//so the memory round trip is paid once rather than once per bucket.
+template <typename tile_type>
+__device__ inline void ht_prefetch_bucket_pair(const tile_type & my_tile, const void * bucket_0, const void * bucket_1, uint64_t n_bytes){
+
+  uint half_tile = (my_tile.size() > 1) ? my_tile.size()/2 : 1;
+
+  for (uint i = 0; i < 2; i++){
+
+    //a tile of 1 covers both buckets itself.
+    if (my_tile.size() > 1 && (my_tile.thread_rank() / half_tile) != i) continue;
+
+    uint64_t start = (uint64_t) (i == 0 ? bucket_0 : bucket_1);
+    uint64_t end = start + n_bytes;
+
+    for (uint64_t line = (start & ~127ULL) + (my_tile.thread_rank() % half_tile)*128; line < end; line += half_tile*128){
+      ht_prefetch_l2((const void *) line);
+    }
+
+  }
+
+}
+
+
 #endif
\ No newline at end of file
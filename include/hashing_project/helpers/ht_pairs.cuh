@@ -13,8 +13,9 @@ namespace tables {
     uint64_t second;
   };
 
+  //8-byte pairs (32-bit key + 32-bit val) are read with a single 64-bit load, so they need 8-byte alignment.
   template <typename Key, typename Val>
-   struct ht_pair{
+   struct alignas((sizeof(Key)+sizeof(Val) == 8) ? 8 : (alignof(Key) > alignof(Val) ? alignof(Key) : alignof(Val))) ht_pair{
       Key key;
       Val val;
    };
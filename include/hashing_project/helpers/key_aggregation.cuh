@@ -0,0 +1,194 @@
+#ifndef HT_KEY_AGGREGATION
+#define HT_KEY_AGGREGATION
+
+//warp-level duplicate key aggregation for batched upserts.
+//
+//Under skew many tiles of one warp carry the same key, and each of them takes the same
+//bucket lock in turn. batch_upsert<aggregation, tile_size, true> matches the keys of the
+//tiles in each warp with __match_any_sync, folds the values of duplicates together in batch
+//order, and only the tile holding the last copy of a key touches the table.
+//
+//aggregations:
+// - replace_aggregation:          upsert_replace, last writer (highest batch index) wins.
+// - add_aggregation<Key, Val>:    upsert_function with an atomic add, duplicates are summed first.
+//
+//Ordering is only kept inside a warp - same as the unaggregated kernel, warps race.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   struct replace_aggregation {
+
+      template <typename Val>
+      __device__ static Val combine(Val older, Val newer){
+         return newer;
+      }
+
+      template <typename ht_type, typename tile_type, typename Key, typename Val>
+      __device__ static bool issue(ht_type * table, const tile_type & my_tile, const Key & key, const Val & val){
+         return table->upsert_replace(my_tile, key, val);
+      }
+
+   };
+
+
+   template <typename Key, typename Val>
+   struct add_aggregation {
+
+      static_assert(sizeof(Val) == 4 || sizeof(Val) == 8, "add_aggregation needs 32 or 64 bit values");
+
+      __device__ static Val combine(Val older, Val newer){
+         return older + newer;
+      }
+
+      //runs under the bucket lock - the atomic keeps concurrent lock-free readers coherent.
+      __device__ static void add_to_pair(hashing_project::tables::ht_pair<Key, Val> * location, Key key, Val val){
+
+         if constexpr (sizeof(Val) == 8){
+            atomicAdd((unsigned long long int *)&location->val, (unsigned long long int) val);
+         } else {
+            atomicAdd((unsigned int *)&location->val, (unsigned int) val);
+         }
+
+      }
+
+      template <typename ht_type, typename tile_type>
+      __device__ static bool issue(ht_type * table, const tile_type & my_tile, const Key & key, const Val & val){
+         return table->upsert_function(my_tile, key, val, &add_to_pair);
+      }
+
+   };
+
+
+   //match_any only takes 32/64 bit words.
+   template <typename Key>
+   __device__ inline unsigned int match_any_key(unsigned int mask, const Key & key){
+
+      static_assert(sizeof(Key) == 4 || sizeof(Key) == 8, "warp aggregation needs 32 or 64 bit keys");
+
+      if constexpr (sizeof(Key) == 8){
+         return __match_any_sync(mask, (unsigned long long) key);
+      } else {
+         return __match_any_sync(mask, (unsigned int) key);
+      }
+
+   }
+
+
+   //one op per tile. Every lane of the warp must call this - padding tiles pass valid = false.
+   //tiles are in batch order by lane, so the highest matching lane holds the last copy of a key.
+   //returns true on the tile that should issue the op, and val becomes the folded value there.
+   template <typename aggregation, uint tile_size, typename Key, typename Val>
+   __device__ inline bool aggregate_warp(bool valid, const Key & key, Val & val){
+
+      static_assert(tile_size <= 32, "tiles larger than a warp cannot be aggregated");
+
+      uint lane = threadIdx.x % 32;
+
+      uint my_leader = lane - lane % tile_size;
+
+      //lanes that lead a tile.
+      unsigned int leader_mask = 0;
+
+      for (uint i = 0; i < 32; i += tile_size){
+         leader_mask |= 1U << i;
+      }
+
+      unsigned int valid_mask = __ballot_sync(~0U, valid);
+
+      unsigned int peers = match_any_key(~0U, key) & valid_mask & leader_mask;
+
+      //fold the duplicates in lane order - uniform loop so every lane takes part in the shuffles.
+      Val folded = val;
+      bool first = true;
+
+      for (uint i = 0; i < 32; i += tile_size){
+
+         Val other = __shfl_sync(~0U, val, i);
+
+         if (peers & (1U << i)){
+
+            folded = first ? other : aggregation::combine(folded, other);
+            first = false;
+
+         }
+
+      }
+
+      if (!valid) return false;
+
+      uint last = 31 - __clz(peers);
+
+      val = folded;
+
+      return my_leader == last;
+
+   }
+
+
+   //one op per tile. With aggregate set the kernel keeps every tile alive until the warp
+   //has matched its keys, so blocks must be a multiple of 32 threads.
+   template <typename ht_type, typename aggregation, uint tile_size, bool aggregate, typename Key, typename Val>
+   __global__ void batch_upsert_kernel(ht_type * table, Key * keys, Val * vals, uint64_t n_ops, uint64_t * n_issued){
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      bool valid = tid < n_ops;
+
+      if (!aggregate && !valid) return;
+
+      Key key = valid ? keys[tid] : keys[0];
+      Val val = valid ? vals[tid] : vals[0];
+
+      if (aggregate){
+
+         if (!aggregate_warp<aggregation, tile_size>(valid, key, val)) return;
+
+      }
+
+      aggregation::issue(table, my_tile, key, val);
+
+      if (n_issued != nullptr && my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)n_issued, 1ULL);
+      }
+
+   }
+
+
+   //keys and vals in device memory. n_issued (device or managed, may be nullptr) counts the
+   //table ops actually issued - n_ops - n_issued lock acquisitions were saved.
+   template <typename aggregation, uint tile_size, bool aggregate = true, typename ht_type, typename Key, typename Val>
+   __host__ void batch_upsert(ht_type * table, Key * keys, Val * vals, uint64_t n_ops, uint64_t * n_issued = nullptr){
+
+      if (n_ops == 0) return;
+
+      batch_upsert_kernel<ht_type, aggregation, tile_size, aggregate, Key, Val><<<(n_ops*tile_size-1)/256+1,256>>>(table, keys, vals, n_ops, n_issued);
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_KEY_AGGREGATION
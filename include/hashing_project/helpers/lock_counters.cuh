@@ -0,0 +1,253 @@
+#ifndef LOCK_COUNTERS_HT
+#define LOCK_COUNTERS_HT
+
+//bucket lock contention counters, kept apart from the probe counts.
+//
+//With MEASURE_LOCKS set, every lock loop in the tables records
+// - acquires:   locks taken (shared or exclusive).
+// - contended:  acquires whose first attempt failed.
+// - failed:     failed attempts, i.e. spin iterations. Abandoned try_locks (hopscotch displacement) count here too.
+//
+//enable_lock_heatmap(n_buckets) additionally records acquires and failed attempts per lock bucket,
+//and dump_lock_heatmap writes them out so hot buckets under skewed keys can be found.
+//
+//With MEASURE_LOCKS off (the default) every macro is empty and nothing is allocated,
+//so the lock loops compile exactly as before.
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifndef MEASURE_LOCKS
+#define MEASURE_LOCKS 0
+#endif
+
+
+#if MEASURE_LOCKS
+
+__device__ __managed__ uint64_t helper_lock_acquires = 0;
+__device__ __managed__ uint64_t helper_lock_contended = 0;
+__device__ __managed__ uint64_t helper_lock_failed = 0;
+
+//2 counters per heatmap bucket - acquires, then failed attempts. nullptr when the heatmap is off.
+__device__ __managed__ uint64_t * helper_lock_heatmap = nullptr;
+__device__ __managed__ uint64_t helper_lock_heatmap_buckets = 0;
+
+#define LOCK_SPIN_INIT uint64_t lock_spins = 0;
+
+#define ADD_LOCK_SPIN lock_spins++;
+
+#define ADD_LOCK_ACQUIRE(bucket) hashing_project::helpers::record_lock_acquire(bucket, lock_spins);
+
+#define ADD_LOCK_ABANDON(bucket) hashing_project::helpers::record_lock_abandon(bucket, lock_spins);
+
+#else
+
+#define LOCK_SPIN_INIT
+#define ADD_LOCK_SPIN
+#define ADD_LOCK_ACQUIRE(bucket)
+#define ADD_LOCK_ABANDON(bucket)
+
+#endif
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+   struct lock_counts {
+
+      uint64_t acquires;
+      uint64_t contended;
+      uint64_t failed;
+
+      double spins_per_acquire(){
+
+         if (acquires == 0) return 0;
+
+         return 1.0*failed/acquires;
+      }
+
+   };
+
+#if MEASURE_LOCKS
+
+   __device__ inline void record_lock_acquire(uint64_t bucket, uint64_t n_failed){
+
+      atomicAdd((unsigned long long int *)&helper_lock_acquires, 1ULL);
+
+      if (n_failed != 0){
+         atomicAdd((unsigned long long int *)&helper_lock_contended, 1ULL);
+         atomicAdd((unsigned long long int *)&helper_lock_failed, (unsigned long long int) n_failed);
+      }
+
+      if (helper_lock_heatmap != nullptr){
+
+         uint64_t cell = bucket % helper_lock_heatmap_buckets;
+
+         atomicAdd((unsigned long long int *)&helper_lock_heatmap[2*cell], 1ULL);
+
+         if (n_failed != 0) atomicAdd((unsigned long long int *)&helper_lock_heatmap[2*cell+1], (unsigned long long int) n_failed);
+
+      }
+
+   }
+
+   //single-attempt lock that gave up - the attempt counts as a failure, nothing was acquired.
+   __device__ inline void record_lock_abandon(uint64_t bucket, uint64_t n_failed){
+
+      atomicAdd((unsigned long long int *)&helper_lock_failed, (unsigned long long int) n_failed+1);
+
+      if (helper_lock_heatmap != nullptr){
+
+         uint64_t cell = bucket % helper_lock_heatmap_buckets;
+
+         atomicAdd((unsigned long long int *)&helper_lock_heatmap[2*cell+1], (unsigned long long int) n_failed+1);
+
+      }
+
+   }
+
+   //read and reset the global counters.
+   inline lock_counts get_lock_counts(){
+
+      cudaDeviceSynchronize();
+
+      lock_counts counts {helper_lock_acquires, helper_lock_contended, helper_lock_failed};
+
+      helper_lock_acquires = 0;
+      helper_lock_contended = 0;
+      helper_lock_failed = 0;
+
+      cudaDeviceSynchronize();
+
+      return counts;
+
+   }
+
+   //buckets past n_buckets wrap around, so a smaller heatmap can be used for a large table.
+   inline void enable_lock_heatmap(uint64_t n_buckets){
+
+      cudaDeviceSynchronize();
+
+      uint64_t * heatmap;
+
+      cudaMallocManaged((void **)&heatmap, sizeof(uint64_t)*2*n_buckets);
+
+      cudaMemset(heatmap, 0, sizeof(uint64_t)*2*n_buckets);
+
+      cudaDeviceSynchronize();
+
+      helper_lock_heatmap_buckets = n_buckets;
+      helper_lock_heatmap = heatmap;
+
+   }
+
+   inline void disable_lock_heatmap(){
+
+      cudaDeviceSynchronize();
+
+      if (helper_lock_heatmap != nullptr) cudaFree(helper_lock_heatmap);
+
+      helper_lock_heatmap = nullptr;
+      helper_lock_heatmap_buckets = 0;
+
+   }
+
+   //writes the heatmap as a grid of n_cells cells, row_width per line. Each cell sums the failed
+   //attempts of a contiguous range of buckets - plot it directly as an image.
+   //also writes the top_k hottest buckets (bucket acquires failed) to filename.hot.
+   //resets the heatmap.
+   inline void dump_lock_heatmap(std::string filename, uint64_t n_cells=4096, uint64_t row_width=64, uint64_t top_k=32){
+
+      cudaDeviceSynchronize();
+
+      if (helper_lock_heatmap == nullptr) return;
+
+      uint64_t n_buckets = helper_lock_heatmap_buckets;
+
+      if (n_cells > n_buckets) n_cells = n_buckets;
+
+      uint64_t buckets_per_cell = (n_buckets-1)/n_cells+1;
+
+      std::vector<uint64_t> cells(n_cells, 0);
+
+      std::vector<std::pair<uint64_t, uint64_t>> hot;
+
+      for (uint64_t i = 0; i < n_buckets; i++){
+
+         uint64_t failed = helper_lock_heatmap[2*i+1];
+
+         cells[i/buckets_per_cell] += failed;
+
+         if (failed != 0) hot.push_back(std::make_pair(failed, i));
+
+      }
+
+      std::ofstream heatmap_file;
+      heatmap_file.open(filename.c_str());
+
+      for (uint64_t i = 0; i < n_cells; i++){
+
+         heatmap_file << cells[i];
+
+         if ((i+1) % row_width == 0 || i+1 == n_cells){
+            heatmap_file << "\n";
+         } else {
+            heatmap_file << " ";
+         }
+
+      }
+
+      heatmap_file.close();
+
+      uint64_t n_hot = std::min<uint64_t>(top_k, hot.size());
+
+      std::partial_sort(hot.begin(), hot.begin()+n_hot, hot.end(), [](const std::pair<uint64_t, uint64_t> & a, const std::pair<uint64_t, uint64_t> & b){ return a.first > b.first; });
+
+      std::ofstream hot_file;
+      hot_file.open((filename + ".hot").c_str());
+      hot_file << "bucket acquires failed\n";
+
+      for (uint64_t i = 0; i < n_hot; i++){
+         hot_file << hot[i].second << " " << helper_lock_heatmap[2*hot[i].second] << " " << hot[i].first << "\n";
+      }
+
+      hot_file.close();
+
+      cudaMemset(helper_lock_heatmap, 0, sizeof(uint64_t)*2*n_buckets);
+
+      cudaDeviceSynchronize();
+
+   }
+
+#else
+
+   inline lock_counts get_lock_counts(){
+      return lock_counts {0, 0, 0};
+   }
+
+   inline void enable_lock_heatmap(uint64_t n_buckets){
+      return;
+   }
+
+   inline void disable_lock_heatmap(){
+      return;
+   }
+
+   inline void dump_lock_heatmap(std::string filename, uint64_t n_cells=4096, uint64_t row_width=64, uint64_t top_k=32){
+      return;
+   }
+
+#endif
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // LOCK_COUNTERS_HT
@@ -0,0 +1,332 @@
+#ifndef HT_LOCK_LAYOUTS
+#define HT_LOCK_LAYOUTS
+
+//bucket lock layouts for the lock-based tables.
+//
+//Tables take the layout as their last template parameter and only go through the static
+//functions below, so the lock array can be swapped without touching the table logic.
+//
+//packed_bucket_locks      - 64 bucket locks per uint64_t bitmap word (the original layout).
+//                           Smallest footprint, but writers to 64 neighboring buckets share one atomic word.
+//sector_bucket_locks<S>   - one lock per bucket, padded to its own S byte sector (32 = one DRAM sector,
+//                           128 = one L2 line). No false sharing, S bytes per bucket.
+//striped_bucket_locks<N>  - fixed pool of N sector-padded locks, bucket % N. Footprint is independent of
+//                           the table size, but unrelated buckets can share a lock, so a thread that
+//                           holds one bucket must not block on a second (see shares_locks).
+//rw_bucket_locks<S>       - sector-padded reader-writer lock per bucket. Readers share the bucket,
+//                           writers are exclusive and take priority over new readers.
+//
+//Every layout has a shared (reader) mode via try_lock_shared / unlock_shared. Layouts without
+//a reader count fall back to the exclusive lock, so the shared calls are always safe to use.
+//
+//All layouts start unlocked, so the init kernels' unlocks are harmless.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <string>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+
+#ifndef SET_BIT_MASK
+#define SET_BIT_MASK(index) ((1ULL << index))
+#endif
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   struct packed_bucket_locks {
+
+      using lock_type = uint64_t;
+
+      static const bool shares_locks = false;
+
+      static __host__ uint64_t get_n_locks(uint64_t n_buckets){
+         return (n_buckets-1)/64+1;
+      }
+
+      static __host__ lock_type * generate_locks(uint64_t n_buckets){
+
+         lock_type * locks = gallatin::utils::get_device_version<lock_type>(get_n_locks(n_buckets));
+
+         cudaMemset(locks, 0, sizeof(lock_type)*get_n_locks(n_buckets));
+
+         return locks;
+
+      }
+
+      static __host__ void free_locks(lock_type * locks){
+         cudaFree(locks);
+      }
+
+      //bits, rounded to bytes - matches what the tables reported before the layouts existed.
+      static __host__ uint64_t get_space_usage(uint64_t n_buckets){
+         return (n_buckets-1)/8+1;
+      }
+
+      static __host__ std::string get_name(){
+         return "packed";
+      }
+
+      //if old is 0, SET_BIT_MASK & 0 is 0 - acquired.
+      static __device__ bool try_lock(lock_type * locks, uint64_t bucket){
+
+         uint64_t high = bucket/64;
+         uint64_t low = bucket % 64;
+
+         return !(atomicOr((unsigned long long int *)&locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+
+      }
+
+      static __device__ void unlock(lock_type * locks, uint64_t bucket){
+
+         uint64_t high = bucket/64;
+         uint64_t low = bucket % 64;
+
+         atomicAnd((unsigned long long int *)&locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+
+      }
+
+      static __device__ bool try_lock_shared(lock_type * locks, uint64_t bucket){
+         return try_lock(locks, bucket);
+      }
+
+      static __device__ void unlock_shared(lock_type * locks, uint64_t bucket){
+         unlock(locks, bucket);
+      }
+
+      static __device__ bool same_lock(uint64_t bucket_a, uint64_t bucket_b){
+         return bucket_a == bucket_b;
+      }
+
+   };
+
+
+   //one 32 bit lock word alone in its sector.
+   template <uint sector_bytes>
+   struct alignas(sector_bytes) padded_lock {
+
+      static_assert(sector_bytes >= 4 && (sector_bytes & (sector_bytes-1)) == 0, "lock sectors must be a power of two of at least 4 bytes");
+
+      uint32_t word;
+
+   };
+
+
+   template <uint sector_bytes>
+   struct sector_bucket_locks {
+
+      using lock_type = padded_lock<sector_bytes>;
+
+      static const bool shares_locks = false;
+
+      static __host__ uint64_t get_n_locks(uint64_t n_buckets){
+         return n_buckets;
+      }
+
+      static __host__ lock_type * generate_locks(uint64_t n_buckets){
+
+         lock_type * locks = gallatin::utils::get_device_version<lock_type>(n_buckets);
+
+         cudaMemset(locks, 0, sizeof(lock_type)*n_buckets);
+
+         return locks;
+
+      }
+
+      static __host__ void free_locks(lock_type * locks){
+         cudaFree(locks);
+      }
+
+      static __host__ uint64_t get_space_usage(uint64_t n_buckets){
+         return n_buckets*sizeof(lock_type);
+      }
+
+      static __host__ std::string get_name(){
+         return "sector_" + std::to_string(sector_bytes);
+      }
+
+      static __device__ bool try_lock(lock_type * locks, uint64_t bucket){
+         return atomicCAS(&locks[bucket].word, 0U, 1U) == 0U;
+      }
+
+      static __device__ void unlock(lock_type * locks, uint64_t bucket){
+         atomicExch(&locks[bucket].word, 0U);
+      }
+
+      static __device__ bool try_lock_shared(lock_type * locks, uint64_t bucket){
+         return try_lock(locks, bucket);
+      }
+
+      static __device__ void unlock_shared(lock_type * locks, uint64_t bucket){
+         unlock(locks, bucket);
+      }
+
+      static __device__ bool same_lock(uint64_t bucket_a, uint64_t bucket_b){
+         return bucket_a == bucket_b;
+      }
+
+   };
+
+
+   template <uint64_t n_stripes, uint sector_bytes=32>
+   struct striped_bucket_locks {
+
+      static_assert(n_stripes > 0, "striped locks need at least one stripe");
+
+      using lock_type = padded_lock<sector_bytes>;
+
+      static const bool shares_locks = true;
+
+      static __host__ __device__ uint64_t get_stripe(uint64_t bucket){
+         return bucket % n_stripes;
+      }
+
+      static __host__ uint64_t get_n_locks(uint64_t n_buckets){
+         return n_stripes;
+      }
+
+      static __host__ lock_type * generate_locks(uint64_t n_buckets){
+
+         lock_type * locks = gallatin::utils::get_device_version<lock_type>(n_stripes);
+
+         cudaMemset(locks, 0, sizeof(lock_type)*n_stripes);
+
+         return locks;
+
+      }
+
+      static __host__ void free_locks(lock_type * locks){
+         cudaFree(locks);
+      }
+
+      static __host__ uint64_t get_space_usage(uint64_t n_buckets){
+         return n_stripes*sizeof(lock_type);
+      }
+
+      static __host__ std::string get_name(){
+         return "striped_" + std::to_string(n_stripes);
+      }
+
+      static __device__ bool try_lock(lock_type * locks, uint64_t bucket){
+         return atomicCAS(&locks[get_stripe(bucket)].word, 0U, 1U) == 0U;
+      }
+
+      static __device__ void unlock(lock_type * locks, uint64_t bucket){
+         atomicExch(&locks[get_stripe(bucket)].word, 0U);
+      }
+
+      static __device__ bool try_lock_shared(lock_type * locks, uint64_t bucket){
+         return try_lock(locks, bucket);
+      }
+
+      static __device__ void unlock_shared(lock_type * locks, uint64_t bucket){
+         unlock(locks, bucket);
+      }
+
+      static __device__ bool same_lock(uint64_t bucket_a, uint64_t bucket_b){
+         return get_stripe(bucket_a) == get_stripe(bucket_b);
+      }
+
+   };
+
+
+   //top bit of the word is the writer, the low 31 bits count readers.
+   //a writer claims the bit before the readers are gone, so new readers back off and the writer
+   //only waits for the readers already inside - writers cannot be starved by a stream of hits.
+   template <uint sector_bytes=32>
+   struct rw_bucket_locks {
+
+      using lock_type = padded_lock<sector_bytes>;
+
+      static const bool shares_locks = false;
+
+      static const uint32_t writer_bit = 1U << 31;
+
+      static __host__ uint64_t get_n_locks(uint64_t n_buckets){
+         return n_buckets;
+      }
+
+      static __host__ lock_type * generate_locks(uint64_t n_buckets){
+
+         lock_type * locks = gallatin::utils::get_device_version<lock_type>(n_buckets);
+
+         cudaMemset(locks, 0, sizeof(lock_type)*n_buckets);
+
+         return locks;
+
+      }
+
+      static __host__ void free_locks(lock_type * locks){
+         cudaFree(locks);
+      }
+
+      static __host__ uint64_t get_space_usage(uint64_t n_buckets){
+         return n_buckets*sizeof(lock_type);
+      }
+
+      static __host__ std::string get_name(){
+         return "rw_" + std::to_string(sector_bytes);
+      }
+
+      static __device__ uint32_t load_word(lock_type * locks, uint64_t bucket){
+         return ((volatile uint32_t *) &locks[bucket].word)[0];
+      }
+
+      //fails only if another writer holds or is waiting on the bucket.
+      //once the writer bit is set, readers inside are short probes, so waiting them out here
+      //cannot deadlock - readers never hold a second lock.
+      static __device__ bool try_lock(lock_type * locks, uint64_t bucket){
+
+         if (atomicOr(&locks[bucket].word, writer_bit) & writer_bit) return false;
+
+         while (load_word(locks, bucket) != writer_bit);
+
+         return true;
+
+      }
+
+      //readers that raced the writer bit may still be counted - clear only the bit.
+      static __device__ void unlock(lock_type * locks, uint64_t bucket){
+         atomicAnd(&locks[bucket].word, ~writer_bit);
+      }
+
+      static __device__ bool try_lock_shared(lock_type * locks, uint64_t bucket){
+
+         //cheap check first so waiting readers don't hammer the word with adds.
+         if (load_word(locks, bucket) & writer_bit) return false;
+
+         if (atomicAdd(&locks[bucket].word, 1U) & writer_bit){
+
+            //writer got in first - back out.
+            atomicSub(&locks[bucket].word, 1U);
+            return false;
+
+         }
+
+         return true;
+
+      }
+
+      static __device__ void unlock_shared(lock_type * locks, uint64_t bucket){
+         atomicSub(&locks[bucket].word, 1U);
+      }
+
+      static __device__ bool same_lock(uint64_t bucket_a, uint64_t bucket_b){
+         return bucket_a == bucket_b;
+      }
+
+   };
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_LOCK_LAYOUTS
@@ -0,0 +1,69 @@
+#ifndef HT_PINNED_PAGES
+#define HT_PINNED_PAGES
+
+//pinned, device-visible host memory with the page policy of helpers/host_pages.cuh.
+//
+// - get_host_version_paged<T>(n_items[, policy]): replaces gallatin::utils::get_host_version<T>(n_items)
+//   for large buffers the device reads over PCIe, such as the caches' host_items. The memory comes
+//   from host_alloc and is pinned with cudaHostRegister, so the device reaches it through UVA just
+//   like cudaMallocHost memory. With base pages, or if registering fails, it falls back to
+//   cudaMallocHost.
+// - free_host_paged(ptr): frees either kind.
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/host_pages.cuh>
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   template <typename T>
+   __host__ T * get_host_version_paged(uint64_t n_items, hashing_project::host::page_policy policy = hashing_project::host::get_host_page_policy()){
+
+      if (policy == hashing_project::host::page_policy::base_pages){
+         return gallatin::utils::get_host_version<T>(n_items);
+      }
+
+      T * host_items = hashing_project::host::host_alloc_typed<T>(n_items, policy);
+
+      if (host_items != nullptr && cudaHostRegister(host_items, sizeof(T)*n_items, cudaHostRegisterMapped | cudaHostRegisterPortable) == cudaSuccess){
+         return host_items;
+      }
+
+      cudaGetLastError();
+
+      hashing_project::host::host_free(host_items);
+
+      return gallatin::utils::get_host_version<T>(n_items);
+
+   }
+
+
+   __host__ inline void free_host_paged(void * ptr){
+
+      if (ptr == nullptr) return;
+
+      //only registered memory unregisters - cudaMallocHost memory reports an error here.
+      if (cudaHostUnregister(ptr) == cudaSuccess){
+         hashing_project::host::host_free(ptr);
+         return;
+      }
+
+      cudaGetLastError();
+
+      cudaFreeHost(ptr);
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_PINNED_PAGES
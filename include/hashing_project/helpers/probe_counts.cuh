@@ -13,9 +13,19 @@ __device__ __managed__ uint64_t helper_global_probes_count = 0;
   if (my_tile.thread_rank() == 0) \
     atomicAdd(&helper_global_probes_count, ((sizeof(Key)+sizeof(Val))*my_tile.size()-1)/128+1);
 
+//rounded up - with 8 byte pairs a small bucket is less than one cache line, but still costs one.
 #define ADD_PROBE_BUCKET \
   if (my_tile.thread_rank() == 0)   \
-    atomicAdd(&helper_global_probes_count, (uint64_t) bucket_size*(sizeof(Key)+sizeof(Val))/128);
+    atomicAdd(&helper_global_probes_count, ((uint64_t) bucket_size*(sizeof(Key)+sizeof(Val))-1)/128+1);
+
+//key-only variants for the set tables - each tile thread loads 16 bytes of keys per pass.
+#define ADD_PROBE_ADJUSTED_SET \
+  if (my_tile.thread_rank() == 0) \
+    atomicAdd(&helper_global_probes_count, (16*my_tile.size()-1)/128+1);
+
+#define ADD_PROBE_BUCKET_SET \
+  if (my_tile.thread_rank() == 0)   \
+    atomicAdd(&helper_global_probes_count, ((uint64_t) bucket_size*sizeof(Key)-1)/128+1);
 
 #define ADD_PROBE atomicAdd(&helper_global_probes_count, 1);
 namespace helpers {
@@ -32,6 +42,8 @@ inline uint64_t get_num_probes() {
 #define ADD_PROBE
 #define ADD_PROBE_BUCKET
 #define ADD_PROBE_ADJUSTED
+#define ADD_PROBE_ADJUSTED_SET
+#define ADD_PROBE_BUCKET_SET
 namespace helpers {
 inline uint64_t get_num_probes() {
   return 0;
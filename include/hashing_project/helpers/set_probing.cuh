@@ -0,0 +1,78 @@
+#ifndef HT_SET_PROBING
+#define HT_SET_PROBING
+
+//probe policies for the key-only sets (tables/double_hashing_set.cuh, tables/double_hashing_metadata_set.cuh).
+//
+//The sets keep one bucket layout per file and take the probe sequence as a template parameter,
+//so the same bucket code runs as a double hashing set or a power-of-two-choice set.
+//A policy gives the i-th candidate bucket of a hash and two flags:
+//   stop_on_empty      - a bucket with an empty slot ends queries and erases. Only valid when
+//                        inserts fill the sequence in order.
+//   least_full_insert  - inserts try the candidate with the most open slots first, then the others.
+//
+//bucket 0 of every policy is (hash & 32 bits) % n_buckets, the lock bucket of the key.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <string>
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   //double hashing: bucket i is bucket 0 plus i strides of the upper hash bits.
+   template <uint max_probes>
+   struct double_set_probing {
+
+      static const uint n_probes = max_probes;
+
+      static const bool stop_on_empty = true;
+
+      static const bool least_full_insert = false;
+
+      __device__ static uint64_t get_bucket(uint64_t key_hash, uint probe, uint64_t n_buckets){
+
+         return ((key_hash & 0xffffffffULL) % n_buckets + (key_hash >> 32)*probe) % n_buckets;
+
+      }
+
+      static std::string get_prefix(){
+         return "double_hashing";
+      }
+
+   };
+
+
+   //power-of-two-choice, same candidates as tables/p2_hashing_metadata.cuh.
+   //Inserts go to the emptier bucket, so queries and erases always check both.
+   struct p2_set_probing {
+
+      static const uint n_probes = 2;
+
+      static const bool stop_on_empty = false;
+
+      static const bool least_full_insert = true;
+
+      __device__ static uint64_t get_bucket(uint64_t key_hash, uint probe, uint64_t n_buckets){
+
+         return (probe == 0 ? (key_hash & 0xffffffffULL) : (key_hash >> 32)) % n_buckets;
+
+      }
+
+      static std::string get_prefix(){
+         return "p2_hashing";
+      }
+
+   };
+
+
+}
+
+}
+
+
+#endif //end of set probing guard
@@ -0,0 +1,179 @@
+#ifndef HT_STREAMING_INGEST
+#define HT_STREAMING_INGEST
+
+//chunked, pipelined insert of a host-resident batch.
+//
+// - stream_ingest<tile_size>(table, host_keys, host_vals, n, chunk_size, n_buffers)
+//
+//The batch is split into chunk_size pairs and cycled through n_buffers device buffers, one stream
+//each. The copy of chunk i+1 runs on its own stream while chunk i is inserted, so transfer and
+//insert overlap. Only n_buffers chunks are ever resident, so the batch can be larger than device
+//memory. A buffer is reused once its stream has finished the previous chunk's insert.
+//
+//Pinned input (cudaMallocHost) is copied directly. Pageable input is first memcpy'd into a pinned
+//staging buffer per slot by the host thread, which overlaps with the inserts already queued.
+//
+//Chunks insert concurrently with each other, like the one-kernel fill: for duplicate keys the
+//surviving value is not ordered.
+//Returns the number of pairs upsert_replace placed.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+#include <cstring>
+#include <vector>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   template <typename ht_type, uint tile_size, typename Key, typename Val>
+   __global__ void stream_insert_kernel(ht_type * table, const Key * keys, const Val * vals, uint64_t n_keys, uint64_t * n_failed){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_keys) return;
+
+      if (!table->upsert_replace(my_tile, keys[tid], vals[tid]) && my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)n_failed, 1ULL);
+      }
+
+
+   }
+
+
+   __host__ inline bool is_pinned(const void * ptr){
+
+      cudaPointerAttributes attributes;
+
+      if (cudaPointerGetAttributes(&attributes, ptr) != cudaSuccess){
+         cudaGetLastError();
+         return false;
+      }
+
+      return attributes.type == cudaMemoryTypeHost;
+
+   }
+
+
+   template <uint tile_size, typename ht_type, typename Key, typename Val>
+   __host__ uint64_t stream_ingest(ht_type * table, const Key * host_keys, const Val * host_vals, uint64_t n, uint64_t chunk_size = (1ULL << 22), uint n_buffers = 3){
+
+      if (n == 0) return 0;
+
+      if (n_buffers == 0) n_buffers = 1;
+
+      if (chunk_size > n) chunk_size = n;
+
+      bool staged = !(is_pinned(host_keys) && is_pinned(host_vals));
+
+      std::vector<cudaStream_t> streams(n_buffers);
+
+      std::vector<Key *> key_buffers(n_buffers);
+      std::vector<Val *> val_buffers(n_buffers);
+
+      std::vector<Key *> key_staging(n_buffers, nullptr);
+      std::vector<Val *> val_staging(n_buffers, nullptr);
+
+      for (uint i = 0; i < n_buffers; i++){
+
+         cudaStreamCreateWithFlags(&streams[i], cudaStreamNonBlocking);
+
+         cudaMalloc((void **)&key_buffers[i], sizeof(Key)*chunk_size);
+         cudaMalloc((void **)&val_buffers[i], sizeof(Val)*chunk_size);
+
+         if (staged){
+            cudaMallocHost((void **)&key_staging[i], sizeof(Key)*chunk_size);
+            cudaMallocHost((void **)&val_staging[i], sizeof(Val)*chunk_size);
+         }
+
+      }
+
+      uint64_t * n_failed;
+
+      cudaMallocManaged((void **)&n_failed, sizeof(uint64_t));
+
+      n_failed[0] = 0;
+
+      //managed memory must not be touched by the host while kernels run.
+      cudaDeviceSynchronize();
+
+      uint64_t n_chunks = (n-1)/chunk_size+1;
+
+      for (uint64_t chunk = 0; chunk < n_chunks; chunk++){
+
+         uint slot = chunk % n_buffers;
+
+         uint64_t start = chunk*chunk_size;
+
+         uint64_t n_chunk = (n - start < chunk_size) ? n - start : chunk_size;
+
+         //previous chunk in this slot must be inserted before its buffers are overwritten.
+         cudaStreamSynchronize(streams[slot]);
+
+         const Key * key_source = host_keys + start;
+         const Val * val_source = host_vals + start;
+
+         if (staged){
+
+            std::memcpy(key_staging[slot], key_source, sizeof(Key)*n_chunk);
+            std::memcpy(val_staging[slot], val_source, sizeof(Val)*n_chunk);
+
+            key_source = key_staging[slot];
+            val_source = val_staging[slot];
+
+         }
+
+         cudaMemcpyAsync(key_buffers[slot], key_source, sizeof(Key)*n_chunk, cudaMemcpyHostToDevice, streams[slot]);
+         cudaMemcpyAsync(val_buffers[slot], val_source, sizeof(Val)*n_chunk, cudaMemcpyHostToDevice, streams[slot]);
+
+         stream_insert_kernel<ht_type, tile_size, Key, Val><<<(n_chunk*tile_size-1)/256+1,256,0,streams[slot]>>>(table, key_buffers[slot], val_buffers[slot], n_chunk, n_failed);
+
+      }
+
+      cudaDeviceSynchronize();
+
+      uint64_t n_inserted = n - n_failed[0];
+
+      cudaFree(n_failed);
+
+      for (uint i = 0; i < n_buffers; i++){
+
+         cudaFree(key_buffers[i]);
+         cudaFree(val_buffers[i]);
+
+         if (staged){
+            cudaFreeHost(key_staging[i]);
+            cudaFreeHost(val_staging[i]);
+         }
+
+         cudaStreamDestroy(streams[i]);
+
+      }
+
+      return n_inserted;
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_STREAMING_INGEST
@@ -0,0 +1,178 @@
+#ifndef HT_TABLE_EXPORT
+#define HT_TABLE_EXPORT
+
+//dense export of every live pair into keys_out / vals_out, built on the sweep hooks
+//from helpers/table_sweep.cuh.
+//
+// - export_pairs<tile_size>(table, keys_out, vals_out, capacity, sort_by_key)
+//
+//Same two-phase shape as the multimap retrieve_count / retrieve_write:
+// 1) one tile per sweep bucket counts its live pairs into counts[bucket],
+// 2) thrust::exclusive_scan turns the counts into per-bucket offsets,
+// 3) each tile writes its bucket's pairs to [offsets[bucket], offsets[bucket+1]). Live lanes of a
+//    round take consecutive positions, so the writes are coalesced.
+//Optionally thrust::sort_by_key sorts the output by key.
+//
+//Works on every table table_sweep.cuh supports, the quotient iceberg included. The multimaps, sets
+//and the large-value / string-key wrappers have no sweep hooks and cannot be exported.
+//
+//The table should be quiescent between the passes (queries are fine). A bucket that gained pairs
+//only writes the number counted in pass 1. A bucket that lost pairs leaves a gap, and the export
+//returns export_changed.
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+#include <thrust/execution_policy.h>
+#include <thrust/scan.h>
+#include <thrust/sort.h>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/table_sweep.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   //returned by export_pairs when a bucket lost pairs between the count and write passes.
+   static const uint64_t export_changed = ~0ULL;
+
+
+   template <typename ht_type, uint tile_size>
+   __global__ void export_count_kernel(ht_type * table, uint64_t n_buckets, uint64_t * counts){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t n_live = 0;
+
+      table->for_each_in_bucket(my_tile, tid, [&](bool live, const auto & key, const auto & val){
+
+         n_live += __popc(my_tile.ballot(live));
+
+      });
+
+      if (my_tile.thread_rank() == 0){
+         counts[tid] = n_live;
+      }
+
+
+   }
+
+
+   template <typename ht_type, uint tile_size, typename Key, typename Val>
+   __global__ void export_write_kernel(ht_type * table, uint64_t n_buckets, uint64_t * offsets, Key * keys_out, Val * vals_out, uint64_t * n_short){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t start = offsets[tid];
+
+      uint64_t end = offsets[tid+1];
+
+      uint64_t n_written = 0;
+
+      table->for_each_in_bucket(my_tile, tid, [&](bool live, const auto & key, const auto & val){
+
+         auto live_ballot = my_tile.ballot(live);
+
+         uint64_t write_index = start + n_written + __popc(live_ballot & ((1U << my_tile.thread_rank())-1));
+
+         //pairs added since the count pass don't fit.
+         if (live && write_index < end){
+            keys_out[write_index] = key;
+            vals_out[write_index] = val;
+         }
+
+         n_written += __popc(live_ballot);
+
+      });
+
+      if (my_tile.thread_rank() == 0 && start + n_written < end){
+         atomicAdd((unsigned long long int *)n_short, 1ULL);
+      }
+
+
+   }
+
+
+   //returns the number of pairs written. If the table holds more than capacity, nothing is
+   //written and the required size is returned - check against capacity.
+   template <uint tile_size, typename ht_type, typename Key, typename Val>
+   __host__ uint64_t export_pairs(ht_type * table, Key * keys_out, Val * vals_out, uint64_t capacity, bool sort_by_key = false){
+
+      uint64_t n_buckets = table->get_n_sweep_buckets();
+
+      uint64_t * offsets;
+
+      cudaMalloc((void **)&offsets, sizeof(uint64_t)*(n_buckets+1));
+
+      cudaMemset(offsets+n_buckets, 0, sizeof(uint64_t));
+
+      export_count_kernel<ht_type, tile_size><<<(n_buckets*tile_size-1)/256+1,256>>>(table, n_buckets, offsets);
+
+      thrust::exclusive_scan(thrust::device, offsets, offsets+n_buckets+1, offsets);
+
+      uint64_t total;
+
+      cudaMemcpy(&total, offsets+n_buckets, sizeof(uint64_t), cudaMemcpyDeviceToHost);
+
+      if (total > capacity){
+         cudaFree(offsets);
+         return total;
+      }
+
+      uint64_t * n_short;
+
+      cudaMallocManaged((void **)&n_short, sizeof(uint64_t));
+
+      n_short[0] = 0;
+
+      export_write_kernel<ht_type, tile_size, Key, Val><<<(n_buckets*tile_size-1)/256+1,256>>>(table, n_buckets, offsets, keys_out, vals_out, n_short);
+
+      cudaDeviceSynchronize();
+
+      bool changed = (n_short[0] != 0);
+
+      cudaFree(n_short);
+      cudaFree(offsets);
+
+      if (changed) return export_changed;
+
+      if (sort_by_key){
+         thrust::sort_by_key(thrust::device, keys_out, keys_out+total, vals_out);
+      }
+
+      return total;
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_TABLE_EXPORT
@@ -0,0 +1,157 @@
+#ifndef HT_TABLE_SWEEP
+#define HT_TABLE_SWEEP
+
+//table-wide traversal for the key-value tables, for periodic expiry and export jobs.
+//
+// - for_each<tile_size>(table, func, stream)   func(key, val) on every live pair
+// - erase_if<tile_size>(table, pred, stream)   removes every live pair with pred(key, val), returns the count
+//
+//One tile per sweep bucket (table->get_n_sweep_buckets()), same launch shape as the fill kernels.
+//The table's for_each_in_bucket hook reads the bucket's metadata first - tags for the md tables,
+//keys otherwise - so values are only loaded for live slots and rounds with no live slot are skipped.
+//Chaining walks the whole chain of each head slot, the iceberg tables sweep their backyard
+//buckets after the frontyard.
+//
+//Hook contract: every lane of the tile calls func(live, key, val) once per round with at least
+//one live slot, so func may use tile collectives. Only live lanes hold a pair.
+//
+//Sweeps take no locks and can run next to queries and upserts (launch on a separate stream).
+//for_each is weakly consistent: a pair that is present and not moved for the whole sweep is
+//visited exactly once. Pairs inserted or removed during the sweep may or may not be seen, and cuckoo
+//kicks / hopscotch displacement can carry a pair past the sweep.
+//erase_if rechecks every candidate under the key's lock (helpers::erase_key_if), so a value
+//changed by a concurrent upsert is tested again before removal and lock-free readers see the
+//version bump.
+//
+//func and pred are copied into the kernel: use functor structs with a __device__ operator().
+//Supported: p2_ext, p2_inv, md_p2, double, md_double, iht_p2, iht_p2_metadata_full, iht_p2_metadata_quotient,
+//cuckoo, hopscotch, chaining. The quotient iceberg rebuilds frontyard keys from (bucket, tag, remainder).
+//Not supported: the multimaps (no find_pair_no_lock for erase_key_if), the sets (no values), and the
+//large-value and string-key wrappers (their inner pairs are (key, slab offset) and (hash, arena offset)).
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/conditional_ops.cuh>
+
+namespace cg = cooperative_groups;
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+   template <typename ht_type, uint tile_size, typename func_type>
+   __global__ void for_each_kernel(ht_type * table, uint64_t n_buckets, func_type func){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      table->for_each_in_bucket(my_tile, tid, [&](bool live, const auto & key, const auto & val){
+
+         if (live) func(key, val);
+
+      });
+
+
+   }
+
+
+   template <typename ht_type, uint tile_size, typename pred_type>
+   __global__ void erase_if_kernel(ht_type * table, uint64_t n_buckets, pred_type pred, uint64_t * n_erased){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t my_erased = 0;
+
+      table->for_each_in_bucket(my_tile, tid, [&](bool live, const auto & key, const auto & val){
+
+         auto candidates = my_tile.ballot(live && pred(key, val));
+
+         //erase one candidate at a time with the whole tile.
+         while (candidates){
+
+            auto leader = __ffs(candidates)-1;
+
+            auto erase_key = my_tile.shfl(key, leader);
+
+            if (erase_key_if(my_tile, table, erase_key, pred)) my_erased++;
+
+            candidates &= candidates-1;
+
+         }
+
+      });
+
+      if (my_tile.thread_rank() == 0 && my_erased != 0){
+         atomicAdd((unsigned long long int *)n_erased, (unsigned long long int) my_erased);
+      }
+
+
+   }
+
+
+   //async on stream - func reports through its own device state, sync before reading it.
+   template <uint tile_size, typename ht_type, typename func_type>
+   __host__ void for_each(ht_type * table, func_type func, cudaStream_t stream = 0){
+
+      uint64_t n_buckets = table->get_n_sweep_buckets();
+
+      for_each_kernel<ht_type, tile_size, func_type><<<(n_buckets*tile_size-1)/256+1,256,0,stream>>>(table, n_buckets, func);
+
+   }
+
+
+   //synchronizes stream, returns the number of pairs removed.
+   template <uint tile_size, typename ht_type, typename pred_type>
+   __host__ uint64_t erase_if(ht_type * table, pred_type pred, cudaStream_t stream = 0){
+
+      uint64_t n_buckets = table->get_n_sweep_buckets();
+
+      uint64_t * n_erased;
+
+      cudaMallocManaged((void **)&n_erased, sizeof(uint64_t));
+
+      n_erased[0] = 0;
+
+      erase_if_kernel<ht_type, tile_size, pred_type><<<(n_buckets*tile_size-1)/256+1,256,0,stream>>>(table, n_buckets, pred, n_erased);
+
+      cudaStreamSynchronize(stream);
+
+      uint64_t return_erased = n_erased[0];
+
+      cudaFree(n_erased);
+
+      return return_erased;
+
+   }
+
+
+}  // namespace helpers
+
+}  // namespace hashing_project
+
+#endif  // HT_TABLE_SWEEP
@@ -9,6 +9,7 @@
 
 #include <hashing_project/helpers/cuckoo_vector.cuh>
 #include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
 
 using namespace std;
 
@@ -626,6 +627,92 @@ __global__ void contract(coo_matrix<n_dims> * x_mat, ht_type * y_mat, ht_type *
 }
 
 
+//multimap variant - y entries are stored directly as (contraction key -> y index) duplicates
+//instead of one cuckoo_vector per key.
+template <typename mm_type, int n_dims, int contraction_dims, uint tile_size>
+__global__ void convert_to_multimap(mm_type * indirection_table, coo_matrix<n_dims> * conversion_matrix, uint64_t n_items, uint64_t * n_failures){
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_items) return;
+
+   uint64_t hash_key = conversion_matrix->get_ht_key(tid, 0, contraction_dims);
+
+   if (!indirection_table->insert_dup_no_lock(my_tile, hash_key, tid)){
+
+   	if (my_tile.thread_rank() == 0){
+   		atomicAdd((unsigned long long int *)n_failures, 1ULL);
+   	}
+
+   }
+
+}
+
+
+template <int n_dims, int contraction_dims>
+__global__ void extract_contraction_keys(coo_matrix<n_dims> * x_mat, uint64_t * keys){
+
+	uint64_t tid = gallatin::utils::get_tid();
+
+	if (tid >= x_mat->n_items) return;
+
+	keys[tid] = x_mat->get_ht_key(tid, n_dims-contraction_dims, contraction_dims);
+
+}
+
+
+//contract x items [batch_start, batch_end) against the y indices retrieved for them.
+//y_indices holds the batch only, starting at offsets[batch_start].
+template <typename ht_type, typename lower_COO, int n_dims, int contraction_dims, int output_dims, uint tile_size>
+__global__ void contract_multimap(coo_matrix<n_dims> * x_mat, coo_matrix<n_dims> * y_mat, uint64_t * offsets, uint64_t * y_indices, uint64_t batch_start, uint64_t batch_end, ht_type * accumulator, coo_matrix<output_dims> * output){
+
+	auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile) + batch_start;
+
+   if (tid >= batch_end) return;
+
+   auto lhs = x_mat->items[tid];
+
+   uint64_t batch_base = offsets[batch_start];
+
+   for (uint64_t i = offsets[tid]; i < offsets[tid+1]; i++){
+
+   	lower_COO rhs;
+
+   	rhs.set_values(y_mat->items[y_indices[i-batch_base]]);
+
+   	uint64_t merged_key = output->get_output_key(lhs, contraction_dims, rhs);
+
+   	uint64_t value = rhs.value*lhs.value;
+
+   	auto location = accumulator->find_pair_no_lock(my_tile, merged_key);
+
+   	if (location != nullptr){
+
+   		if (my_tile.thread_rank() == 0){
+   			per_value_accumulate_external(location, merged_key, value);
+   		}
+
+   	} else {
+   		accumulator->upsert_function(my_tile, merged_key, value, &per_value_accumulate);
+   	}
+
+   	my_tile.sync();
+
+   }
+
+}
+
+
 struct data_pair {
 	uint64_t key;
 	uint64_t value;
@@ -1267,6 +1354,183 @@ __host__ double tensor_contraction_nips_013(std::string filename, uint64_t accum
 
 
 
+//multimap version of tensor_contraction_nips_2 (contraction_dims = 1) and
+//tensor_contraction_nips_013 (contraction_dims = 3).
+//y is loaded with insert_dup, then the x keys are retrieved with the two-phase bulk
+//count/prefix-sum/write and contracted in batches of at most max_batch_items y indices.
+//The accumulator is md_double_generic so only the indirection structure differs from doubleMD.
+template <int contraction_dims, template<typename, typename, uint, uint> typename multimap_type, uint tile_size, uint bucket_size>
+__host__ double tensor_contraction_multimap(std::string filename, uint64_t accumulator_nslots, uint64_t max_batch_items=(1ULL << 28)){
+
+	static_assert(contraction_dims == 1 || contraction_dims == 3, "multimap contraction runs the nips 2 and nips 013 layouts");
+
+	constexpr int n_dims = 4;
+
+	constexpr int leftover_dims = n_dims-contraction_dims;
+	constexpr int output_dims = leftover_dims*2;
+	using lower_COO = COO<leftover_dims>;
+
+	using mm_type = multimap_type<uint64_t, uint64_t, tile_size, bucket_size>;
+	using ht_type = hashing_project::tables::md_double_generic<uint64_t, uint64_t, tile_size, 32>;
+
+	using output_mat_type = coo_matrix<output_dims>;
+
+
+	coo_matrix<n_dims> x_mat(filename);
+
+	if (contraction_dims == 1){
+		//0 1 2 3 -> 0 1 3 2
+		x_mat.swap_dims(2, 3);
+	} else {
+		//0 1 2 3 -> 2 0 1 3
+		x_mat.swap_dims(0, 2);
+		x_mat.swap_dims(1,2);
+	}
+
+	coo_matrix<n_dims> y_mat(x_mat);
+
+	int stride = n_dims-contraction_dims;
+
+	for (int i =0; i < contraction_dims; i++){
+
+		y_mat.swap_dims(i, i+stride);
+
+	}
+
+	output_mat_type output_mat;
+
+	output_mat.set_dimensions(x_mat, y_mat, contraction_dims);
+
+	//every y entry is its own slot now.
+	uint64_t n_slots= y_mat.n_items*1.10;
+
+	mm_type * indirection_table = mm_type::generate_on_device(n_slots, 999);
+
+
+	coo_matrix<n_dims> * y_mat_device = gallatin::utils::get_device_version<coo_matrix<n_dims>>();
+	cudaMemcpy(y_mat_device, &y_mat, sizeof(coo_matrix<n_dims>), cudaMemcpyHostToDevice);
+
+
+	coo_matrix<n_dims> * x_mat_device = gallatin::utils::get_device_version<coo_matrix<n_dims>>();
+	cudaMemcpy(x_mat_device, &x_mat, sizeof(coo_matrix<n_dims>), cudaMemcpyHostToDevice);
+
+	coo_matrix<output_dims> * output_mat_device = gallatin::utils::get_device_version<coo_matrix<output_dims>>();
+	cudaMemcpy(output_mat_device, &output_mat, sizeof(coo_matrix<output_dims>), cudaMemcpyHostToDevice);
+
+	uint64_t * n_failures;
+
+	cudaMallocManaged((void **)&n_failures, sizeof(uint64_t));
+
+	n_failures[0] = 0;
+
+	uint64_t * x_keys = gallatin::utils::get_device_version<uint64_t>(x_mat.n_items);
+
+	uint64_t * offsets = gallatin::utils::get_device_version<uint64_t>(x_mat.n_items+1);
+
+	cudaDeviceSynchronize();
+
+
+	printf("%s starting\n", mm_type::get_name().c_str());
+
+
+	gallatin::utils::timer convert_timing;
+
+	convert_to_multimap<mm_type, n_dims, contraction_dims, tile_size><<<(y_mat.n_items*tile_size-1)/256+1,256>>>(indirection_table, y_mat_device, y_mat.n_items, n_failures);
+
+	convert_timing.sync_end();
+
+	convert_timing.print_throughput("Converted", y_mat.n_items);
+
+	indirection_table->print_fill();
+
+	if (n_failures[0] != 0){
+		printf("%lu y entries failed to insert - contraction is incomplete\n", n_failures[0]);
+	}
+
+
+	ht_type * accumulator = ht_type::generate_on_device(accumulator_nslots, 444);
+
+	cudaDeviceSynchronize();
+
+
+	gallatin::utils::timer count_timing;
+
+	extract_contraction_keys<n_dims, contraction_dims><<<(x_mat.n_items-1)/256+1,256>>>(x_mat_device, x_keys);
+
+	uint64_t total_matches = indirection_table->retrieve_count(x_keys, x_mat.n_items, offsets);
+
+	count_timing.sync_end();
+
+	count_timing.print_throughput("Counted", x_mat.n_items);
+
+	printf("%lu products to contract\n", total_matches);
+
+
+	//batch boundaries - a single x entry is never split.
+	uint64_t * host_offsets = gallatin::utils::get_host_version<uint64_t>(x_mat.n_items+1);
+
+	cudaMemcpy(host_offsets, offsets, sizeof(uint64_t)*(x_mat.n_items+1), cudaMemcpyDeviceToHost);
+
+	uint64_t batch_capacity = max_batch_items;
+
+	for (uint64_t i = 0; i < x_mat.n_items; i++){
+		if (host_offsets[i+1]-host_offsets[i] > batch_capacity) batch_capacity = host_offsets[i+1]-host_offsets[i];
+	}
+
+	if (batch_capacity > total_matches) batch_capacity = total_matches;
+
+	uint64_t * y_indices = gallatin::utils::get_device_version<uint64_t>(batch_capacity > 0 ? batch_capacity : 1);
+
+	cudaDeviceSynchronize();
+
+
+	gallatin::utils::timer contract_timing;
+
+	uint64_t batch_start = 0;
+
+	while (batch_start < x_mat.n_items){
+
+		uint64_t batch_end = batch_start+1;
+
+		while (batch_end < x_mat.n_items && host_offsets[batch_end+1]-host_offsets[batch_start] <= batch_capacity){
+			batch_end++;
+		}
+
+		uint64_t n_batch = batch_end-batch_start;
+
+		indirection_table->retrieve_write(x_keys+batch_start, n_batch, offsets+batch_start, y_indices);
+
+		contract_multimap<ht_type, lower_COO, n_dims, contraction_dims, output_dims, tile_size><<<(n_batch*tile_size-1)/256+1,256>>>(x_mat_device, y_mat_device, offsets, y_indices, batch_start, batch_end, accumulator, output_mat_device);
+
+		batch_start = batch_end;
+
+	}
+
+	contract_timing.sync_end();
+
+	contract_timing.print_throughput("contracted", x_mat.n_items);
+
+	accumulator->print_fill();
+
+
+	mm_type::free_on_device(indirection_table);
+
+	ht_type::free_on_device(accumulator);
+
+	cudaFree(n_failures);
+	cudaFree(x_keys);
+	cudaFree(offsets);
+	cudaFree(y_indices);
+	cudaFreeHost(host_offsets);
+
+	return convert_timing.elapsed()+count_timing.elapsed()+contract_timing.elapsed();
+
+
+}
+
+
+
+
 template <int n_dims, int contraction_dims, template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
 __host__ void tensor_contraction_individual_ops(std::string filename, uint64_t accumulator_nslots){
 
@@ -0,0 +1,246 @@
+#ifndef HT_VALUE_SLAB
+#define HT_VALUE_SLAB
+
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <cooperative_groups.h>
+
+//alloc utils needed for easy host_device transfer
+#include <gallatin/allocators/alloc_utils.cuh>
+
+namespace cg = cooperative_groups;
+
+
+#ifndef SET_BIT_MASK
+#define SET_BIT_MASK(index) ((1ULL << index))
+#endif
+
+
+namespace hashing_project {
+
+namespace helpers {
+
+
+  //fixed-size value row - the size class of a slab.
+  //rows are copied in 16 byte chunks, so sizes must be a multiple of 16.
+  template <uint n_bytes>
+  struct value_row {
+
+    static_assert(n_bytes % 16 == 0, "value rows must be a multiple of 16 bytes");
+
+    uint4 data[n_bytes/16];
+
+  };
+
+
+  template <typename slab_type>
+  __global__ void reclaim_slab_kernel(slab_type * slab, uint64_t n_retired){
+
+    uint64_t tid = gallatin::utils::get_tid();
+
+    if (tid >= n_retired) return;
+
+    slab->free_handle(slab->retired[tid]);
+
+  }
+
+
+  //table-owned storage for values that don't fit in a slot.
+  //Slots store a handle (index+1, so 0 stays the empty sentinel) into the slab.
+  //
+  //Allocation is a bitmap - one bit per row, claimed with atomicOr.
+  //Deletes don't free immediately: a query may still be copying the row, so the handle is
+  //pushed to a retired list and only returned to the bitmap by reclaim(), which runs between
+  //kernels when no reader can hold a handle (kernel boundaries act as the quiescent point).
+  template <typename Val>
+  struct value_slab {
+
+    using my_type = value_slab<Val>;
+
+    static_assert(sizeof(Val) % 16 == 0, "slab values are copied in 16 byte chunks");
+
+    Val * values;
+    uint64_t * alloc_bits;
+
+    uint64_t * retired;
+    uint64_t n_retired;
+
+    uint64_t n_values;
+    uint64_t n_words;
+
+
+    static __host__ my_type * generate_on_device(uint64_t ext_n_values){
+
+      my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+      host_version->n_values = ext_n_values;
+      host_version->n_words = (ext_n_values-1)/64+1;
+
+      host_version->values = gallatin::utils::get_device_version<Val>(ext_n_values);
+
+      host_version->alloc_bits = gallatin::utils::get_device_version<uint64_t>(host_version->n_words);
+
+      cudaMemset(host_version->alloc_bits, 0, sizeof(uint64_t)*host_version->n_words);
+
+      //a handle is retired at most once per allocation, so n_values entries bounds the list between reclaims.
+      host_version->retired = gallatin::utils::get_device_version<uint64_t>(ext_n_values);
+      host_version->n_retired = 0;
+
+      cudaDeviceSynchronize();
+
+      return gallatin::utils::move_to_device<my_type>(host_version);
+
+    }
+
+    static __host__ void free_on_device(my_type * device_version){
+
+      my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+      cudaFree(host_version->values);
+      cudaFree(host_version->alloc_bits);
+      cudaFree(host_version->retired);
+
+      cudaFreeHost(host_version);
+
+    }
+
+
+    //claim a free row - start at a hinted word so concurrent tiles spread across the bitmap.
+    //returns 0 if the slab is full.
+    __device__ uint64_t allocate(uint64_t hint){
+
+      uint64_t start = hint % n_words;
+
+      for (uint64_t i = 0; i < n_words; i++){
+
+        uint64_t word = (start + i) % n_words;
+
+        uint64_t loaded = alloc_bits[word];
+
+        while (~loaded != 0ULL){
+
+          int bit = __ffsll(~loaded)-1;
+
+          uint64_t index = word*64+bit;
+
+          //tail bits past n_values are never handed out.
+          if (index >= n_values) break;
+
+          uint64_t old = atomicOr((unsigned long long int *)&alloc_bits[word], (unsigned long long int) SET_BIT_MASK(bit));
+
+          if (!(old & SET_BIT_MASK(bit))){
+            return index+1;
+          }
+
+          loaded = old | SET_BIT_MASK(bit);
+
+        }
+
+      }
+
+      return 0;
+
+    }
+
+    //immediate free - only safe for handles that were never published.
+    __device__ void free_handle(uint64_t handle){
+
+      uint64_t index = handle-1;
+
+      atomicAnd((unsigned long long int *)&alloc_bits[index/64], (unsigned long long int) ~SET_BIT_MASK(index % 64));
+
+    }
+
+    //deferred free - row becomes reusable after the next reclaim().
+    __device__ void retire(uint64_t handle){
+
+      uint64_t slot = atomicAdd((unsigned long long int *)&n_retired, 1ULL);
+
+      retired[slot] = handle;
+
+    }
+
+    __device__ Val * get_value(uint64_t handle){
+
+      return &values[handle-1];
+
+    }
+
+
+    //tile-cooperative row copies - each thread moves 16 bytes per step.
+    template <uint tile_size>
+    __device__ void write_value(const cg::thread_block_tile<tile_size> & my_tile, uint64_t handle, const Val & val){
+
+      uint4 * dst = (uint4 *) get_value(handle);
+      const uint4 * src = (const uint4 *) &val;
+
+      for (uint i = my_tile.thread_rank(); i < sizeof(Val)/16; i+=my_tile.size()){
+        dst[i] = src[i];
+      }
+
+      //value must be visible before the handle is published.
+      __threadfence();
+      my_tile.sync();
+
+    }
+
+    template <uint tile_size>
+    __device__ void read_value(const cg::thread_block_tile<tile_size> & my_tile, uint64_t handle, Val & val){
+
+      const uint4 * src = (const uint4 *) get_value(handle);
+      uint4 * dst = (uint4 *) &val;
+
+      for (uint i = my_tile.thread_rank(); i < sizeof(Val)/16; i+=my_tile.size()){
+        dst[i] = src[i];
+      }
+
+      my_tile.sync();
+
+    }
+
+
+    //return retired rows to the allocator. Host only, between kernels.
+    __host__ void reclaim(){
+
+      my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+      uint64_t to_reclaim = host_version->n_retired;
+
+      if (to_reclaim > 0){
+
+        reclaim_slab_kernel<my_type><<<(to_reclaim-1)/256+1,256>>>(this, to_reclaim);
+
+        uint64_t zero = 0;
+        cudaMemcpy(&this->n_retired, &zero, sizeof(uint64_t), cudaMemcpyHostToDevice);
+
+      }
+
+      cudaDeviceSynchronize();
+
+      cudaFreeHost(host_version);
+
+    }
+
+    __host__ uint64_t get_space_usage(){
+
+      my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+      uint64_t bytes = host_version->n_values*(sizeof(Val)+sizeof(uint64_t)) + host_version->n_words*sizeof(uint64_t);
+
+      cudaFreeHost(host_version);
+
+      return bytes;
+
+    }
+
+  };
+
+
+}
+
+}
+
+
+#endif //end of value slab guard
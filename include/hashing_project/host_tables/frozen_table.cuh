@@ -0,0 +1,416 @@
+#ifndef HOST_FROZEN_TABLE
+#define HOST_FROZEN_TABLE
+
+//Read-only snapshot of a table for query-only phases.
+//
+//Pairs are packed into a bucketized cuckoo table: two candidate buckets per key, bucket_size
+//pairs per bucket (64 bytes for 4 x 16 byte pairs on the host, 128 bytes for 8 on the GPU),
+//built offline to ~95% fill. There are no tombstones, locks or holding keys, so a lookup is at
+//most two plain bucket reads plus a small stash that only collects keys the cuckoo walk gave up on.
+//
+//The builder lives here so it can run without CUDA. tables/frozen_table.cuh uploads the
+//same layout to the device and the file format is shared, so a snapshot saved by either
+//side can be loaded by the other.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+
+
+//keys the cuckoo walk could not place. Checked on every miss, so kept small.
+#define FROZEN_STASH_SIZE 32
+
+#define FROZEN_MAX_KICKS 500
+
+#define FROZEN_TARGET_FILL .95
+
+#define FROZEN_FILE_VERSION 1
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   struct frozen_file_header {
+
+      char magic[8];
+      uint32_t version;
+      uint32_t key_bytes;
+      uint32_t val_bytes;
+      uint32_t bucket_size;
+      uint64_t n_buckets;
+      uint64_t n_items;
+      uint64_t seed;
+      uint64_t n_stash;
+
+   };
+
+   static const char frozen_file_magic[8] = {'H', 'T', 'F', 'R', 'O', 'Z', 'E', 'N'};
+
+
+   template <typename Key, typename Val, uint bucket_size>
+   struct frozen_bucket {
+
+      static_assert((bucket_size & (bucket_size-1)) == 0, "frozen buckets must be a power of two slots");
+
+      using pair_type = ht_pair<Key, Val>;
+
+      alignas(bucket_size*sizeof(pair_type)) pair_type slots[bucket_size];
+
+   };
+
+
+   template <typename Key, Key defaultKey, typename Val, uint bucket_size>
+   struct host_frozen_table {
+
+
+      using my_type = host_frozen_table<Key, defaultKey, Val, bucket_size>;
+
+      using bucket_type = frozen_bucket<Key, Val, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+
+      bucket_type * buckets;
+
+      uint64_t n_buckets;
+      uint64_t n_items;
+      uint64_t seed;
+
+      packed_pair_type stash[FROZEN_STASH_SIZE];
+      uint64_t n_stash;
+
+
+      static my_type * allocate_on_host(uint64_t ext_n_buckets, uint64_t ext_seed){
+
+         my_type * host_version = new my_type;
+
+         host_version->n_buckets = ext_n_buckets;
+         host_version->n_items = 0;
+         host_version->seed = ext_seed;
+         host_version->n_stash = 0;
+
+         host_version->buckets = (bucket_type *) hashing_project::host::host_alloc(sizeof(bucket_type)*ext_n_buckets, alignof(bucket_type));
+
+         if (host_version->buckets == nullptr) throw std::bad_alloc();
+
+         packed_pair_type sentinel_pair{defaultKey, Val{}};
+
+         for (uint64_t i = 0; i < ext_n_buckets; i++){
+            for (uint j = 0; j < bucket_size; j++){
+               host_version->buckets[i].slots[j] = sentinel_pair;
+            }
+         }
+
+         for (uint i = 0; i < FROZEN_STASH_SIZE; i++){
+            host_version->stash[i] = sentinel_pair;
+         }
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         hashing_project::host::host_free(host_version->buckets);
+
+         delete host_version;
+
+      }
+
+
+      //pack n_pairs unique pairs. The table is grown by 2% and rebuilt until every key fits.
+      static my_type * build_on_host(const packed_pair_type * pairs, uint64_t n_pairs, uint64_t ext_seed){
+
+         uint64_t ext_n_buckets = (uint64_t) (n_pairs/(bucket_size*FROZEN_TARGET_FILL))+1;
+
+         while (true){
+
+            my_type * host_version = allocate_on_host(ext_n_buckets, ext_seed);
+
+            if (host_version->insert_all(pairs, n_pairs)) return host_version;
+
+            free_on_host(host_version);
+
+            ext_n_buckets = ext_n_buckets*1.02+1;
+
+         }
+
+      }
+
+
+      uint64_t hash(const void * key, int len, uint64_t seed){
+         return hashing_project::host::hash(key, len, seed);
+      }
+
+      uint64_t get_first_bucket(uint64_t hash){
+         return (hash & 0xFFFFFFFFULL) % n_buckets;
+      }
+
+      //never equal to the first bucket, so each key always has two choices.
+      uint64_t get_second_bucket(uint64_t hash){
+
+         if (n_buckets == 1) return 0;
+
+         uint64_t bucket_0 = get_first_bucket(hash);
+         uint64_t bucket_1 = (hash >> 32) % n_buckets;
+
+         return (bucket_1 == bucket_0) ? (bucket_0+1) % n_buckets : bucket_1;
+
+      }
+
+      uint64_t get_alt_bucket(const Key & key, uint64_t bucket){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+
+         return (bucket == bucket_0) ? get_second_bucket(key_hash) : bucket_0;
+
+      }
+
+
+      //build-side insert: place in the emptier bucket, otherwise random walk eviction.
+      bool insert_all(const packed_pair_type * pairs, uint64_t n_pairs){
+
+         std::vector<uint8_t> fill(n_buckets, 0);
+
+         uint64_t rng_state = seed ^ 0x9E3779B97F4A7C15ULL;
+
+         for (uint64_t i = 0; i < n_pairs; i++){
+
+            packed_pair_type current = pairs[i];
+
+            uint64_t key_hash = hash(&current.key, sizeof(Key), seed);
+
+            uint64_t bucket = get_first_bucket(key_hash);
+            uint64_t bucket_1 = get_second_bucket(key_hash);
+
+            if (fill[bucket_1] < fill[bucket]) bucket = bucket_1;
+
+            bool placed = false;
+
+            for (uint kick = 0; kick < FROZEN_MAX_KICKS; kick++){
+
+               if (fill[bucket] < bucket_size){
+
+                  buckets[bucket].slots[fill[bucket]] = current;
+                  fill[bucket]++;
+                  placed = true;
+                  break;
+
+               }
+
+               //xorshift - victim choice only needs to be cheap and not cycle.
+               rng_state ^= rng_state << 13;
+               rng_state ^= rng_state >> 7;
+               rng_state ^= rng_state << 17;
+
+               uint victim = rng_state % bucket_size;
+
+               packed_pair_type evicted = buckets[bucket].slots[victim];
+               buckets[bucket].slots[victim] = current;
+
+               current = evicted;
+               bucket = get_alt_bucket(current.key, bucket);
+
+            }
+
+            if (!placed){
+
+               if (n_stash == FROZEN_STASH_SIZE) return false;
+
+               stash[n_stash] = current;
+               n_stash++;
+
+            }
+
+         }
+
+         n_items = n_pairs;
+
+         return true;
+
+      }
+
+
+      [[nodiscard]] bool find_with_reference(const Key & key, Val & val){
+
+         //empty slots hold the sentinel, which is never a live key.
+         if (key == defaultKey) return false;
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         const bucket_type * bucket_0 = &buckets[get_first_bucket(key_hash)];
+
+         for (uint i = 0; i < bucket_size; i++){
+            if (bucket_0->slots[i].key == key){
+               val = bucket_0->slots[i].val;
+               return true;
+            }
+         }
+
+         const bucket_type * bucket_1 = &buckets[get_second_bucket(key_hash)];
+
+         for (uint i = 0; i < bucket_size; i++){
+            if (bucket_1->slots[i].key == key){
+               val = bucket_1->slots[i].val;
+               return true;
+            }
+         }
+
+         for (uint64_t i = 0; i < n_stash; i++){
+            if (stash[i].key == key){
+               val = stash[i].val;
+               return true;
+            }
+         }
+
+         return false;
+
+      }
+
+      //snapshot is immutable - identical to find_with_reference.
+      [[nodiscard]] bool find_with_reference_no_lock(const Key & key, Val & val){
+         return find_with_reference(key, val);
+      }
+
+
+      //file is the header, the stash, then the bucket array.
+      bool save_checkpoint(std::string filename){
+
+         FILE * file = fopen(filename.c_str(), "wb");
+
+         if (file == nullptr) return false;
+
+         frozen_file_header header;
+
+         memcpy(header.magic, frozen_file_magic, 8);
+         header.version = FROZEN_FILE_VERSION;
+         header.key_bytes = sizeof(Key);
+         header.val_bytes = sizeof(Val);
+         header.bucket_size = bucket_size;
+         header.n_buckets = n_buckets;
+         header.n_items = n_items;
+         header.seed = seed;
+         header.n_stash = n_stash;
+
+         bool written = fwrite(&header, sizeof(frozen_file_header), 1, file) == 1;
+
+         written = written && fwrite(stash, sizeof(packed_pair_type), FROZEN_STASH_SIZE, file) == FROZEN_STASH_SIZE;
+
+         written = written && fwrite(buckets, sizeof(bucket_type), n_buckets, file) == n_buckets;
+
+         fclose(file);
+
+         return written;
+
+      }
+
+      //nullptr if the file is missing or was written for a different key/value/bucket layout.
+      static my_type * load_checkpoint(std::string filename){
+
+         FILE * file = fopen(filename.c_str(), "rb");
+
+         if (file == nullptr) return nullptr;
+
+         frozen_file_header header;
+
+         if (fread(&header, sizeof(frozen_file_header), 1, file) != 1
+            || memcmp(header.magic, frozen_file_magic, 8) != 0
+            || header.version != FROZEN_FILE_VERSION
+            || header.key_bytes != sizeof(Key)
+            || header.val_bytes != sizeof(Val)
+            || header.bucket_size != bucket_size
+            || header.n_stash > FROZEN_STASH_SIZE){
+
+            fclose(file);
+            return nullptr;
+
+         }
+
+         my_type * host_version = allocate_on_host(header.n_buckets, header.seed);
+
+         host_version->n_items = header.n_items;
+         host_version->n_stash = header.n_stash;
+
+         bool read = fread(host_version->stash, sizeof(packed_pair_type), FROZEN_STASH_SIZE, file) == FROZEN_STASH_SIZE;
+
+         read = read && fread(host_version->buckets, sizeof(bucket_type), header.n_buckets, file) == header.n_buckets;
+
+         fclose(file);
+
+         if (!read){
+            free_on_host(host_version);
+            return nullptr;
+         }
+
+         return host_version;
+
+      }
+
+
+      static std::string get_name(){
+         return "host_frozen_table";
+      }
+
+      uint64_t get_fill(){
+         return n_items;
+      }
+
+      float load(){
+         return 1.0*n_items/(n_buckets*bucket_size);
+      }
+
+      uint64_t get_space_usage(){
+         return n_buckets*sizeof(bucket_type) + sizeof(my_type);
+      }
+
+      double get_bytes_per_key(){
+         return n_items == 0 ? 0 : 1.0*get_space_usage()/n_items;
+      }
+
+      void print_fill(){
+
+         printf("fill: %lu/%lu = %f%%, %lu stashed\n", n_items, n_buckets*bucket_size, 100.0*load(), n_stash);
+
+      }
+
+      void print_space_usage(){
+
+         printf("%s using %lu bytes, %f bytes per key\n", get_name().c_str(), get_space_usage(), get_bytes_per_key());
+
+      }
+
+   };
+
+
+template <typename T>
+constexpr T generate_frozen_sentinel() {
+  return ((T) 0);
+};
+
+
+//tile_size is unused on the host - kept so the alias drops into the same test templates as the device tables.
+//4 x 16 byte pairs keeps a host bucket on one 64 byte line.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using host_frozen_generic = typename hashing_project::tables::host_frozen_table<Key,
+                                    generate_frozen_sentinel<Key>(),
+                                    Val,
+                                    bucket_size>;
+
+
+}  // namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_FROZEN_TABLE
@@ -0,0 +1,751 @@
+#ifndef HOST_HOPSCOTCH_TABLE
+#define HOST_HOPSCOTCH_TABLE
+
+//Host version of tables/hopscotch.cuh.
+//
+//same layout and protocol as the device table: buckets of bucket_size pairs, a 32-bit
+//hop map per home bucket marking which of the next HOPSCOTCH_NEIGHBORHOOD buckets hold
+//its keys, and displacement that try-locks the home of every key it moves.
+//Writers hold the lock stripe of the key's home bucket, readers never lock.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <new>
+#include <string>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+#include <hashing_project/helpers/host_locks.cuh>
+#include <hashing_project/helpers/checkpoint.cuh>
+
+
+#define MAX_VALUE(nbits) ((1ULL << (nbits)) - 1)
+#define BITMASK(nbits) ((nbits) == 64 ? 0xffffffffffffffff : MAX_VALUE(nbits))
+
+#define SET_BIT_MASK(index) ((1ULL << index))
+
+
+#ifndef HOPSCOTCH_NEIGHBORHOOD
+#define HOPSCOTCH_NEIGHBORHOOD 32
+#endif
+
+#ifndef HOPSCOTCH_MAX_PROBES
+#define HOPSCOTCH_MAX_PROBES 256
+#endif
+
+#ifndef HOPSCOTCH_QUERY_RETRIES
+#define HOPSCOTCH_QUERY_RETRIES 2
+#endif
+
+#define HOST_HOPSCOTCH_LOCK_STRIPES 16384
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint bucket_size>
+   struct host_hopscotch_table {
+
+
+      using my_type = host_hopscotch_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+      static const Key holdingKey = tombstoneKey-1;
+
+
+      packed_pair_type * slots;
+      uint32_t * hop_maps;
+      hashing_project::host::host_striped_locks locks;
+
+      //set when restored by load_checkpoint() - the arrays live in the file mapping.
+      hashing_project::helpers::checkpoint_mapping mapping;
+
+      uint64_t n_buckets;
+      uint64_t seed;
+
+
+      static my_type * generate_on_host(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = new my_type;
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets = ext_n_buckets;
+         host_version->seed = ext_seed;
+
+         host_version->slots = (packed_pair_type *) hashing_project::host::host_alloc(sizeof(packed_pair_type)*ext_n_buckets*bucket_size);
+
+         host_version->hop_maps = (uint32_t *) hashing_project::host::host_alloc(sizeof(uint32_t)*ext_n_buckets);
+
+         if (host_version->slots == nullptr || host_version->hop_maps == nullptr) throw std::bad_alloc();
+
+         uint64_t n_locks = ext_n_buckets < HOST_HOPSCOTCH_LOCK_STRIPES ? ext_n_buckets : HOST_HOPSCOTCH_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         packed_pair_type sentinel_pair{defaultKey, defaultVal};
+
+         for (uint64_t i = 0; i < ext_n_buckets; i++){
+
+            host_version->hop_maps[i] = 0;
+
+            for (uint j = 0; j < bucket_size; j++){
+               host_version->slots[i*bucket_size+j] = sentinel_pair;
+            }
+
+         }
+
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         if (host_version->mapping.is_mapped()){
+            host_version->mapping.unmap();
+         } else {
+            hashing_project::host::host_free(host_version->slots);
+            hashing_project::host::host_free(host_version->hop_maps);
+         }
+
+         host_version->locks.free_locks();
+
+         delete host_version;
+
+      }
+
+
+      uint64_t hash(const void * key, int len, uint64_t seed){
+         return hashing_project::host::hash(key, len, seed);
+      }
+
+      uint64_t get_first_bucket(uint64_t hash){
+         return (hash & BITMASK(32)) % n_buckets;
+      }
+
+      uint64_t get_home(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+      uint64_t get_distance(uint64_t home, uint64_t bucket){
+         return (bucket + n_buckets - home) % n_buckets;
+      }
+
+      packed_pair_type * get_bucket_ptr(uint64_t bucket){
+         return &slots[bucket*bucket_size];
+      }
+
+      static bool is_live(Key key){
+         return key != defaultKey && key != tombstoneKey && key != holdingKey;
+      }
+
+
+      uint64_t get_lock_bucket(Key key){
+         return get_home(key);
+      }
+
+      void stall_lock(uint64_t bucket){
+         locks.lock(bucket);
+      }
+
+      void unlock(uint64_t bucket){
+         locks.unlock(bucket);
+      }
+
+      void lock_key(Key key){
+         stall_lock(get_lock_bucket(key));
+      }
+
+      void unlock_key(Key key){
+         unlock(get_lock_bucket(key));
+      }
+
+
+      uint32_t load_hop_map(uint64_t home){
+         return hashing_project::host::ht_load_acq(&hop_maps[home]);
+      }
+
+      void set_hop_bit(uint64_t home, uint64_t distance){
+         __atomic_fetch_or(&hop_maps[home], (uint32_t) SET_BIT_MASK(distance), __ATOMIC_RELEASE);
+      }
+
+      void clear_hop_bit(uint64_t home, uint64_t distance){
+         __atomic_fetch_and(&hop_maps[home], (uint32_t) ~SET_BIT_MASK(distance), __ATOMIC_RELEASE);
+      }
+
+
+      bool bucket_has_home(uint64_t bucket, uint64_t home){
+
+         packed_pair_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         for (uint i = 0; i < bucket_size; i++){
+
+            Key loaded_key = hashing_project::host::ht_load_acq(&bucket_ptr[i].key);
+
+            if (is_live(loaded_key) && get_home(loaded_key) == home) return true;
+
+         }
+
+         return false;
+
+      }
+
+
+      packed_pair_type * claim_free_slot(uint64_t home, uint64_t & free_distance){
+
+         for (uint64_t i = 0; i < HOPSCOTCH_MAX_PROBES && i < n_buckets; i++){
+
+            packed_pair_type * bucket_ptr = get_bucket_ptr((home + i) % n_buckets);
+
+            for (uint j = 0; j < bucket_size; j++){
+
+               Key loaded_key = hashing_project::host::ht_load_acq(&bucket_ptr[j].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey) continue;
+
+               if (hashing_project::host::ht_cas(&bucket_ptr[j].key, loaded_key, holdingKey)){
+                  free_distance = i;
+                  return &bucket_ptr[j];
+               }
+
+            }
+
+         }
+
+         return nullptr;
+
+      }
+
+
+      bool move_slot(uint64_t home, packed_pair_type * old_slot, packed_pair_type * free_slot, uint64_t free_bucket, uint64_t & moved_home){
+
+         Key loaded_key = hashing_project::host::ht_load_acq(&old_slot->key);
+
+         if (!is_live(loaded_key)) return false;
+
+         moved_home = get_home(loaded_key);
+
+         if (get_distance(moved_home, free_bucket) >= HOPSCOTCH_NEIGHBORHOOD) return false;
+
+         bool needs_lock = !locks.same_stripe(moved_home, home);
+
+         if (needs_lock && !locks.try_lock(moved_home)) return false;
+
+         //slot may have changed before the lock was acquired.
+         loaded_key = hashing_project::host::ht_load_acq(&old_slot->key);
+
+         if (!is_live(loaded_key) || get_home(loaded_key) != moved_home){
+
+            if (needs_lock) locks.unlock(moved_home);
+            return false;
+
+         }
+
+         Val loaded_val = hashing_project::host::ht_load_acq(&old_slot->val);
+
+         //publish at the new location before retiring the old one.
+         hashing_project::host::ht_store_rel(&free_slot->val, loaded_val);
+         hashing_project::host::ht_store_rel(&free_slot->key, loaded_key);
+
+         set_hop_bit(moved_home, get_distance(moved_home, free_bucket));
+
+         hashing_project::host::ht_store_rel(&old_slot->key, holdingKey);
+
+         return true;
+
+      }
+
+
+      bool hop_free_slot(uint64_t home, packed_pair_type * & free_slot, uint64_t & free_distance){
+
+         uint64_t free_bucket = (home + free_distance) % n_buckets;
+
+         for (uint64_t offset = HOPSCOTCH_NEIGHBORHOOD-1; offset > 0; offset--){
+
+            uint64_t bucket_index = (free_bucket + n_buckets - offset) % n_buckets;
+
+            packed_pair_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+            for (uint j = 0; j < bucket_size; j++){
+
+               uint64_t moved_home;
+
+               if (!move_slot(home, &bucket_ptr[j], free_slot, free_bucket, moved_home)) continue;
+
+               if (!bucket_has_home(bucket_index, moved_home)){
+                  clear_hop_bit(moved_home, get_distance(moved_home, bucket_index));
+               }
+
+               if (!locks.same_stripe(moved_home, home)) locks.unlock(moved_home);
+
+               free_slot = &bucket_ptr[j];
+               free_distance = free_distance - offset;
+
+               return true;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+
+      bool upsert_replace_internal(const Key & key, const Val & val, uint64_t home){
+
+         uint64_t free_distance;
+
+         packed_pair_type * free_slot = claim_free_slot(home, free_distance);
+
+         if (free_slot == nullptr) return false;
+
+         while (free_distance >= HOPSCOTCH_NEIGHBORHOOD){
+
+            if (!hop_free_slot(home, free_slot, free_distance)){
+
+               hashing_project::host::ht_store_rel(&free_slot->key, tombstoneKey);
+               return false;
+
+            }
+
+         }
+
+         hashing_project::host::ht_store_rel(&free_slot->val, val);
+         hashing_project::host::ht_store_rel(&free_slot->key, key);
+
+         set_hop_bit(home, free_distance);
+
+         return true;
+
+      }
+
+
+      packed_pair_type * query_packed_reference(const Key & key, uint64_t home, uint64_t & found_distance, bool retry){
+
+         for (int attempt = 0; attempt <= HOPSCOTCH_QUERY_RETRIES; attempt++){
+
+            uint32_t hop_map = load_hop_map(home);
+
+            uint32_t remaining = hop_map;
+
+            while (remaining){
+
+               int distance = __builtin_ctz(remaining);
+
+               remaining &= remaining-1;
+
+               packed_pair_type * bucket_ptr = get_bucket_ptr((home + distance) % n_buckets);
+
+               for (uint j = 0; j < bucket_size; j++){
+
+                  if (hashing_project::host::ht_load_acq(&bucket_ptr[j].key) == key){
+                     found_distance = distance;
+                     return &bucket_ptr[j];
+                  }
+
+               }
+
+            }
+
+            if (!retry || load_hop_map(home) == hop_map) return nullptr;
+
+         }
+
+         return nullptr;
+
+      }
+
+      bool query_internal(const Key & key, Val & val, uint64_t home){
+
+         for (int attempt = 0; attempt <= HOPSCOTCH_QUERY_RETRIES; attempt++){
+
+            uint32_t hop_map = load_hop_map(home);
+
+            uint32_t remaining = hop_map;
+
+            while (remaining){
+
+               int distance = __builtin_ctz(remaining);
+
+               remaining &= remaining-1;
+
+               packed_pair_type * bucket_ptr = get_bucket_ptr((home + distance) % n_buckets);
+
+               for (uint j = 0; j < bucket_size; j++){
+
+                  if (hashing_project::host::ht_load_acq(&bucket_ptr[j].key) != key) continue;
+
+                  Val loaded_val = hashing_project::host::ht_load_acq(&bucket_ptr[j].val);
+
+                  //re-validate - the slot may have been moved or deleted while reading.
+                  if (hashing_project::host::ht_load_acq(&bucket_ptr[j].key) == key){
+                     val = loaded_val;
+                     return true;
+                  }
+
+               }
+
+            }
+
+            if (load_hop_map(home) == hop_map) return false;
+
+         }
+
+         return false;
+
+      }
+
+
+      bool upsert_replace(const Key & key, const Val & val){
+
+         uint64_t home = get_home(key);
+         uint64_t found_distance;
+
+         stall_lock(home);
+
+         packed_pair_type * existing_loc = query_packed_reference(key, home, found_distance, false);
+
+         if (existing_loc != nullptr){
+
+            hashing_project::host::ht_store_rel(&existing_loc->val, val);
+
+            unlock(home);
+
+            return true;
+
+         }
+
+         bool return_val = upsert_replace_internal(key, val, home);
+
+         unlock(home);
+
+         return return_val;
+
+      }
+
+      bool upsert_no_lock(const Key & key, const Val & val){
+
+         uint64_t home = get_home(key);
+         uint64_t found_distance;
+
+         packed_pair_type * existing_loc = query_packed_reference(key, home, found_distance, false);
+
+         if (existing_loc != nullptr){
+
+            hashing_project::host::ht_store_rel(&existing_loc->val, val);
+
+            return true;
+
+         }
+
+         return upsert_replace_internal(key, val, home);
+
+      }
+
+      bool upsert_replace_no_lock(const Key & key, const Val & val){
+         return upsert_no_lock(key, val);
+      }
+
+
+      template <typename replace_func_type>
+      bool upsert_function(const Key & key, const Val & val, replace_func_type replace_func){
+
+         uint64_t home = get_home(key);
+         uint64_t found_distance;
+
+         stall_lock(home);
+
+         packed_pair_type * existing_loc = query_packed_reference(key, home, found_distance, false);
+
+         if (existing_loc != nullptr){
+
+            replace_func(existing_loc, key, val);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            unlock(home);
+
+            return true;
+
+         }
+
+         bool return_val = upsert_replace_internal(key, val, home);
+
+         unlock(home);
+
+         return return_val;
+
+      }
+
+      template <typename replace_func_type>
+      bool upsert_function_no_lock(const Key & key, const Val & val, replace_func_type replace_func){
+
+         uint64_t home = get_home(key);
+         uint64_t found_distance;
+
+         packed_pair_type * existing_loc = query_packed_reference(key, home, found_distance, false);
+
+         if (existing_loc != nullptr){
+
+            replace_func(existing_loc, key, val);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            return true;
+
+         }
+
+         return upsert_replace_internal(key, val, home);
+
+      }
+
+
+      //with STABLE_HT_LOCKLESS_QUERY the probe is re-run if a writer (including a displacement
+      //moving one of home's keys) held home's stripe meanwhile.
+      [[nodiscard]] bool find_with_reference(Key key, Val & val){
+
+         uint64_t home = get_home(key);
+
+         return locks.optimistic_query(home, [&](){
+            return query_internal(key, val, home);
+         });
+
+      }
+
+      //plain unvalidated probe, for callers that already hold home's stripe.
+      [[nodiscard]] bool find_with_reference_no_lock(Key key, Val & val){
+
+         return query_internal(key, val, get_home(key));
+
+      }
+
+      [[nodiscard]] packed_pair_type * find_pair(Key key){
+
+         uint64_t found_distance;
+
+         return query_packed_reference(key, get_home(key), found_distance, true);
+
+      }
+
+      [[nodiscard]] packed_pair_type * find_pair_no_lock(Key key){
+
+         return find_pair(key);
+
+      }
+
+
+      bool remove_internal(const Key & key, uint64_t home){
+
+         uint64_t found_distance;
+
+         packed_pair_type * found_pair = query_packed_reference(key, home, found_distance, false);
+
+         if (found_pair == nullptr) return false;
+
+         if (!hashing_project::host::ht_cas(&found_pair->key, key, tombstoneKey)) return false;
+
+         hashing_project::host::ht_store_rel(&found_pair->val, tombstoneVal);
+
+         if (!bucket_has_home((home + found_distance) % n_buckets, home)){
+            clear_hop_bit(home, found_distance);
+         }
+
+         return true;
+
+      }
+
+      bool remove(Key key){
+
+         uint64_t home = get_home(key);
+
+         stall_lock(home);
+
+         bool result = remove_internal(key, home);
+
+         unlock(home);
+
+         return result;
+
+      }
+
+      bool remove_no_lock(Key key){
+
+         return remove_internal(key, get_home(key));
+
+      }
+
+
+      static packed_pair_type pack_together(Key key, Val val){
+         return packed_pair_type{key, val};
+      }
+
+      static std::string get_name(){
+         return "host_hopscotch_hashing";
+      }
+
+      uint64_t get_num_locks(){
+         return n_buckets;
+      }
+
+      uint64_t get_bucket_fill(uint64_t bucket){
+
+         packed_pair_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         uint64_t fill = 0;
+
+         for (uint j = 0; j < bucket_size; j++){
+
+            Key loaded_key = hashing_project::host::ht_load_acq(&bucket_ptr[j].key);
+
+            fill += (loaded_key != defaultKey && loaded_key != tombstoneKey);
+
+         }
+
+         return fill;
+
+      }
+
+      //checkpoint (helpers/checkpoint.cuh): slots, hop_maps. Call on a quiescent table.
+      bool save_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         return writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), 1, bucket_size, seed, n_buckets, 0))
+            && writer.write_region(slots, sizeof(packed_pair_type)*n_buckets*bucket_size)
+            && writer.write_region(hop_maps, sizeof(uint32_t)*n_buckets)
+            && writer.close();
+
+      }
+
+      //zero copy restore of a table written by save_checkpoint(): the arrays point into a private mapping of the
+      //file, so pages fault in on first touch and writes never reach the file. Locks start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), 1, bucket_size)) return nullptr;
+
+         my_type * host_version = new my_type;
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->slots = (packed_pair_type *) reader.next_region(sizeof(packed_pair_type)*host_version->n_buckets*bucket_size);
+         host_version->hop_maps = (uint32_t *) reader.next_region(sizeof(uint32_t)*host_version->n_buckets);
+
+         if (host_version->slots == nullptr || host_version->hop_maps == nullptr){
+            delete host_version;
+            return nullptr;
+         }
+
+         uint64_t n_locks = host_version->n_buckets < HOST_HOPSCOTCH_LOCK_STRIPES ? host_version->n_buckets : HOST_HOPSCOTCH_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         host_version->mapping = reader.release();
+
+         return host_version;
+
+      }
+
+      uint64_t get_n_sweep_buckets(){
+         return n_buckets;
+      }
+
+      //sweep hook for helpers/host_table_sweep.cuh: func(key, val) on every live slot of the bucket.
+      //Keys are loaded first and the value only for a live slot.
+      template <typename func_type>
+      void for_each_in_bucket(uint64_t bucket, func_type func){
+
+         packed_pair_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         for (uint j = 0; j < bucket_size; j++){
+
+            Key loaded_key = hashing_project::host::ht_load_acq(&bucket_ptr[j].key);
+
+            if (!is_live(loaded_key)) continue;
+
+            Val loaded_val = hashing_project::host::ht_load_acq(&bucket_ptr[j].val);
+
+            //re-validate - the slot may have been moved or deleted while reading.
+            if (hashing_project::host::ht_load_acq(&bucket_ptr[j].key) != loaded_key) continue;
+
+            func(loaded_key, loaded_val);
+
+         }
+
+      }
+
+      uint64_t get_fill(){
+
+         uint64_t n_items = 0;
+
+         for (uint64_t i = 0; i < n_buckets; i++){
+            n_items += get_bucket_fill(i);
+         }
+
+         return n_items;
+
+      }
+
+      float load(){
+         return 1.0*get_fill()/(n_buckets*bucket_size);
+      }
+
+      void print_fill(){
+
+         uint64_t n_items = get_fill();
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_buckets*bucket_size, 100.0*n_items/(n_buckets*bucket_size));
+
+      }
+
+      void print_space_usage(){
+
+         uint64_t capacity = n_buckets*(bucket_size*sizeof(packed_pair_type)+sizeof(uint32_t)) + locks.get_space_usage();
+
+         printf("host_hopscotch_hashing using %lu bytes\n", capacity);
+
+      }
+
+   };
+
+
+template <typename T>
+constexpr T generate_host_hopscotch_tombstone(uint64_t offset) {
+  return (~((T) 0)) - offset;
+};
+
+template <typename T>
+constexpr T generate_host_hopscotch_sentinel() {
+  return ((T) 0);
+};
+
+
+//tile_size is unused on the host - kept so the alias drops into the same test templates as the device tables.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using host_hopscotch_generic = typename hashing_project::tables::host_hopscotch_table<Key,
+                                    generate_host_hopscotch_sentinel<Key>(),
+                                    generate_host_hopscotch_tombstone<Key>(0),
+                                    Val,
+                                    generate_host_hopscotch_sentinel<Val>(),
+                                    generate_host_hopscotch_tombstone<Val>(0),
+                                    bucket_size>;
+
+
+} //namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_HOPSCOTCH_TABLE
@@ -0,0 +1,894 @@
+#ifndef HOST_ICEBERG_QUOTIENT
+#define HOST_ICEBERG_QUOTIENT
+
+//Host version of tables/iht_p2_metadata_quotient.cuh.
+//
+//Same placement as the device table for a given seed: the frontyard bucket is
+//fmix64(key ^ seed) % n_buckets_primary, its 16 bit tag and 32 bit remainder come from the
+//quotient, and the backyard is two-choice over full keys. Tags of a bucket are matched 8 at a
+//time with SSE2.
+//
+//Writers take the lock stripe of the key's frontyard bucket. Slots are claimed by CASing the
+//tag to holding, the remainder/pair and value are written, then the tag is published with a
+//release store, so lock-free readers never match a half-written slot.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <string>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+#include <hashing_project/helpers/host_locks.cuh>
+#include <hashing_project/helpers/checkpoint.cuh>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+//same split as METADATA_FULL_FRONT_TOTAL_RATIO on the device.
+#define HOST_ICEBERG_FRONT_TOTAL_RATIO .83
+
+#define HOST_ICEBERG_MIN_FRONT_BUCKETS (1ULL << 16)
+
+#define HOST_ICEBERG_LOCK_STRIPES 16384
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   static const uint16_t host_iceberg_empty_tag = 0;
+   static const uint16_t host_iceberg_tombstone_tag = 0xFFFF;
+   static const uint16_t host_iceberg_holding_tag = 0xFFFE;
+
+
+   template <uint bucket_size>
+   struct host_iceberg_tags {
+
+      static_assert(bucket_size % 8 == 0 && bucket_size <= 32, "iceberg buckets are matched 8 tags at a time into 32 bit masks");
+
+      alignas(16) uint16_t tags[bucket_size];
+
+      void init(){
+
+         for (uint i = 0; i < bucket_size; i++){
+            tags[i] = host_iceberg_empty_tag;
+         }
+
+      }
+
+      static bool is_storable(uint16_t tag){
+         return tag != host_iceberg_empty_tag && tag != host_iceberg_tombstone_tag && tag != host_iceberg_holding_tag;
+      }
+
+      //bitmask of every slot whose tag equals tag.
+      inline uint32_t match(uint16_t tag) const {
+
+         std::atomic_thread_fence(std::memory_order_acquire);
+
+         #if defined(__SSE2__)
+
+         uint32_t match = 0;
+
+         for (uint i = 0; i < bucket_size; i+=8){
+
+            __m128i loaded = _mm_load_si128((const __m128i *) &tags[i]);
+            __m128i equal = _mm_cmpeq_epi16(loaded, _mm_set1_epi16((short) tag));
+
+            //narrow the 16 bit lanes to bytes so movemask gives one bit per slot.
+            match |= ((uint32_t) (_mm_movemask_epi8(_mm_packs_epi16(equal, _mm_setzero_si128())) & 0xFF)) << i;
+
+         }
+
+         return match;
+
+         #else
+
+         uint32_t match = 0;
+
+         for (uint i = 0; i < bucket_size; i++){
+            match |= ((uint32_t) (hashing_project::host::ht_load_acq(&tags[i]) == tag)) << i;
+         }
+
+         return match;
+
+         #endif
+
+      }
+
+      inline uint32_t match_open() const {
+         return match(host_iceberg_empty_tag) | match(host_iceberg_tombstone_tag);
+      }
+
+      //slots holding a published tag.
+      inline uint32_t match_live() const {
+
+         uint32_t live = ~(match_open() | match(host_iceberg_holding_tag));
+
+         if constexpr (bucket_size < 32){
+            live &= (1U << bucket_size)-1;
+         }
+
+         return live;
+
+      }
+
+      uint16_t load_tag(int index) const {
+         return hashing_project::host::ht_load_acq(&tags[index]);
+      }
+
+      //claim the first open slot for a writer, -1 if the bucket is full.
+      int claim(){
+
+         uint32_t open_slots = match_open();
+
+         while (open_slots){
+
+            int slot = __builtin_ctz(open_slots);
+
+            uint16_t current = load_tag(slot);
+
+            if ((current == host_iceberg_empty_tag || current == host_iceberg_tombstone_tag) && hashing_project::host::ht_cas(&tags[slot], current, host_iceberg_holding_tag)){
+               return slot;
+            }
+
+            open_slots &= open_slots-1;
+
+         }
+
+         return -1;
+
+      }
+
+      void publish(int index, uint16_t tag){
+         hashing_project::host::ht_store_rel(&tags[index], tag);
+      }
+
+      uint32_t get_fill() const {
+         return bucket_size - __builtin_popcount(match_open());
+      }
+
+   };
+
+
+   template <typename Val, uint bucket_size>
+   struct host_iceberg_quotient_bucket {
+
+      uint32_t remainders[bucket_size];
+      Val vals[bucket_size];
+
+   };
+
+   template <typename Key, typename Val, uint bucket_size>
+   struct host_iceberg_backyard_bucket {
+
+      ht_pair<Key, Val> slots[bucket_size];
+
+   };
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint bucket_size>
+   struct host_quotient_iceberg_table {
+
+
+      static_assert(sizeof(Key) == 8, "quotienting needs 64 bit keys for the invertible permutation");
+
+
+      using my_type = host_quotient_iceberg_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, bucket_size>;
+
+      using tag_bucket_type = host_iceberg_tags<bucket_size>;
+
+      using frontyard_bucket_type = host_iceberg_quotient_bucket<Val, bucket_size>;
+
+      using backyard_bucket_type = host_iceberg_backyard_bucket<Key, Val, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+
+      tag_bucket_type * metadata;
+      frontyard_bucket_type * primary_buckets;
+
+      tag_bucket_type * backing_metadata;
+      backyard_bucket_type * alt_buckets;
+
+      hashing_project::host::host_striped_locks locks;
+
+      //set when restored by load_checkpoint() - the arrays live in the file mapping.
+      hashing_project::helpers::checkpoint_mapping mapping;
+
+      uint64_t n_buckets_primary;
+      uint64_t n_buckets_alt;
+      uint64_t seed;
+
+
+      static my_type * generate_on_host(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = new my_type;
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets_primary = ext_n_buckets*HOST_ICEBERG_FRONT_TOTAL_RATIO;
+
+         if (host_version->n_buckets_primary < HOST_ICEBERG_MIN_FRONT_BUCKETS) host_version->n_buckets_primary = HOST_ICEBERG_MIN_FRONT_BUCKETS;
+
+         host_version->n_buckets_alt = ext_n_buckets*(1.0-HOST_ICEBERG_FRONT_TOTAL_RATIO)+1;
+
+         host_version->seed = ext_seed;
+
+         host_version->metadata = (tag_bucket_type *) hashing_project::host::host_alloc(sizeof(tag_bucket_type)*host_version->n_buckets_primary);
+         host_version->primary_buckets = (frontyard_bucket_type *) hashing_project::host::host_alloc(sizeof(frontyard_bucket_type)*host_version->n_buckets_primary);
+         host_version->backing_metadata = (tag_bucket_type *) hashing_project::host::host_alloc(sizeof(tag_bucket_type)*host_version->n_buckets_alt);
+         host_version->alt_buckets = (backyard_bucket_type *) hashing_project::host::host_alloc(sizeof(backyard_bucket_type)*host_version->n_buckets_alt);
+
+         if (host_version->metadata == nullptr || host_version->primary_buckets == nullptr || host_version->backing_metadata == nullptr || host_version->alt_buckets == nullptr) throw std::bad_alloc();
+
+         uint64_t n_locks = host_version->n_buckets_primary < HOST_ICEBERG_LOCK_STRIPES ? host_version->n_buckets_primary : HOST_ICEBERG_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         for (uint64_t i = 0; i < host_version->n_buckets_primary; i++){
+
+            host_version->metadata[i].init();
+
+            for (uint j = 0; j < bucket_size; j++){
+               host_version->primary_buckets[i].remainders[j] = 0;
+               host_version->primary_buckets[i].vals[j] = defaultVal;
+            }
+
+         }
+
+         packed_pair_type sentinel_pair{defaultKey, defaultVal};
+
+         for (uint64_t i = 0; i < host_version->n_buckets_alt; i++){
+
+            host_version->backing_metadata[i].init();
+
+            for (uint j = 0; j < bucket_size; j++){
+               host_version->alt_buckets[i].slots[j] = sentinel_pair;
+            }
+
+         }
+
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         if (host_version->mapping.is_mapped()){
+            host_version->mapping.unmap();
+         } else {
+            hashing_project::host::host_free(host_version->metadata);
+            hashing_project::host::host_free(host_version->primary_buckets);
+            hashing_project::host::host_free(host_version->backing_metadata);
+            hashing_project::host::host_free(host_version->alt_buckets);
+         }
+
+         host_version->locks.free_locks();
+
+         delete host_version;
+
+      }
+
+
+      uint64_t hash(const void * key, int len, uint64_t seed){
+         return hashing_project::host::hash(key, len, seed);
+      }
+
+      //must match quotient_md_iht_p2_table::permute_key.
+      uint64_t permute_key(Key key){
+
+         uint64_t h = ((uint64_t) key) ^ seed;
+
+         h ^= h >> 33;
+         h *= 0xff51afd7ed558ccdULL;
+         h ^= h >> 33;
+         h *= 0xc4ceb9fe1a85ec53ULL;
+         h ^= h >> 33;
+
+         return h;
+
+      }
+
+      Key unpermute_key(uint64_t h){
+
+         h ^= h >> 33;
+         h *= 0x9cb4b2f8129337dbULL;
+         h ^= h >> 33;
+         h *= 0x4f74430c22a54005ULL;
+         h ^= h >> 33;
+
+         return (Key) (h ^ seed);
+
+      }
+
+      uint64_t get_first_bucket(uint64_t key_hash){
+         return key_hash % n_buckets_primary;
+      }
+
+      uint64_t get_quotient(uint64_t key_hash){
+         return key_hash / n_buckets_primary;
+      }
+
+      Key recover_key(uint64_t bucket, uint16_t tag, uint32_t remainder){
+
+         uint64_t quotient = (((uint64_t) remainder) << 16) | tag;
+
+         return unpermute_key(quotient*n_buckets_primary + bucket);
+
+      }
+
+      uint64_t get_second_bucket(uint64_t key_hash){
+         return (key_hash >> 32) % n_buckets_alt;
+      }
+
+      uint64_t get_third_bucket(const Key & key){
+         return hash(&key, sizeof(Key), seed+2) % n_buckets_alt;
+      }
+
+      //backyard tag, same rule as iht_full_metadata_bucket::get_tag plus the holding tag.
+      uint16_t get_backyard_tag(Key key){
+
+         uint16_t key_tag = (uint16_t) key;
+
+         while (!tag_bucket_type::is_storable(key_tag)){
+            key += 1;
+            key_tag = (uint16_t) key;
+         }
+
+         return key_tag;
+
+      }
+
+
+      uint64_t get_lock_bucket(Key key){
+         return get_first_bucket(permute_key(key));
+      }
+
+      void stall_lock(uint64_t bucket){
+         locks.lock(bucket);
+      }
+
+      void unlock(uint64_t bucket){
+         locks.unlock(bucket);
+      }
+
+
+      //frontyard slot holding (tag, remainder), or -1.
+      int find_frontyard(uint64_t bucket, uint16_t tag, uint32_t remainder){
+
+         uint32_t match = metadata[bucket].match(tag);
+
+         while (match){
+
+            int slot = __builtin_ctz(match);
+
+            if (hashing_project::host::ht_load_acq(&primary_buckets[bucket].remainders[slot]) == remainder) return slot;
+
+            match &= match-1;
+
+         }
+
+         return -1;
+
+      }
+
+      //claim an open frontyard slot and publish the pair, false if the bucket is full.
+      bool insert_frontyard(uint64_t bucket_primary, uint16_t tag, uint32_t remainder, const Val & val){
+
+         int claimed = metadata[bucket_primary].claim();
+
+         if (claimed == -1) return false;
+
+         hashing_project::host::ht_store_rel(&primary_buckets[bucket_primary].remainders[claimed], remainder);
+         hashing_project::host::ht_store_rel(&primary_buckets[bucket_primary].vals[claimed], val);
+
+         metadata[bucket_primary].publish(claimed, tag);
+
+         return true;
+
+      }
+
+      int find_backyard(uint64_t bucket, const Key & key, uint16_t tag){
+
+         uint32_t match = backing_metadata[bucket].match(tag);
+
+         while (match){
+
+            int slot = __builtin_ctz(match);
+
+            if (hashing_project::host::ht_load_acq(&alt_buckets[bucket].slots[slot].key) == key) return slot;
+
+            match &= match-1;
+
+         }
+
+         return -1;
+
+      }
+
+
+      bool upsert_replace(const Key & key, const Val & val){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         stall_lock(bucket_primary);
+
+         bool return_val = upsert_replace_internal(key, val, bucket_primary, key_hash);
+
+         unlock(bucket_primary);
+
+         return return_val;
+
+      }
+
+      bool upsert_no_lock(const Key & key, const Val & val){
+
+         uint64_t key_hash = permute_key(key);
+
+         return upsert_replace_internal(key, val, get_first_bucket(key_hash), key_hash);
+
+      }
+
+      bool upsert_replace_internal(const Key & key, const Val & val, uint64_t bucket_primary, uint64_t key_hash){
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = (uint16_t) quotient;
+         uint32_t remainder = (uint32_t) (quotient >> 16);
+
+         #if P2_SPECULATIVE_LOAD
+         hashing_project::host::prefetch_read(&backing_metadata[get_second_bucket(key_hash)], sizeof(backing_metadata[0]));
+         hashing_project::host::prefetch_read(&backing_metadata[get_third_bucket(key)], sizeof(backing_metadata[0]));
+         #endif
+
+         if (tag_bucket_type::is_storable(tag)){
+
+            int existing = find_frontyard(bucket_primary, tag, remainder);
+
+            if (existing != -1){
+               hashing_project::host::ht_store_rel(&primary_buckets[bucket_primary].vals[existing], val);
+               return true;
+            }
+
+            //same shortcut as full_md_iht_p2_table. A key only spills to the backyard once its frontyard bucket
+            //has no empty slot, and remove leaves tombstones, so while an empty slot is left the key cannot be
+            //in the backyard and the backyard probe is skipped.
+            if (metadata[bucket_primary].match(host_iceberg_empty_tag) && insert_frontyard(bucket_primary, tag, remainder, val)) return true;
+
+         }
+
+         uint16_t backyard_tag = get_backyard_tag(key);
+
+         uint64_t bucket_0 = get_second_bucket(key_hash);
+         uint64_t bucket_1 = get_third_bucket(key);
+
+         int existing = find_backyard(bucket_0, key, backyard_tag);
+
+         if (existing != -1){
+            hashing_project::host::ht_store_rel(&alt_buckets[bucket_0].slots[existing].val, val);
+            return true;
+         }
+
+         existing = find_backyard(bucket_1, key, backyard_tag);
+
+         if (existing != -1){
+            hashing_project::host::ht_store_rel(&alt_buckets[bucket_1].slots[existing].val, val);
+            return true;
+         }
+
+         //the key is in neither yard - a frontyard tombstone is still preferred over the backyard.
+         if (tag_bucket_type::is_storable(tag) && insert_frontyard(bucket_primary, tag, remainder, val)) return true;
+
+         //backyard buckets are shared across lock stripes, so claims can lose and retry.
+         while (true){
+
+            uint32_t bucket_0_fill = backing_metadata[bucket_0].get_fill();
+            uint32_t bucket_1_fill = backing_metadata[bucket_1].get_fill();
+
+            if (bucket_0_fill == bucket_size && bucket_1_fill == bucket_size) return false;
+
+            uint64_t bucket = (bucket_0_fill <= bucket_1_fill) ? bucket_0 : bucket_1;
+
+            int claimed = backing_metadata[bucket].claim();
+
+            if (claimed == -1) continue;
+
+            hashing_project::host::ht_store_rel(&alt_buckets[bucket].slots[claimed].val, val);
+            hashing_project::host::ht_store_rel(&alt_buckets[bucket].slots[claimed].key, key);
+
+            backing_metadata[bucket].publish(claimed, backyard_tag);
+
+            return true;
+
+         }
+
+      }
+
+
+      //unvalidated probe - frontyard, then both backyard buckets.
+      bool query_internal(const Key & key, Val & val){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = (uint16_t) quotient;
+
+         if (tag_bucket_type::is_storable(tag)){
+
+            int found = find_frontyard(bucket_primary, tag, (uint32_t) (quotient >> 16));
+
+            if (found != -1){
+
+               Val loaded_val = hashing_project::host::ht_load_acq(&primary_buckets[bucket_primary].vals[found]);
+
+               //re-validate - slot may have been removed and reclaimed while reading.
+               if (metadata[bucket_primary].load_tag(found) == tag){
+                  val = loaded_val;
+                  return true;
+               }
+
+            }
+
+         }
+
+         uint16_t backyard_tag = get_backyard_tag(key);
+
+         uint64_t backyard_buckets[2] = {get_second_bucket(key_hash), get_third_bucket(key)};
+
+         for (uint i = 0; i < 2; i++){
+
+            uint64_t bucket = backyard_buckets[i];
+
+            int found = find_backyard(bucket, key, backyard_tag);
+
+            if (found != -1){
+
+               Val loaded_val = hashing_project::host::ht_load_acq(&alt_buckets[bucket].slots[found].val);
+
+               if (backing_metadata[bucket].load_tag(found) == backyard_tag && hashing_project::host::ht_load_acq(&alt_buckets[bucket].slots[found].key) == key){
+                  val = loaded_val;
+                  return true;
+               }
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+      //with STABLE_HT_LOCKLESS_QUERY the probe is re-run if a writer held the primary stripe meanwhile -
+      //every write to a key, frontyard or backyard, happens under its primary bucket's lock.
+      [[nodiscard]] bool find_with_reference(const Key & key, Val & val){
+
+         #if P2_SPECULATIVE_LOAD
+
+         return find_with_reference_speculative(key, val);
+
+         #elif STABLE_HT_LOCKLESS_QUERY
+
+         return locks.optimistic_query(get_lock_bucket(key), [&](){
+            return query_internal(key, val);
+         });
+
+         #else
+
+         return query_internal(key, val);
+
+         #endif
+
+      }
+
+      //plain unvalidated probe, for callers that already hold the key's primary stripe.
+      [[nodiscard]] bool find_with_reference_no_lock(const Key & key, Val & val){
+         return query_internal(key, val);
+      }
+
+      //prefetch the frontyard bucket and both backyard candidates before the probe starts, so
+      //frontyard misses don't wait on two more dependent misses for the p2 backyard.
+      [[nodiscard]] bool find_with_reference_speculative(const Key & key, Val & val){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+         uint64_t bucket_0 = get_second_bucket(key_hash);
+         uint64_t bucket_1 = get_third_bucket(key);
+
+         hashing_project::host::prefetch_read(&metadata[bucket_primary], sizeof(metadata[bucket_primary]));
+         hashing_project::host::prefetch_read(&backing_metadata[bucket_0], sizeof(backing_metadata[bucket_0]));
+         hashing_project::host::prefetch_read(&backing_metadata[bucket_1], sizeof(backing_metadata[bucket_1]));
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         return locks.optimistic_query(bucket_primary, [&](){
+            return query_internal(key, val);
+         });
+
+         #else
+
+         return query_internal(key, val);
+
+         #endif
+
+      }
+
+
+      bool remove(const Key & key){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         stall_lock(bucket_primary);
+
+         bool return_val = remove_internal(key, bucket_primary, key_hash);
+
+         unlock(bucket_primary);
+
+         return return_val;
+
+      }
+
+      bool remove_no_lock(const Key & key){
+
+         uint64_t key_hash = permute_key(key);
+
+         return remove_internal(key, get_first_bucket(key_hash), key_hash);
+
+      }
+
+      bool remove_internal(const Key & key, uint64_t bucket_primary, uint64_t key_hash){
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = (uint16_t) quotient;
+
+         if (tag_bucket_type::is_storable(tag)){
+
+            int found = find_frontyard(bucket_primary, tag, (uint32_t) (quotient >> 16));
+
+            if (found != -1){
+               metadata[bucket_primary].publish(found, host_iceberg_tombstone_tag);
+               return true;
+            }
+
+         }
+
+         uint16_t backyard_tag = get_backyard_tag(key);
+
+         uint64_t backyard_buckets[2] = {get_second_bucket(key_hash), get_third_bucket(key)};
+
+         for (uint i = 0; i < 2; i++){
+
+            uint64_t bucket = backyard_buckets[i];
+
+            int found = find_backyard(bucket, key, backyard_tag);
+
+            if (found != -1){
+
+               hashing_project::host::ht_store_rel(&alt_buckets[bucket].slots[found].key, tombstoneKey);
+               backing_metadata[bucket].publish(found, host_iceberg_tombstone_tag);
+               return true;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+
+      //key held by a frontyard slot, or defaultKey if the slot is not live.
+      Key get_frontyard_key(uint64_t bucket, int slot){
+
+         uint16_t tag = metadata[bucket].load_tag(slot);
+
+         if (!tag_bucket_type::is_storable(tag)) return defaultKey;
+
+         return recover_key(bucket, tag, hashing_project::host::ht_load_acq(&primary_buckets[bucket].remainders[slot]));
+
+      }
+
+
+      //checkpoint (helpers/checkpoint.cuh): frontyard metadata + primary_buckets, then the backyard
+      //backing_metadata + alt_buckets. Call on a quiescent table.
+      bool save_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         return writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), 1, bucket_size, seed, n_buckets_primary, n_buckets_alt))
+            && writer.write_region(metadata, sizeof(tag_bucket_type)*n_buckets_primary)
+            && writer.write_region(primary_buckets, sizeof(frontyard_bucket_type)*n_buckets_primary)
+            && writer.write_region(backing_metadata, sizeof(tag_bucket_type)*n_buckets_alt)
+            && writer.write_region(alt_buckets, sizeof(backyard_bucket_type)*n_buckets_alt)
+            && writer.close();
+
+      }
+
+      //zero copy restore of a table written by save_checkpoint(): the arrays point into a private mapping of the
+      //file, so pages fault in on first touch and writes never reach the file. Locks start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), 1, bucket_size)) return nullptr;
+
+         my_type * host_version = new my_type;
+
+         host_version->n_buckets_primary = reader.header.n_buckets_primary;
+         host_version->n_buckets_alt = reader.header.n_buckets_alt;
+         host_version->seed = reader.header.seed;
+
+         host_version->metadata = (tag_bucket_type *) reader.next_region(sizeof(tag_bucket_type)*host_version->n_buckets_primary);
+         host_version->primary_buckets = (frontyard_bucket_type *) reader.next_region(sizeof(frontyard_bucket_type)*host_version->n_buckets_primary);
+         host_version->backing_metadata = (tag_bucket_type *) reader.next_region(sizeof(tag_bucket_type)*host_version->n_buckets_alt);
+         host_version->alt_buckets = (backyard_bucket_type *) reader.next_region(sizeof(backyard_bucket_type)*host_version->n_buckets_alt);
+
+         if (host_version->metadata == nullptr || host_version->primary_buckets == nullptr || host_version->backing_metadata == nullptr || host_version->alt_buckets == nullptr){
+            delete host_version;
+            return nullptr;
+         }
+
+         uint64_t n_locks = host_version->n_buckets_primary < HOST_ICEBERG_LOCK_STRIPES ? host_version->n_buckets_primary : HOST_ICEBERG_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         host_version->mapping = reader.release();
+
+         return host_version;
+
+      }
+
+      uint64_t get_n_sweep_buckets(){
+         return n_buckets_primary + n_buckets_alt;
+      }
+
+      //sweep hook for helpers/host_table_sweep.cuh - frontyard buckets first, then the backyard.
+      //Tags are matched first, so only live slots are read. Frontyard keys are rebuilt from the quotient.
+      template <typename func_type>
+      void for_each_in_bucket(uint64_t bucket, func_type func){
+
+         if (bucket < n_buckets_primary){
+
+            uint32_t live = metadata[bucket].match_live();
+
+            while (live){
+
+               int slot = __builtin_ctz(live);
+
+               live &= live-1;
+
+               uint16_t tag = metadata[bucket].load_tag(slot);
+
+               if (!tag_bucket_type::is_storable(tag)) continue;
+
+               Key loaded_key = recover_key(bucket, tag, hashing_project::host::ht_load_acq(&primary_buckets[bucket].remainders[slot]));
+               Val loaded_val = hashing_project::host::ht_load_acq(&primary_buckets[bucket].vals[slot]);
+
+               //re-validate - slot may have been removed and reclaimed while reading.
+               if (metadata[bucket].load_tag(slot) != tag) continue;
+
+               func(loaded_key, loaded_val);
+
+            }
+
+            return;
+
+         }
+
+         bucket -= n_buckets_primary;
+
+         uint32_t live = backing_metadata[bucket].match_live();
+
+         while (live){
+
+            int slot = __builtin_ctz(live);
+
+            live &= live-1;
+
+            uint16_t tag = backing_metadata[bucket].load_tag(slot);
+
+            Key loaded_key = hashing_project::host::ht_load_acq(&alt_buckets[bucket].slots[slot].key);
+            Val loaded_val = hashing_project::host::ht_load_acq(&alt_buckets[bucket].slots[slot].val);
+
+            if (!tag_bucket_type::is_storable(tag) || loaded_key == defaultKey || loaded_key == tombstoneKey) continue;
+
+            if (backing_metadata[bucket].load_tag(slot) != tag || hashing_project::host::ht_load_acq(&alt_buckets[bucket].slots[slot].key) != loaded_key) continue;
+
+            func(loaded_key, loaded_val);
+
+         }
+
+      }
+
+
+      static std::string get_name(){
+         return "host_quotient_iceberg_table";
+      }
+
+      uint64_t get_num_locks(){
+         return n_buckets_primary;
+      }
+
+      uint64_t get_fill(){
+
+         uint64_t n_items = 0;
+
+         for (uint64_t i = 0; i < n_buckets_primary; i++){
+            n_items += metadata[i].get_fill();
+         }
+
+         for (uint64_t i = 0; i < n_buckets_alt; i++){
+            n_items += backing_metadata[i].get_fill();
+         }
+
+         return n_items;
+
+      }
+
+      float load(){
+         return 1.0*get_fill()/((n_buckets_primary+n_buckets_alt)*bucket_size);
+      }
+
+      uint64_t get_space_usage(){
+
+         return n_buckets_primary*(sizeof(tag_bucket_type)+sizeof(frontyard_bucket_type)) + n_buckets_alt*(sizeof(tag_bucket_type)+sizeof(backyard_bucket_type)) + locks.get_space_usage();
+
+      }
+
+      void print_fill(){
+
+         uint64_t n_items = get_fill();
+
+         uint64_t n_slots = (n_buckets_primary+n_buckets_alt)*bucket_size;
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_slots, 100.0*n_items/n_slots);
+
+      }
+
+      void print_space_usage(){
+
+         printf("host_quotient_iceberg_table using %lu bytes\n", get_space_usage());
+
+      }
+
+   };
+
+
+template <typename T>
+constexpr T generate_host_iceberg_tombstone(uint64_t offset) {
+  return (~((T) 0)) - offset;
+};
+
+template <typename T>
+constexpr T generate_host_iceberg_sentinel() {
+  return ((T) 0);
+};
+
+
+//tile_size is unused on the host - kept so the alias drops into the same test templates as the device tables.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using host_iht_p2_quotient_generic = typename hashing_project::tables::host_quotient_iceberg_table<Key,
+                                    generate_host_iceberg_sentinel<Key>(),
+                                    generate_host_iceberg_tombstone<Key>(0),
+                                    Val,
+                                    generate_host_iceberg_sentinel<Val>(),
+                                    generate_host_iceberg_tombstone<Val>(0),
+                                    bucket_size>;
+
+
+}  // namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_ICEBERG_QUOTIENT
@@ -0,0 +1,473 @@
+#ifndef HOST_SHARDED_TABLE
+#define HOST_SHARDED_TABLE
+
+//Hash-partitioned router over N instances of a host table (swiss, hopscotch, quotient iceberg).
+//
+//A key's shard comes from the high 32 bits of a router hash, mapped to [0, n_shards) with a
+//multiply-shift. The router seed is derived from the table seed but differs from it, so a shard's
+//keys still spread over all of its buckets.
+//
+//Single key ops forward to the owning shard. Batch ops (upsert / find / remove) run in three steps:
+// 1) partition: workers histogram their slice of the batch by shard, an exclusive scan over
+//    (shard, worker) gives every worker a private range per shard, and a second pass scatters keys
+//    (and values) into contiguous per-shard buffers along with each pair's input index,
+// 2) execute: every shard runs its buffer concurrently on n_threads / n_shards threads,
+// 3) gather: results are written through the saved input index, so they come back in input order.
+//
+//Shards are independent tables with their own locks, so shard batches never contend.
+//Concurrent batches on the same sharded table behave like concurrent ops on the shards.
+//
+//NUMA: generate_on_host(..., numa_aware = true) assigns shard i to node i % n_nodes
+//(helpers/host_numa.cuh). Each shard is generated on a thread pinned to its node, so first-touch
+//places its arrays there. Step 2 runs every shard's ops on threads pinned to the same node, so table
+//probes stay node-local and only the sequential reads of the partition buffers cross sockets.
+//On a one-node machine this is the same as the default layout plus pinning.
+//Per-node counters (ops and busy time of the node's slowest shard per batch) are kept in both modes.
+//Without numa_aware every shard counts as node 0.
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <utility>
+#include <chrono>
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_numa.cuh>
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename table_type>
+   struct host_sharded_table {
+
+
+      using my_type = host_sharded_table<table_type>;
+
+      using packed_pair_type = typename table_type::packed_pair_type;
+
+      using Key = decltype(std::declval<packed_pair_type>().key);
+      using Val = decltype(std::declval<packed_pair_type>().val);
+
+
+      std::vector<table_type *> shards;
+
+      uint32_t n_shards;
+
+      uint64_t router_seed;
+
+
+      bool numa_aware;
+
+      hashing_project::host::numa_topology topology;
+
+      std::vector<uint32_t> shard_node;
+
+      //per node, updated with __atomic adds - concurrent batches may finish together.
+      std::vector<uint64_t> node_ops;
+      std::vector<uint64_t> node_busy_ns;
+
+
+      //cache_capacity is the total over all shards.
+      static my_type * generate_on_host(uint64_t cache_capacity, uint64_t ext_seed, uint32_t ext_n_shards, bool ext_numa_aware = false){
+
+         my_type * host_version = new my_type;
+
+         if (ext_n_shards == 0) ext_n_shards = 1;
+
+         host_version->n_shards = ext_n_shards;
+
+         host_version->router_seed = ext_seed ^ 0x9E3779B97F4A7C15ULL;
+
+         host_version->numa_aware = ext_numa_aware;
+
+         if (ext_numa_aware){
+            host_version->topology = hashing_project::host::numa_topology::detect();
+         } else {
+            host_version->topology.node_ids.push_back(0);
+            host_version->topology.node_cpus.push_back(std::vector<int>());
+         }
+
+         uint32_t n_nodes = host_version->topology.get_n_nodes();
+
+         host_version->node_ops.assign(n_nodes, 0);
+         host_version->node_busy_ns.assign(n_nodes, 0);
+
+         uint64_t shard_capacity = (cache_capacity-1)/ext_n_shards+1;
+
+         host_version->shards.assign(ext_n_shards, nullptr);
+         host_version->shard_node.assign(ext_n_shards, 0);
+
+         hashing_project::host::parallel_for(ext_n_shards, ext_n_shards, [&](uint64_t shard){
+
+            host_version->shard_node[shard] = shard % n_nodes;
+
+            if (ext_numa_aware){
+
+               hashing_project::host::parallel_for_on_node(host_version->topology, host_version->shard_node[shard], 1, 1, [&](uint64_t){
+                  host_version->shards[shard] = table_type::generate_on_host(shard_capacity, ext_seed+shard);
+               });
+
+            } else {
+               host_version->shards[shard] = table_type::generate_on_host(shard_capacity, ext_seed+shard);
+            }
+
+         });
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         for (table_type * shard : host_version->shards){
+            table_type::free_on_host(shard);
+         }
+
+         delete host_version;
+
+      }
+
+
+      uint32_t get_shard(const Key & key){
+
+         uint64_t key_hash = hashing_project::host::hash(&key, sizeof(Key), router_seed);
+
+         return (uint32_t) (((key_hash >> 32) * n_shards) >> 32);
+
+      }
+
+
+      bool upsert_replace(const Key & key, const Val & val){
+         return shards[get_shard(key)]->upsert_replace(key, val);
+      }
+
+      [[nodiscard]] bool find_with_reference(Key key, Val & val){
+         return shards[get_shard(key)]->find_with_reference(key, val);
+      }
+
+      bool remove(Key key){
+         return shards[get_shard(key)]->remove(key);
+      }
+
+
+      //batch split into per-shard buffers. Shard s owns [shard_start[s], shard_start[s+1]) of
+      //keys / vals / input_index.
+      struct partition {
+
+         std::vector<uint64_t> shard_start;
+
+         std::vector<Key> keys;
+         std::vector<Val> vals;
+
+         std::vector<uint64_t> input_index;
+
+      };
+
+
+      partition partition_batch(const Key * keys, const Val * vals, uint64_t n, uint32_t n_threads){
+
+         partition batch;
+
+         uint32_t n_workers = n_threads == 0 ? 1 : n_threads;
+
+         uint64_t items_per_worker = n == 0 ? 0 : (n-1)/n_workers+1;
+
+         std::vector<uint32_t> shard_ids(n);
+
+         //histogram[worker*n_shards + shard]
+         std::vector<uint64_t> histogram((uint64_t) n_workers*n_shards, 0);
+
+         hashing_project::host::parallel_for(n_workers, n_workers, [&](uint64_t worker){
+
+            uint64_t start = worker*items_per_worker;
+            uint64_t end = start + items_per_worker < n ? start + items_per_worker : n;
+
+            for (uint64_t i = start; i < end; i++){
+
+               shard_ids[i] = get_shard(keys[i]);
+
+               histogram[worker*n_shards + shard_ids[i]]++;
+
+            }
+
+         });
+
+         //scan in (shard, worker) order - each worker writes its own contiguous piece of each shard.
+         batch.shard_start.assign(n_shards+1, 0);
+
+         std::vector<uint64_t> cursors((uint64_t) n_workers*n_shards);
+
+         uint64_t running = 0;
+
+         for (uint32_t shard = 0; shard < n_shards; shard++){
+
+            batch.shard_start[shard] = running;
+
+            for (uint32_t worker = 0; worker < n_workers; worker++){
+
+               cursors[(uint64_t) worker*n_shards + shard] = running;
+
+               running += histogram[(uint64_t) worker*n_shards + shard];
+
+            }
+
+         }
+
+         batch.shard_start[n_shards] = running;
+
+         batch.keys.resize(n);
+         batch.input_index.resize(n);
+
+         if (vals != nullptr) batch.vals.resize(n);
+
+         hashing_project::host::parallel_for(n_workers, n_workers, [&](uint64_t worker){
+
+            uint64_t start = worker*items_per_worker;
+            uint64_t end = start + items_per_worker < n ? start + items_per_worker : n;
+
+            for (uint64_t i = start; i < end; i++){
+
+               uint64_t position = cursors[worker*n_shards + shard_ids[i]]++;
+
+               batch.keys[position] = keys[i];
+               batch.input_index[position] = i;
+
+               if (vals != nullptr) batch.vals[position] = vals[i];
+
+            }
+
+         });
+
+         return batch;
+
+      }
+
+
+      //op(shard, position in the partition) on every pair, shards in parallel.
+      template <typename op_type>
+      void execute_batch(partition & batch, uint32_t n_threads, op_type op){
+
+         uint32_t threads_per_shard = n_threads / n_shards;
+
+         if (threads_per_shard == 0) threads_per_shard = 1;
+
+         std::vector<uint64_t> shard_ns(n_shards, 0);
+
+         hashing_project::host::parallel_for(n_shards, n_shards, [&](uint64_t shard){
+
+            uint64_t start = batch.shard_start[shard];
+
+            uint64_t n_ops = batch.shard_start[shard+1]-start;
+
+            auto shard_start = std::chrono::high_resolution_clock::now();
+
+            if (numa_aware){
+
+               hashing_project::host::parallel_for_on_node(topology, shard_node[shard], threads_per_shard, n_ops, [&](uint64_t i){
+                  op(shards[shard], start+i);
+               });
+
+            } else {
+
+               hashing_project::host::parallel_for(threads_per_shard, n_ops, [&](uint64_t i){
+                  op(shards[shard], start+i);
+               });
+
+            }
+
+            auto shard_end = std::chrono::high_resolution_clock::now();
+
+            shard_ns[shard] = std::chrono::duration_cast<std::chrono::nanoseconds>(shard_end-shard_start).count();
+
+         });
+
+         //a node is busy until its slowest shard finishes.
+         for (uint32_t node = 0; node < topology.get_n_nodes(); node++){
+
+            uint64_t ops = 0;
+            uint64_t busy_ns = 0;
+
+            for (uint32_t shard = 0; shard < n_shards; shard++){
+
+               if (shard_node[shard] != node) continue;
+
+               ops += batch.shard_start[shard+1]-batch.shard_start[shard];
+
+               if (shard_ns[shard] > busy_ns) busy_ns = shard_ns[shard];
+
+            }
+
+            __atomic_fetch_add(&node_ops[node], ops, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&node_busy_ns[node], busy_ns, __ATOMIC_RELAXED);
+
+         }
+
+      }
+
+
+      //results in input order: inserted[i] for keys[i]. Returns the number of successes.
+      uint64_t upsert_batch(const Key * keys, const Val * vals, uint64_t n, bool * inserted = nullptr, uint32_t n_threads = hashing_project::host::get_default_n_threads()){
+
+         partition batch = partition_batch(keys, vals, n, n_threads);
+
+         std::atomic<uint64_t> n_inserted(0);
+
+         execute_batch(batch, n_threads, [&](table_type * shard, uint64_t position){
+
+            bool result = shard->upsert_replace(batch.keys[position], batch.vals[position]);
+
+            if (inserted != nullptr) inserted[batch.input_index[position]] = result;
+
+            if (result) n_inserted.fetch_add(1, std::memory_order_relaxed);
+
+         });
+
+         return n_inserted.load();
+
+      }
+
+      //vals_out[i] is only written if found[i]. Returns the number found.
+      uint64_t find_batch(const Key * keys, Val * vals_out, bool * found, uint64_t n, uint32_t n_threads = hashing_project::host::get_default_n_threads()){
+
+         partition batch = partition_batch(keys, nullptr, n, n_threads);
+
+         std::atomic<uint64_t> n_found(0);
+
+         execute_batch(batch, n_threads, [&](table_type * shard, uint64_t position){
+
+            uint64_t index = batch.input_index[position];
+
+            Val val;
+
+            bool result = shard->find_with_reference(batch.keys[position], val);
+
+            if (result){
+               vals_out[index] = val;
+               n_found.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            found[index] = result;
+
+         });
+
+         return n_found.load();
+
+      }
+
+      uint64_t remove_batch(const Key * keys, uint64_t n, bool * removed = nullptr, uint32_t n_threads = hashing_project::host::get_default_n_threads()){
+
+         partition batch = partition_batch(keys, nullptr, n, n_threads);
+
+         std::atomic<uint64_t> n_removed(0);
+
+         execute_batch(batch, n_threads, [&](table_type * shard, uint64_t position){
+
+            bool result = shard->remove(batch.keys[position]);
+
+            if (removed != nullptr) removed[batch.input_index[position]] = result;
+
+            if (result) n_removed.fetch_add(1, std::memory_order_relaxed);
+
+         });
+
+         return n_removed.load();
+
+      }
+
+
+      static std::string get_name(){
+         return "host_sharded_" + table_type::get_name();
+      }
+
+      uint64_t get_fill(){
+
+         uint64_t n_items = 0;
+
+         for (table_type * shard : shards){
+            n_items += shard->get_fill();
+         }
+
+         return n_items;
+
+      }
+
+      //largest shard fill over the mean - 1.0 is a perfect split.
+      double get_shard_imbalance(){
+
+         uint64_t max_fill = 0;
+         uint64_t total_fill = 0;
+
+         for (table_type * shard : shards){
+
+            uint64_t shard_fill = shard->get_fill();
+
+            if (shard_fill > max_fill) max_fill = shard_fill;
+
+            total_fill += shard_fill;
+
+         }
+
+         if (total_fill == 0) return 1.0;
+
+         return 1.0*max_fill*n_shards/total_fill;
+
+      }
+
+      uint32_t get_n_nodes(){
+         return topology.get_n_nodes();
+      }
+
+      //batch ops routed to node since the last reset.
+      uint64_t get_node_ops(uint32_t node){
+         return __atomic_load_n(&node_ops[node], __ATOMIC_RELAXED);
+      }
+
+      //ops per second while the node was executing batches.
+      double get_node_throughput(uint32_t node){
+
+         uint64_t busy_ns = __atomic_load_n(&node_busy_ns[node], __ATOMIC_RELAXED);
+
+         if (busy_ns == 0) return 0;
+
+         return 1e9*get_node_ops(node)/busy_ns;
+
+      }
+
+      void reset_node_counters(){
+
+         for (uint32_t node = 0; node < get_n_nodes(); node++){
+            __atomic_store_n(&node_ops[node], 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&node_busy_ns[node], 0, __ATOMIC_RELAXED);
+         }
+
+      }
+
+      void print_node_counters(){
+
+         for (uint32_t node = 0; node < get_n_nodes(); node++){
+            printf("node %d: %lu ops, %f M/s\n", topology.node_ids[node], get_node_ops(node), get_node_throughput(node)/1000000);
+         }
+
+      }
+
+      void print_space_usage(){
+
+         for (table_type * shard : shards){
+            shard->print_space_usage();
+         }
+
+      }
+
+   };
+
+
+}  // namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_SHARDED_TABLE
@@ -0,0 +1,267 @@
+#ifndef HOST_STRING_TABLE
+#define HOST_STRING_TABLE
+
+//host version of tables/string_key_table.cuh.
+//strings live in an append-only arena, the inner host table maps
+//(64-bit string hash -> arena offset), and the arena is only read on a hash match.
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   //arena layout: [val][len][bytes...], padded to 8 bytes.
+   struct host_string_record {
+      uint64_t val;
+      uint64_t len;
+   };
+
+
+   template <template<typename, typename, uint, uint> typename inner_table, uint bucket_size>
+   struct host_string_table {
+
+
+      using my_type = host_string_table<inner_table, bucket_size>;
+
+      using table_type = inner_table<uint64_t, uint64_t, 1, bucket_size>;
+
+
+      table_type * table;
+
+      char * arena;
+      uint64_t arena_bytes;
+      std::atomic<uint64_t> arena_used;
+
+      uint64_t seed;
+
+
+      static my_type * generate_on_host(uint64_t cache_capacity, uint64_t ext_arena_bytes, uint64_t ext_seed){
+
+         my_type * host_version = new my_type;
+
+         host_version->table = table_type::generate_on_host(cache_capacity, ext_seed);
+
+         host_version->arena = (char *) hashing_project::host::host_alloc(ext_arena_bytes);
+
+         if (host_version->arena == nullptr) throw std::bad_alloc();
+
+         host_version->arena_bytes = ext_arena_bytes;
+
+         //offset 0 is reserved so no record sits at the empty value.
+         host_version->arena_used.store(sizeof(host_string_record), std::memory_order_relaxed);
+
+         host_version->seed = ext_seed;
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         table_type::free_on_host(host_version->table);
+
+         hashing_project::host::host_free(host_version->arena);
+
+         delete host_version;
+
+      }
+
+
+      //hash of the string, moved off the inner table's sentinel/tombstone/holding keys.
+      uint64_t get_string_hash(std::string_view str){
+
+         uint64_t str_hash = hashing_project::host::hash(str.data(), str.size(), seed);
+
+         if (str_hash == 0ULL) str_hash = 1ULL;
+         if (str_hash >= ~1ULL) str_hash -= 2;
+
+         return str_hash;
+
+      }
+
+      host_string_record * get_record(uint64_t offset){
+         return (host_string_record *) (arena + offset);
+      }
+
+      const char * get_string(uint64_t offset){
+         return arena + offset + sizeof(host_string_record);
+      }
+
+      bool string_matches(uint64_t offset, std::string_view str){
+
+         host_string_record * record = get_record(offset);
+
+         if (record->len != str.size()) return false;
+
+         return std::memcmp(get_string(offset), str.data(), str.size()) == 0;
+
+      }
+
+
+      static uint64_t get_record_bytes(uint64_t len){
+         return ((sizeof(host_string_record) + len - 1)/8+1)*8;
+      }
+
+      //append a record. Returns 0 if the arena is full.
+      //arena_used only advances when the record fits, so a full arena stays at its real usage.
+      uint64_t append_string(std::string_view str, uint64_t val){
+
+         uint64_t record_bytes = get_record_bytes(str.size());
+
+         uint64_t offset = arena_used.load(std::memory_order_relaxed);
+
+         do {
+
+            if (offset + record_bytes > arena_bytes) return 0;
+
+         } while (!arena_used.compare_exchange_weak(offset, offset + record_bytes, std::memory_order_relaxed));
+
+         host_string_record * record = get_record(offset);
+
+         record->val = val;
+         record->len = str.size();
+
+         std::memcpy(arena + offset + sizeof(host_string_record), str.data(), str.size());
+
+         //publishing the offset through the inner table is a release store.
+         return offset;
+
+      }
+
+      //undo an append whose key could not be stored. The space is returned if nothing was
+      //appended after it - otherwise the record is unreachable, like a removed string.
+      void rollback_string(uint64_t offset, uint64_t len){
+
+         uint64_t expected = offset + get_record_bytes(len);
+
+         arena_used.compare_exchange_strong(expected, offset, std::memory_order_relaxed);
+
+      }
+
+
+      bool upsert_replace(std::string_view str, uint64_t val){
+
+         uint64_t str_hash = get_string_hash(str);
+
+         uint64_t bucket = table->get_lock_bucket(str_hash);
+
+         table->stall_lock(bucket);
+
+         uint64_t offset;
+
+         bool return_val;
+
+         if (table->find_with_reference_no_lock(str_hash, offset)){
+
+            return_val = string_matches(offset, str);
+
+            if (return_val){
+               hashing_project::host::ht_store_rel(&get_record(offset)->val, val);
+            }
+
+         } else {
+
+            offset = append_string(str, val);
+
+            return_val = (offset != 0) && table->upsert_no_lock(str_hash, offset);
+
+            //the inner table is full - don't leave the record behind.
+            if (offset != 0 && !return_val) rollback_string(offset, str.size());
+
+         }
+
+         table->unlock(bucket);
+
+         return return_val;
+
+      }
+
+
+      [[nodiscard]] bool find_with_reference(std::string_view str, uint64_t & val){
+
+         uint64_t str_hash = get_string_hash(str);
+
+         uint64_t offset;
+
+         if (!table->find_with_reference(str_hash, offset)) return false;
+
+         //only touch the arena after a full hash match.
+         if (!string_matches(offset, str)) return false;
+
+         val = hashing_project::host::ht_load_acq(&get_record(offset)->val);
+
+         return true;
+
+      }
+
+
+      bool remove(std::string_view str){
+
+         uint64_t str_hash = get_string_hash(str);
+
+         uint64_t bucket = table->get_lock_bucket(str_hash);
+
+         table->stall_lock(bucket);
+
+         uint64_t offset;
+
+         bool return_val = false;
+
+         if (table->find_with_reference_no_lock(str_hash, offset) && string_matches(offset, str)){
+
+            return_val = table->remove_no_lock(str_hash);
+
+         }
+
+         table->unlock(bucket);
+
+         return return_val;
+
+      }
+
+
+      uint64_t get_arena_usage(){
+         return arena_used.load(std::memory_order_relaxed);
+      }
+
+      static std::string get_name(){
+         return "host_string_key_" + table_type::get_name();
+      }
+
+      uint64_t get_fill(){
+         return table->get_fill();
+      }
+
+      void print_space_usage(){
+
+         table->print_space_usage();
+
+         printf("string arena using %lu/%lu bytes\n", get_arena_usage(), arena_bytes);
+
+      }
+
+   };
+
+
+template <uint bucket_size>
+using host_string_key_swiss = host_string_table<host_swiss_generic, bucket_size>;
+
+
+}  // namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_STRING_TABLE
@@ -0,0 +1,470 @@
+#ifndef HOST_SWISS_MULTIMAP
+#define HOST_SWISS_MULTIMAP
+
+//Host multimap on the swiss-table layout, the CPU counterpart of
+//tables/double_hashing_metadata_multimap.cuh.
+//
+//insert_dup claims the first empty or deleted control byte along the (linear) group probe
+//sequence, so a key may be stored any number of times. count/retrieve_all match H2 over
+//each group and stop at the first group with an empty slot. The probe sequence is not
+//capped at HOST_SWISS_MAX_PROBES - a heavy key spans ~copies/group_size groups.
+//
+//Writers serialize on the key's primary lock stripe only against remove_all; insert_dups
+//race safely on the control-byte CAS.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+#include <hashing_project/helpers/host_locks.cuh>
+#include <hashing_project/helpers/checkpoint.cuh>
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint group_size>
+   struct host_swiss_multimap {
+
+
+      using my_type = host_swiss_multimap<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, group_size>;
+
+      using group_type = swiss_group<group_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+
+      group_type * groups;
+      packed_pair_type * slots;
+      hashing_project::host::host_striped_locks locks;
+
+      //set when restored by load_checkpoint() - the arrays live in the file mapping.
+      hashing_project::helpers::checkpoint_mapping mapping;
+
+      uint64_t n_groups;
+      uint64_t seed;
+
+
+      static my_type * generate_on_host(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = new my_type;
+
+         uint64_t ext_n_groups = (cache_capacity-1)/group_size+1;
+
+         host_version->n_groups = ext_n_groups;
+         host_version->seed = ext_seed;
+
+         host_version->groups = (group_type *) hashing_project::host::host_alloc(sizeof(group_type)*ext_n_groups);
+
+         host_version->slots = (packed_pair_type *) hashing_project::host::host_alloc(sizeof(packed_pair_type)*ext_n_groups*group_size);
+
+         if (host_version->groups == nullptr || host_version->slots == nullptr) throw std::bad_alloc();
+
+         uint64_t n_locks = ext_n_groups < HOST_SWISS_LOCK_STRIPES ? ext_n_groups : HOST_SWISS_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         packed_pair_type sentinel_pair{defaultKey, defaultVal};
+
+         for (uint64_t i = 0; i < ext_n_groups; i++){
+
+            host_version->groups[i].init();
+
+            for (uint j = 0; j < group_size; j++){
+               host_version->slots[i*group_size+j] = sentinel_pair;
+            }
+
+         }
+
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         if (host_version->mapping.is_mapped()){
+            host_version->mapping.unmap();
+         } else {
+            hashing_project::host::host_free(host_version->groups);
+            hashing_project::host::host_free(host_version->slots);
+         }
+
+         host_version->locks.free_locks();
+
+         delete host_version;
+
+      }
+
+
+      uint64_t hash(const void * key, int len, uint64_t seed){
+         return hashing_project::host::hash(key, len, seed);
+      }
+
+      uint64_t get_first_bucket(uint64_t hash){
+         return (hash >> 7) % n_groups;
+      }
+
+      uint8_t get_tag(uint64_t hash){
+         return (uint8_t) (hash & 0x7F);
+      }
+
+      //linear over groups - triangular probing revisits groups when n_groups is not a power of two,
+      //which would double count copies on a walk this long.
+      uint64_t get_probe_group(uint64_t group_0, uint64_t i){
+         return (group_0 + i) % n_groups;
+      }
+
+
+      uint64_t get_lock_bucket(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+      void stall_lock(uint64_t bucket){
+         locks.lock(bucket);
+      }
+
+      void unlock(uint64_t bucket){
+         locks.unlock(bucket);
+      }
+
+
+      bool insert_dup_internal(const Key & key, const Val & val, uint64_t group_0, uint8_t tag){
+
+         for (uint64_t i = 0; i < n_groups; i++){
+
+            uint64_t group_index = get_probe_group(group_0, i);
+
+            group_type * group = &groups[group_index];
+
+            uint32_t open_slots = group->match_empty() | group->match_deleted();
+
+            while (open_slots){
+
+               int slot = __builtin_ctz(open_slots);
+
+               uint8_t current = group->load_ctrl(slot);
+
+               if ((current == swiss_ctrl_empty || current == swiss_ctrl_deleted) && group->claim(slot, current)){
+
+                  packed_pair_type * slot_ptr = &slots[group_index*group_size+slot];
+
+                  hashing_project::host::ht_store_rel(&slot_ptr->val, val);
+                  hashing_project::host::ht_store_rel(&slot_ptr->key, key);
+
+                  group->store_ctrl(slot, tag);
+
+                  return true;
+
+               }
+
+               open_slots &= open_slots-1;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+
+      //visit every live copy of key - func(slot_ptr, val, index) with index counting from 0.
+      template <typename func_type>
+      uint64_t walk_matches(const Key & key, uint64_t group_0, uint8_t tag, func_type && func){
+
+         uint64_t n_matches = 0;
+
+         for (uint64_t i = 0; i < n_groups; i++){
+
+            uint64_t group_index = get_probe_group(group_0, i);
+
+            group_type * group = &groups[group_index];
+
+            uint32_t match = group->match_byte(tag);
+
+            while (match){
+
+               int slot = __builtin_ctz(match);
+
+               packed_pair_type * slot_ptr = &slots[group_index*group_size+slot];
+
+               if (hashing_project::host::ht_load_acq(&slot_ptr->key) == key){
+
+                  Val loaded_val = hashing_project::host::ht_load_acq(&slot_ptr->val);
+
+                  //re-validate - slot may have been removed and reclaimed while reading.
+                  if (group->load_ctrl(slot) == tag && hashing_project::host::ht_load_acq(&slot_ptr->key) == key){
+
+                     func(slot_ptr, loaded_val, n_matches);
+                     n_matches++;
+
+                  }
+
+               }
+
+               match &= match-1;
+
+            }
+
+            //inserts never skip a group with an empty slot - nothing further down.
+            if (group->match_empty()) return n_matches;
+
+         }
+
+         return n_matches;
+
+      }
+
+
+      //add one more copy of key. Only fails if the whole probe sequence is full.
+      bool insert_dup(const Key & key, const Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+
+         stall_lock(group_0);
+
+         bool return_val = insert_dup_internal(key, val, group_0, get_tag(key_hash));
+
+         unlock(group_0);
+
+         return return_val;
+
+      }
+
+      bool insert_dup_no_lock(const Key & key, const Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return insert_dup_internal(key, val, get_first_bucket(key_hash), get_tag(key_hash));
+
+      }
+
+
+      [[nodiscard]] uint64_t count(const Key & key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return walk_matches(key, get_first_bucket(key_hash), get_tag(key_hash), [](packed_pair_type *, const Val &, uint64_t){});
+
+      }
+
+
+      //write up to capacity values stored under key into out.
+      //returns the total number of copies, which may exceed capacity.
+      uint64_t retrieve_all(const Key & key, Val * out, uint64_t capacity){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return walk_matches(key, get_first_bucket(key_hash), get_tag(key_hash), [&](packed_pair_type *, const Val & loaded_val, uint64_t index){
+
+            if (index < capacity) out[index] = loaded_val;
+
+         });
+
+      }
+
+
+      uint64_t remove_all_no_lock(const Key & key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return walk_matches(key, get_first_bucket(key_hash), get_tag(key_hash), [&](packed_pair_type * slot_ptr, const Val &, uint64_t){
+
+            uint64_t slot_index = slot_ptr - slots;
+
+            groups[slot_index/group_size].store_ctrl(slot_index % group_size, swiss_ctrl_deleted);
+
+            hashing_project::host::ht_store_rel(&slot_ptr->key, tombstoneKey);
+
+         });
+
+      }
+
+      //tombstone every copy of key, returns the number removed.
+      uint64_t remove_all(const Key & key){
+
+         uint64_t group_0 = get_lock_bucket(key);
+
+         stall_lock(group_0);
+
+         uint64_t n_removed = remove_all_no_lock(key);
+
+         unlock(group_0);
+
+         return n_removed;
+
+      }
+
+
+      //bulk phase 1 - offsets has n_keys+1 entries.
+      //on return offsets[i] is the exclusive prefix sum of the counts, offsets[n_keys] the total.
+      uint64_t retrieve_count(const Key * keys, uint64_t n_keys, uint64_t * offsets, uint64_t n_threads){
+
+         hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+            offsets[i] = count(keys[i]);
+         });
+
+         uint64_t total = 0;
+
+         for (uint64_t i = 0; i < n_keys; i++){
+
+            uint64_t n_matches = offsets[i];
+            offsets[i] = total;
+            total += n_matches;
+
+         }
+
+         offsets[n_keys] = total;
+
+         return total;
+
+      }
+
+      //bulk phase 2 - values must hold offsets[n_keys]-offsets[0] entries.
+      //writes are relative to offsets[0], so keys+i / offsets+i retrieves a batch.
+      void retrieve_write(const Key * keys, uint64_t n_keys, const uint64_t * offsets, Val * values, uint64_t n_threads){
+
+         hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+            retrieve_all(keys[i], values+(offsets[i]-offsets[0]), offsets[i+1]-offsets[i]);
+         });
+
+      }
+
+      uint64_t retrieve(const Key * keys, uint64_t n_keys, uint64_t * offsets, std::vector<Val> & values, uint64_t n_threads){
+
+         uint64_t total = retrieve_count(keys, n_keys, offsets, n_threads);
+
+         values.resize(total);
+
+         retrieve_write(keys, n_keys, offsets, values.data(), n_threads);
+
+         return total;
+
+      }
+
+
+      //checkpoint (helpers/checkpoint.cuh): control groups then slots, as in host_swiss_table.
+      //Call on a quiescent table.
+      bool save_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         return writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), 1, group_size, seed, n_groups, 0))
+            && writer.write_region(groups, sizeof(group_type)*n_groups)
+            && writer.write_region(slots, sizeof(packed_pair_type)*n_groups*group_size)
+            && writer.close();
+
+      }
+
+      //zero copy restore of a table written by save_checkpoint(): the arrays point into a private mapping of the
+      //file, so pages fault in on first touch and writes never reach the file. Locks start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), 1, group_size)) return nullptr;
+
+         my_type * host_version = new my_type;
+
+         host_version->n_groups = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->groups = (group_type *) reader.next_region(sizeof(group_type)*host_version->n_groups);
+         host_version->slots = (packed_pair_type *) reader.next_region(sizeof(packed_pair_type)*host_version->n_groups*group_size);
+
+         if (host_version->groups == nullptr || host_version->slots == nullptr){
+            delete host_version;
+            return nullptr;
+         }
+
+         uint64_t n_locks = host_version->n_groups < HOST_SWISS_LOCK_STRIPES ? host_version->n_groups : HOST_SWISS_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         host_version->mapping = reader.release();
+
+         return host_version;
+
+      }
+
+      static std::string get_name(){
+         return "host_swiss_multimap";
+      }
+
+      uint64_t get_num_locks(){
+         return n_groups;
+      }
+
+      uint64_t get_bucket_fill(uint64_t group){
+         return __builtin_popcount(groups[group].match_full());
+      }
+
+      uint64_t get_fill(){
+
+         uint64_t n_items = 0;
+
+         for (uint64_t i = 0; i < n_groups; i++){
+            n_items += get_bucket_fill(i);
+         }
+
+         return n_items;
+
+      }
+
+      float load(){
+         return 1.0*get_fill()/(n_groups*group_size);
+      }
+
+      void print_fill(){
+
+         uint64_t n_items = get_fill();
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_groups*group_size, 100.0*n_items/(n_groups*group_size));
+
+      }
+
+      void print_space_usage(){
+
+         uint64_t capacity = n_groups*(sizeof(group_type)+group_size*sizeof(packed_pair_type)) + locks.get_space_usage();
+
+         printf("host_swiss_multimap using %lu bytes\n", capacity);
+
+      }
+
+   };
+
+
+//tile_size is unused on the host - kept so the alias drops into the same test templates as the device tables.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using host_swiss_multimap_generic = typename hashing_project::tables::host_swiss_multimap<Key,
+                                    generate_host_swiss_sentinel<Key>(),
+                                    generate_host_swiss_tombstone<Key>(0),
+                                    Val,
+                                    generate_host_swiss_sentinel<Val>(),
+                                    generate_host_swiss_tombstone<Val>(0),
+                                    bucket_size>;
+
+
+}  // namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_SWISS_MULTIMAP
@@ -0,0 +1,783 @@
+#ifndef HOST_SWISS_TABLE
+#define HOST_SWISS_TABLE
+
+//Host-native swiss-table modeled on the metadata tables.
+//
+//one control byte per slot (7-bit H2 fingerprint, or empty/deleted/busy), slots grouped
+//into 16-byte (SSE2) or 32-byte (AVX2) groups that are matched with a single
+//pcmpeqb+movemask, and triangular probing across groups.
+//
+//Concurrency mirrors the device metadata tables:
+// - writers take the lock stripe of the key's primary group, so all writers of a key serialize.
+// - empty/tombstone slots are claimed with a CAS on the control byte (like match_empty/match_tombstone),
+//   as writers from other primary groups may be racing on the same slot.
+// - readers never lock: they match on control bytes, read the pair and re-validate the control byte.
+//
+//API matches double_metadata_table minus the tile argument so the same drivers can run either backend.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <new>
+#include <string>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+#include <hashing_project/helpers/host_locks.cuh>
+#include <hashing_project/helpers/checkpoint.cuh>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+#define HOST_SWISS_MAX_PROBES 64
+
+//upper bound on lock stripes - 64 bytes each.
+#define HOST_SWISS_LOCK_STRIPES 16384
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   //control byte encoding - full slots hold the 7-bit H2, so the top bit marks a special state.
+   static const uint8_t swiss_ctrl_empty = 0x80;
+   static const uint8_t swiss_ctrl_deleted = 0xFE;
+   //slot claimed by a writer but pair not yet published.
+   static const uint8_t swiss_ctrl_busy = 0xFF;
+
+
+   template <uint group_size>
+   struct swiss_group {
+
+      static_assert(group_size == 16 || group_size == 32, "swiss groups must be 16 (SSE2) or 32 (AVX2) slots");
+
+      alignas(group_size) uint8_t ctrl[group_size];
+
+      void init(){
+
+         for (uint i = 0; i < group_size; i++){
+            ctrl[i] = swiss_ctrl_empty;
+         }
+
+      }
+
+      //bitmask of every byte in the group equal to tag.
+      inline uint32_t match_byte(uint8_t tag) const {
+
+         std::atomic_thread_fence(std::memory_order_acquire);
+
+         #if defined(__AVX2__)
+
+         if constexpr (group_size == 32){
+
+            __m256i loaded = _mm256_load_si256((const __m256i *) ctrl);
+            return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(loaded, _mm256_set1_epi8((char) tag)));
+
+         }
+
+         #endif
+
+         #if defined(__SSE2__)
+
+         uint32_t match = 0;
+
+         for (uint i = 0; i < group_size; i+=16){
+
+            __m128i loaded = _mm_load_si128((const __m128i *) &ctrl[i]);
+            match |= ((uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(loaded, _mm_set1_epi8((char) tag)))) << i;
+
+         }
+
+         return match;
+
+         #else
+
+         uint32_t match = 0;
+
+         for (uint i = 0; i < group_size; i++){
+            match |= ((uint32_t) (ctrl[i] == tag)) << i;
+         }
+
+         return match;
+
+         #endif
+
+      }
+
+      inline uint32_t match_empty() const {
+         return match_byte(swiss_ctrl_empty);
+      }
+
+      inline uint32_t match_deleted() const {
+         return match_byte(swiss_ctrl_deleted);
+      }
+
+      //slots that hold a live key - H2 values never set the top bit.
+      inline uint32_t match_full() const {
+
+         std::atomic_thread_fence(std::memory_order_acquire);
+
+         #if defined(__SSE2__)
+
+         uint32_t special = 0;
+
+         for (uint i = 0; i < group_size; i+=16){
+            __m128i loaded = _mm_load_si128((const __m128i *) &ctrl[i]);
+            special |= ((uint32_t) _mm_movemask_epi8(loaded)) << i;
+         }
+
+         #else
+
+         uint32_t special = 0;
+
+         for (uint i = 0; i < group_size; i++){
+            special |= ((uint32_t) (ctrl[i] >> 7)) << i;
+         }
+
+         #endif
+
+         if constexpr (group_size == 32){
+            return ~special;
+         } else {
+            return (~special) & 0xFFFFu;
+         }
+
+      }
+
+      inline uint8_t load_ctrl(int index) const {
+         return hashing_project::host::ht_load_acq(&ctrl[index]);
+      }
+
+      inline void store_ctrl(int index, uint8_t new_ctrl){
+         hashing_project::host::ht_store_rel(&ctrl[index], new_ctrl);
+      }
+
+      inline bool claim(int index, uint8_t expected){
+         return hashing_project::host::ht_cas(&ctrl[index], expected, swiss_ctrl_busy);
+      }
+
+   };
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint group_size>
+   struct host_swiss_table {
+
+
+      using my_type = host_swiss_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, group_size>;
+
+      using group_type = swiss_group<group_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+
+      group_type * groups;
+      packed_pair_type * slots;
+      hashing_project::host::host_striped_locks locks;
+
+      //set when restored by load_checkpoint() - the arrays live in the file mapping.
+      hashing_project::helpers::checkpoint_mapping mapping;
+
+      uint64_t n_groups;
+      uint64_t seed;
+
+
+      static my_type * generate_on_host(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = new my_type;
+
+         uint64_t ext_n_groups = (cache_capacity-1)/group_size+1;
+
+         host_version->n_groups = ext_n_groups;
+         host_version->seed = ext_seed;
+
+         host_version->groups = (group_type *) hashing_project::host::host_alloc(sizeof(group_type)*ext_n_groups);
+
+         host_version->slots = (packed_pair_type *) hashing_project::host::host_alloc(sizeof(packed_pair_type)*ext_n_groups*group_size);
+
+         if (host_version->groups == nullptr || host_version->slots == nullptr) throw std::bad_alloc();
+
+         uint64_t n_locks = ext_n_groups < HOST_SWISS_LOCK_STRIPES ? ext_n_groups : HOST_SWISS_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         packed_pair_type sentinel_pair{defaultKey, defaultVal};
+
+         for (uint64_t i = 0; i < ext_n_groups; i++){
+
+            host_version->groups[i].init();
+
+            for (uint j = 0; j < group_size; j++){
+               host_version->slots[i*group_size+j] = sentinel_pair;
+            }
+
+         }
+
+         std::atomic_thread_fence(std::memory_order_seq_cst);
+
+         return host_version;
+
+      }
+
+      static void free_on_host(my_type * host_version){
+
+         if (host_version->mapping.is_mapped()){
+            host_version->mapping.unmap();
+         } else {
+            hashing_project::host::host_free(host_version->groups);
+            hashing_project::host::host_free(host_version->slots);
+         }
+
+         host_version->locks.free_locks();
+
+         delete host_version;
+
+      }
+
+
+      uint64_t hash(const void * key, int len, uint64_t seed){
+         return hashing_project::host::hash(key, len, seed);
+      }
+
+      //H1 selects the group, H2 is the 7-bit fingerprint stored in the control byte.
+      uint64_t get_first_bucket(uint64_t hash){
+         return (hash >> 7) % n_groups;
+      }
+
+      uint8_t get_tag(uint64_t hash){
+         return (uint8_t) (hash & 0x7F);
+      }
+
+      //triangular probing: group_i = group_0 + i*(i+1)/2
+      uint64_t get_probe_group(uint64_t group_0, uint64_t i){
+         return (group_0 + (i*(i+1))/2) % n_groups;
+      }
+
+
+      uint64_t get_lock_bucket(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+      void stall_lock(uint64_t bucket){
+         locks.lock(bucket);
+      }
+
+      void unlock(uint64_t bucket){
+         locks.unlock(bucket);
+      }
+
+      void lock_key(Key key){
+         stall_lock(get_lock_bucket(key));
+      }
+
+      void unlock_key(Key key){
+         unlock(get_lock_bucket(key));
+      }
+
+
+      //locate the live slot holding key. Readers validate the control byte after reading the pair,
+      //so a concurrent delete + reuse of the slot is not observed as a match.
+      packed_pair_type * query_packed_reference(const Key & key, uint64_t group_0, uint8_t tag){
+
+         for (uint64_t i = 0; i < HOST_SWISS_MAX_PROBES; i++){
+
+            uint64_t group_index = get_probe_group(group_0, i);
+
+            group_type * group = &groups[group_index];
+
+            uint32_t match = group->match_byte(tag);
+
+            while (match){
+
+               int slot = __builtin_ctz(match);
+
+               packed_pair_type * slot_ptr = &slots[group_index*group_size+slot];
+
+               if (hashing_project::host::ht_load_acq(&slot_ptr->key) == key && group->load_ctrl(slot) == tag){
+                  return slot_ptr;
+               }
+
+               match &= match-1;
+
+            }
+
+            //an empty slot ends the probe sequence.
+            if (group->match_empty()) return nullptr;
+
+         }
+
+         return nullptr;
+
+      }
+
+
+      bool query_internal(const Key & key, Val & val, uint64_t group_0, uint8_t tag){
+
+         for (uint64_t i = 0; i < HOST_SWISS_MAX_PROBES; i++){
+
+            uint64_t group_index = get_probe_group(group_0, i);
+
+            group_type * group = &groups[group_index];
+
+            uint32_t match = group->match_byte(tag);
+
+            while (match){
+
+               int slot = __builtin_ctz(match);
+
+               packed_pair_type * slot_ptr = &slots[group_index*group_size+slot];
+
+               if (hashing_project::host::ht_load_acq(&slot_ptr->key) == key){
+
+                  Val loaded_val = hashing_project::host::ht_load_acq(&slot_ptr->val);
+
+                  //re-validate - slot may have been deleted and reclaimed while reading.
+                  if (group->load_ctrl(slot) == tag && hashing_project::host::ht_load_acq(&slot_ptr->key) == key){
+                     val = loaded_val;
+                     return true;
+                  }
+
+               }
+
+               match &= match-1;
+
+            }
+
+            if (group->match_empty()) return false;
+
+         }
+
+         return false;
+
+      }
+
+
+      //claim the first empty or deleted slot along the probe sequence and publish the pair.
+      bool upsert_replace_internal(const Key & key, const Val & val, uint64_t group_0, uint8_t tag){
+
+         for (uint64_t i = 0; i < HOST_SWISS_MAX_PROBES; i++){
+
+            uint64_t group_index = get_probe_group(group_0, i);
+
+            group_type * group = &groups[group_index];
+
+            uint32_t open_slots = group->match_empty() | group->match_deleted();
+
+            while (open_slots){
+
+               int slot = __builtin_ctz(open_slots);
+
+               uint8_t current = group->load_ctrl(slot);
+
+               if ((current == swiss_ctrl_empty || current == swiss_ctrl_deleted) && group->claim(slot, current)){
+
+                  packed_pair_type * slot_ptr = &slots[group_index*group_size+slot];
+
+                  hashing_project::host::ht_store_rel(&slot_ptr->val, val);
+                  hashing_project::host::ht_store_rel(&slot_ptr->key, key);
+
+                  group->store_ctrl(slot, tag);
+
+                  return true;
+
+               }
+
+               open_slots &= open_slots-1;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+
+      bool upsert_replace(const Key & key, const Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+         uint8_t tag = get_tag(key_hash);
+
+         stall_lock(group_0);
+
+         packed_pair_type * existing_loc = query_packed_reference(key, group_0, tag);
+
+         if (existing_loc != nullptr){
+
+            hashing_project::host::ht_store_rel(&existing_loc->val, val);
+
+            unlock(group_0);
+
+            return true;
+
+         }
+
+         bool return_val = upsert_replace_internal(key, val, group_0, tag);
+
+         unlock(group_0);
+
+         return return_val;
+
+      }
+
+      bool upsert_no_lock(const Key & key, const Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+         uint8_t tag = get_tag(key_hash);
+
+         packed_pair_type * existing_loc = query_packed_reference(key, group_0, tag);
+
+         if (existing_loc != nullptr){
+
+            hashing_project::host::ht_store_rel(&existing_loc->val, val);
+
+            return true;
+
+         }
+
+         return upsert_replace_internal(key, val, group_0, tag);
+
+      }
+
+      bool upsert_replace_no_lock(const Key & key, const Val & val){
+         return upsert_no_lock(key, val);
+      }
+
+
+      template <typename replace_func_type>
+      bool upsert_function(const Key & key, const Val & val, replace_func_type replace_func){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+         uint8_t tag = get_tag(key_hash);
+
+         stall_lock(group_0);
+
+         packed_pair_type * existing_loc = query_packed_reference(key, group_0, tag);
+
+         if (existing_loc != nullptr){
+
+            replace_func(existing_loc, key, val);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            unlock(group_0);
+
+            return true;
+
+         }
+
+         bool return_val = upsert_replace_internal(key, val, group_0, tag);
+
+         unlock(group_0);
+
+         return return_val;
+
+      }
+
+      template <typename replace_func_type>
+      bool upsert_function_no_lock(const Key & key, const Val & val, replace_func_type replace_func){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+         uint8_t tag = get_tag(key_hash);
+
+         packed_pair_type * existing_loc = query_packed_reference(key, group_0, tag);
+
+         if (existing_loc != nullptr){
+
+            replace_func(existing_loc, key, val);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            return true;
+
+         }
+
+         return upsert_replace_internal(key, val, group_0, tag);
+
+      }
+
+
+      //with STABLE_HT_LOCKLESS_QUERY the probe is re-run if a writer held group_0's stripe meanwhile.
+      [[nodiscard]] bool find_with_reference(Key key, Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+         uint8_t tag = get_tag(key_hash);
+
+         return locks.optimistic_query(group_0, [&](){
+            return query_internal(key, val, group_0, tag);
+         });
+
+      }
+
+      //plain unvalidated probe, for callers that already hold the key's stripe - find_with_reference
+      //would wait on the caller's own odd version.
+      [[nodiscard]] bool find_with_reference_no_lock(Key key, Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return query_internal(key, val, get_first_bucket(key_hash), get_tag(key_hash));
+
+      }
+
+      [[nodiscard]] packed_pair_type * find_pair(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return query_packed_reference(key, get_first_bucket(key_hash), get_tag(key_hash));
+
+      }
+
+      [[nodiscard]] packed_pair_type * find_pair_no_lock(Key key){
+
+         return find_pair(key);
+
+      }
+
+
+      bool remove_internal(const Key & key, uint64_t group_0, uint8_t tag){
+
+         packed_pair_type * existing_loc = query_packed_reference(key, group_0, tag);
+
+         if (existing_loc == nullptr) return false;
+
+         uint64_t slot_index = existing_loc - slots;
+
+         //mark deleted before wiping the key so readers that already matched the tag fail re-validation.
+         groups[slot_index/group_size].store_ctrl(slot_index % group_size, swiss_ctrl_deleted);
+
+         hashing_project::host::ht_store_rel(&existing_loc->key, tombstoneKey);
+
+         return true;
+
+      }
+
+      bool remove(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t group_0 = get_first_bucket(key_hash);
+
+         stall_lock(group_0);
+
+         bool result = remove_internal(key, group_0, get_tag(key_hash));
+
+         unlock(group_0);
+
+         return result;
+
+      }
+
+      bool remove_no_lock(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return remove_internal(key, get_first_bucket(key_hash), get_tag(key_hash));
+
+      }
+
+
+      static packed_pair_type pack_together(Key key, Val val){
+         return packed_pair_type{key, val};
+      }
+
+      static std::string get_name(){
+         return "host_swiss_table";
+      }
+
+      uint64_t get_num_locks(){
+         return n_groups;
+      }
+
+      uint64_t get_bucket_fill(uint64_t group){
+         return __builtin_popcount(groups[group].match_full());
+      }
+
+      //bulk build hooks for helpers/host_bulk_build.cuh. Each key is placed in its first group.
+      uint64_t get_n_bulk_buckets(){
+         return n_groups;
+      }
+
+      uint64_t get_bulk_bucket(const Key & key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+      static const uint64_t bulk_bucket_size = group_size;
+
+      //plain stores of n <= group_size pairs and their control bytes into an empty group - no lock,
+      //only valid while building.
+      void bulk_fill_bucket(uint64_t group, const Key * keys, const Val * vals, uint64_t n){
+
+         for (uint64_t i = 0; i < n; i++){
+
+            uint64_t key_hash = hash(&keys[i], sizeof(Key), seed);
+
+            slots[group*group_size+i] = packed_pair_type{keys[i], vals[i]};
+
+            groups[group].ctrl[i] = get_tag(key_hash);
+
+         }
+
+      }
+
+      //checkpoint (helpers/checkpoint.cuh): groups, slots. Call on a quiescent table.
+      bool save_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         return writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), 1, group_size, seed, n_groups, 0))
+            && writer.write_region(groups, sizeof(group_type)*n_groups)
+            && writer.write_region(slots, sizeof(packed_pair_type)*n_groups*group_size)
+            && writer.close();
+
+      }
+
+      //zero copy restore of a table written by save_checkpoint(): the arrays point into a private mapping of the
+      //file, so pages fault in on first touch and writes never reach the file. Locks start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), 1, group_size)) return nullptr;
+
+         my_type * host_version = new my_type;
+
+         host_version->n_groups = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->groups = (group_type *) reader.next_region(sizeof(group_type)*host_version->n_groups);
+         host_version->slots = (packed_pair_type *) reader.next_region(sizeof(packed_pair_type)*host_version->n_groups*group_size);
+
+         if (host_version->groups == nullptr || host_version->slots == nullptr){
+            delete host_version;
+            return nullptr;
+         }
+
+         uint64_t n_locks = host_version->n_groups < HOST_SWISS_LOCK_STRIPES ? host_version->n_groups : HOST_SWISS_LOCK_STRIPES;
+
+         host_version->locks.init(n_locks);
+
+         host_version->mapping = reader.release();
+
+         return host_version;
+
+      }
+
+      uint64_t get_n_sweep_buckets(){
+         return n_groups;
+      }
+
+      //sweep hook for helpers/host_table_sweep.cuh: func(key, val) on every live slot of the group.
+      //Control bytes are matched first, so an empty group never touches the slot array.
+      template <typename func_type>
+      void for_each_in_bucket(uint64_t group, func_type func){
+
+         group_type * group_ptr = &groups[group];
+
+         uint32_t full = group_ptr->match_full();
+
+         while (full){
+
+            int slot = __builtin_ctz(full);
+
+            full &= full-1;
+
+            uint8_t tag = group_ptr->load_ctrl(slot);
+
+            packed_pair_type * slot_ptr = &slots[group*group_size+slot];
+
+            Key loaded_key = hashing_project::host::ht_load_acq(&slot_ptr->key);
+            Val loaded_val = hashing_project::host::ht_load_acq(&slot_ptr->val);
+
+            //same re-validation as the readers.
+            if ((tag & swiss_ctrl_empty) || group_ptr->load_ctrl(slot) != tag) continue;
+
+            if (hashing_project::host::ht_load_acq(&slot_ptr->key) != loaded_key) continue;
+
+            func(loaded_key, loaded_val);
+
+         }
+
+      }
+
+      uint64_t get_fill(){
+
+         uint64_t n_items = 0;
+
+         for (uint64_t i = 0; i < n_groups; i++){
+            n_items += get_bucket_fill(i);
+         }
+
+         return n_items;
+
+      }
+
+      float load(){
+         return 1.0*get_fill()/(n_groups*group_size);
+      }
+
+      void print_fill(){
+
+         uint64_t n_items = get_fill();
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_groups*group_size, 100.0*n_items/(n_groups*group_size));
+
+      }
+
+      void print_space_usage(){
+
+         uint64_t capacity = n_groups*(sizeof(group_type)+group_size*sizeof(packed_pair_type)) + locks.get_space_usage();
+
+         printf("host_swiss_table using %lu bytes\n", capacity);
+
+      }
+
+   };
+
+
+template <typename T>
+constexpr T generate_host_swiss_tombstone(uint64_t offset) {
+  return (~((T) 0)) - offset;
+};
+
+template <typename T>
+constexpr T generate_host_swiss_sentinel() {
+  return ((T) 0);
+};
+
+
+//tile_size is unused on the host - kept so the alias drops into the same test templates as the device tables.
+//bucket_size is the group width: 16 for SSE2 matching, 32 for AVX2.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using host_swiss_generic = typename hashing_project::tables::host_swiss_table<Key,
+                                    generate_host_swiss_sentinel<Key>(),
+                                    generate_host_swiss_tombstone<Key>(0),
+                                    Val,
+                                    generate_host_swiss_sentinel<Val>(),
+                                    generate_host_swiss_tombstone<Val>(0),
+                                    bucket_size>;
+
+
+} //namespace tables
+
+}  // namespace hashing_project
+
+#endif  // HOST_SWISS_TABLE
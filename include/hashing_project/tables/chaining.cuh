@@ -21,6 +21,13 @@
 #include <cooperative_groups/scan.h>
 #include <hashing_project/helpers/probe_counts.cuh>
 #include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
+
+#include <thrust/execution_policy.h>
+#include <thrust/scan.h>
 
 
 #define COUNT_CHAINING_NEXT_LOAD 0
@@ -122,6 +129,45 @@ namespace tables {
    }
 
 
+   //checkpoint kernels - one thread per head slot.
+   template <typename ht_type>
+   __global__ void chain_length_kernel(ht_type * table, uint64_t nblocks, uint64_t * lengths){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      if (tid >= nblocks) return;
+
+      lengths[tid] = table->count_chain_length(tid);
+
+   }
+
+
+   template <typename ht_type, typename pair_type>
+   __global__ void pack_chains_kernel(ht_type * table, uint64_t nblocks, uint64_t * offsets, pair_type * packed_slots){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      if (tid >= nblocks) return;
+
+      table->pack_chain(tid, packed_slots + offsets[tid]*ht_type::slots_per_block);
+
+   }
+
+
+   template <typename ht_type, typename pair_type>
+   __global__ void unpack_chains_kernel(ht_type * table, uint64_t nblocks, uint64_t * offsets, pair_type * packed_slots, uint64_t * n_failed){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      if (tid >= nblocks) return;
+
+      if (!table->unpack_chain(tid, offsets[tid+1]-offsets[tid], packed_slots + offsets[tid]*ht_type::slots_per_block)){
+         atomicAdd((unsigned long long int *)n_failed, 1ULL);
+      }
+
+   }
+
+
 
    template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
    struct coop_chaining_block {
@@ -730,10 +776,10 @@ namespace tables {
 
    };
 
-   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
    struct chaining_table{
 
-      using my_type = chaining_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+      using my_type = chaining_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
 
       uint64_t nslots;
 
@@ -747,7 +793,10 @@ namespace tables {
 
       block_type ** pointer_list;
 
-      uint64_t * locks;
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
 
       using packed_pair_type = ht_pair<Key, Val>;
 
@@ -764,9 +813,10 @@ namespace tables {
          host_version->nblocks = (ext_nslots-1)/(bucket_size) +1;
 
 
-         host_version->locks = gallatin::utils::get_device_version<uint64_t>(host_version->nblocks);
+         host_version->locks = lock_layout::generate_locks(host_version->nblocks);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->nblocks);
 
-         cudaMemset(host_version->locks, 0, sizeof(uint64_t)*(host_version->nblocks));
 
 
          //host_version->defaultKey = ext_defaultKey;
@@ -796,9 +846,10 @@ namespace tables {
 
          //host_version->defaultKey = ext_defaultKey;
 
-         host_version->locks = gallatin::utils::get_device_version<uint64_t>( (host_version->nblocks-1)/64+1);
+         host_version->locks = lock_layout::generate_locks(host_version->nblocks);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->nblocks);
 
-         cudaMemset(host_version->locks, 0, sizeof(uint64_t)*((host_version->nblocks-1)/64+1));
 
 
          cudaMalloc((void **)&ext_pointer_list, host_version->nblocks*sizeof(block_type *));
@@ -838,7 +889,8 @@ namespace tables {
 
          cudaFree(host_version->pointer_list);
 
-         cudaFree(host_version->locks);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
 
          cudaFreeHost(host_version);
 
@@ -860,16 +912,58 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
+            //printf("Looping in key lock %lu\n", bucket);
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+      }
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
 
-         do {
             ADD_PROBE
-            //printf("Looping in key lock %lu\n", bucket);
+            ADD_LOCK_ACQUIRE(bucket)
+
          }
-         while (atomicOr((unsigned long long int *)&locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
 
       }
 
@@ -969,6 +1063,239 @@ namespace tables {
 
       }
 
+      static const uint64_t slots_per_block = bucket_size-1;
+
+      //copies the slots of chain tid, head block first, to packed_slots.
+      __device__ void pack_chain(uint64_t tid, packed_pair_type * packed_slots){
+
+         block_type * main_block = pointer_list[tid];
+
+         while (main_block != nullptr){
+
+            for (uint64_t i = 0; i < slots_per_block; i++){
+               packed_slots[i] = main_block->slots[i];
+            }
+
+            packed_slots += slots_per_block;
+
+            main_block = main_block->next;
+
+         }
+
+      }
+
+      //rebuilds chain tid from n_chain packed blocks. Built back to front so every block is
+      //complete before it is linked. On a failed malloc the chain keeps the blocks built so far.
+      __device__ bool unpack_chain(uint64_t tid, uint64_t n_chain, packed_pair_type * packed_slots){
+
+         block_type * next_block = nullptr;
+
+         for (uint64_t j = n_chain; j > 0; j--){
+
+            block_type * new_block = (block_type *) gallatin::allocators::global_malloc(sizeof(block_type));
+
+            if (new_block == nullptr){
+               pointer_list[tid] = next_block;
+               return false;
+            }
+
+            for (uint64_t i = 0; i < slots_per_block; i++){
+               new_block->slots[i] = packed_slots[(j-1)*slots_per_block+i];
+            }
+
+            new_block->next = next_block;
+
+            next_block = new_block;
+
+         }
+
+         pointer_list[tid] = next_block;
+
+         return true;
+
+      }
+
+      //checkpoint (helpers/checkpoint.cuh): chain length per head slot, then the slots of every
+      //chain block packed head first. n_buckets_alt in the header is the total block count.
+      //Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t nblocks = host_version->nblocks;
+
+         uint64_t * lengths;
+
+         cudaMalloc((void **)&lengths, sizeof(uint64_t)*(nblocks+1));
+
+         cudaMemset(lengths+nblocks, 0, sizeof(uint64_t));
+
+         chain_length_kernel<my_type><<<(nblocks-1)/256+1,256>>>(this, nblocks, lengths);
+
+         uint64_t * offsets;
+
+         cudaMalloc((void **)&offsets, sizeof(uint64_t)*(nblocks+1));
+
+         thrust::exclusive_scan(thrust::device, lengths, lengths+nblocks+1, offsets);
+
+         uint64_t n_chained;
+
+         cudaMemcpy(&n_chained, offsets+nblocks, sizeof(uint64_t), cudaMemcpyDeviceToHost);
+
+         packed_pair_type * packed_slots;
+
+         cudaMalloc((void **)&packed_slots, sizeof(packed_pair_type)*slots_per_block*n_chained);
+
+         pack_chains_kernel<my_type, packed_pair_type><<<(nblocks-1)/256+1,256>>>(this, nblocks, offsets, packed_slots);
+
+         cudaDeviceSynchronize();
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, nblocks, n_chained))
+            && hashing_project::helpers::write_device_region(writer, lengths, sizeof(uint64_t)*nblocks)
+            && hashing_project::helpers::write_device_region(writer, packed_slots, sizeof(packed_pair_type)*slots_per_block*n_chained)
+            && writer.close();
+
+         cudaFree(packed_slots);
+         cudaFree(offsets);
+         cudaFree(lengths);
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(): the lengths and packed slots are copied in bulk, then
+      //one thread per head slot reallocates its chain. Needs the gallatin global allocator
+      //initialized, same as generate_on_device. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated, for a different table type or the allocator runs out.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         uint64_t nblocks = reader.header.n_buckets_primary;
+
+         uint64_t n_chained = reader.header.n_buckets_alt;
+
+         uint64_t * offsets;
+
+         cudaMalloc((void **)&offsets, sizeof(uint64_t)*(nblocks+1));
+
+         cudaMemset(offsets+nblocks, 0, sizeof(uint64_t));
+
+         packed_pair_type * packed_slots;
+
+         cudaMalloc((void **)&packed_slots, sizeof(packed_pair_type)*slots_per_block*n_chained);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, offsets, sizeof(uint64_t)*nblocks)
+            && hashing_project::helpers::read_device_region(reader, packed_slots, sizeof(packed_pair_type)*slots_per_block*n_chained);
+
+         uint64_t n_scanned = 0;
+
+         if (loaded){
+
+            thrust::exclusive_scan(thrust::device, offsets, offsets+nblocks+1, offsets);
+
+            cudaMemcpy(&n_scanned, offsets+nblocks, sizeof(uint64_t), cudaMemcpyDeviceToHost);
+
+            //lengths that don't sum to the header count would unpack out of bounds.
+            if (n_scanned != n_chained){
+               fprintf(stderr, "checkpoint load %s: chain lengths do not match the header\n", path.c_str());
+               loaded = false;
+            }
+
+         }
+
+         my_type * device_version = nullptr;
+
+         if (loaded){
+
+            device_version = generate_on_device(nblocks*bucket_size, reader.header.seed);
+
+            uint64_t * n_failed;
+
+            cudaMallocManaged((void **)&n_failed, sizeof(uint64_t));
+
+            n_failed[0] = 0;
+
+            unpack_chains_kernel<my_type, packed_pair_type><<<(nblocks-1)/256+1,256>>>(device_version, nblocks, offsets, packed_slots, n_failed);
+
+            cudaDeviceSynchronize();
+
+            if (n_failed[0] != 0){
+
+               fprintf(stderr, "checkpoint load %s: allocator ran out rebuilding %lu chains\n", path.c_str(), n_failed[0]);
+
+               free_on_device(device_version);
+
+               device_version = nullptr;
+
+            }
+
+            cudaFree(n_failed);
+
+         }
+
+         cudaFree(packed_slots);
+         cudaFree(offsets);
+
+         return device_version;
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         return get_num_locks();
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh: walks the whole chain of head slot bucket.
+      //Keys are loaded first and the pair only for a live slot. Blocks are never unlinked,
+      //so following next without the lock is safe.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         block_type * my_block = (block_type *) hash_table_load<uint64_t>((uint64_t *)&pointer_list[bucket]);
+
+         while (my_block != nullptr){
+
+            for (uint i = my_tile.thread_rank(); i < block_type::n_traversals; i+=my_tile.size()){
+
+               bool live = false;
+
+               packed_pair_type loaded_pair {defaultKey, defaultVal};
+
+               if (i < bucket_size-1){
+
+                  Key loaded_key = hash_table_load(&my_block->slots[i].key);
+
+                  if (loaded_key != defaultKey && loaded_key != tombstoneKey && loaded_key != block_type::holdingKey){
+
+                     loaded_pair = my_block->load_packed_pair(i);
+
+                     //slot may have turned over between the two loads.
+                     live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey && loaded_pair.key != block_type::holdingKey);
+
+                  }
+
+               }
+
+               if (!my_tile.ballot(live)) continue;
+
+               func(live, loaded_pair.key, loaded_pair.val);
+
+            }
+
+            my_block = (block_type *) hash_table_load((uint64_t *)&my_block->next);
+
+         }
+
+      }
+
 
       __device__ void unlock_bucket_one_thread(uint64_t bucket){
 
@@ -978,11 +1305,10 @@ namespace tables {
 
          ADD_PROBE
          
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         atomicAnd((unsigned long long int *)&locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(locks, bucket);
 
       }
 
@@ -1227,7 +1553,8 @@ namespace tables {
 
       }
 
-      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
          uint64_t bucket_0 = gallatin::hashers::MurmurHash64A(&key, sizeof(Key), seed) % nblocks;
 
@@ -1242,9 +1569,12 @@ namespace tables {
 
          if (stored_copy != nullptr){
 
-            //upsert
-            
-            replace_func(stored_copy, key, val);
+            //upsert - once per tile, the pointer is the same on every lane.
+            if (my_tile.thread_rank() == 0){
+               replace_func(stored_copy, key, val);
+            }
+
+            my_tile.sync();
 
             unlock(my_tile, bucket_0);
             return true;
@@ -1262,7 +1592,8 @@ namespace tables {
 
       }
 
-      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
          uint64_t bucket_0 = gallatin::hashers::MurmurHash64A(&key, sizeof(Key), seed) % nblocks;
 
@@ -1277,9 +1608,12 @@ namespace tables {
 
          if (stored_copy != nullptr){
 
-            //upsert
-            
-            replace_func(stored_copy, key, val);
+            //upsert - once per tile, the pointer is the same on every lane.
+            if (my_tile.thread_rank() == 0){
+               replace_func(stored_copy, key, val);
+            }
+
+            my_tile.sync();
 
             //unlock(my_tile, bucket_0);
             return true;
@@ -1428,6 +1762,15 @@ namespace tables {
       //added nodiscard - lookups should always have the return value checked.
       [[nodiscard]] __device__ bool find_with_reference(cg::thread_block_tile<partition_size> my_tile, Key queryKey, Val & returnVal){
 
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, queryKey), [&](){
+            return find_with_reference_no_lock(my_tile, queryKey, returnVal);
+         });
+
+         #else
+
          uint64_t my_slot = gallatin::hashers::MurmurHash64A(&queryKey, sizeof(Key), seed) % nblocks;
 
 
@@ -1461,6 +1804,8 @@ namespace tables {
 
          return true;
 
+         #endif
+
       }
 
       [[nodiscard]] __device__ bool find_with_reference_no_lock(cg::thread_block_tile<partition_size> my_tile, Key queryKey, Val & returnVal){
@@ -1607,7 +1952,7 @@ namespace tables {
 
          my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
             
-         uint64_t capacity = host_version->nblocks*sizeof(block_type *) + (host_version->nblocks-1)/8+1; 
+         uint64_t capacity = host_version->nblocks*sizeof(block_type *) + lock_layout::get_space_usage(host_version->nblocks); 
 
 
          uint64_t nblocks = host_version->nblocks;
@@ -1661,6 +2006,19 @@ using chaining_generic = typename hashing_project::tables::chaining_table<Key,
                                     bucket_size>;
 
 
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using chaining_generic_with_locks = typename hashing_project::tables::chaining_table<Key,
+                                    generate_chaining_sentinel<Key>(),
+                                    generate_chaining_tombstone<Key>(0),
+                                    Val,
+                                    generate_chaining_sentinel<Val>(),
+                                    generate_chaining_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
 
 }
 
@@ -10,6 +10,10 @@
 #include <gallatin/allocators/alloc_utils.cuh>
 #include <hashing_project/helpers/const_cuckoo_vector.cuh>
 #include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
 
 #include "assert.h"
 #include "stdio.h"
@@ -30,7 +34,6 @@ namespace cg = cooperative_groups;
 
 #define MAX_CUCKOO_ATTEMPTS 500
 
-#define MEASURE_LOCKS 1
 
 #define DEBUG_PRINTS 0
 
@@ -413,7 +416,8 @@ template <typename HT, uint tile_size>
 
       }
 
-      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint upsert_mapping, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint upsert_mapping, replace_func_type replace_func){
 
 
          //first read size
@@ -822,11 +826,14 @@ template <typename HT, uint tile_size>
 
 
 
-   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
    struct cuckoo_table {
 
 
-      using my_type = cuckoo_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+      using my_type = cuckoo_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
+
+      //eviction paths hold several bucket locks at once, sorted by bucket - two buckets on one stripe would self-deadlock.
+      static_assert(!lock_layout::shares_locks, "cuckoo needs a lock layout with one lock per bucket");
 
 
       using tile_type = cg::thread_block_tile<partition_size>;
@@ -838,7 +845,10 @@ template <typename HT, uint tile_size>
       using vector_type = hashing_project::data_structs::const_cuckoo_vector<hashing_project::data_structs::const_vector_pair<Key>, CUCKOO_MAX_PROBES+1>;
 
       bucket_type * primary_buckets;
-      uint64_t * primary_locks;
+      typename lock_layout::lock_type * primary_locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
 
       uint64_t n_buckets_primary;
       uint64_t n_buckets_alt;
@@ -858,7 +868,9 @@ template <typename HT, uint tile_size>
          //printf("Iceberg table has %lu total: %lu primary and %lu alt\n", ext_n_buckets, host_version->n_buckets_primary, host_version->n_buckets_alt);
 
          host_version->primary_buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets_primary);
-         host_version->primary_locks = gallatin::utils::get_device_version<uint64_t>( (host_version->n_buckets_primary-1)/64+1);
+         host_version->primary_locks = lock_layout::generate_locks(host_version->n_buckets_primary);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets_primary);
 
          host_version->seed = ext_seed;
 
@@ -903,12 +915,8 @@ template <typename HT, uint tile_size>
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
-
          // uint64_t current_lock = hash_table_load(&primary_locks[bucket]);
 
-
          // while (true){
 
          //    while (current_lock % 2 != 0){
@@ -926,16 +934,19 @@ template <typename HT, uint tile_size>
 
          // }
 
+         LOCK_SPIN_INIT
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-
-         do {
-            ADD_PROBE
+         while (!lock_layout::try_lock(primary_locks, bucket)){
+            ADD_LOCK_SPIN
             #if DEBUG_PRINTS
             printf("Looping on lock %llu\n", bucket);
             #endif
          }
-         while (atomicOr((unsigned long long int *)&primary_locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
 
          #if DEBUG_PRINTS
          printf("Lock %llu acquired\n", bucket);
@@ -946,6 +957,47 @@ template <typename HT, uint tile_size>
 
 
 
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(primary_locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(primary_locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
       __device__ void unlock(tile_type my_tile, uint64_t bucket){
 
          if (my_tile.thread_rank() == 0){
@@ -963,13 +1015,11 @@ template <typename HT, uint tile_size>
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
-
          ADD_PROBE
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         atomicAnd((unsigned long long int *)&primary_locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(primary_locks, bucket);
       }
 
 
@@ -1117,7 +1167,8 @@ template <typename HT, uint tile_size>
          my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
 
          cudaFree(host_version->primary_buckets);
-         cudaFree(host_version->primary_locks);
+         lock_layout::free_locks(host_version->primary_locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
 
 
 
@@ -1235,7 +1286,8 @@ template <typename HT, uint tile_size>
       }
 
 
-      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          __shared__ vector_type data_vectors[64];
@@ -1593,7 +1645,8 @@ template <typename HT, uint tile_size>
       }
 
 
-      __device__ bool upsert_primary_buckets_function(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_0, uint64_t bucket_1, uint64_t bucket_2, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_primary_buckets_function(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_0, uint64_t bucket_1, uint64_t bucket_2, replace_func_type replace_func){
 
 
 
@@ -2035,7 +2088,8 @@ template <typename HT, uint tile_size>
 
       }
 
-      __device__ bool upsert_function_internal(const tile_type & my_tile, const Key & key, const Val & val, vector_type * order_vector, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_internal(const tile_type & my_tile, const Key & key, const Val & val, vector_type * order_vector, replace_func_type replace_func){
 
 
 
@@ -2178,7 +2232,8 @@ template <typename HT, uint tile_size>
 
       }
 
-      __device__ pair_type * find_pair_no_lock(tile_type my_tile, Key key){
+      //takes the key's lock - same split as the other tables, find_pair_no_lock is the unlocked probe.
+      __device__ pair_type * find_pair(tile_type my_tile, Key key){
 
          uint64_t lock_bucket = get_current_bucket(key, 0);
 
@@ -2225,7 +2280,7 @@ template <typename HT, uint tile_size>
 
       }
 
-      __device__ pair_type * find_pair_no_lock_2(tile_type my_tile, Key key){
+      __device__ pair_type * find_pair_no_lock(tile_type my_tile, Key key){
 
          for (int i = 0; i < N_CUCKOO_HASHES; i++){
             uint64_t bucket = get_current_bucket(key, i);
@@ -2309,6 +2364,15 @@ template <typename HT, uint tile_size>
       // //nope! no storage
       [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
 
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return find_with_reference_no_lock(my_tile, key, val);
+         });
+
+         #else
+
 
          // for (int i = 0; i < N_CUCKOO_HASHES; i++){
 
@@ -2341,9 +2405,7 @@ template <typename HT, uint tile_size>
 
          return found;
 
-
-
-
+         #endif
 
       }
 
@@ -2443,6 +2505,28 @@ template <typename HT, uint tile_size>
 
 
 
+      }
+
+      //caller holds the key's lock (get_lock_bucket).
+      __device__ bool remove_no_lock(tile_type my_tile, Key key){
+
+         pair_type * found_pair = query_packed_reference(my_tile, key);
+
+         if (found_pair == nullptr) return false;
+
+         bool ballot = false;
+
+         if (my_tile.thread_rank() == 0){
+
+            ADD_PROBE
+            ballot = typed_atomic_write(&found_pair->key, key, tombstoneKey);
+
+         }
+
+         __threadfence();
+
+         return my_tile.ballot(ballot);
+
       }
 
       // __device__ bool upsert(tile_type my_tile, Key old_key, Val old_val, Key new_key, Val new_val){
@@ -2480,7 +2564,7 @@ template <typename HT, uint tile_size>
 
          my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
             
-         uint64_t capacity = host_version->n_buckets_primary*sizeof(bucket_type) + (host_version->n_buckets_primary-1)/8+1; 
+         uint64_t capacity = host_version->n_buckets_primary*sizeof(bucket_type) + lock_layout::get_space_usage(host_version->n_buckets_primary); 
 
          cudaFreeHost(host_version);
 
@@ -2528,6 +2612,136 @@ template <typename HT, uint tile_size>
 
       }
 
+      //bulk build hooks for helpers/bulk_build.cuh. Each key is placed in the bucket of the first hash.
+      __host__ uint64_t get_n_bulk_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_bulk_buckets = host_version->n_buckets_primary;
+
+         cudaFreeHost(host_version);
+
+         return n_bulk_buckets;
+
+      }
+
+      __device__ uint64_t get_bulk_bucket(const Key & key){
+
+         return get_current_bucket(key, 0);
+
+      }
+
+      static const uint64_t bulk_bucket_size = bucket_size;
+
+      //plain stores of n <= bucket_size pairs into an empty bucket - no lock, only valid while building.
+      __device__ void bulk_fill_bucket(const tile_type & my_tile, uint64_t bucket, const Key * keys, const Val * vals, uint64_t n){
+
+         bucket_type * bucket_ptr = get_bucket_ptr_primary(bucket);
+
+         for (uint64_t i = my_tile.thread_rank(); i < n; i+=my_tile.size()){
+            bucket_ptr->slots[i].key = keys[i];
+            bucket_ptr->slots[i].val = vals[i];
+         }
+
+      }
+
+      //checkpoint (helpers/checkpoint.cuh): primary_buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets_primary, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->primary_buckets, sizeof(bucket_type)*host_version->n_buckets_primary)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets_primary = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->primary_buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets_primary);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->primary_buckets, sizeof(bucket_type)*host_version->n_buckets_primary);
+
+         if (!loaded){
+
+            cudaFree(host_version->primary_buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->primary_locks = lock_layout::generate_locks(host_version->n_buckets_primary);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets_primary);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_sweep_buckets = host_version->n_buckets_primary;
+
+         cudaFreeHost(host_version);
+
+         return n_sweep_buckets;
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh. Keys are loaded first and the pair only for a live slot.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         bucket_type * bucket_ptr = get_bucket_ptr_primary(bucket);
+
+         for (uint i = my_tile.thread_rank(); i < bucket_type::n_traversals; i+=my_tile.size()){
+
+            bool live = false;
+
+            pair_type loaded_pair {defaultKey, defaultVal};
+
+            if (i < bucket_size){
+
+               Key loaded_key = hash_table_load(&bucket_ptr->slots[i].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey){
+
+                  loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(&bucket_ptr->slots[i]);
+
+                  //slot may have turned over between the two loads.
+                  live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey);
+
+               }
+
+            }
+
+            if (!my_tile.ballot(live)) continue;
+
+            func(live, loaded_pair.key, loaded_pair.val);
+
+         }
+
+      }
+
       __host__ uint64_t get_num_locks(){
 
          my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
@@ -2566,6 +2780,19 @@ using cuckoo_generic = typename hashing_project::tables::cuckoo_table<Key,
                                     bucket_size>;
 
 
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using cuckoo_generic_with_locks = typename hashing_project::tables::cuckoo_table<Key,
+                                    generate_cuckoo_sentinel<Key>(),
+                                    generate_cuckoo_tombstone<Key>(0),
+                                    Val,
+                                    generate_cuckoo_sentinel<Val>(),
+                                    generate_cuckoo_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
 
 
 } //namespace wrappers
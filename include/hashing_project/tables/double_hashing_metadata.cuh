@@ -13,6 +13,10 @@
 #include <hashing_project/helpers/ht_pairs.cuh>
 #include <hashing_project/helpers/probe_counts.cuh>
 #include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
 
 
 #include "assert.h"
@@ -396,9 +400,11 @@ namespace tables {
 
 
       #if LARGE_BUCKET_MODS
-      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint64_t upsert_mapping, void (*replace_func)(pair_type *, Key, Val))
+      template <typename replace_func_type>
+      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint64_t upsert_mapping, replace_func_type replace_func)
       #else
-      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint32_t upsert_mapping, void (*replace_func)(pair_type *, Key, Val))
+      template <typename replace_func_type>
+      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint32_t upsert_mapping, replace_func_type replace_func)
       #endif
       {
 
@@ -1712,11 +1718,11 @@ namespace tables {
 
 
 
-   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
    struct double_metadata_table {
 
 
-      using my_type = double_metadata_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+      using my_type = double_metadata_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
 
 
       using tile_type = cg::thread_block_tile<partition_size>;
@@ -1731,7 +1737,10 @@ namespace tables {
 
       md_bucket_type * metadata;
       bucket_type * buckets;
-      uint64_t * locks;
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
 
       uint64_t n_buckets;
       uint64_t seed;
@@ -1749,7 +1758,9 @@ namespace tables {
 
          host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(ext_n_buckets);
 
-         host_version->locks = gallatin::utils::get_device_version<uint64_t>( (ext_n_buckets-1)/64+1);
+         host_version->locks = lock_layout::generate_locks(ext_n_buckets);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(ext_n_buckets);
 
          host_version->seed = ext_seed;
 
@@ -1821,21 +1832,63 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
-
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
+         LOCK_SPIN_INIT
 
-         do {
-            ADD_PROBE
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
             //printf("Looping in lock\n");
          }
-         while (atomicOr((unsigned long long int *)&locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
 
          //printf("Exiting lock\n");
 
       }
 
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
       __device__ void unlock(tile_type my_tile, uint64_t bucket){
 
          if (my_tile.thread_rank() == 0){
@@ -1853,11 +1906,9 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         hashing_project::helpers::end_bucket_write(versions, bucket);
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         atomicAnd((unsigned long long int *)&locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+         lock_layout::unlock(locks, bucket);
          ADD_PROBE
 
       }
@@ -1940,7 +1991,8 @@ namespace tables {
 
          cudaFree(host_version->metadata);
          cudaFree(host_version->buckets);
-         cudaFree(host_version->locks);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
 
          cudaFreeHost(host_version);
          
@@ -2153,7 +2205,8 @@ namespace tables {
       }
 
 
-      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -2193,7 +2246,8 @@ namespace tables {
 
       }
 
-      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -2370,6 +2424,15 @@ namespace tables {
 
    [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
 
+      #if STABLE_HT_LOCKLESS_QUERY
+
+      //probe unlocked and re-validate against the version of the key's lock bucket.
+      return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+         return find_with_reference_no_lock(my_tile, key, val);
+      });
+
+      #else
+
 
          //return false;
 
@@ -2380,6 +2443,8 @@ namespace tables {
 
          return query_internal(my_tile, key, val, bucket_primary, step);
 
+      #endif
+
    }
 
    [[nodiscard]] __device__ packed_pair_type * find_pair(tile_type my_tile, Key key){
@@ -2530,7 +2595,7 @@ namespace tables {
 
          my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
             
-         uint64_t capacity = host_version->n_buckets*(sizeof(bucket_type)+sizeof(md_bucket_type)) + (host_version->n_buckets-1)/8+1; 
+         uint64_t capacity = host_version->n_buckets*(sizeof(bucket_type)+sizeof(md_bucket_type)) + lock_layout::get_space_usage(host_version->n_buckets); 
 
          cudaFreeHost(host_version);
 
@@ -2633,6 +2698,112 @@ namespace tables {
 
       }
 
+      //checkpoint (helpers/checkpoint.cuh): metadata, buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::write_device_region(writer, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(host_version->n_buckets);
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::read_device_region(reader, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets);
+
+         if (!loaded){
+
+            cudaFree(host_version->metadata);
+            cudaFree(host_version->buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->locks = lock_layout::generate_locks(host_version->n_buckets);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_sweep_buckets = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return n_sweep_buckets;
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh. Tags are loaded first: the pair is only loaded for a live tag,
+      //and a round of empty/tombstone tags never touches the pair bucket.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         md_bucket_type * md_bucket = get_metadata(bucket);
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         for (uint i = my_tile.thread_rank(); i < md_bucket_type::n_traversals; i+=my_tile.size()){
+
+            uint16_t loaded_tag = md_bucket->get_empty_tag();
+
+            if (i < bucket_size){
+               loaded_tag = hash_table_load(&md_bucket->metadata[i]);
+            }
+
+            bool live = (loaded_tag != md_bucket->get_empty_tag() && loaded_tag != md_bucket->get_tombstone_tag());
+
+            if (!my_tile.ballot(live)) continue;
+
+            packed_pair_type loaded_pair {defaultKey, defaultVal};
+
+            if (live){
+
+               loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(&bucket_ptr->slots[i]);
+
+               //a freshly claimed tag is set before its pair is written, and removal only clears the tag.
+               live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey && loaded_pair.key != bucket_type::holdingKey && md_bucket->get_tag(loaded_pair.key) == loaded_tag);
+
+            }
+
+            if (!my_tile.ballot(live)) continue;
+
+            func(live, loaded_pair.key, loaded_pair.val);
+
+         }
+
+      }
+
 
    };
 
@@ -2660,6 +2831,19 @@ using md_double_generic = typename hashing_project::tables::double_metadata_tabl
                                     bucket_size>;
 
 
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using md_double_generic_with_locks = typename hashing_project::tables::double_metadata_table<Key,
+                                    generate_double_md_sentinel<Key>(),
+                                    generate_double_md_tombstone<Key>(0),
+                                    Val,
+                                    generate_double_md_sentinel<Val>(),
+                                    generate_double_md_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
 
 
 } //namespace wrappers
@@ -0,0 +1,857 @@
+#ifndef OUR_DOUBLE_META_SET
+#define OUR_DOUBLE_META_SET
+
+#include <cooperative_groups.h>
+#include <cooperative_groups/reduce.h>
+#include <cooperative_groups/scan.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/probe_counts.cuh>
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/set_probing.cuh>
+
+//metadata buckets are shared with the map version.
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+
+//Key-only version of double_hashing_metadata.cuh.
+//tags are identical to the map table, but the slot array holds only keys - a 32 slot
+//bucket is 256 bytes instead of 512, and a tag match needs a single 8-byte key read to confirm.
+//As in double_hashing_set.cuh the probe sequence is a policy - md_p2_set_generic is the p2 version.
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename HT, uint tile_size>
+   __global__ void double_md_set_get_fill_kernel(HT * metadata_table, uint64_t n_buckets, uint64_t * item_count){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t n_items_in_bucket = metadata_table->get_bucket_fill(my_tile, tid);
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)item_count, n_items_in_bucket);
+      }
+
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, uint partition_size, uint bucket_size>
+   struct double_md_set_bucket {
+
+      alignas(16) Key slots[bucket_size];
+
+
+      __device__ void init(){
+
+         for (uint i=0; i < bucket_size; i++){
+
+            slots[i] = defaultKey;
+
+         }
+
+         __threadfence();
+      }
+
+
+      //confirm tag matches against the stored keys - returns the slot index or -1.
+      #if LARGE_BUCKET_MODS
+      __device__ int query_key_ballot(const cg::thread_block_tile<partition_size> & my_tile, const Key & read_key, uint64_t match_ballot)
+      #else
+      __device__ int query_key_ballot(const cg::thread_block_tile<partition_size> & my_tile, const Key & read_key, uint32_t match_ballot)
+      #endif
+      {
+
+         int found = __ffsll(match_ballot)-1;
+
+         while (found != -1){
+
+            bool found_flag = false;
+
+            if (my_tile.thread_rank() == found % my_tile.size()){
+
+               ADD_PROBE
+
+               Key loaded_key = hash_table_load(&slots[found]);
+
+               found_flag = (loaded_key == read_key);
+
+            }
+
+            if (my_tile.ballot(found_flag)){
+               return found;
+            }
+
+            match_ballot ^= SET_BIT_MASK(found);
+
+            found = __ffsll(match_ballot)-1;
+
+         }
+
+
+         return -1;
+
+
+      }
+
+
+   };
+
+
+   template <typename table>
+   __global__ void init_double_md_set_kernel(table * hash_table){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      hash_table->init_bucket_and_locks(tid);
+
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks, typename probe_policy = hashing_project::helpers::double_set_probing<META_MAX_PROBES>>
+   struct double_metadata_set {
+
+
+      using my_type = double_metadata_set<Key, defaultKey, tombstoneKey, partition_size, bucket_size, lock_layout, probe_policy>;
+
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      //Val parameters of the metadata bucket are only used by its pair helpers, which the set never calls.
+      using md_bucket_type = double_metadata_bucket<Key, defaultKey, tombstoneKey, Key, tombstoneKey, partition_size, bucket_size>;
+
+      using bucket_type = double_md_set_bucket<Key, defaultKey, tombstoneKey, partition_size, bucket_size>;
+
+      #if LARGE_BUCKET_MODS
+      using ballot_type = uint64_t;
+      #else
+      using ballot_type = uint32_t;
+      #endif
+
+
+      md_bucket_type * metadata;
+      bucket_type * buckets;
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
+
+      uint64_t n_buckets;
+      uint64_t seed;
+
+
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets = ext_n_buckets;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(ext_n_buckets);
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(ext_n_buckets);
+
+         host_version->locks = lock_layout::generate_locks(ext_n_buckets);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(ext_n_buckets);
+
+         host_version->seed = ext_seed;
+
+         my_type * device_version = gallatin::utils::move_to_device<my_type>(host_version);
+
+         init_double_md_set_kernel<my_type><<<(ext_n_buckets-1)/256+1,256>>>(device_version);
+
+         cudaDeviceSynchronize();
+
+         return device_version;
+
+      }
+
+      __device__ void init_bucket_and_locks(uint64_t tid){
+
+         if (tid < n_buckets){
+            metadata[tid].init();
+            buckets[tid].init();
+            unlock_bucket_one_thread(tid);
+         }
+
+      }
+
+
+      __device__ void stall_lock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+
+            stall_lock_one_thread(bucket);
+
+         }
+
+         my_tile.sync();
+
+      }
+
+      __device__ void lock_key(tile_type my_tile, Key key){
+
+         stall_lock(my_tile, get_lock_bucket(my_tile, key));
+
+      }
+
+      __device__ void unlock_key(tile_type my_tile, Key key){
+
+         unlock(my_tile, get_lock_bucket(my_tile, key));
+
+      }
+
+      __device__ uint64_t get_lock_bucket(tile_type my_tile, Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+
+      __device__ void stall_lock_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+      }
+
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+            unlock_bucket_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+
+      __device__ void unlock_bucket_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(locks, bucket);
+         ADD_PROBE
+
+      }
+
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const uint64_t * data = (const uint64_t *)key;
+         const uint64_t * end = data + (len/8);
+
+         while(data != end)
+         {
+            uint64_t k = *data++;
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = (const unsigned char*)data;
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      __device__ uint64_t get_first_bucket(uint64_t hash){
+         return probe_policy::get_bucket(hash, 0, n_buckets);
+      }
+
+      __host__ uint64_t get_num_locks(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t nblocks = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return nblocks;
+
+      }
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         cudaFree(host_version->buckets);
+         cudaFree(host_version->metadata);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
+
+         cudaFreeHost(host_version);
+
+         return;
+
+      }
+
+
+      __device__ bucket_type * get_bucket_ptr(uint64_t bucket_addr){
+
+         return &buckets[bucket_addr];
+
+      }
+
+      __device__ md_bucket_type * get_metadata(uint64_t bucket_addr){
+
+         return &metadata[bucket_addr];
+
+      }
+
+
+      __device__ void load_ballots(const tile_type & my_tile, const Key & key, md_bucket_type * md_bucket, ballot_type & bucket_empty, ballot_type & bucket_tombstone, ballot_type & bucket_match){
+
+         #if LARGE_MD_LOAD
+         md_bucket->load_fill_ballots_huge(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+         #else
+         md_bucket->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+         #endif
+
+      }
+
+
+      __device__ bool contains_internal(const tile_type & my_tile, const Key & key, uint64_t key_hash){
+
+
+         for (uint i = 0; i < probe_policy::n_probes; i++){
+
+
+            uint64_t bucket_index = probe_policy::get_bucket(key_hash, i, n_buckets);
+
+            md_bucket_type * md_bucket = get_metadata(bucket_index);
+            bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+            ballot_type bucket_empty;
+            ballot_type bucket_tombstone;
+            ballot_type bucket_match;
+
+            load_ballots(my_tile, key, md_bucket, bucket_empty, bucket_tombstone, bucket_match);
+
+            if (bucket_ptr->query_key_ballot(my_tile, key, bucket_match) != -1){
+               return true;
+            }
+
+            //shortcutting
+            if (probe_policy::stop_on_empty && __popcll(bucket_empty) > 0) return false;
+
+
+         }
+
+         return false;
+
+
+      }
+
+
+      //claim a tag in one bucket, then publish the key into the slot.
+      __device__ bool insert_into_bucket(const tile_type & my_tile, const Key & key, uint64_t bucket_index, ballot_type bucket_empty, ballot_type bucket_tombstone){
+
+         md_bucket_type * md_bucket = get_metadata(bucket_index);
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+         int result = md_bucket->match_empty(my_tile, key, bucket_empty);
+
+         if (result == -1){
+            result = md_bucket->match_tombstone(my_tile, key, bucket_tombstone);
+         }
+
+         if (result == -1) return false;
+
+         //tag is claimed, so the slot is ours - the key store is the publish.
+         if (my_tile.thread_rank() == 0){
+            ADD_PROBE
+            ht_store(&bucket_ptr->slots[result], key);
+            __threadfence();
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+
+      __device__ bool insert_internal(const tile_type & my_tile, const Key & key, uint64_t key_hash){
+
+
+         ballot_type bucket_empty;
+         ballot_type bucket_tombstone;
+         ballot_type bucket_match;
+
+         if constexpr (probe_policy::least_full_insert){
+
+            static_assert(probe_policy::n_probes == 2, "least full inserts choose between two buckets");
+
+            uint64_t bucket_0 = probe_policy::get_bucket(key_hash, 0, n_buckets);
+            uint64_t bucket_1 = probe_policy::get_bucket(key_hash, 1, n_buckets);
+
+            ballot_type bucket_1_empty;
+            ballot_type bucket_1_tombstone;
+
+            load_ballots(my_tile, key, get_metadata(bucket_0), bucket_empty, bucket_tombstone, bucket_match);
+            load_ballots(my_tile, key, get_metadata(bucket_1), bucket_1_empty, bucket_1_tombstone, bucket_match);
+
+            //emptier bucket first, ties go to bucket 0.
+            if (__popcll(bucket_1_empty | bucket_1_tombstone) > __popcll(bucket_empty | bucket_tombstone)){
+
+               if (insert_into_bucket(my_tile, key, bucket_1, bucket_1_empty, bucket_1_tombstone)) return true;
+
+               return insert_into_bucket(my_tile, key, bucket_0, bucket_empty, bucket_tombstone);
+
+            }
+
+            if (insert_into_bucket(my_tile, key, bucket_0, bucket_empty, bucket_tombstone)) return true;
+
+            return insert_into_bucket(my_tile, key, bucket_1, bucket_1_empty, bucket_1_tombstone);
+
+         } else {
+
+            for (uint i = 0; i < probe_policy::n_probes; i++){
+
+               uint64_t bucket_index = probe_policy::get_bucket(key_hash, i, n_buckets);
+
+               load_ballots(my_tile, key, get_metadata(bucket_index), bucket_empty, bucket_tombstone, bucket_match);
+
+               if (insert_into_bucket(my_tile, key, bucket_index, bucket_empty, bucket_tombstone)) return true;
+
+            }
+
+            return false;
+
+         }
+
+      }
+
+
+      __device__ bool erase_internal(const tile_type & my_tile, const Key & key, uint64_t key_hash){
+
+
+         for (uint i = 0; i < probe_policy::n_probes; i++){
+
+
+            uint64_t bucket_index = probe_policy::get_bucket(key_hash, i, n_buckets);
+
+            md_bucket_type * md_bucket = get_metadata(bucket_index);
+            bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+            ballot_type bucket_empty;
+            ballot_type bucket_tombstone;
+            ballot_type bucket_match;
+
+            load_ballots(my_tile, key, md_bucket, bucket_empty, bucket_tombstone, bucket_match);
+
+            int erased_index = bucket_ptr->query_key_ballot(my_tile, key, bucket_match);
+
+            if (erased_index != -1){
+
+               if (my_tile.thread_rank() == 0){
+
+                  ADD_PROBE
+                  ht_store(&bucket_ptr->slots[erased_index], tombstoneKey);
+                  __threadfence();
+
+                  md_bucket->set_tombstone(erased_index);
+               }
+
+               my_tile.sync();
+
+               return true;
+
+            }
+
+            //shortcutting
+            if (probe_policy::stop_on_empty && __popcll(bucket_empty) > 0) return false;
+
+
+         }
+
+         return false;
+
+
+      }
+
+
+      //returns true if key is in the set after the call - false only if the probe sequence is full.
+      __device__ bool insert(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_0);
+
+         if (contains_internal(my_tile, key, key_hash)){
+
+            unlock(my_tile, bucket_0);
+
+            return true;
+
+         }
+
+         bool return_val = insert_internal(my_tile, key, key_hash);
+
+         unlock(my_tile, bucket_0);
+
+         return return_val;
+
+      }
+
+      __device__ bool insert_no_lock(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         if (contains_internal(my_tile, key, key_hash)) return true;
+
+         return insert_internal(my_tile, key, key_hash);
+
+      }
+
+
+      [[nodiscard]] __device__ bool contains(const tile_type & my_tile, const Key & key){
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return contains_no_lock(my_tile, key);
+         });
+
+         #else
+
+         return contains_no_lock(my_tile, key);
+
+         #endif
+
+      }
+
+      [[nodiscard]] __device__ bool contains_no_lock(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return contains_internal(my_tile, key, key_hash);
+
+      }
+
+
+      __device__ bool erase(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_0);
+
+         bool return_val = erase_internal(my_tile, key, key_hash);
+
+         unlock(my_tile, bucket_0);
+
+         return return_val;
+
+      }
+
+      __device__ bool erase_no_lock(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return erase_internal(my_tile, key, key_hash);
+
+      }
+
+
+      //checkpoint (helpers/checkpoint.cuh): metadata + buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), 0, partition_size, bucket_size, host_version->seed, host_version->n_buckets, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::write_device_region(writer, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), 0, partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(host_version->n_buckets);
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::read_device_region(reader, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets);
+
+         if (!loaded){
+
+            cudaFree(host_version->metadata);
+            cudaFree(host_version->buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->locks = lock_layout::generate_locks(host_version->n_buckets);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ float load(){
+
+         return 0;
+
+      }
+
+      static std::string get_name(){
+         return probe_policy::get_prefix() + "_metadata_set";
+      }
+
+      __host__ void print_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t capacity = host_version->n_buckets*(sizeof(bucket_type)+sizeof(md_bucket_type)) + lock_layout::get_space_usage(host_version->n_buckets);
+
+         cudaFreeHost(host_version);
+
+         printf("%s using %llu bytes\n", get_name().c_str(), capacity);
+
+      }
+
+
+      __host__ void print_fill(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+         uint64_t n_items = get_fill();
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_buckets*bucket_size, 100.0*n_items/(n_buckets*bucket_size));
+
+         cudaFreeHost(host_version);
+
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+
+         uint64_t * n_items;
+
+         cudaMallocManaged((void **)&n_items, sizeof(uint64_t));
+
+         n_items[0] = 0;
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+
+         double_md_set_get_fill_kernel<my_type, partition_size><<<(n_buckets*partition_size-1)/256+1,256>>>(this, n_buckets, n_items);
+
+         cudaDeviceSynchronize();
+
+         uint64_t return_items = n_items[0];
+
+         cudaFree(n_items);
+         cudaFreeHost(host_version);
+
+         return return_items;
+
+
+      }
+
+      __device__ uint64_t get_bucket_fill(tile_type my_tile, uint64_t bucket){
+
+
+         ballot_type bucket_empty;
+         ballot_type bucket_tombstone;
+         ballot_type bucket_match;
+
+         load_ballots(my_tile, defaultKey, get_metadata(bucket), bucket_empty, bucket_tombstone, bucket_match);
+
+         return bucket_size-__popcll(bucket_empty)-__popcll(bucket_tombstone);
+
+
+      }
+
+
+   };
+
+
+//Val is unused - kept so the set drops into the same test templates as the map tables.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using md_double_set_generic = typename hashing_project::tables::double_metadata_set<Key,
+                                    generate_double_md_sentinel<Key>(),
+                                    generate_double_md_tombstone<Key>(0),
+                                    tile_size,
+                                    bucket_size>;
+
+
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using md_double_set_generic_with_locks = typename hashing_project::tables::double_metadata_set<Key,
+                                    generate_double_md_sentinel<Key>(),
+                                    generate_double_md_tombstone<Key>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
+//power-of-two-choice metadata set, the key-only counterpart of p2_hashing_metadata.cuh.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using md_p2_set_generic = typename hashing_project::tables::double_metadata_set<Key,
+                                    generate_double_md_sentinel<Key>(),
+                                    generate_double_md_tombstone<Key>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    hashing_project::helpers::packed_bucket_locks,
+                                    hashing_project::helpers::p2_set_probing>;
+
+
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of double metadata set include guard
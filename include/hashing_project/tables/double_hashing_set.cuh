@@ -0,0 +1,907 @@
+#ifndef OUR_DOUBLE_SET
+#define OUR_DOUBLE_SET
+
+#include <cooperative_groups.h>
+#include <cooperative_groups/reduce.h>
+#include <cooperative_groups/scan.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/probe_counts.cuh>
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/set_probing.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+// helper_macro
+// define macros
+#define MAX_VALUE(nbits) ((1ULL << (nbits)) - 1)
+#define BITMASK(nbits) ((nbits) == 64 ? 0xffffffffffffffff : MAX_VALUE(nbits))
+
+#define SET_BIT_MASK(index) ((1ULL << index))
+
+
+//Key-only version of double_hashing.cuh for membership / deduplication.
+//slots hold just the key, so a bucket is half the bytes of the map version and
+//every tile pass pulls 16 bytes of keys per thread with ht_load_packed_keys.
+//As the key is the whole slot, an insert publishes with a single CAS and
+//contains() needs no second read after the bucket scan.
+//The probe sequence is a policy (helpers/set_probing.cuh): double hashing by default,
+//p2_set_generic runs the same buckets with power-of-two-choice.
+
+#define DOUBLE_SET_MAX_PROBES 80
+
+#define MEASURE_INSERTS 1
+#define MEASURE_QUERIES 1
+#define MEASURE_DELETES 1
+
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename HT, uint tile_size>
+   __global__ void double_set_get_fill_kernel(HT * metadata_table, uint64_t n_buckets, uint64_t * item_count){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t n_items_in_bucket = metadata_table->get_bucket_fill(my_tile, tid);
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)item_count, n_items_in_bucket);
+      }
+
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, uint partition_size, uint bucket_size>
+   struct double_set_bucket {
+
+      //keys covered by one 16-byte load.
+      static const uint keys_per_load = 16/sizeof(Key);
+
+      static const uint n_loads = bucket_size/keys_per_load;
+
+      static const uint64_t n_traversals = ((n_loads-1)/partition_size+1)*partition_size;
+
+      static_assert((bucket_size*sizeof(Key)) % 16 == 0, "set buckets must be a multiple of 16 bytes for packed key loads");
+      static_assert(bucket_size <= 32, "set bucket ballots are 32 bits");
+
+      alignas(16) Key slots[bucket_size];
+
+
+      __device__ void init(){
+
+         for (uint i=0; i < bucket_size; i++){
+
+            slots[i] = defaultKey;
+
+         }
+
+         __threadfence();
+      }
+
+
+      //one pass over the bucket - each thread loads keys_per_load keys and the tile reduces the masks.
+      __device__ void load_fill_ballots(const cg::thread_block_tile<partition_size> & my_tile, const Key & upsert_key, __restrict__ uint32_t & empty_match, __restrict__ uint32_t & tombstone_match, __restrict__ uint32_t & key_match){
+
+
+         //wipe previous
+         empty_match = 0U;
+         tombstone_match = 0U;
+         key_match = 0U;
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            uint32_t local_empty = 0U;
+            uint32_t local_tombstone = 0U;
+            uint32_t local_match = 0U;
+
+            if (i < n_loads){
+
+               packed_tags loaded_keys = ht_load_packed_keys<Key>(&slots[i*keys_per_load]);
+
+               Key * load_key_indexer = (Key *) &loaded_keys;
+
+               for (uint j = 0; j < keys_per_load; j++){
+
+                  Key loaded_key = load_key_indexer[j];
+
+                  uint32_t set_index = SET_BIT_MASK(i*keys_per_load+j);
+
+                  local_empty |= (loaded_key == defaultKey)*set_index;
+                  local_tombstone |= (loaded_key == tombstoneKey)*set_index;
+                  local_match |= (loaded_key == upsert_key)*set_index;
+
+               }
+
+            }
+
+            empty_match |= cg::reduce(my_tile, local_empty, cg::plus<uint32_t>());
+            tombstone_match |= cg::reduce(my_tile, local_tombstone, cg::plus<uint32_t>());
+            key_match |= cg::reduce(my_tile, local_match, cg::plus<uint32_t>());
+
+         }
+
+         return;
+
+      }
+
+
+      //claim one open slot by swapping the key straight in - the key is the whole slot,
+      //so the CAS is also the publish.
+      __device__ bool insert_ballots(const cg::thread_block_tile<partition_size> & my_tile, Key ext_key, uint32_t empty_match, uint32_t tombstone_match){
+
+         bool ballot = false;
+
+         if (my_tile.thread_rank() == 0){
+
+            uint32_t candidates = empty_match | tombstone_match;
+
+            while (candidates){
+
+               int slot = __ffs(candidates)-1;
+
+               candidates ^= SET_BIT_MASK(slot);
+
+               Key expected = (empty_match & SET_BIT_MASK(slot)) ? defaultKey : tombstoneKey;
+
+               ADD_PROBE
+               if (typed_atomic_write(&slots[slot], expected, ext_key)){
+                  ballot = true;
+                  break;
+               }
+
+            }
+
+         }
+
+         return my_tile.ballot(ballot);
+
+      }
+
+
+      __device__ bool erase_ballot(const cg::thread_block_tile<partition_size> & my_tile, Key ext_key, uint32_t match_ballot){
+
+         bool ballot = false;
+
+         if (my_tile.thread_rank() == 0){
+
+            while (match_ballot){
+
+               int slot = __ffs(match_ballot)-1;
+
+               match_ballot ^= SET_BIT_MASK(slot);
+
+               ADD_PROBE
+               if (typed_atomic_write(&slots[slot], ext_key, tombstoneKey)){
+                  ballot = true;
+                  break;
+               }
+
+            }
+
+         }
+
+         return my_tile.ballot(ballot);
+
+      }
+
+
+   };
+
+
+   template <typename table>
+   __global__ void init_double_set_kernel(table * hash_table){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      hash_table->init_bucket_and_locks(tid);
+
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks, typename probe_policy = hashing_project::helpers::double_set_probing<DOUBLE_SET_MAX_PROBES>>
+   struct double_set_table {
+
+
+      using my_type = double_set_table<Key, defaultKey, tombstoneKey, partition_size, bucket_size, lock_layout, probe_policy>;
+
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using bucket_type = double_set_bucket<Key, defaultKey, tombstoneKey, partition_size, bucket_size>;
+
+
+      bucket_type * buckets;
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
+
+      uint64_t n_buckets;
+      uint64_t seed;
+
+
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets = ext_n_buckets;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(ext_n_buckets);
+
+         host_version->locks = lock_layout::generate_locks(ext_n_buckets);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(ext_n_buckets);
+
+         host_version->seed = ext_seed;
+
+         my_type * device_version = gallatin::utils::move_to_device<my_type>(host_version);
+
+         init_double_set_kernel<my_type><<<(ext_n_buckets-1)/256+1,256>>>(device_version);
+
+         cudaDeviceSynchronize();
+
+         return device_version;
+
+      }
+
+      __device__ void init_bucket_and_locks(uint64_t tid){
+
+         if (tid < n_buckets){
+            buckets[tid].init();
+            unlock_bucket_one_thread(tid);
+         }
+
+      }
+
+
+      __device__ void lock_key(tile_type my_tile, Key key){
+
+         stall_lock(my_tile, get_lock_bucket(my_tile, key));
+
+      }
+
+      __device__ void unlock_key(tile_type my_tile, Key key){
+
+         unlock(my_tile, get_lock_bucket(my_tile, key));
+
+      }
+
+      __device__ uint64_t get_lock_bucket(tile_type my_tile, Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+
+      __device__ void stall_lock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+
+            stall_lock_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+      __device__ void stall_lock_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+      }
+
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+            unlock_bucket_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+
+      __device__ void unlock_bucket_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(locks, bucket);
+         ADD_PROBE
+
+      }
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const uint64_t * data = (const uint64_t *)key;
+         const uint64_t * end = data + (len/8);
+
+         while(data != end)
+         {
+            uint64_t k = *data++;
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = (const unsigned char*)data;
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      __device__ uint64_t get_first_bucket(uint64_t hash){
+
+         return probe_policy::get_bucket(hash, 0, n_buckets);
+
+      }
+
+      __host__ uint64_t get_num_locks(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t nblocks = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return nblocks;
+
+      }
+
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         cudaFree(host_version->buckets);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
+
+         cudaFreeHost(host_version);
+
+         return;
+
+      }
+
+
+      __device__ bucket_type * get_bucket_ptr(uint64_t bucket_addr){
+
+         return &buckets[bucket_addr];
+
+      }
+
+
+      __device__ bool contains_internal(const tile_type & my_tile, const Key & key, uint64_t key_hash){
+
+
+         for (uint i = 0; i < probe_policy::n_probes; i++){
+
+
+            bucket_type * bucket_ptr = get_bucket_ptr(probe_policy::get_bucket(key_hash, i, n_buckets));
+
+            uint32_t bucket_empty;
+            uint32_t bucket_tombstone;
+            uint32_t bucket_match;
+
+            #if MEASURE_QUERIES
+            ADD_PROBE_ADJUSTED_SET
+            #endif
+            bucket_ptr->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+
+            if (bucket_match) return true;
+
+            //shortcutting
+            if (probe_policy::stop_on_empty && __popc(bucket_empty) > 0) return false;
+
+         }
+
+         return false;
+
+      }
+
+
+      //claim an open slot in one bucket, reloading while the bucket still shows one.
+      __device__ bool insert_into_bucket(const tile_type & my_tile, const Key & key, bucket_type * bucket_ptr, uint32_t bucket_empty, uint32_t bucket_tombstone){
+
+         uint32_t bucket_match;
+
+         while (__popc(bucket_empty | bucket_tombstone) != 0){
+
+            if (bucket_ptr->insert_ballots(my_tile, key, bucket_empty, bucket_tombstone)) return true;
+
+            #if MEASURE_INSERTS
+            ADD_PROBE_ADJUSTED_SET
+            #endif
+            bucket_ptr->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+
+         }
+
+         return false;
+
+      }
+
+
+      __device__ bool insert_internal(const tile_type & my_tile, const Key & key, uint64_t key_hash){
+
+
+         uint32_t bucket_empty;
+         uint32_t bucket_tombstone;
+         uint32_t bucket_match;
+
+         if constexpr (probe_policy::least_full_insert){
+
+            static_assert(probe_policy::n_probes == 2, "least full inserts choose between two buckets");
+
+            bucket_type * bucket_0_ptr = get_bucket_ptr(probe_policy::get_bucket(key_hash, 0, n_buckets));
+            bucket_type * bucket_1_ptr = get_bucket_ptr(probe_policy::get_bucket(key_hash, 1, n_buckets));
+
+            uint32_t bucket_1_empty;
+            uint32_t bucket_1_tombstone;
+
+            #if MEASURE_INSERTS
+            ADD_PROBE_ADJUSTED_SET
+            ADD_PROBE_ADJUSTED_SET
+            #endif
+            bucket_0_ptr->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+            bucket_1_ptr->load_fill_ballots(my_tile, key, bucket_1_empty, bucket_1_tombstone, bucket_match);
+
+            //emptier bucket first, ties go to bucket 0.
+            if (__popc(bucket_1_empty | bucket_1_tombstone) > __popc(bucket_empty | bucket_tombstone)){
+
+               if (insert_into_bucket(my_tile, key, bucket_1_ptr, bucket_1_empty, bucket_1_tombstone)) return true;
+
+               return insert_into_bucket(my_tile, key, bucket_0_ptr, bucket_empty, bucket_tombstone);
+
+            }
+
+            if (insert_into_bucket(my_tile, key, bucket_0_ptr, bucket_empty, bucket_tombstone)) return true;
+
+            return insert_into_bucket(my_tile, key, bucket_1_ptr, bucket_1_empty, bucket_1_tombstone);
+
+         } else {
+
+            for (uint i = 0; i < probe_policy::n_probes; i++){
+
+
+               bucket_type * bucket_ptr = get_bucket_ptr(probe_policy::get_bucket(key_hash, i, n_buckets));
+
+
+               #if MEASURE_INSERTS
+               ADD_PROBE_ADJUSTED_SET
+               #endif
+
+               bucket_ptr->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+
+               if (insert_into_bucket(my_tile, key, bucket_ptr, bucket_empty, bucket_tombstone)) return true;
+
+            }
+
+            return false;
+
+         }
+
+      }
+
+
+      __device__ bool erase_internal(const tile_type & my_tile, const Key & key, uint64_t key_hash){
+
+
+         for (uint i = 0; i < probe_policy::n_probes; i++){
+
+
+            bucket_type * bucket_ptr = get_bucket_ptr(probe_policy::get_bucket(key_hash, i, n_buckets));
+
+            uint32_t bucket_empty;
+            uint32_t bucket_tombstone;
+            uint32_t bucket_match;
+
+            #if MEASURE_DELETES
+            ADD_PROBE_ADJUSTED_SET
+            #endif
+            bucket_ptr->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+
+            if (bucket_match){
+               return bucket_ptr->erase_ballot(my_tile, key, bucket_match);
+            }
+
+            //shortcutting
+            if (probe_policy::stop_on_empty && __popc(bucket_empty) > 0) return false;
+
+         }
+
+         return false;
+
+      }
+
+
+      //returns true if key is in the set after the call - false only if the probe sequence is full.
+      __device__ bool insert(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_0);
+
+         if (contains_internal(my_tile, key, key_hash)){
+
+            unlock(my_tile, bucket_0);
+
+            return true;
+
+         }
+
+         bool return_val = insert_internal(my_tile, key, key_hash);
+
+         unlock(my_tile, bucket_0);
+
+         return return_val;
+
+      }
+
+      __device__ bool insert_no_lock(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         if (contains_internal(my_tile, key, key_hash)) return true;
+
+         return insert_internal(my_tile, key, key_hash);
+
+      }
+
+
+      [[nodiscard]] __device__ bool contains(const tile_type & my_tile, const Key & key){
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return contains_no_lock(my_tile, key);
+         });
+
+         #else
+
+         return contains_no_lock(my_tile, key);
+
+         #endif
+
+      }
+
+      [[nodiscard]] __device__ bool contains_no_lock(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return contains_internal(my_tile, key, key_hash);
+
+      }
+
+
+      __device__ bool erase(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_0);
+
+         bool return_val = erase_internal(my_tile, key, key_hash);
+
+         unlock(my_tile, bucket_0);
+
+         return return_val;
+
+      }
+
+      __device__ bool erase_no_lock(const tile_type & my_tile, const Key & key){
+
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return erase_internal(my_tile, key, key_hash);
+
+      }
+
+
+      //checkpoint (helpers/checkpoint.cuh): buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), 0, partition_size, bucket_size, host_version->seed, host_version->n_buckets, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), 0, partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets);
+
+         if (!loaded){
+
+            cudaFree(host_version->buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->locks = lock_layout::generate_locks(host_version->n_buckets);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ float load(){
+
+         return 0;
+
+      }
+
+      static std::string get_name(){
+         return probe_policy::get_prefix() + "_set";
+      }
+
+      __host__ void print_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t capacity = host_version->n_buckets*sizeof(bucket_type) + lock_layout::get_space_usage(host_version->n_buckets);
+
+         cudaFreeHost(host_version);
+
+         printf("%s using %llu bytes\n", get_name().c_str(), capacity);
+
+      }
+
+      __host__ void print_fill(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+
+         uint64_t n_items = get_fill();
+
+         cudaDeviceSynchronize();
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_buckets*bucket_size, 100.0*n_items/(n_buckets*bucket_size));
+
+         cudaFreeHost(host_version);
+
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+
+         uint64_t * n_items;
+
+         cudaMallocManaged((void **)&n_items, sizeof(uint64_t));
+
+         n_items[0] = 0;
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+
+         double_set_get_fill_kernel<my_type, partition_size><<<(n_buckets*partition_size-1)/256+1,256>>>(this, n_buckets, n_items);
+
+         cudaDeviceSynchronize();
+
+         uint64_t return_items = n_items[0];
+
+         cudaFree(n_items);
+         cudaFreeHost(host_version);
+
+         return return_items;
+
+
+      }
+
+      __device__ uint64_t get_bucket_fill(tile_type my_tile, uint64_t bucket){
+
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+
+         uint32_t bucket_empty;
+         uint32_t bucket_tombstone;
+         uint32_t bucket_match;
+
+         bucket_ptr->load_fill_ballots(my_tile, defaultKey, bucket_empty, bucket_tombstone, bucket_match);
+
+         return bucket_size-__popc(bucket_empty) - __popc(bucket_tombstone);
+
+      }
+
+
+   };
+
+template <typename T>
+constexpr T generate_double_set_tombstone(uint64_t offset) {
+  return (~((T) 0)) - offset;
+};
+
+template <typename T>
+constexpr T generate_double_set_sentinel() {
+  return ((T) 0);
+};
+
+
+//Val is unused - kept so the set drops into the same test templates as the map tables.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using double_set_generic = typename hashing_project::tables::double_set_table<Key,
+                                    generate_double_set_sentinel<Key>(),
+                                    generate_double_set_tombstone<Key>(0),
+                                    tile_size,
+                                    bucket_size>;
+
+
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using double_set_generic_with_locks = typename hashing_project::tables::double_set_table<Key,
+                                    generate_double_set_sentinel<Key>(),
+                                    generate_double_set_tombstone<Key>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
+//power-of-two-choice set - the candidate buckets of p2_hashing_metadata.cuh, for lf_probes comparisons.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using p2_set_generic = typename hashing_project::tables::double_set_table<Key,
+                                    generate_double_set_sentinel<Key>(),
+                                    generate_double_set_tombstone<Key>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    hashing_project::helpers::packed_bucket_locks,
+                                    hashing_project::helpers::p2_set_probing>;
+
+
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of double set include guard
@@ -0,0 +1,496 @@
+#ifndef OUR_FROZEN_TABLE
+#define OUR_FROZEN_TABLE
+
+#include <cooperative_groups.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+
+//builder, file format and host queries.
+#include <hashing_project/host_tables/frozen_table.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+
+//Frozen snapshot of a live table, for phases that only query.
+//
+//freeze() copies the live pairs out of any table with flat pair buckets (everything except
+//chaining and the sets), packs them into a bucketized cuckoo table on the host and uploads it.
+//Each lookup is one 128 byte bucket read - one pair per thread of an 8 thread tile - with a
+//second bucket and the stash only on a miss. No locks, tombstones or acquire loads.
+//
+//The live table must be quiescent while freeze() runs. The snapshot never changes afterwards:
+//refreeze to pick up new writes.
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   //live table layouts freeze() can read - flat arrays of buckets that hold ht_pair slots.
+   template <typename T, typename = void>
+   struct frozen_has_buckets : std::false_type {};
+
+   template <typename T>
+   struct frozen_has_buckets<T, std::void_t<decltype(std::declval<T&>().buckets->slots[0].key), decltype(std::declval<T&>().n_buckets)>> : std::true_type {};
+
+   template <typename T, typename = void>
+   struct frozen_has_primary_buckets : std::false_type {};
+
+   template <typename T>
+   struct frozen_has_primary_buckets<T, std::void_t<decltype(std::declval<T&>().primary_buckets->slots[0].key), decltype(std::declval<T&>().n_buckets_primary)>> : std::true_type {};
+
+   template <typename T, typename = void>
+   struct frozen_has_alt_buckets : std::false_type {};
+
+   template <typename T>
+   struct frozen_has_alt_buckets<T, std::void_t<decltype(std::declval<T&>().alt_buckets->slots[0].key), decltype(std::declval<T&>().n_buckets_alt)>> : std::true_type {};
+
+
+   //one thread per live slot. output == nullptr only counts.
+   template <typename bucket_type, typename pair_type, typename Key>
+   __global__ void frozen_collect_kernel(bucket_type * buckets, uint64_t n_buckets, pair_type * output, uint64_t * n_output, Key emptyKey, Key tombstoneKey){
+
+      constexpr uint64_t n_slots = sizeof(bucket_type::slots)/sizeof(bucket_type::slots[0]);
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      if (tid >= n_buckets*n_slots) return;
+
+      auto & slot = buckets[tid/n_slots].slots[tid % n_slots];
+
+      Key key = slot.key;
+
+      if (key == emptyKey || key == tombstoneKey) return;
+
+      uint64_t index = atomicAdd((unsigned long long int *)n_output, 1ULL);
+
+      if (output != nullptr){
+         output[index].key = key;
+         output[index].val = slot.val;
+      }
+
+   }
+
+
+   template <typename Key, Key defaultKey, typename Val, uint partition_size, uint bucket_size>
+   struct frozen_table {
+
+
+      using my_type = frozen_table<Key, defaultKey, Val, partition_size, bucket_size>;
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using bucket_type = frozen_bucket<Key, Val, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+      using host_type = host_frozen_table<Key, defaultKey, Val, bucket_size>;
+
+      static const uint64_t n_traversals = ((bucket_size-1)/partition_size+1)*partition_size;
+
+
+      bucket_type * buckets;
+
+      uint64_t n_buckets;
+      uint64_t n_items;
+      uint64_t seed;
+
+      packed_pair_type stash[FROZEN_STASH_SIZE];
+      uint64_t n_stash;
+
+
+      //upload a host snapshot.
+      static __host__ my_type * generate_on_device(host_type * host_table){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = host_table->n_buckets;
+         host_version->n_items = host_table->n_items;
+         host_version->seed = host_table->seed;
+         host_version->n_stash = host_table->n_stash;
+
+         for (uint i = 0; i < FROZEN_STASH_SIZE; i++){
+            host_version->stash[i] = host_table->stash[i];
+         }
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_table->n_buckets);
+
+         cudaMemcpy(host_version->buckets, host_table->buckets, sizeof(bucket_type)*host_table->n_buckets, cudaMemcpyHostToDevice);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         cudaFree(host_version->buckets);
+
+         cudaFreeHost(host_version);
+
+      }
+
+
+      template <typename bucket_span_type>
+      static __host__ void collect_span(bucket_span_type * span, uint64_t n_span_buckets, packed_pair_type * output, uint64_t * n_output){
+
+         constexpr uint64_t n_slots = sizeof(bucket_span_type::slots)/sizeof(bucket_span_type::slots[0]);
+
+         if (n_span_buckets == 0) return;
+
+         //every table in tables/ uses generate_*_tombstone<Key>(0).
+         frozen_collect_kernel<bucket_span_type, packed_pair_type, Key><<<(n_span_buckets*n_slots-1)/256+1,256>>>(span, n_span_buckets, output, n_output, defaultKey, ~((Key) 0));
+
+      }
+
+      template <typename live_table>
+      static __host__ void collect_live_pairs(live_table * host_live, packed_pair_type * output, uint64_t * n_output){
+
+         static_assert(frozen_has_buckets<live_table>::value || frozen_has_primary_buckets<live_table>::value, "freeze() needs a map table with flat pair buckets");
+
+         if constexpr (frozen_has_buckets<live_table>::value){
+            collect_span(host_live->buckets, host_live->n_buckets, output, n_output);
+         }
+
+         if constexpr (frozen_has_primary_buckets<live_table>::value){
+            collect_span(host_live->primary_buckets, host_live->n_buckets_primary, output, n_output);
+         }
+
+         if constexpr (frozen_has_alt_buckets<live_table>::value){
+            collect_span(host_live->alt_buckets, host_live->n_buckets_alt, output, n_output);
+         }
+
+         cudaDeviceSynchronize();
+
+      }
+
+
+      //snapshot a quiescent live table. The live table is left untouched.
+      template <typename live_table>
+      static __host__ my_type * freeze(live_table * live, uint64_t ext_seed){
+
+         live_table * host_live = gallatin::utils::copy_to_host<live_table>(live);
+
+         uint64_t * n_output;
+
+         cudaMallocManaged((void **)&n_output, sizeof(uint64_t));
+
+         n_output[0] = 0;
+
+         collect_live_pairs(host_live, nullptr, n_output);
+
+         uint64_t n_pairs = n_output[0];
+
+         packed_pair_type * device_pairs = gallatin::utils::get_device_version<packed_pair_type>(n_pairs > 0 ? n_pairs : 1);
+
+         n_output[0] = 0;
+
+         collect_live_pairs(host_live, device_pairs, n_output);
+
+         std::vector<packed_pair_type> pairs(n_pairs);
+
+         cudaMemcpy(pairs.data(), device_pairs, sizeof(packed_pair_type)*n_pairs, cudaMemcpyDeviceToHost);
+
+         host_type * host_table = host_type::build_on_host(pairs.data(), n_pairs, ext_seed);
+
+         my_type * device_version = generate_on_device(host_table);
+
+         host_type::free_on_host(host_table);
+
+         cudaFree(device_pairs);
+         cudaFree(n_output);
+         cudaFreeHost(host_live);
+
+         return device_version;
+
+      }
+
+
+      //download for host queries or inspection - free with host_type::free_on_host.
+      __host__ host_type * to_host(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         host_type * host_table = host_type::allocate_on_host(host_version->n_buckets, host_version->seed);
+
+         host_table->n_items = host_version->n_items;
+         host_table->n_stash = host_version->n_stash;
+
+         for (uint i = 0; i < FROZEN_STASH_SIZE; i++){
+            host_table->stash[i] = host_version->stash[i];
+         }
+
+         cudaMemcpy(host_table->buckets, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets, cudaMemcpyDeviceToHost);
+
+         cudaFreeHost(host_version);
+
+         return host_table;
+
+      }
+
+      __host__ bool save_checkpoint(std::string filename){
+
+         host_type * host_table = to_host();
+
+         bool saved = host_table->save_checkpoint(filename);
+
+         host_type::free_on_host(host_table);
+
+         return saved;
+
+      }
+
+      //nullptr if the file can't be read or has a different layout.
+      static __host__ my_type * load_checkpoint(std::string filename){
+
+         host_type * host_table = host_type::load_checkpoint(filename);
+
+         if (host_table == nullptr) return nullptr;
+
+         my_type * device_version = generate_on_device(host_table);
+
+         host_type::free_on_host(host_table);
+
+         return device_version;
+
+      }
+
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const uint64_t * data = (const uint64_t *)key;
+         const uint64_t * end = data + (len/8);
+
+         while(data != end)
+         {
+            uint64_t k = *data++;
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = (const unsigned char*)data;
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      //must match host_frozen_table.
+      __device__ uint64_t get_first_bucket(uint64_t hash){
+         return (hash & 0xFFFFFFFFULL) % n_buckets;
+      }
+
+      __device__ uint64_t get_second_bucket(uint64_t hash){
+
+         if (n_buckets == 1) return 0;
+
+         uint64_t bucket_0 = get_first_bucket(hash);
+         uint64_t bucket_1 = (hash >> 32) % n_buckets;
+
+         return (bucket_1 == bucket_0) ? (bucket_0+1) % n_buckets : bucket_1;
+
+      }
+
+
+      //plain loads - the snapshot is never written after upload.
+      __device__ bool query_bucket(const tile_type & my_tile, const bucket_type * bucket, const Key & key, Val & val){
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            bool found = false;
+
+            packed_pair_type loaded_pair;
+
+            if (i < bucket_size){
+
+               ADD_PROBE
+
+               loaded_pair = bucket->slots[i];
+
+               found = (loaded_pair.key == key);
+
+            }
+
+            auto found_ballot = my_tile.ballot(found);
+
+            if (found_ballot){
+
+               int leader = __ffs(found_ballot)-1;
+
+               val = my_tile.shfl(loaded_pair.val, leader);
+
+               return true;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+
+      [[nodiscard]] __device__ bool find_with_reference(const tile_type & my_tile, const Key & key, Val & val){
+
+         if (key == defaultKey) return false;
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         if (query_bucket(my_tile, &buckets[get_first_bucket(key_hash)], key, val)) return true;
+
+         if (query_bucket(my_tile, &buckets[get_second_bucket(key_hash)], key, val)) return true;
+
+         if (n_stash == 0) return false;
+
+         for (uint64_t i = my_tile.thread_rank(); i < ((n_stash-1)/partition_size+1)*partition_size; i+=my_tile.size()){
+
+            bool found = (i < n_stash) && (stash[i].key == key);
+
+            auto found_ballot = my_tile.ballot(found);
+
+            if (found_ballot){
+
+               int leader = __ffs(found_ballot)-1;
+
+               val = my_tile.shfl(found ? stash[i].val : Val{}, leader);
+
+               return true;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+      //snapshot is immutable - identical to find_with_reference.
+      [[nodiscard]] __device__ bool find_with_reference_no_lock(const tile_type & my_tile, const Key & key, Val & val){
+
+         return find_with_reference(my_tile, key, val);
+
+      }
+
+
+      __host__ float load(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         float fill = 1.0*host_version->n_items/(host_version->n_buckets*bucket_size);
+
+         cudaFreeHost(host_version);
+
+         return fill;
+
+      }
+
+      static std::string get_name(){
+         return "frozen_table";
+      }
+
+      __host__ uint64_t get_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t fill = host_version->n_items;
+
+         cudaFreeHost(host_version);
+
+         return fill;
+
+      }
+
+      __host__ uint64_t get_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t capacity = host_version->n_buckets*sizeof(bucket_type) + sizeof(my_type);
+
+         cudaFreeHost(host_version);
+
+         return capacity;
+
+      }
+
+      __host__ double get_bytes_per_key(){
+
+         uint64_t n_keys = get_fill();
+
+         return n_keys == 0 ? 0 : 1.0*get_space_usage()/n_keys;
+
+      }
+
+      __host__ void print_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         printf("fill: %lu/%lu = %f%%, %lu stashed\n", host_version->n_items, host_version->n_buckets*bucket_size, 100.0*host_version->n_items/(host_version->n_buckets*bucket_size), host_version->n_stash);
+
+         cudaFreeHost(host_version);
+
+      }
+
+      __host__ void print_space_usage(){
+
+         printf("frozen_table using %lu bytes, %f bytes per key\n", get_space_usage(), get_bytes_per_key());
+
+      }
+
+
+   };
+
+
+//8 x 16 byte pairs per bucket is one 128 byte line, read by an 8 thread tile.
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using frozen_generic = typename hashing_project::tables::frozen_table<Key,
+                                    generate_frozen_sentinel<Key>(),
+                                    Val,
+                                    tile_size,
+                                    bucket_size>;
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of frozen table include guard
@@ -0,0 +1,1426 @@
+#ifndef OUR_HOPSCOTCH
+#define OUR_HOPSCOTCH
+
+#include <cooperative_groups.h>
+#include <cooperative_groups/reduce.h>
+#include <cooperative_groups/scan.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/probe_counts.cuh>
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+// helper_macro
+// define macros
+#define MAX_VALUE(nbits) ((1ULL << (nbits)) - 1)
+#define BITMASK(nbits) ((nbits) == 64 ? 0xffffffffffffffff : MAX_VALUE(nbits))
+
+#define SET_BIT_MASK(index) ((1ULL << index))
+
+
+//Bucketed hopscotch hashing.
+//every key lives within HOPSCOTCH_NEIGHBORHOOD buckets of its home bucket,
+//and each home bucket keeps a bitmap of the buckets in its neighborhood that hold its keys.
+//queries read the bitmap and then only the marked buckets, so a query is bounded to
+//1 metadata read + popcount(bitmap) bucket reads instead of the up-to-N probes of double hashing.
+
+//neighborhood size in buckets - one bit per bucket in the uint32_t hop map.
+#define HOPSCOTCH_NEIGHBORHOOD 32
+
+//how far past the home bucket an insert will look for a free slot before giving up.
+#define HOPSCOTCH_MAX_PROBES 256
+
+//queries are not lockless: a displacement can move a key between two marked buckets while
+//both bits stay set, so an unvalidated walk can miss a present key. find_with_reference takes the
+//home bucket's shared lock, or with STABLE_HT_LOCKLESS_QUERY validates the walk against the home
+//bucket's version - every move of a key holds its home's lock.
+
+#define MEASURE_INSERTS 1
+#define MEASURE_QUERIES 1
+#define MEASURE_DELETES 1
+
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename HT, uint tile_size>
+   __global__ void hopscotch_get_fill_kernel(HT * metadata_table, uint64_t n_buckets, uint64_t * item_count){
+
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_buckets) return;
+
+      uint64_t n_items_in_bucket = metadata_table->get_bucket_fill(my_tile, tid);
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)item_count, n_items_in_bucket);
+      }
+
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+   struct hopscotch_bucket {
+
+      //marks a slot that has been claimed by an insert or displacement but not yet published.
+      static const Key holdingKey = tombstoneKey-1;
+
+      using pair_type = ht_pair<Key, Val>;
+
+      pair_type slots[bucket_size];
+
+      static const uint64_t n_traversals = ((bucket_size-1)/partition_size+1)*partition_size;
+
+
+      __device__ void init(){
+
+         pair_type sentinel_pair{defaultKey, defaultVal};
+
+         for (uint i=0; i < bucket_size; i++){
+
+            slots[i] = sentinel_pair;
+
+         }
+
+         __threadfence();
+      }
+
+      __device__ pair_type load_packed_pair(int index){
+         return ht_load_packed_pair<ht_pair, Key, Val>(&slots[index]);
+      }
+
+
+      //one pass over the bucket - ballots for empty, tombstone, and exact key matches.
+      __device__ void load_fill_ballots(const cg::thread_block_tile<partition_size> & my_tile, const Key & upsert_key, __restrict__ uint & empty_match, __restrict__ uint & tombstone_match, __restrict__ uint & key_match){
+
+
+         //wipe previous
+         empty_match = 0U;
+         tombstone_match = 0U;
+         key_match = 0U;
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            //step in clean intervals of my_tile.
+            uint offset = i - my_tile.thread_rank();
+
+            bool valid = i < bucket_size;
+
+            bool found_empty = false;
+            bool found_tombstone = false;
+            bool found_exact = false;
+
+            if (valid){
+
+               Key loaded_key = hash_table_load(&slots[i].key);
+
+               found_empty = (loaded_key == defaultKey);
+               found_tombstone = (loaded_key == tombstoneKey);
+               found_exact = (loaded_key == upsert_key);
+
+            }
+
+            empty_match |= (my_tile.ballot(found_empty) << offset);
+            tombstone_match |= (my_tile.ballot(found_tombstone) << offset);
+            key_match |= (my_tile.ballot(found_exact) << offset);
+
+         }
+
+         return;
+
+      }
+
+
+      //claim one of the open slots by swapping in holdingKey.
+      //returns the slot index, or -1 if every candidate was taken by another writer.
+      __device__ int claim_slot_ballots(const cg::thread_block_tile<partition_size> & my_tile, uint empty_match, uint tombstone_match){
+
+         int claimed = -1;
+
+         if (my_tile.thread_rank() == 0){
+
+            uint candidates = empty_match | tombstone_match;
+
+            while (candidates){
+
+               int slot = __ffs(candidates)-1;
+
+               candidates ^= SET_BIT_MASK(slot);
+
+               Key expected = (empty_match & SET_BIT_MASK(slot)) ? defaultKey : tombstoneKey;
+
+               ADD_PROBE
+               if (typed_atomic_write(&slots[slot].key, expected, holdingKey)){
+                  claimed = slot;
+                  break;
+               }
+
+            }
+
+         }
+
+         return my_tile.shfl(claimed, 0);
+
+      }
+
+
+      __device__ bool query(const cg::thread_block_tile<partition_size> & my_tile, Key ext_key, Val & return_val){
+
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            bool valid = i < bucket_size;
+
+            bool found_ballot = false;
+
+            Val loaded_val;
+
+            if (valid){
+
+               pair_type loaded_pair = load_packed_pair(i);
+
+               found_ballot = (loaded_pair.key == ext_key);
+
+               if (found_ballot){
+
+                  loaded_val = loaded_pair.val;
+               }
+            }
+
+
+            int found = __ffs(my_tile.ballot(found_ballot))-1;
+
+            if (found == -1) continue;
+
+            return_val = my_tile.shfl(loaded_val, found);
+
+            return true;
+
+         }
+
+
+         return false;
+
+      }
+
+      __device__ pair_type * query_pair_ballot(const cg::thread_block_tile<partition_size> & my_tile, __restrict__ uint & match_ballot){
+
+            int found = __ffs(match_ballot)-1;
+
+            if (found == -1) return nullptr;
+
+            return &slots[found];
+
+      }
+
+
+   };
+
+
+   template <typename table>
+   __global__ void init_hopscotch_table_kernel(table * hash_table){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      hash_table->init_bucket_and_locks(tid);
+
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
+   struct hopscotch_table {
+
+
+      using my_type = hopscotch_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
+
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using bucket_type = hopscotch_bucket<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+      static const Key holdingKey = bucket_type::holdingKey;
+
+      bucket_type * buckets;
+
+      //bit i of hop_maps[b] is set if bucket b+i holds a key whose home is b.
+      //only the holder of b's lock modifies hop_maps[b].
+      uint32_t * hop_maps;
+
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
+
+      uint64_t n_buckets;
+      uint64_t seed;
+
+
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets = ext_n_buckets;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(ext_n_buckets);
+
+         host_version->hop_maps = gallatin::utils::get_device_version<uint32_t>(ext_n_buckets);
+
+         host_version->locks = lock_layout::generate_locks(ext_n_buckets);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(ext_n_buckets);
+
+         host_version->seed = ext_seed;
+
+         my_type * device_version = gallatin::utils::move_to_device<my_type>(host_version);
+
+         init_hopscotch_table_kernel<my_type><<<(ext_n_buckets-1)/256+1,256>>>(device_version);
+
+         cudaDeviceSynchronize();
+
+         return device_version;
+
+      }
+
+      __device__ void init_bucket_and_locks(uint64_t tid){
+
+         if (tid < n_buckets){
+            buckets[tid].init();
+            hop_maps[tid] = 0;
+            unlock_bucket_one_thread(tid);
+         }
+
+      }
+
+
+      __device__ void lock_key(tile_type my_tile, Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         uint64_t home = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, home);
+
+      }
+
+      __device__ void unlock_key(tile_type my_tile, Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         uint64_t home = get_first_bucket(key_hash);
+
+         unlock(my_tile, home);
+
+      }
+
+      __device__ uint64_t get_lock_bucket(tile_type my_tile, Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+
+      __device__ void stall_lock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+
+            stall_lock_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+      __device__ void stall_lock_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+
+      }
+
+      //single attempt - used by displacement, which already holds the inserting key's lock
+      //and must not block on a second one.
+      __device__ bool try_lock_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return true;
+         #endif
+
+         ADD_PROBE
+
+         LOCK_SPIN_INIT
+
+         if (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_ABANDON(bucket)
+            return false;
+         }
+
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+         return true;
+
+      }
+
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+            unlock_bucket_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+
+      __device__ void unlock_bucket_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(locks, bucket);
+         ADD_PROBE
+
+      }
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const uint64_t * data = (const uint64_t *)key;
+         const uint64_t * end = data + (len/8);
+
+         while(data != end)
+         {
+            uint64_t k = *data++;
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = (const unsigned char*)data;
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      __device__ uint64_t get_first_bucket(uint64_t hash){
+
+         return (hash & BITMASK(32)) % n_buckets;
+
+      }
+
+      __device__ uint64_t get_home(Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+      //number of buckets from home forward to bucket, wrapping at the end of the table.
+      __device__ uint64_t get_distance(uint64_t home, uint64_t bucket){
+
+         return (bucket + n_buckets - home) % n_buckets;
+
+      }
+
+      __host__ uint64_t get_num_locks(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t nblocks = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return nblocks;
+
+      }
+
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         cudaFree(host_version->buckets);
+         cudaFree(host_version->hop_maps);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
+
+         cudaFreeHost(host_version);
+
+         return;
+
+      }
+
+
+      __device__ bucket_type * get_bucket_ptr(uint64_t bucket_addr){
+
+         return &buckets[bucket_addr];
+
+      }
+
+
+      __device__ uint32_t load_hop_map(const tile_type & my_tile, uint64_t home){
+
+         ADD_PROBE_TILE
+
+         return hash_table_load(&hop_maps[home]);
+
+      }
+
+      __device__ void set_hop_bit_one_thread(uint64_t home, uint64_t distance){
+
+         atomicOr((unsigned int *)&hop_maps[home], (unsigned int) SET_BIT_MASK(distance));
+
+      }
+
+      __device__ void clear_hop_bit_one_thread(uint64_t home, uint64_t distance){
+
+         atomicAnd((unsigned int *)&hop_maps[home], (unsigned int) ~SET_BIT_MASK(distance));
+
+      }
+
+
+      //does bucket still hold any key whose home is home?
+      //used to retire a hop map bit after a delete or displacement empties the last one.
+      __device__ bool bucket_has_home(const tile_type & my_tile, uint64_t bucket, uint64_t home){
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         for (uint i = my_tile.thread_rank(); i < bucket_type::n_traversals; i+=my_tile.size()){
+
+            bool found = false;
+
+            if (i < bucket_size){
+
+               Key loaded_key = hash_table_load(&bucket_ptr->slots[i].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey && loaded_key != holdingKey){
+
+                  found = (get_home(loaded_key) == home);
+
+               }
+
+            }
+
+            if (my_tile.ballot(found)) return true;
+
+         }
+
+         return false;
+
+      }
+
+
+      //ballot of live keys in bucket that could legally move to target_bucket,
+      //i.e. their home is within HOPSCOTCH_NEIGHBORHOOD buckets behind the target.
+      __device__ uint load_movable_ballot(const tile_type & my_tile, uint64_t bucket, uint64_t target_bucket){
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         uint movable = 0U;
+
+         for (uint i = my_tile.thread_rank(); i < bucket_type::n_traversals; i+=my_tile.size()){
+
+            uint offset = i - my_tile.thread_rank();
+
+            bool found = false;
+
+            if (i < bucket_size){
+
+               Key loaded_key = hash_table_load(&bucket_ptr->slots[i].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey && loaded_key != holdingKey){
+
+                  found = (get_distance(get_home(loaded_key), target_bucket) < HOPSCOTCH_NEIGHBORHOOD);
+
+               }
+
+            }
+
+            movable |= (my_tile.ballot(found) << offset);
+
+         }
+
+         return movable;
+
+      }
+
+
+      //claim the first open slot in [home, home+HOPSCOTCH_MAX_PROBES).
+      __device__ packed_pair_type * claim_free_slot(const tile_type & my_tile, uint64_t home, uint64_t & free_distance){
+
+
+         for (uint64_t i = 0; i < HOPSCOTCH_MAX_PROBES && i < n_buckets; i++){
+
+            uint64_t bucket_index = (home + i) % n_buckets;
+            bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+            uint bucket_empty;
+            uint bucket_tombstone;
+            uint bucket_match;
+
+            #if MEASURE_INSERTS
+            ADD_PROBE_ADJUSTED
+            #endif
+
+            bucket_ptr->load_fill_ballots(my_tile, defaultKey, bucket_empty, bucket_tombstone, bucket_match);
+
+            while (__popc(bucket_empty | bucket_tombstone) != 0){
+
+               int slot = bucket_ptr->claim_slot_ballots(my_tile, bucket_empty, bucket_tombstone);
+
+               if (slot != -1){
+                  free_distance = i;
+                  return &bucket_ptr->slots[slot];
+               }
+
+               #if MEASURE_INSERTS
+               ADD_PROBE_ADJUSTED
+               #endif
+               bucket_ptr->load_fill_ballots(my_tile, defaultKey, bucket_empty, bucket_tombstone, bucket_match);
+
+            }
+
+         }
+
+         return nullptr;
+
+      }
+
+
+      //move the pair in old_slot into the claimed free_slot, leaving old_slot claimed by this tile.
+      //the moved key's home must be locked for the move - a try lock is used as the tile
+      //already holds the lock for its own key.
+      __device__ bool move_slot_one_thread(uint64_t home, packed_pair_type * old_slot, packed_pair_type * free_slot, uint64_t free_bucket, uint64_t & moved_home){
+
+         packed_pair_type loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(old_slot);
+
+         if (loaded_pair.key == defaultKey || loaded_pair.key == tombstoneKey || loaded_pair.key == holdingKey) return false;
+
+         moved_home = get_home(loaded_pair.key);
+
+         if (get_distance(moved_home, free_bucket) >= HOPSCOTCH_NEIGHBORHOOD) return false;
+
+         //with a striped lock layout moved_home can share home's lock - try_lock then fails
+         //and this candidate is skipped instead of self-deadlocking.
+         if (moved_home != home && !try_lock_one_thread(moved_home)) return false;
+
+         //slot may have changed before the lock was acquired.
+         ADD_PROBE
+         loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(old_slot);
+
+         if (loaded_pair.key == defaultKey || loaded_pair.key == tombstoneKey || loaded_pair.key == holdingKey || get_home(loaded_pair.key) != moved_home){
+
+            if (moved_home != home) unlock_bucket_one_thread(moved_home);
+            return false;
+
+         }
+
+         //publish at the new location before retiring the old one so lockless readers
+         //always have at least one copy to find.
+         ADD_PROBE
+         ht_store_packed_pair(free_slot, loaded_pair);
+         __threadfence();
+
+         set_hop_bit_one_thread(moved_home, get_distance(moved_home, free_bucket));
+         __threadfence();
+
+         ht_store(&old_slot->key, holdingKey);
+         __threadfence();
+
+         return true;
+
+      }
+
+
+      //hop the claimed free slot at least one bucket closer to home.
+      __device__ bool hop_free_slot(const tile_type & my_tile, uint64_t home, packed_pair_type * & free_slot, uint64_t & free_distance){
+
+         uint64_t free_bucket = (home + free_distance) % n_buckets;
+
+         //start furthest from the free bucket for the largest hop.
+         for (uint64_t offset = HOPSCOTCH_NEIGHBORHOOD-1; offset > 0; offset--){
+
+            uint64_t bucket_index = (free_bucket + n_buckets - offset) % n_buckets;
+
+            bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+            #if MEASURE_INSERTS
+            ADD_PROBE_ADJUSTED
+            #endif
+
+            uint movable = load_movable_ballot(my_tile, bucket_index, free_bucket);
+
+            while (movable){
+
+               int slot = __ffs(movable)-1;
+
+               movable ^= SET_BIT_MASK(slot);
+
+               bool moved = false;
+               uint64_t moved_home = 0;
+
+               if (my_tile.thread_rank() == 0){
+                  moved = move_slot_one_thread(home, &bucket_ptr->slots[slot], free_slot, free_bucket, moved_home);
+               }
+
+               if (!my_tile.ballot(moved)) continue;
+
+               moved_home = my_tile.shfl(moved_home, 0);
+
+               if (!bucket_has_home(my_tile, bucket_index, moved_home)){
+
+                  if (my_tile.thread_rank() == 0){
+                     clear_hop_bit_one_thread(moved_home, get_distance(moved_home, bucket_index));
+                  }
+
+               }
+
+               if (moved_home != home){
+                  unlock(my_tile, moved_home);
+               } else {
+                  my_tile.sync();
+               }
+
+               free_slot = &bucket_ptr->slots[slot];
+               free_distance = free_distance - offset;
+
+               return true;
+
+            }
+
+         }
+
+         return false;
+
+      }
+
+
+      __device__ bool upsert_replace_internal(const tile_type & my_tile, const Key & key, const Val & val, uint64_t home){
+
+
+         uint64_t free_distance;
+
+         packed_pair_type * free_slot = claim_free_slot(my_tile, home, free_distance);
+
+         if (free_slot == nullptr) return false;
+
+         while (free_distance >= HOPSCOTCH_NEIGHBORHOOD){
+
+            if (!hop_free_slot(my_tile, home, free_slot, free_distance)){
+
+               //no key could be displaced - hand the slot back.
+               if (my_tile.thread_rank() == 0){
+                  ht_store(&free_slot->key, tombstoneKey);
+                  __threadfence();
+               }
+
+               my_tile.sync();
+
+               return false;
+
+            }
+
+         }
+
+         if (my_tile.thread_rank() == 0){
+
+            ADD_PROBE
+            ht_store_packed_pair(free_slot, {key, val});
+            __threadfence();
+
+            set_hop_bit_one_thread(home, free_distance);
+            __threadfence();
+
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+
+      //find the pair for key by walking the marked buckets of the home neighborhood.
+      //one pass - the caller holds home's lock or validates against home's version.
+      __device__ packed_pair_type * query_packed_reference(const tile_type & my_tile, Key key, uint64_t home, uint64_t & found_distance){
+
+         uint32_t remaining = load_hop_map(my_tile, home);
+
+         while (remaining){
+
+            int distance = __ffs(remaining)-1;
+
+            remaining ^= SET_BIT_MASK(distance);
+
+            bucket_type * bucket_ptr = get_bucket_ptr((home + distance) % n_buckets);
+
+            uint bucket_empty;
+            uint bucket_tombstone;
+            uint bucket_match;
+
+            #if MEASURE_QUERIES
+            ADD_PROBE_ADJUSTED
+            #endif
+
+            bucket_ptr->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+
+            packed_pair_type * val_loc = bucket_ptr->query_pair_ballot(my_tile, bucket_match);
+
+            if (val_loc != nullptr){
+               found_distance = distance;
+               return val_loc;
+            }
+
+         }
+
+         return nullptr;
+
+      }
+
+      //same contract as query_packed_reference.
+      __device__ bool query_internal(const tile_type & my_tile, Key key, Val & val, uint64_t home){
+
+         uint32_t remaining = load_hop_map(my_tile, home);
+
+         while (remaining){
+
+            int distance = __ffs(remaining)-1;
+
+            remaining ^= SET_BIT_MASK(distance);
+
+            bucket_type * bucket_ptr = get_bucket_ptr((home + distance) % n_buckets);
+
+            #if MEASURE_QUERIES
+            ADD_PROBE_ADJUSTED
+            #endif
+
+            if (bucket_ptr->query(my_tile, key, val)) return true;
+
+         }
+
+         return false;
+
+      }
+
+
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
+
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         stall_lock(my_tile, home);
+
+         packed_pair_type * existing_loc = query_packed_reference(my_tile, key, home, found_distance);
+
+         if (existing_loc != nullptr){
+
+
+            if (my_tile.thread_rank() == 0){
+
+               replace_func(existing_loc, key, val);
+              __threadfence();
+
+            }
+
+            //this syncs.
+            unlock(my_tile, home);
+
+            return true;
+         }
+
+         bool return_val = upsert_replace_internal(my_tile, key, val, home);
+
+         unlock(my_tile, home);
+
+         return return_val;
+
+      }
+
+      template <typename replace_func_type>
+      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
+
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         packed_pair_type * existing_loc = query_packed_reference(my_tile, key, home, found_distance);
+
+         if (existing_loc != nullptr){
+
+
+            if (my_tile.thread_rank() == 0){
+
+               replace_func(existing_loc, key, val);
+              __threadfence();
+
+            }
+
+            my_tile.sync();
+
+            return true;
+         }
+
+         return upsert_replace_internal(my_tile, key, val, home);
+
+      }
+
+
+      __device__ bool upsert_replace(const tile_type & my_tile, const Key & key, const Val & val){
+
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         stall_lock(my_tile, home);
+
+         packed_pair_type * existing_loc = query_packed_reference(my_tile, key, home, found_distance);
+
+         if (existing_loc != nullptr){
+
+
+            if (my_tile.thread_rank() == 0){
+
+               ht_store(&existing_loc->val, val);
+              __threadfence();
+
+            }
+
+            //this syncs.
+            unlock(my_tile, home);
+
+            return true;
+         }
+
+         bool return_val = upsert_replace_internal(my_tile, key, val, home);
+
+         unlock(my_tile, home);
+
+         return return_val;
+
+      }
+
+      __device__ bool upsert_no_lock(const tile_type & my_tile, const Key & key, const Val & val){
+
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         packed_pair_type * existing_loc = query_packed_reference(my_tile, key, home, found_distance);
+
+         if (existing_loc != nullptr){
+
+
+            if (my_tile.thread_rank() == 0){
+
+               ht_store(&existing_loc->val, val);
+              __threadfence();
+
+            }
+
+            my_tile.sync();
+
+            return true;
+         }
+
+         return upsert_replace_internal(my_tile, key, val, home);
+
+      }
+
+
+      [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's home bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, home, [&](){
+            return query_internal(my_tile, key, val, home);
+         });
+
+         #else
+
+         stall_lock_shared(my_tile, home);
+
+         bool found = query_internal(my_tile, key, val, home);
+
+         unlock_shared(my_tile, home);
+
+         return found;
+
+         #endif
+
+      }
+
+      //caller holds home's lock.
+      [[nodiscard]] __device__ bool find_with_reference_no_lock(tile_type my_tile, Key key, Val & val){
+
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         packed_pair_type * pair_location = query_packed_reference(my_tile, key, home, found_distance);
+
+         if (pair_location == nullptr){
+            return false;
+         }
+
+         val = hash_table_load(&pair_location->val);
+         __threadfence();
+
+         return true;
+
+      }
+
+      //the pointer is only stable while home is locked - a later displacement may move the pair.
+      [[nodiscard]] __device__ packed_pair_type * find_pair(tile_type my_tile, Key key){
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         stall_lock_shared(my_tile, home);
+
+         packed_pair_type * pair_location = query_packed_reference(my_tile, key, home, found_distance);
+
+         unlock_shared(my_tile, home);
+
+         return pair_location;
+
+      }
+
+      //caller holds home's lock.
+      [[nodiscard]] __device__ packed_pair_type * find_pair_no_lock(tile_type my_tile, Key key){
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+         uint64_t found_distance;
+
+         return query_packed_reference(my_tile, key, home, found_distance);
+
+      }
+
+
+      //erase key and retire its hop bit if it was the last key from home in that bucket.
+      //caller holds the lock on home.
+      __device__ bool remove_internal(const tile_type & my_tile, Key key, uint64_t home){
+
+         uint64_t found_distance;
+
+         packed_pair_type * found_pair = query_packed_reference(my_tile, key, home, found_distance);
+
+         if (found_pair == nullptr){
+            return false;
+         }
+
+         bool ballot = false;
+
+         if (my_tile.thread_rank() == 0){
+
+            ADD_PROBE
+            ballot = typed_atomic_write(&found_pair->key, key, tombstoneKey);
+            if (ballot){
+
+               //force store
+               ht_store(&found_pair->val, tombstoneVal);
+            }
+
+         }
+
+         if (!my_tile.ballot(ballot)) return false;
+
+         uint64_t bucket_index = (home + found_distance) % n_buckets;
+
+         if (!bucket_has_home(my_tile, bucket_index, home)){
+
+            if (my_tile.thread_rank() == 0){
+               clear_hop_bit_one_thread(home, found_distance);
+               __threadfence();
+            }
+
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+      __device__ bool remove(tile_type my_tile, Key key){
+
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+
+         stall_lock(my_tile, home);
+
+         bool result = remove_internal(my_tile, key, home);
+
+         unlock(my_tile, home);
+
+         return result;
+
+      }
+
+      __device__ bool remove_no_lock(tile_type my_tile, Key key){
+
+         uint64_t home = get_lock_bucket(my_tile, key);
+
+         return remove_internal(my_tile, key, home);
+
+      }
+
+
+      static __device__ packed_pair_type pack_together(Key key, Val val){
+         return packed_pair_type{key, val};
+      }
+
+      __host__ float load(){
+
+         return 0;
+
+      }
+
+      static std::string get_name(){
+         return "hopscotch_hashing";
+      }
+
+      __host__ void print_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t capacity = host_version->n_buckets*(sizeof(bucket_type)+sizeof(uint32_t)) + lock_layout::get_space_usage(host_version->n_buckets);
+
+         cudaFreeHost(host_version);
+
+         printf("hopscotch_hashing using %llu bytes\n", capacity);
+
+      }
+
+      __host__ void print_fill(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+
+         uint64_t n_items = get_fill();
+
+         cudaDeviceSynchronize();
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_buckets*bucket_size, 100.0*n_items/(n_buckets*bucket_size));
+
+         cudaFreeHost(host_version);
+
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+
+         uint64_t * n_items;
+
+         cudaMallocManaged((void **)&n_items, sizeof(uint64_t));
+
+         n_items[0] = 0;
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+
+         hopscotch_get_fill_kernel<my_type, partition_size><<<(n_buckets*partition_size-1)/256+1,256>>>(this, n_buckets, n_items);
+
+         cudaDeviceSynchronize();
+
+         uint64_t return_items = n_items[0];
+
+         cudaFree(n_items);
+         cudaFreeHost(host_version);
+
+         return return_items;
+
+
+      }
+
+      __device__ uint64_t get_bucket_fill(tile_type my_tile, uint64_t bucket){
+
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+
+         uint32_t bucket_empty;
+         uint32_t bucket_tombstone;
+         uint32_t bucket_match;
+
+         //holding slots are counted as full - they are mid-insert.
+         bucket_ptr->load_fill_ballots(my_tile, defaultKey, bucket_empty, bucket_tombstone, bucket_match);
+
+         return bucket_size-__popc(bucket_empty) - __popc(bucket_tombstone);
+
+      }
+
+      //checkpoint (helpers/checkpoint.cuh): buckets, hop_maps. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::write_device_region(writer, host_version->hop_maps, sizeof(uint32_t)*host_version->n_buckets)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets);
+         host_version->hop_maps = gallatin::utils::get_device_version<uint32_t>(host_version->n_buckets);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::read_device_region(reader, host_version->hop_maps, sizeof(uint32_t)*host_version->n_buckets);
+
+         if (!loaded){
+
+            cudaFree(host_version->buckets);
+            cudaFree(host_version->hop_maps);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->locks = lock_layout::generate_locks(host_version->n_buckets);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_sweep_buckets = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return n_sweep_buckets;
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh. Keys are loaded first and the pair only for a live slot. Holding slots are mid-insert or mid-move and are skipped.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         for (uint i = my_tile.thread_rank(); i < bucket_type::n_traversals; i+=my_tile.size()){
+
+            bool live = false;
+
+            packed_pair_type loaded_pair {defaultKey, defaultVal};
+
+            if (i < bucket_size){
+
+               Key loaded_key = hash_table_load(&bucket_ptr->slots[i].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey && loaded_key != holdingKey){
+
+                  loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(&bucket_ptr->slots[i]);
+
+                  //slot may have turned over between the two loads.
+                  live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey && loaded_pair.key != holdingKey);
+
+               }
+
+            }
+
+            if (!my_tile.ballot(live)) continue;
+
+            func(live, loaded_pair.key, loaded_pair.val);
+
+         }
+
+      }
+
+
+   };
+
+template <typename T>
+constexpr T generate_hopscotch_tombstone(uint64_t offset) {
+  return (~((T) 0)) - offset;
+};
+
+template <typename T>
+constexpr T generate_hopscotch_sentinel() {
+  return ((T) 0);
+};
+
+
+// template <typename Key, Key sentinel, Key tombstone, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using hopscotch_generic = typename hashing_project::tables::hopscotch_table<Key,
+                                    generate_hopscotch_sentinel<Key>(),
+                                    generate_hopscotch_tombstone<Key>(0),
+                                    Val,
+                                    generate_hopscotch_sentinel<Val>(),
+                                    generate_hopscotch_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size>;
+
+
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using hopscotch_generic_with_locks = typename hashing_project::tables::hopscotch_table<Key,
+                                    generate_hopscotch_sentinel<Key>(),
+                                    generate_hopscotch_tombstone<Key>(0),
+                                    Val,
+                                    generate_hopscotch_sentinel<Val>(),
+                                    generate_hopscotch_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of hopscotch include guard
@@ -10,6 +10,10 @@
 #include <gallatin/allocators/alloc_utils.cuh>
 #include <hashing_project/helpers/probe_counts.cuh>
 #include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
 
 
 #include "assert.h"
@@ -425,7 +429,8 @@ namespace tables {
 
 
             //attempt to insert into the table based on an existing mapping.
-      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint upsert_mapping, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint upsert_mapping, replace_func_type replace_func){
 
 
          //first read size
@@ -622,7 +627,8 @@ namespace tables {
 
       }
 
-      __device__ bool load_fill_ballots_upserts_func(const cg::thread_block_tile<partition_size> & my_tile, const Key & upsert_key, const Val & upsert_val, __restrict__ uint & empty_match, __restrict__ uint & tombstone_match, __restrict__ uint & key_match, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool load_fill_ballots_upserts_func(const cg::thread_block_tile<partition_size> & my_tile, const Key & upsert_key, const Val & upsert_val, __restrict__ uint & empty_match, __restrict__ uint & tombstone_match, __restrict__ uint & key_match, replace_func_type replace_func){
 
 
          //wipe previous
@@ -931,11 +937,11 @@ namespace tables {
 
 
 
-   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
    struct iht_p2_table {
 
 
-      using my_type = iht_p2_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+      using my_type = iht_p2_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
 
 
       using tile_type = cg::thread_block_tile<partition_size>;
@@ -946,8 +952,11 @@ namespace tables {
 
       bucket_type * primary_buckets;
       bucket_type * alt_buckets;
-      uint64_t * primary_locks;
-      uint64_t * alt_locks;
+      typename lock_layout::lock_type * primary_locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
+      typename lock_layout::lock_type * alt_locks;
 
       uint64_t n_buckets_primary;
       uint64_t n_buckets_alt;
@@ -970,8 +979,10 @@ namespace tables {
          host_version->primary_buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets_primary);
          host_version->alt_buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets_alt);
 
-         host_version->primary_locks = gallatin::utils::get_device_version<uint64_t>( (host_version->n_buckets_primary-1)/64+1);
-         host_version->alt_locks = gallatin::utils::get_device_version<uint64_t>( (host_version->n_buckets_alt-1)/64+1);
+         host_version->primary_locks = lock_layout::generate_locks(host_version->n_buckets_primary);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets_primary);
+         host_version->alt_locks = lock_layout::generate_locks(host_version->n_buckets_alt);
 
          host_version->seed = ext_seed;
 
@@ -1030,14 +1041,16 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         LOCK_SPIN_INIT
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         do {
-            ADD_PROBE
+         while (!lock_layout::try_lock(primary_locks, bucket)){
+            ADD_LOCK_SPIN
          }
-         while (atomicOr((unsigned long long int *)&primary_locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
 
       }
 
@@ -1054,14 +1067,14 @@ namespace tables {
 
       __device__ void stall_lock_one_thread_alt(uint64_t bucket){
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         LOCK_SPIN_INIT
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         do {
-            ADD_PROBE
+         while (!lock_layout::try_lock(alt_locks, bucket)){
+            ADD_LOCK_SPIN
          }
-         while (atomicOr((unsigned long long int *)&alt_locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
 
 
       }
@@ -1076,6 +1089,47 @@ namespace tables {
 
       }
 
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(primary_locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(primary_locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
       __device__ void unlock(tile_type my_tile, uint64_t bucket){
 
          unlock_primary(my_tile, bucket);
@@ -1090,11 +1144,9 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         hashing_project::helpers::end_bucket_write(versions, bucket);
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         atomicAnd((unsigned long long int *)&primary_locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+         lock_layout::unlock(primary_locks, bucket);
          ADD_PROBE
 
       }
@@ -1112,11 +1164,7 @@ namespace tables {
 
       __device__ void unlock_bucket_one_thread_alt(uint64_t bucket){
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
-
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         atomicAnd((unsigned long long int *)&alt_locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+         lock_layout::unlock(alt_locks, bucket);
          ADD_PROBE
 
       }
@@ -1238,10 +1286,11 @@ namespace tables {
          my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
 
          cudaFree(host_version->primary_buckets);
-         cudaFree(host_version->primary_locks);
+         lock_layout::free_locks(host_version->primary_locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
 
          cudaFree(host_version->alt_buckets);
-         cudaFree(host_version->alt_locks);
+         lock_layout::free_locks(host_version->alt_locks);
 
          cudaFreeHost(host_version);
          
@@ -1279,7 +1328,8 @@ namespace tables {
 
        }
 
-      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -1295,7 +1345,8 @@ namespace tables {
 
        }
 
-      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -1327,7 +1378,8 @@ namespace tables {
 
       }
 
-      __device__ bool upsert_function_internal(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_primary, uint64_t key_hash, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_internal(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_primary, uint64_t key_hash, replace_func_type replace_func){
 
 
 
@@ -1680,6 +1732,15 @@ namespace tables {
       // //nope! no storage
       [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
 
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return find_with_reference_no_lock(my_tile, key, val);
+         });
+
+         #else
+
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -1715,6 +1776,8 @@ namespace tables {
 
          return false;
 
+         #endif
+
       }
 
       __device__ bool remove(tile_type my_tile, Key key){
@@ -2012,7 +2075,7 @@ namespace tables {
 
          my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
             
-         uint64_t capacity = host_version->n_buckets_primary*sizeof(bucket_type) + (host_version->n_buckets_primary-1)/8+1; 
+         uint64_t capacity = host_version->n_buckets_primary*sizeof(bucket_type) + lock_layout::get_space_usage(host_version->n_buckets_primary); 
 
          capacity += host_version->n_buckets_alt*sizeof(bucket_type);
 
@@ -2104,6 +2167,145 @@ namespace tables {
 
       }
 
+      //bulk build hooks for helpers/bulk_build.cuh. Each key is placed in the frontyard bucket.
+      __host__ uint64_t get_n_bulk_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_bulk_buckets = host_version->n_buckets_primary;
+
+         cudaFreeHost(host_version);
+
+         return n_bulk_buckets;
+
+      }
+
+      __device__ uint64_t get_bulk_bucket(const Key & key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+      static const uint64_t bulk_bucket_size = bucket_size;
+
+      //plain stores of n <= bucket_size pairs into an empty bucket - no lock, only valid while building.
+      __device__ void bulk_fill_bucket(const tile_type & my_tile, uint64_t bucket, const Key * keys, const Val * vals, uint64_t n){
+
+         bucket_type * bucket_ptr = get_bucket_ptr_primary(bucket);
+
+         for (uint64_t i = my_tile.thread_rank(); i < n; i+=my_tile.size()){
+            bucket_ptr->slots[i].key = keys[i];
+            bucket_ptr->slots[i].val = vals[i];
+         }
+
+      }
+
+      //checkpoint (helpers/checkpoint.cuh): primary_buckets, then the backyard alt_buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets_primary, host_version->n_buckets_alt))
+            && hashing_project::helpers::write_device_region(writer, host_version->primary_buckets, sizeof(bucket_type)*host_version->n_buckets_primary)
+            && hashing_project::helpers::write_device_region(writer, host_version->alt_buckets, sizeof(bucket_type)*host_version->n_buckets_alt)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets_primary = reader.header.n_buckets_primary;
+         host_version->n_buckets_alt = reader.header.n_buckets_alt;
+         host_version->seed = reader.header.seed;
+
+         host_version->primary_buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets_primary);
+         host_version->alt_buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets_alt);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->primary_buckets, sizeof(bucket_type)*host_version->n_buckets_primary)
+            && hashing_project::helpers::read_device_region(reader, host_version->alt_buckets, sizeof(bucket_type)*host_version->n_buckets_alt);
+
+         if (!loaded){
+
+            cudaFree(host_version->primary_buckets);
+            cudaFree(host_version->alt_buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->primary_locks = lock_layout::generate_locks(host_version->n_buckets_primary);
+         host_version->alt_locks = lock_layout::generate_locks(host_version->n_buckets_alt);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets_primary);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_sweep_buckets = host_version->n_buckets_primary + host_version->n_buckets_alt;
+
+         cudaFreeHost(host_version);
+
+         return n_sweep_buckets;
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh. Frontyard buckets come first, then the backyard.
+      //Keys are loaded first and the pair only for a live slot.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         bucket_type * bucket_ptr = (bucket < n_buckets_primary) ? get_bucket_ptr_primary(bucket) : get_bucket_ptr_alt(bucket - n_buckets_primary);
+
+         for (uint i = my_tile.thread_rank(); i < bucket_type::n_traversals; i+=my_tile.size()){
+
+            bool live = false;
+
+            packed_pair_type loaded_pair {defaultKey, defaultVal};
+
+            if (i < bucket_size){
+
+               Key loaded_key = hash_table_load(&bucket_ptr->slots[i].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey && loaded_key != bucket_type::holdingKey){
+
+                  loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(&bucket_ptr->slots[i]);
+
+                  //slot may have turned over between the two loads.
+                  live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey && loaded_pair.key != bucket_type::holdingKey);
+
+               }
+
+            }
+
+            if (!my_tile.ballot(live)) continue;
+
+            func(live, loaded_pair.key, loaded_pair.val);
+
+         }
+
+      }
+
 
    };
 
@@ -2131,6 +2333,19 @@ using iht_p2_generic = typename hashing_project::tables::iht_p2_table<Key,
                                     bucket_size>;
 
 
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using iht_p2_generic_with_locks = typename hashing_project::tables::iht_p2_table<Key,
+                                    generate_iht_p2_sentinel<Key>(),
+                                    generate_iht_p2_tombstone<Key>(0),
+                                    Val,
+                                    generate_iht_p2_sentinel<Val>(),
+                                    generate_iht_p2_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
 
 
 } //namespace wrappers
@@ -0,0 +1,1311 @@
+#ifndef OUR_IHT_P2_METADATA_QUOTIENT
+#define OUR_IHT_P2_METADATA_QUOTIENT
+
+#include <cooperative_groups.h>
+#include <cooperative_groups/reduce.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+#include <hashing_project/helpers/probe_counts.cuh>
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
+
+//backyard buckets, metadata and fill kernel are shared with the full-key iceberg table.
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+
+//Quotiented iceberg table.
+//
+//Keys are run through an invertible permutation h = fmix64(key ^ seed). The frontyard bucket is
+//h % n_buckets_primary and the quotient q = h / n_buckets_primary is split in two:
+// - the low 16 bits are the metadata tag, so tag matches are exact on those bits.
+// - the next 32 bits are stored in the frontyard slot as the remainder.
+//(bucket, tag, remainder) recovers h and so the key, and a frontyard slot is 2+4 bytes of key
+//instead of 2+8 - the full table's 18 byte slot drops to 14. The backyard keeps full keys.
+//
+//q only fits in 48 bits if n_buckets_primary >= 2^16, so smaller tables are rounded up.
+//Quotients whose tag collides with the empty/tombstone/holding tags go straight to the backyard.
+//Only 64 bit keys are supported.
+
+#define QUOTIENT_MIN_FRONT_BUCKETS (1ULL << 16)
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename table>
+   __global__ void init_quotient_iht_p2_table_kernel(table * hash_table){
+
+      uint64_t tid = gallatin::utils::get_tid();
+
+      hash_table->init_bucket_and_locks(tid);
+
+   }
+
+
+   //frontyard metadata - tags are quotient bits rather than key bits.
+   template <uint partition_size, uint bucket_size>
+   struct iht_quotient_metadata_bucket {
+
+      static_assert(bucket_size % 8 == 0 && bucket_size <= 32, "quotient frontyard buckets are loaded 8 tags at a time into 32 bit ballots");
+
+      static const uint16_t empty_tag = 0;
+      static const uint16_t tombstone_tag = 0xFFFF;
+      //slot claimed, remainder and value not yet published.
+      static const uint16_t holding_tag = 0xFFFE;
+
+      static const uint64_t n_traversals = ((bucket_size-1)/partition_size+1)*partition_size;
+
+      uint16_t metadata[bucket_size];
+
+
+      __device__ void init(){
+
+         for (uint64_t i = 0; i < bucket_size; i++){
+            metadata[i] = empty_tag;
+         }
+
+         __threadfence();
+
+      }
+
+      static __device__ bool is_storable(uint16_t tag){
+         return tag != empty_tag && tag != tombstone_tag && tag != holding_tag;
+      }
+
+
+      __device__ void load_fill_ballots(const cg::thread_block_tile<partition_size> & my_tile, uint16_t tag, uint32_t & empty_match, uint32_t & tombstone_match, uint32_t & key_match){
+
+         ADD_PROBE_TILE
+
+         empty_match = 0U;
+         tombstone_match = 0U;
+         key_match = 0U;
+
+         //every thread takes part in the reduce, even past the end of the bucket.
+         for (uint base = 0; base < bucket_size/8; base+=my_tile.size()){
+
+            uint i = base + my_tile.thread_rank();
+
+            uint32_t local_empty = 0U;
+            uint32_t local_tombstone = 0U;
+            uint32_t local_match = 0U;
+
+            if (i < bucket_size/8){
+
+               packed_tags loaded_tags = iht_full_load_multi_tags(&metadata[i*8]);
+
+               uint16_t * load_tag_indexer = (uint16_t *) &loaded_tags;
+
+               for (uint j = 0; j < 8; j++){
+
+                  uint16_t loaded_tag = load_tag_indexer[j];
+
+                  uint32_t set_index = SET_BIT_MASK(i*8+j);
+
+                  local_empty |= (loaded_tag == empty_tag)*set_index;
+                  local_tombstone |= (loaded_tag == tombstone_tag)*set_index;
+                  local_match |= (loaded_tag == tag)*set_index;
+
+               }
+
+            }
+
+            empty_match |= cg::reduce(my_tile, local_empty, cg::bit_or<uint32_t>());
+            tombstone_match |= cg::reduce(my_tile, local_tombstone, cg::bit_or<uint32_t>());
+            key_match |= cg::reduce(my_tile, local_match, cg::bit_or<uint32_t>());
+
+         }
+
+      }
+
+
+      //move one slot in match from expected_tag to holding_tag, returns the slot or -1.
+      __device__ int claim(const cg::thread_block_tile<partition_size> & my_tile, uint32_t match, uint16_t expected_tag){
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            bool open = (i < bucket_size) && (match & SET_BIT_MASK(i));
+
+            auto ballot_result = my_tile.ballot(open);
+
+            while (ballot_result){
+
+               bool ballot = false;
+
+               const auto leader = __ffs(ballot_result)-1;
+
+               if (leader == my_tile.thread_rank()){
+
+                  ADD_PROBE
+
+                  ballot = gallatin::utils::typed_atomic_write(&metadata[i], expected_tag, holding_tag);
+
+               }
+
+               if (my_tile.ballot(ballot)){ return my_tile.shfl(i, leader); }
+
+               ballot_result ^= 1UL << leader;
+
+            }
+
+         }
+
+         return -1;
+
+      }
+
+      __device__ void publish(int index, uint16_t tag){
+
+         ADD_PROBE
+         ht_store(&metadata[index], tag);
+         __threadfence();
+
+      }
+
+      __device__ void set_tombstone(int index){
+
+         ADD_PROBE
+         ht_store(&metadata[index], tombstone_tag);
+         __threadfence();
+
+      }
+
+   };
+
+
+   //remainders and values are kept in separate arrays so the remainders stay dense.
+   template <typename Val, uint partition_size, uint bucket_size>
+   struct iht_quotient_frontyard_bucket {
+
+      static const uint64_t n_traversals = ((bucket_size-1)/partition_size+1)*partition_size;
+
+      uint32_t remainders[bucket_size];
+      Val vals[bucket_size];
+
+
+      __device__ void init(){
+
+         for (uint i = 0; i < bucket_size; i++){
+            remainders[i] = 0;
+            vals[i] = Val{};
+         }
+
+         __threadfence();
+
+      }
+
+
+      //slot in match whose remainder equals rem, or -1.
+      __device__ int match_remainder(const cg::thread_block_tile<partition_size> & my_tile, uint32_t rem, uint32_t match){
+
+         if (match == 0) return -1;
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            bool found = false;
+
+            if (i < bucket_size && (match & SET_BIT_MASK(i))){
+
+               ADD_PROBE
+
+               found = (hash_table_load(&remainders[i]) == rem);
+
+            }
+
+            auto found_ballot = my_tile.ballot(found);
+
+            if (found_ballot){
+               return i - my_tile.thread_rank() + __ffs(found_ballot)-1;
+            }
+
+         }
+
+         return -1;
+
+      }
+
+      __device__ void store(int index, uint32_t rem, Val val){
+
+         ADD_PROBE
+         ht_store(&remainders[index], rem);
+         ht_store(&vals[index], val);
+
+      }
+
+   };
+
+
+   //what find_pair_no_lock and upsert_function hand out - frontyard slots have no pair to point at,
+   //so both yards expose just the value, in the ->val shape helpers/conditional_ops.cuh expects.
+   template <typename Val>
+   struct quotient_val_slot {
+      Val val;
+   };
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
+   struct quotient_md_iht_p2_table {
+
+
+      static_assert(sizeof(Key) == 8, "quotienting needs 64 bit keys for the invertible permutation");
+
+
+      using my_type = quotient_md_iht_p2_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using md_bucket_type = iht_quotient_metadata_bucket<partition_size, bucket_size>;
+
+      using frontyard_bucket_type = iht_quotient_frontyard_bucket<Val, partition_size, bucket_size>;
+
+      using backyard_md_bucket_type = iht_full_metadata_bucket<Key, defaultKey, tombstoneKey, Val, tombstoneVal, partition_size, bucket_size>;
+
+      using backyard_bucket_type = iht_full_md_frontyard_bucket<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+      using val_slot_type = quotient_val_slot<Val>;
+
+
+      md_bucket_type * metadata;
+      frontyard_bucket_type * primary_buckets;
+
+      backyard_md_bucket_type * backing_metadata;
+      backyard_bucket_type * alt_buckets;
+      typename lock_layout::lock_type * primary_locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
+
+      uint64_t n_buckets_primary;
+      uint64_t n_buckets_alt;
+      uint64_t seed;
+
+
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets_primary = ext_n_buckets*METADATA_FULL_FRONT_TOTAL_RATIO;
+
+         if (host_version->n_buckets_primary < QUOTIENT_MIN_FRONT_BUCKETS) host_version->n_buckets_primary = QUOTIENT_MIN_FRONT_BUCKETS;
+
+         host_version->n_buckets_alt = ext_n_buckets*(1.0-METADATA_FULL_FRONT_TOTAL_RATIO)+1;
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(host_version->n_buckets_primary);
+         host_version->primary_buckets = gallatin::utils::get_device_version<frontyard_bucket_type>(host_version->n_buckets_primary);
+         host_version->backing_metadata = gallatin::utils::get_device_version<backyard_md_bucket_type>(host_version->n_buckets_alt);
+         host_version->alt_buckets = gallatin::utils::get_device_version<backyard_bucket_type>(host_version->n_buckets_alt);
+
+         host_version->primary_locks = lock_layout::generate_locks(host_version->n_buckets_primary);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets_primary);
+
+         host_version->seed = ext_seed;
+
+         uint64_t n_buckets = host_version->n_buckets_primary+host_version->n_buckets_alt;
+
+         my_type * device_version = gallatin::utils::move_to_device<my_type>(host_version);
+
+         init_quotient_iht_p2_table_kernel<my_type><<<(n_buckets-1)/256+1,256>>>(device_version);
+
+         cudaDeviceSynchronize();
+
+         return device_version;
+
+      }
+
+      __device__ void init_bucket_and_locks(uint64_t tid){
+
+         if (tid < n_buckets_primary){
+
+            metadata[tid].init();
+            primary_buckets[tid].init();
+            unlock_bucket_one_thread(tid);
+
+         }
+
+         if (tid < n_buckets_alt){
+
+            backing_metadata[tid].init();
+            alt_buckets[tid].init();
+
+         }
+
+      }
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         cudaFree(host_version->metadata);
+         cudaFree(host_version->primary_buckets);
+         cudaFree(host_version->backing_metadata);
+         cudaFree(host_version->alt_buckets);
+         lock_layout::free_locks(host_version->primary_locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
+
+         cudaFreeHost(host_version);
+
+      }
+
+
+      //every write locks the key's frontyard bucket, as in the full table.
+      __device__ void stall_lock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+            stall_lock_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+      __device__ void stall_lock_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(primary_locks, bucket)){
+            ADD_LOCK_SPIN
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+      }
+
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(primary_locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(primary_locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+            unlock_bucket_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+      __device__ void unlock_bucket_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(primary_locks, bucket);
+         ADD_PROBE
+
+      }
+
+      __device__ uint64_t get_lock_bucket(tile_type my_tile, Key key){
+
+         return get_first_bucket(permute_key(key));
+
+      }
+
+      __host__ uint64_t get_num_locks(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t nblocks = host_version->n_buckets_primary;
+
+         cudaFreeHost(host_version);
+
+         return nblocks;
+
+      }
+
+
+      //fmix64 of key ^ seed - a bijection on 64 bit words.
+      __device__ uint64_t permute_key(Key key){
+
+         uint64_t h = ((uint64_t) key) ^ seed;
+
+         h ^= h >> 33;
+         h *= 0xff51afd7ed558ccdULL;
+         h ^= h >> 33;
+         h *= 0xc4ceb9fe1a85ec53ULL;
+         h ^= h >> 33;
+
+         return h;
+
+      }
+
+      //inverse of permute_key - x ^= x >> 33 is its own inverse, multipliers are the inverses mod 2^64.
+      __device__ Key unpermute_key(uint64_t h){
+
+         h ^= h >> 33;
+         h *= 0x9cb4b2f8129337dbULL;
+         h ^= h >> 33;
+         h *= 0x4f74430c22a54005ULL;
+         h ^= h >> 33;
+
+         return (Key) (h ^ seed);
+
+      }
+
+      __device__ uint64_t get_first_bucket(uint64_t key_hash){
+         return key_hash % n_buckets_primary;
+      }
+
+      __device__ uint64_t get_quotient(uint64_t key_hash){
+         return key_hash / n_buckets_primary;
+      }
+
+      __device__ uint16_t get_quotient_tag(uint64_t quotient){
+         return (uint16_t) quotient;
+      }
+
+      __device__ uint32_t get_quotient_remainder(uint64_t quotient){
+         return (uint32_t) (quotient >> 16);
+      }
+
+      //key stored in frontyard slot (bucket, tag, remainder).
+      __device__ Key recover_key(uint64_t bucket, uint16_t tag, uint32_t remainder){
+
+         uint64_t quotient = (((uint64_t) remainder) << 16) | tag;
+
+         return unpermute_key(quotient*n_buckets_primary + bucket);
+
+      }
+
+      __device__ uint64_t get_second_bucket(uint64_t key_hash){
+         return (key_hash >> 32) % n_buckets_alt;
+      }
+
+      __device__ uint64_t get_third_bucket(const Key & key){
+         return hash(&key, sizeof(Key), seed+2) % n_buckets_alt;
+      }
+
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const uint64_t * data = (const uint64_t *)key;
+         const uint64_t * end = data + (len/8);
+
+         while(data != end)
+         {
+            uint64_t k = *data++;
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = (const unsigned char*)data;
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      //claim a slot in match, write remainder + value, then publish the tag.
+      __device__ bool insert_frontyard(const tile_type & my_tile, md_bucket_type * md_primary, frontyard_bucket_type * bucket_primary_ptr, uint32_t match, uint16_t expected_tag, uint16_t tag, uint32_t remainder, const Val & val){
+
+         int claimed = md_primary->claim(my_tile, match, expected_tag);
+
+         if (claimed == -1) return false;
+
+         if (my_tile.thread_rank() == (claimed % partition_size)){
+
+            bucket_primary_ptr->store(claimed, remainder, val);
+            __threadfence();
+            md_primary->publish(claimed, tag);
+
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+      //backyard insert with the full table's metadata protocol.
+      __device__ bool insert_backyard_slot(const tile_type & my_tile, backyard_bucket_type * bucket_ptr, int slot, const Key & key, const Val & val){
+
+         if (slot == -1) return false;
+
+         if (my_tile.thread_rank() == (slot % partition_size)){
+
+            ADD_PROBE
+            ht_store_packed_pair(&bucket_ptr->slots[slot], {key,val});
+            __threadfence();
+
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+
+      __device__ bool upsert_replace(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_primary);
+
+         bool return_val = upsert_replace_internal(my_tile, key, val, bucket_primary, key_hash);
+
+         unlock(my_tile, bucket_primary);
+
+         return return_val;
+
+      }
+
+      __device__ bool upsert_no_lock(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t key_hash = permute_key(key);
+
+         return upsert_replace_internal(my_tile, key, val, get_first_bucket(key_hash), key_hash);
+
+      }
+
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_primary);
+
+         bool return_val = upsert_function_internal(my_tile, key, val, bucket_primary, key_hash, replace_func);
+
+         unlock(my_tile, bucket_primary);
+
+         return return_val;
+
+      }
+
+      template <typename replace_func_type>
+      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
+
+         uint64_t key_hash = permute_key(key);
+
+         return upsert_function_internal(my_tile, key, val, get_first_bucket(key_hash), key_hash, replace_func);
+
+      }
+
+      __device__ bool upsert_replace_internal(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_primary, uint64_t key_hash){
+
+         return upsert_function_internal(my_tile, key, val, bucket_primary, key_hash, [](val_slot_type * slot, Key, Val ext_val){
+            ht_store(&slot->val, ext_val);
+            __threadfence();
+         });
+
+      }
+
+      //replace_func(val_slot_type *, key, val) runs on one lane if the key exists, otherwise (key, val) is inserted.
+      template <typename replace_func_type>
+      __device__ bool upsert_function_internal(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_primary, uint64_t key_hash, replace_func_type replace_func){
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = get_quotient_tag(quotient);
+         uint32_t remainder = get_quotient_remainder(quotient);
+
+         md_bucket_type * md_primary = &metadata[bucket_primary];
+         frontyard_bucket_type * bucket_primary_ptr = &primary_buckets[bucket_primary];
+
+         if (md_bucket_type::is_storable(tag)){
+
+            uint32_t primary_empty;
+            uint32_t primary_tombstone;
+            uint32_t primary_match;
+
+            md_primary->load_fill_ballots(my_tile, tag, primary_empty, primary_tombstone, primary_match);
+
+            int existing = bucket_primary_ptr->match_remainder(my_tile, remainder, primary_match);
+
+            if (existing != -1){
+
+               if (my_tile.thread_rank() == (existing % partition_size)){
+                  replace_func((val_slot_type *) &bucket_primary_ptr->vals[existing], key, val);
+               }
+
+               my_tile.sync();
+               return true;
+
+            }
+
+            //same shortcut as full_md_iht_p2_table - only while the bucket has an empty slot. A key spills to the
+            //backyard only once its frontyard bucket has none, and removes leave tombstones, so until then
+            //the key cannot be in the backyard.
+            if (primary_empty != 0){
+
+               if (insert_frontyard(my_tile, md_primary, bucket_primary_ptr, primary_tombstone, md_bucket_type::tombstone_tag, tag, remainder, val)) return true;
+
+               if (insert_frontyard(my_tile, md_primary, bucket_primary_ptr, primary_empty, md_bucket_type::empty_tag, tag, remainder, val)) return true;
+
+            }
+
+         }
+
+
+         uint64_t bucket_0 = get_second_bucket(key_hash);
+         uint64_t bucket_1 = get_third_bucket(key);
+
+         uint32_t bucket_0_empty;
+         uint32_t bucket_0_tombstone;
+         uint32_t bucket_0_match;
+
+         uint32_t bucket_1_empty;
+         uint32_t bucket_1_tombstone;
+         uint32_t bucket_1_match;
+
+         backyard_md_bucket_type * md_bucket_0 = &backing_metadata[bucket_0];
+         backyard_bucket_type * bucket_0_ptr = &alt_buckets[bucket_0];
+
+         backyard_md_bucket_type * md_bucket_1 = &backing_metadata[bucket_1];
+         backyard_bucket_type * bucket_1_ptr = &alt_buckets[bucket_1];
+
+         md_bucket_0->load_fill_ballots_huge(my_tile, key, bucket_0_empty, bucket_0_tombstone, bucket_0_match);
+         md_bucket_1->load_fill_ballots_huge(my_tile, key, bucket_1_empty, bucket_1_tombstone, bucket_1_match);
+
+         //backyard slots are full pairs - hand replace_func the value.
+         auto backyard_func = [&](packed_pair_type * pair, Key ext_key, Val ext_val){
+            replace_func((val_slot_type *) &pair->val, ext_key, ext_val);
+         };
+
+         if (__popc(bucket_0_match) != 0){
+
+            if (bucket_0_ptr->upsert_existing_func(my_tile, key, val, bucket_0_match, backyard_func) != -1){
+               return true;
+            }
+
+         }
+
+         if (__popc(bucket_1_match) != 0){
+
+            if (bucket_1_ptr->upsert_existing_func(my_tile, key, val, bucket_1_match, backyard_func) != -1){
+               return true;
+            }
+
+         }
+
+         //the key is in neither yard - a frontyard tombstone is still preferred over the backyard.
+         if (md_bucket_type::is_storable(tag)){
+
+            uint32_t primary_empty;
+            uint32_t primary_tombstone;
+            uint32_t primary_match;
+
+            md_primary->load_fill_ballots(my_tile, tag, primary_empty, primary_tombstone, primary_match);
+
+            if (insert_frontyard(my_tile, md_primary, bucket_primary_ptr, primary_tombstone, md_bucket_type::tombstone_tag, tag, remainder, val)) return true;
+
+         }
+
+         uint bucket_0_size = bucket_size - __popc(bucket_0_empty | bucket_0_tombstone);
+         uint bucket_1_size = bucket_size - __popc(bucket_1_empty | bucket_1_tombstone);
+
+         //p2 over the backyard.
+         while (bucket_0_size != bucket_size || bucket_1_size != bucket_size){
+
+            if (bucket_0_size <= bucket_1_size){
+
+               if (insert_backyard_slot(my_tile, bucket_0_ptr, md_bucket_0->match_tombstone(my_tile, key, bucket_0_tombstone), key, val)) return true;
+
+               if (insert_backyard_slot(my_tile, bucket_0_ptr, md_bucket_0->match_empty(my_tile, key, bucket_0_empty), key, val)) return true;
+
+            } else {
+
+               if (insert_backyard_slot(my_tile, bucket_1_ptr, md_bucket_1->match_tombstone(my_tile, key, bucket_1_tombstone), key, val)) return true;
+
+               if (insert_backyard_slot(my_tile, bucket_1_ptr, md_bucket_1->match_empty(my_tile, key, bucket_1_empty), key, val)) return true;
+
+            }
+
+            md_bucket_0->load_fill_ballots_huge(my_tile, key, bucket_0_empty, bucket_0_tombstone, bucket_0_match);
+            md_bucket_1->load_fill_ballots_huge(my_tile, key, bucket_1_empty, bucket_1_tombstone, bucket_1_match);
+
+            bucket_0_size = bucket_size - __popc(bucket_0_empty | bucket_0_tombstone);
+            bucket_1_size = bucket_size - __popc(bucket_1_empty | bucket_1_tombstone);
+
+         }
+
+         return false;
+
+      }
+
+
+      [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return find_with_reference_no_lock(my_tile, key, val);
+         });
+
+         #else
+
+         return find_with_reference_no_lock(my_tile, key, val);
+
+         #endif
+
+      }
+
+      //plain probe of both yards - the caller holds the lock or validates a version.
+      [[nodiscard]] __device__ bool find_with_reference_no_lock(tile_type my_tile, Key key, Val & val){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = get_quotient_tag(quotient);
+
+         if (md_bucket_type::is_storable(tag)){
+
+            uint32_t primary_empty;
+            uint32_t primary_tombstone;
+            uint32_t primary_match;
+
+            metadata[bucket_primary].load_fill_ballots(my_tile, tag, primary_empty, primary_tombstone, primary_match);
+
+            int found = primary_buckets[bucket_primary].match_remainder(my_tile, get_quotient_remainder(quotient), primary_match);
+
+            if (found != -1){
+
+               //every thread loads the same word - one request.
+               val = hash_table_load(&primary_buckets[bucket_primary].vals[found]);
+               return true;
+
+            }
+
+         }
+
+         uint64_t bucket_0 = get_second_bucket(key_hash);
+
+         if (backing_metadata[bucket_0].query_md_and_bucket_large(my_tile, key, val, &alt_buckets[bucket_0])){
+            return true;
+         }
+
+         uint64_t bucket_1 = get_third_bucket(key);
+
+         if (backing_metadata[bucket_1].query_md_and_bucket_large(my_tile, key, val, &alt_buckets[bucket_1])){
+            return true;
+         }
+
+         return false;
+
+      }
+
+
+      //value slot of key in either yard, or nullptr - the caller holds the key's lock.
+      [[nodiscard]] __device__ val_slot_type * find_pair_no_lock(tile_type my_tile, Key key){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = get_quotient_tag(quotient);
+
+         if (md_bucket_type::is_storable(tag)){
+
+            uint32_t primary_empty;
+            uint32_t primary_tombstone;
+            uint32_t primary_match;
+
+            metadata[bucket_primary].load_fill_ballots(my_tile, tag, primary_empty, primary_tombstone, primary_match);
+
+            int found = primary_buckets[bucket_primary].match_remainder(my_tile, get_quotient_remainder(quotient), primary_match);
+
+            if (found != -1) return (val_slot_type *) &primary_buckets[bucket_primary].vals[found];
+
+         }
+
+         uint64_t bucket_0 = get_second_bucket(key_hash);
+
+         packed_pair_type * pair = backing_metadata[bucket_0].query_md_and_bucket_pair(my_tile, key, &alt_buckets[bucket_0]);
+
+         if (pair == nullptr){
+
+            uint64_t bucket_1 = get_third_bucket(key);
+
+            pair = backing_metadata[bucket_1].query_md_and_bucket_pair(my_tile, key, &alt_buckets[bucket_1]);
+
+         }
+
+         if (pair == nullptr) return nullptr;
+
+         return (val_slot_type *) &pair->val;
+
+      }
+
+
+      __device__ bool remove(tile_type my_tile, Key key){
+
+         uint64_t key_hash = permute_key(key);
+         uint64_t bucket_primary = get_first_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_primary);
+
+         bool return_val = remove_internal(my_tile, key, bucket_primary, key_hash);
+
+         unlock(my_tile, bucket_primary);
+
+         return return_val;
+
+      }
+
+      __device__ bool remove_no_lock(tile_type my_tile, Key key){
+
+         uint64_t key_hash = permute_key(key);
+
+         return remove_internal(my_tile, key, get_first_bucket(key_hash), key_hash);
+
+      }
+
+      __device__ bool remove_backyard(tile_type my_tile, Key key, uint64_t bucket){
+
+         uint32_t bucket_empty;
+         uint32_t bucket_tombstone;
+         uint32_t bucket_match;
+
+         backing_metadata[bucket].load_fill_ballots_huge(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+
+         int erase_index = alt_buckets[bucket].erase_reference(my_tile, key, bucket_match);
+
+         if (erase_index == -1) return false;
+
+         if (erase_index % partition_size == my_tile.thread_rank()){
+            backing_metadata[bucket].set_tombstone(my_tile, erase_index);
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+      __device__ bool remove_internal(tile_type my_tile, Key key, uint64_t bucket_primary, uint64_t key_hash){
+
+         uint64_t quotient = get_quotient(key_hash);
+         uint16_t tag = get_quotient_tag(quotient);
+
+         if (md_bucket_type::is_storable(tag)){
+
+            uint32_t primary_empty;
+            uint32_t primary_tombstone;
+            uint32_t primary_match;
+
+            metadata[bucket_primary].load_fill_ballots(my_tile, tag, primary_empty, primary_tombstone, primary_match);
+
+            int erase_index = primary_buckets[bucket_primary].match_remainder(my_tile, get_quotient_remainder(quotient), primary_match);
+
+            if (erase_index != -1){
+
+               if (erase_index % partition_size == my_tile.thread_rank()){
+                  metadata[bucket_primary].set_tombstone(erase_index);
+               }
+
+               my_tile.sync();
+
+               return true;
+
+            }
+
+         }
+
+         if (remove_backyard(my_tile, key, get_second_bucket(key_hash))) return true;
+
+         return remove_backyard(my_tile, key, get_third_bucket(key));
+
+      }
+
+
+      //key held by a frontyard slot, or defaultKey if the slot is not live.
+      __device__ Key get_frontyard_key(uint64_t bucket, int slot){
+
+         uint16_t tag = hash_table_load(&metadata[bucket].metadata[slot]);
+
+         if (!md_bucket_type::is_storable(tag)) return defaultKey;
+
+         return recover_key(bucket, tag, hash_table_load(&primary_buckets[bucket].remainders[slot]));
+
+      }
+
+
+      //checkpoint (helpers/checkpoint.cuh): frontyard metadata + primary_buckets (remainders and vals),
+      //then the backyard backing_metadata + alt_buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets_primary, host_version->n_buckets_alt))
+            && hashing_project::helpers::write_device_region(writer, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets_primary)
+            && hashing_project::helpers::write_device_region(writer, host_version->primary_buckets, sizeof(frontyard_bucket_type)*host_version->n_buckets_primary)
+            && hashing_project::helpers::write_device_region(writer, host_version->backing_metadata, sizeof(backyard_md_bucket_type)*host_version->n_buckets_alt)
+            && hashing_project::helpers::write_device_region(writer, host_version->alt_buckets, sizeof(backyard_bucket_type)*host_version->n_buckets_alt)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets_primary = reader.header.n_buckets_primary;
+         host_version->n_buckets_alt = reader.header.n_buckets_alt;
+         host_version->seed = reader.header.seed;
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(host_version->n_buckets_primary);
+         host_version->primary_buckets = gallatin::utils::get_device_version<frontyard_bucket_type>(host_version->n_buckets_primary);
+         host_version->backing_metadata = gallatin::utils::get_device_version<backyard_md_bucket_type>(host_version->n_buckets_alt);
+         host_version->alt_buckets = gallatin::utils::get_device_version<backyard_bucket_type>(host_version->n_buckets_alt);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets_primary)
+            && hashing_project::helpers::read_device_region(reader, host_version->primary_buckets, sizeof(frontyard_bucket_type)*host_version->n_buckets_primary)
+            && hashing_project::helpers::read_device_region(reader, host_version->backing_metadata, sizeof(backyard_md_bucket_type)*host_version->n_buckets_alt)
+            && hashing_project::helpers::read_device_region(reader, host_version->alt_buckets, sizeof(backyard_bucket_type)*host_version->n_buckets_alt);
+
+         if (!loaded){
+
+            cudaFree(host_version->metadata);
+            cudaFree(host_version->primary_buckets);
+            cudaFree(host_version->backing_metadata);
+            cudaFree(host_version->alt_buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->primary_locks = lock_layout::generate_locks(host_version->n_buckets_primary);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets_primary);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_sweep_buckets = host_version->n_buckets_primary + host_version->n_buckets_alt;
+
+         cudaFreeHost(host_version);
+
+         return n_sweep_buckets;
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh. Frontyard buckets come first: a live tag loads the
+      //remainder and value and the key is rebuilt from (bucket, tag, remainder). The backyard is
+      //swept like the full table's.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         if (bucket < n_buckets_primary){
+
+            md_bucket_type * md_bucket = &metadata[bucket];
+            frontyard_bucket_type * bucket_ptr = &primary_buckets[bucket];
+
+            for (uint i = my_tile.thread_rank(); i < md_bucket_type::n_traversals; i+=my_tile.size()){
+
+               uint16_t loaded_tag = md_bucket_type::empty_tag;
+
+               if (i < bucket_size){
+                  loaded_tag = hash_table_load(&md_bucket->metadata[i]);
+               }
+
+               bool live = md_bucket_type::is_storable(loaded_tag);
+
+               if (!my_tile.ballot(live)) continue;
+
+               Key key = defaultKey;
+               Val val = defaultVal;
+
+               if (live){
+
+                  uint32_t remainder = hash_table_load(&bucket_ptr->remainders[i]);
+                  val = hash_table_load(&bucket_ptr->vals[i]);
+
+                  //the tag is published after the remainder and value - if it still holds, they belong to it.
+                  live = (hash_table_load(&md_bucket->metadata[i]) == loaded_tag);
+
+                  key = recover_key(bucket, loaded_tag, remainder);
+
+               }
+
+               if (!my_tile.ballot(live)) continue;
+
+               func(live, key, val);
+
+            }
+
+            return;
+
+         }
+
+         uint64_t alt_bucket = bucket - n_buckets_primary;
+
+         backyard_md_bucket_type * md_bucket = &backing_metadata[alt_bucket];
+         backyard_bucket_type * bucket_ptr = &alt_buckets[alt_bucket];
+
+         for (uint i = my_tile.thread_rank(); i < backyard_md_bucket_type::n_traversals; i+=my_tile.size()){
+
+            uint16_t loaded_tag = md_bucket->get_empty_tag();
+
+            if (i < bucket_size){
+               loaded_tag = hash_table_load(&md_bucket->metadata[i]);
+            }
+
+            bool live = (loaded_tag != md_bucket->get_empty_tag() && loaded_tag != md_bucket->get_tombstone_tag());
+
+            if (!my_tile.ballot(live)) continue;
+
+            packed_pair_type loaded_pair {defaultKey, defaultVal};
+
+            if (live){
+
+               loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(&bucket_ptr->slots[i]);
+
+               //a freshly claimed tag is set before its pair is written, and removal only clears the tag.
+               live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey && loaded_pair.key != backyard_bucket_type::holdingKey && md_bucket->get_tag(loaded_pair.key) == loaded_tag);
+
+            }
+
+            if (!my_tile.ballot(live)) continue;
+
+            func(live, loaded_pair.key, loaded_pair.val);
+
+         }
+
+      }
+
+
+      __host__ float load(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_slots = (host_version->n_buckets_primary+host_version->n_buckets_alt)*bucket_size;
+
+         cudaFreeHost(host_version);
+
+         return 1.0*get_fill()/n_slots;
+
+      }
+
+      static std::string get_name(){
+         return "iht_p2_metadata_quotient_hashing";
+      }
+
+      __host__ uint64_t get_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t capacity = host_version->n_buckets_primary*(sizeof(frontyard_bucket_type)+sizeof(md_bucket_type)) + lock_layout::get_space_usage(host_version->n_buckets_primary);
+
+         capacity += host_version->n_buckets_alt*(sizeof(backyard_bucket_type)+sizeof(backyard_md_bucket_type));
+
+         cudaFreeHost(host_version);
+
+         return capacity;
+
+      }
+
+      __host__ void print_space_usage(){
+
+         printf("iht_p2_metadata_quotient_hashing using %lu bytes\n", get_space_usage());
+
+      }
+
+      __host__ void print_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets_primary+host_version->n_buckets_alt;
+
+         cudaFreeHost(host_version);
+
+         uint64_t n_items = get_fill();
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_buckets*bucket_size, 100.0*n_items/(n_buckets*bucket_size));
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+         uint64_t * n_items;
+
+         cudaMallocManaged((void **)&n_items, sizeof(uint64_t));
+
+         n_items[0] = 0;
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets_primary = host_version->n_buckets_primary;
+
+         uint64_t n_buckets_alt = host_version->n_buckets_alt;
+
+         iht_md_get_fill_kernel<my_type, partition_size><<<(n_buckets_primary*partition_size-1)/256+1,256>>>(this, n_buckets_primary, n_buckets_alt, n_items);
+
+         cudaDeviceSynchronize();
+
+         uint64_t return_items = n_items[0];
+
+         cudaFree(n_items);
+         cudaFreeHost(host_version);
+
+         return return_items;
+
+      }
+
+      __device__ uint64_t get_bucket_fill_primary(tile_type my_tile, uint64_t bucket){
+
+         uint32_t bucket_empty;
+         uint32_t bucket_tombstone;
+         uint32_t bucket_match;
+
+         metadata[bucket].load_fill_ballots(my_tile, md_bucket_type::empty_tag, bucket_empty, bucket_tombstone, bucket_match);
+
+         return bucket_size-__popc(bucket_empty) - __popc(bucket_tombstone);
+
+      }
+
+      __device__ uint64_t get_bucket_fill_alt(tile_type my_tile, uint64_t bucket){
+
+         uint32_t bucket_empty;
+         uint32_t bucket_tombstone;
+         uint32_t bucket_match;
+
+         backing_metadata[bucket].load_fill_ballots_huge(my_tile, defaultKey, bucket_empty, bucket_tombstone, bucket_match);
+
+         return bucket_size-__popc(bucket_empty) - __popc(bucket_tombstone);
+
+      }
+
+
+   };
+
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using iht_p2_metadata_quotient_generic = typename hashing_project::tables::quotient_md_iht_p2_table<Key,
+                                    generate_md_full_iht_p2_sentinel<Key>(),
+                                    generate_md_full_iht_p2_tombstone<Key>(0),
+                                    Val,
+                                    generate_md_full_iht_p2_sentinel<Val>(),
+                                    generate_md_full_iht_p2_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size>;
+
+
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using iht_p2_metadata_quotient_generic_with_locks = typename hashing_project::tables::quotient_md_iht_p2_table<Key,
+                                    generate_md_full_iht_p2_sentinel<Key>(),
+                                    generate_md_full_iht_p2_tombstone<Key>(0),
+                                    Val,
+                                    generate_md_full_iht_p2_sentinel<Val>(),
+                                    generate_md_full_iht_p2_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of quotient iceberg include guard
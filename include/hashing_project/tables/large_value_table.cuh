@@ -0,0 +1,305 @@
+#ifndef OUR_LARGE_VALUE_TABLE
+#define OUR_LARGE_VALUE_TABLE
+
+#include <cooperative_groups.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/value_slab.cuh>
+
+//inner tables for the aliases below.
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+
+//Large value mode.
+//Any table in tables/ can only hold 8 or 16 byte pairs, so values larger than 8 bytes
+//live in a table-owned value_slab and the inner table maps key -> 64-bit handle.
+//
+//Upserts write the row before publishing the handle, so a reader that sees the handle
+//sees the full row. Replaced and deleted rows are retired, not freed, and become reusable
+//after reclaim() - call it between kernels, e.g. after every delete phase.
+//
+//A replace therefore holds two rows until the next reclaim(). Tables that replace keys need
+//ext_replace_rows of headroom in generate_on_device, about one row per replace between reclaims.
+//
+//inner_table is any *_generic alias with _no_lock variants (all except cuckoo).
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename Key, typename Val, template<typename, typename, uint, uint> typename inner_table, uint partition_size, uint bucket_size>
+   struct large_value_table {
+
+
+      using my_type = large_value_table<Key, Val, inner_table, partition_size, bucket_size>;
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using table_type = inner_table<Key, uint64_t, partition_size, bucket_size>;
+
+      using slab_type = hashing_project::helpers::value_slab<Val>;
+
+
+      table_type * table;
+      slab_type * slab;
+
+
+      //slab holds cache_capacity rows - at most one live row per slot - plus ext_replace_rows
+      //for the rows retired by replaces since the last reclaim().
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_seed, uint64_t ext_replace_rows = 0){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->table = table_type::generate_on_device(cache_capacity, ext_seed);
+
+         host_version->slab = slab_type::generate_on_device(cache_capacity + ext_replace_rows);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         table_type::free_on_device(host_version->table);
+
+         slab_type::free_on_device(host_version->slab);
+
+         cudaFreeHost(host_version);
+
+      }
+
+
+      __device__ uint64_t get_lock_bucket(tile_type my_tile, Key key){
+         return table->get_lock_bucket(my_tile, key);
+      }
+
+      __device__ void stall_lock(tile_type my_tile, uint64_t bucket){
+         table->stall_lock(my_tile, bucket);
+      }
+
+      __device__ void unlock(tile_type my_tile, uint64_t bucket){
+         table->unlock(my_tile, bucket);
+      }
+
+
+      //allocate and fill a row. Returns 0 on a full slab.
+      __device__ uint64_t stage_value(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t handle;
+
+         if (my_tile.thread_rank() == 0){
+            handle = slab->allocate(table->hash(&key, sizeof(Key), 0));
+         }
+
+         handle = my_tile.shfl(handle, 0);
+
+         if (handle == 0) return 0;
+
+         slab->write_value(my_tile, handle, val);
+
+         return handle;
+
+      }
+
+
+      __device__ bool upsert_replace_no_lock(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t handle = stage_value(my_tile, key, val);
+
+         if (handle == 0) return false;
+
+         uint64_t old_handle = 0;
+
+         bool replaced = table->find_with_reference_no_lock(my_tile, key, old_handle);
+
+         if (!table->upsert_no_lock(my_tile, key, handle)){
+
+            //never published, safe to free now.
+            if (my_tile.thread_rank() == 0) slab->free_handle(handle);
+
+            return false;
+
+         }
+
+         if (replaced && my_tile.thread_rank() == 0){
+            slab->retire(old_handle);
+         }
+
+         return true;
+
+      }
+
+
+      //always stages the value in a new row, even when key is present. Returns false and leaves
+      //the table unchanged on a full slab - a filled table without ext_replace_rows cannot replace
+      //until remove + reclaim() frees rows.
+      __device__ bool upsert_replace(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t bucket = get_lock_bucket(my_tile, key);
+
+         stall_lock(my_tile, bucket);
+
+         bool return_val = upsert_replace_no_lock(my_tile, key, val);
+
+         unlock(my_tile, bucket);
+
+         return return_val;
+
+      }
+
+
+      //pointer to the stored row - only valid until the next reclaim().
+      [[nodiscard]] __device__ Val * find_value(tile_type my_tile, Key key){
+
+         uint64_t handle;
+
+         if (!table->find_with_reference(my_tile, key, handle)) return nullptr;
+
+         return slab->get_value(handle);
+
+      }
+
+
+      [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
+
+         uint64_t handle;
+
+         if (!table->find_with_reference(my_tile, key, handle)) return false;
+
+         slab->read_value(my_tile, handle, val);
+
+         return true;
+
+      }
+
+      [[nodiscard]] __device__ bool find_with_reference_no_lock(tile_type my_tile, Key key, Val & val){
+
+         uint64_t handle;
+
+         if (!table->find_with_reference_no_lock(my_tile, key, handle)) return false;
+
+         slab->read_value(my_tile, handle, val);
+
+         return true;
+
+      }
+
+
+      __device__ bool remove_no_lock(tile_type my_tile, Key key){
+
+         uint64_t handle;
+
+         if (!table->find_with_reference_no_lock(my_tile, key, handle)) return false;
+
+         if (!table->remove_no_lock(my_tile, key)) return false;
+
+         if (my_tile.thread_rank() == 0){
+            slab->retire(handle);
+         }
+
+         return true;
+
+      }
+
+      __device__ bool remove(tile_type my_tile, Key key){
+
+         uint64_t bucket = get_lock_bucket(my_tile, key);
+
+         stall_lock(my_tile, bucket);
+
+         bool return_val = remove_no_lock(my_tile, key);
+
+         unlock(my_tile, bucket);
+
+         return return_val;
+
+      }
+
+
+      //return retired rows to the slab. Host only, no kernels on this table in flight.
+      __host__ void reclaim(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         host_version->slab->reclaim();
+
+         cudaFreeHost(host_version);
+
+      }
+
+
+      __host__ float load(){
+
+         return 0;
+
+      }
+
+      static std::string get_name(){
+         return "large_value_" + table_type::get_name() + "_" + std::to_string(sizeof(Val));
+      }
+
+      __host__ void print_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         host_version->table->print_space_usage();
+
+         printf("value slab using %llu bytes\n", host_version->slab->get_space_usage());
+
+         cudaFreeHost(host_version);
+
+      }
+
+      __host__ void print_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         host_version->table->print_fill();
+
+         cudaFreeHost(host_version);
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t fill = host_version->table->get_fill();
+
+         cudaFreeHost(host_version);
+
+         return fill;
+
+      }
+
+
+   };
+
+
+//row size picks the slab size class.
+template <typename Key, uint value_bytes, uint tile_size, uint bucket_size>
+using large_value_md_double = large_value_table<Key, hashing_project::helpers::value_row<value_bytes>, md_double_generic, tile_size, bucket_size>;
+
+template <typename Key, uint value_bytes, uint tile_size, uint bucket_size>
+using large_value_md_p2 = large_value_table<Key, hashing_project::helpers::value_row<value_bytes>, md_p2_generic, tile_size, bucket_size>;
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of large value include guard
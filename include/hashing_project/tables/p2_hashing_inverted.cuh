@@ -10,6 +10,10 @@
 #include <gallatin/allocators/alloc_utils.cuh>
 #include <hashing_project/helpers/probe_counts.cuh>
 #include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
 
 
 #include "assert.h"
@@ -415,7 +419,8 @@ namespace tables {
       }
 
       //attempt to insert into the table based on an existing mapping.
-      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint upsert_mapping, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ int upsert_existing_func(cg::thread_block_tile<partition_size> my_tile, Key ext_key, Val ext_val, uint upsert_mapping, replace_func_type replace_func){
 
 
          //first read size
@@ -617,7 +622,8 @@ namespace tables {
 
       }
 
-      __device__ bool load_fill_ballots_upserts_func(const cg::thread_block_tile<partition_size> & my_tile, const Key & upsert_key, const Val & upsert_val, __restrict__ uint & empty_match, __restrict__ uint & tombstone_match, __restrict__ uint & key_match, void (*replace_func)(pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool load_fill_ballots_upserts_func(const cg::thread_block_tile<partition_size> & my_tile, const Key & upsert_key, const Val & upsert_val, __restrict__ uint & empty_match, __restrict__ uint & tombstone_match, __restrict__ uint & key_match, replace_func_type replace_func){
 
 
          //wipe previous
@@ -877,11 +883,11 @@ namespace tables {
 
 
 
-   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size>
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
    struct p2_inv_table {
 
 
-      using my_type = p2_inv_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+      using my_type = p2_inv_table<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
 
 
       using tile_type = cg::thread_block_tile<partition_size>;
@@ -891,7 +897,10 @@ namespace tables {
       using packed_pair_type = ht_pair<Key, Val>;
 
       bucket_type * buckets;
-      uint64_t * locks;
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
 
       uint64_t n_buckets;
       uint64_t seed;
@@ -907,7 +916,9 @@ namespace tables {
 
          host_version->buckets = gallatin::utils::get_device_version<bucket_type>(ext_n_buckets);
 
-         host_version->locks = gallatin::utils::get_device_version<uint64_t>( (ext_n_buckets-1)/64+1);
+         host_version->locks = lock_layout::generate_locks(ext_n_buckets);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(ext_n_buckets);
 
          host_version->seed = ext_seed;
 
@@ -947,16 +958,58 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
+      }
+
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
 
-         do {
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
             ADD_PROBE
          }
-         while (atomicOr((unsigned long long int *)&locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
 
+         my_tile.sync();
+
+         #endif
 
       }
 
@@ -977,11 +1030,9 @@ namespace tables {
          return;
          #endif
 
-         uint64_t high = bucket/64;
-         uint64_t low = bucket % 64;
+         hashing_project::helpers::end_bucket_write(versions, bucket);
 
-         //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-         atomicAnd((unsigned long long int *)&locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+         lock_layout::unlock(locks, bucket);
          ADD_PROBE
 
       }
@@ -1071,7 +1122,8 @@ namespace tables {
          my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
 
          cudaFree(host_version->buckets);
-         cudaFree(host_version->locks);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
 
          cudaFreeHost(host_version);
          
@@ -1104,7 +1156,8 @@ namespace tables {
       }
 
 
-      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -1120,7 +1173,8 @@ namespace tables {
 
       }
 
-      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_no_lock(const tile_type & my_tile, const Key & key, const Val & val, replace_func_type replace_func){
 
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
@@ -1153,6 +1207,10 @@ namespace tables {
 
 
          bucket_type * bucket_0_ptr = get_bucket_ptr(bucket_0);
+
+         #if P2_SPECULATIVE_LOAD
+         ht_prefetch_bucket(my_tile, get_bucket_ptr(get_second_bucket(key_hash)), sizeof(bucket_type));
+         #endif
         
 
 
@@ -1285,12 +1343,17 @@ namespace tables {
       }
 
 
-      __device__ bool upsert_function_internal(const tile_type & my_tile, uint64_t key_hash, uint64_t bucket_0, const Key & key, const Val & val, void (*replace_func)(packed_pair_type *, Key, Val)){
+      template <typename replace_func_type>
+      __device__ bool upsert_function_internal(const tile_type & my_tile, uint64_t key_hash, uint64_t bucket_0, const Key & key, const Val & val, replace_func_type replace_func){
 
         //uint64_t bucket_0 = hash(&key, sizeof(Key), seed) % n_buckets;
 
 
          bucket_type * bucket_0_ptr = get_bucket_ptr(bucket_0);
+
+         #if P2_SPECULATIVE_LOAD
+         ht_prefetch_bucket(my_tile, get_bucket_ptr(get_second_bucket(key_hash)), sizeof(bucket_type));
+         #endif
         
 
 
@@ -1425,6 +1488,19 @@ namespace tables {
       // //nope! no storage
       [[nodiscard]] __device__ bool find_with_reference(tile_type my_tile, Key key, Val & val){
 
+         #if P2_SPECULATIVE_LOAD
+
+         return find_with_reference_speculative(my_tile, key, val);
+
+         #elif STABLE_HT_LOCKLESS_QUERY
+
+         //probe unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return find_with_reference_no_lock(my_tile, key, val);
+         });
+
+         #else
+
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
 
@@ -1453,10 +1529,17 @@ namespace tables {
          }
 
          return false;
+
+         #endif
+
       }
 
       [[nodiscard]] __device__ bool find_with_reference_no_lock(tile_type my_tile, Key key, Val & val){
 
+         #if P2_SPECULATIVE_LOAD
+         return find_with_reference_speculative_no_lock(my_tile, key, val);
+         #endif
+
 
          uint64_t key_hash = hash(&key, sizeof(Key), seed);
 
@@ -1486,6 +1569,40 @@ namespace tables {
          return false;
       }
 
+      //speculative p2 probe - both candidate buckets are fetched before bucket 0 is checked.
+      //Keys in bucket 1 and negative queries pay one memory round trip instead of two,
+      //bucket 0 hits pay for a bucket 1 fetch they didn't need.
+      [[nodiscard]] __device__ bool find_with_reference_speculative(tile_type my_tile, Key key, Val & val){
+
+         #if STABLE_HT_LOCKLESS_QUERY
+
+         return hashing_project::helpers::optimistic_query(my_tile, versions, get_lock_bucket(my_tile, key), [&](){
+            return find_with_reference_speculative_no_lock(my_tile, key, val);
+         });
+
+         #else
+
+         return find_with_reference_speculative_no_lock(my_tile, key, val);
+
+         #endif
+
+      }
+
+      [[nodiscard]] __device__ bool find_with_reference_speculative_no_lock(tile_type my_tile, Key key, Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         bucket_type * bucket_0_ptr = get_bucket_ptr(get_first_bucket(key_hash));
+         bucket_type * bucket_1_ptr = get_bucket_ptr(get_second_bucket(key_hash));
+
+         ht_prefetch_bucket_pair(my_tile, bucket_0_ptr, bucket_1_ptr, sizeof(bucket_type));
+
+         if (bucket_0_ptr->query(my_tile, key, val)) return true;
+
+         return bucket_1_ptr->query(my_tile, key, val);
+
+      }
+
       __device__ bool remove(tile_type my_tile, Key key){
         
 
@@ -1668,7 +1785,7 @@ namespace tables {
 
          my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
             
-         uint64_t capacity = host_version->n_buckets*sizeof(bucket_type) + (host_version->n_buckets-1)/8+1; 
+         uint64_t capacity = host_version->n_buckets*sizeof(bucket_type) + lock_layout::get_space_usage(host_version->n_buckets); 
 
          cudaFreeHost(host_version);
 
@@ -1746,6 +1863,103 @@ namespace tables {
 
       }
 
+      //checkpoint (helpers/checkpoint.cuh): buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets);
+
+         if (!loaded){
+
+            cudaFree(host_version->buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->locks = lock_layout::generate_locks(host_version->n_buckets);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ uint64_t get_n_sweep_buckets(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_sweep_buckets = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return n_sweep_buckets;
+
+      }
+
+      //sweep hook for helpers/table_sweep.cuh. Keys are loaded first and the pair only for a live slot.
+      template <typename func_type>
+      __device__ void for_each_in_bucket(const tile_type & my_tile, uint64_t bucket, func_type func){
+
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket);
+
+         for (uint i = my_tile.thread_rank(); i < bucket_type::n_traversals; i+=my_tile.size()){
+
+            bool live = false;
+
+            packed_pair_type loaded_pair {defaultKey, defaultVal};
+
+            if (i < bucket_size){
+
+               Key loaded_key = hash_table_load(&bucket_ptr->slots[i].key);
+
+               if (loaded_key != defaultKey && loaded_key != tombstoneKey && loaded_key != bucket_type::holdingKey){
+
+                  loaded_pair = ht_load_packed_pair<ht_pair, Key, Val>(&bucket_ptr->slots[i]);
+
+                  //slot may have turned over between the two loads.
+                  live = (loaded_pair.key != defaultKey && loaded_pair.key != tombstoneKey && loaded_pair.key != bucket_type::holdingKey);
+
+               }
+
+            }
+
+            if (!my_tile.ballot(live)) continue;
+
+            func(live, loaded_pair.key, loaded_pair.val);
+
+         }
+
+      }
+
 
    };
 
@@ -1773,6 +1987,19 @@ using p2_inv_generic = typename hashing_project::tables::p2_inv_table<Key,
                                     bucket_size>;
 
 
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using p2_inv_generic_with_locks = typename hashing_project::tables::p2_inv_table<Key,
+                                    generate_p2_inv_sentinel<Key>(),
+                                    generate_p2_inv_tombstone<Key>(0),
+                                    Val,
+                                    generate_p2_inv_sentinel<Val>(),
+                                    generate_p2_inv_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
 
 
 } //namespace wrappers
@@ -0,0 +1,884 @@
+#ifndef OUR_P2_META_MULTIMAP
+#define OUR_P2_META_MULTIMAP
+
+#include <cooperative_groups.h>
+#include <cooperative_groups/reduce.h>
+#include <cooperative_groups/scan.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <thrust/execution_policy.h>
+#include <thrust/scan.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_pairs.cuh>
+#include <hashing_project/helpers/probe_counts.cuh>
+#include <hashing_project/helpers/ht_load.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/device_checkpoint.cuh>
+#include <hashing_project/helpers/bucket_versions.cuh>
+
+//metadata and pair buckets are shared with the map version.
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+
+//Multimap version of p2_hashing_metadata.cuh.
+//
+//insert_dup never looks for an existing copy of the key - it claims a tag in the emptier
+//of the two candidate buckets, so a key may be stored several times.
+//count/retrieve_all do one tag pass over each candidate bucket and confirm every tag
+//match in parallel across the tile.
+//
+//All copies of a key live in its two buckets, so a key holds at most 2*bucket_size copies
+//(fewer under load). Use double_hashing_metadata_multimap.cuh for heavy keys.
+//
+//bulk retrieval is two-phase: retrieve_count writes per-key counts and prefix sums them into
+//offsets, retrieve_write fills values[offsets[i], offsets[i+1]) for each key.
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   template <typename HT, typename Key, uint tile_size>
+   __global__ void p2_mm_count_kernel(HT * table, Key * keys, uint64_t n_keys, uint64_t * counts){
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_keys) return;
+
+      uint64_t n_matches = table->count(my_tile, keys[tid]);
+
+      if (my_tile.thread_rank() == 0){
+         counts[tid] = n_matches;
+      }
+
+   }
+
+
+   template <typename HT, typename Key, typename Val, uint tile_size>
+   __global__ void p2_mm_write_kernel(HT * table, Key * keys, uint64_t n_keys, uint64_t * offsets, Val * values){
+
+      auto thread_block = cg::this_thread_block();
+
+      cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+      uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+      if (tid >= n_keys) return;
+
+      uint64_t start = offsets[tid];
+
+      //relative to offsets[0] so a sub-range of keys can be written into its own buffer.
+      table->retrieve_all(my_tile, keys[tid], values+(start-offsets[0]), offsets[tid+1]-start);
+
+   }
+
+
+
+   template <typename Key, Key defaultKey, Key tombstoneKey, typename Val, Val defaultVal, Val tombstoneVal, uint partition_size, uint bucket_size, typename lock_layout = hashing_project::helpers::packed_bucket_locks>
+   struct p2_metadata_multimap {
+
+
+      using my_type = p2_metadata_multimap<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size, lock_layout>;
+
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using md_bucket_type = metadata_bucket<Key, defaultKey, tombstoneKey, Val, tombstoneVal, partition_size, bucket_size>;
+
+      using bucket_type = p2_md_bucket<Key, defaultKey, tombstoneKey, Val, defaultVal, tombstoneVal, partition_size, bucket_size>;
+
+      using packed_pair_type = ht_pair<Key, Val>;
+
+      #if LARGE_BUCKET_MODS
+      using ballot_type = uint64_t;
+      #else
+      using ballot_type = uint32_t;
+      #endif
+
+      static const uint64_t n_traversals = ((bucket_size-1)/partition_size+1)*partition_size;
+
+
+      md_bucket_type * metadata;
+      bucket_type * buckets;
+      typename lock_layout::lock_type * locks;
+
+      //seqlock per lock bucket - only allocated with STABLE_HT_LOCKLESS_QUERY.
+      uint32_t * versions;
+
+      uint64_t n_buckets;
+      uint64_t seed;
+
+
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_seed){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         uint64_t ext_n_buckets = (cache_capacity-1)/bucket_size+1;
+
+         host_version->n_buckets = ext_n_buckets;
+
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(ext_n_buckets);
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(ext_n_buckets);
+
+         host_version->locks = lock_layout::generate_locks(ext_n_buckets);
+
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(ext_n_buckets);
+
+         host_version->seed = ext_seed;
+
+         my_type * device_version = gallatin::utils::move_to_device<my_type>(host_version);
+
+         init_p2_md_table_kernel<my_type><<<(ext_n_buckets-1)/256+1,256>>>(device_version);
+
+         cudaDeviceSynchronize();
+
+         return device_version;
+
+      }
+
+      __device__ void init_bucket_and_locks(uint64_t tid){
+
+         if (tid < n_buckets){
+            metadata[tid].init();
+            buckets[tid].init();
+            unlock_bucket_one_thread(tid);
+         }
+
+      }
+
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         cudaFree(host_version->buckets);
+         cudaFree(host_version->metadata);
+         lock_layout::free_locks(host_version->locks);
+         hashing_project::helpers::free_bucket_versions(host_version->versions);
+
+         cudaFreeHost(host_version);
+
+         return;
+
+      }
+
+
+      __device__ void stall_lock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+
+            stall_lock_one_thread(bucket);
+
+         }
+
+         my_tile.sync();
+
+      }
+
+      __device__ void lock_key(tile_type my_tile, Key key){
+
+         stall_lock(my_tile, get_lock_bucket(my_tile, key));
+
+      }
+
+      __device__ void unlock_key(tile_type my_tile, Key key){
+
+         unlock(my_tile, get_lock_bucket(my_tile, key));
+
+      }
+
+      __device__ uint64_t get_lock_bucket(tile_type my_tile, Key key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return get_first_bucket(key_hash);
+
+      }
+
+
+      __device__ void stall_lock_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         LOCK_SPIN_INIT
+
+         while (!lock_layout::try_lock(locks, bucket)){
+            ADD_LOCK_SPIN
+         }
+
+         ADD_PROBE
+         ADD_LOCK_ACQUIRE(bucket)
+
+         hashing_project::helpers::begin_bucket_write(versions, bucket);
+
+      }
+
+      //shared (reader) side of the bucket lock - readers of the same bucket only exclude writers
+      //on a reader-writer layout, other layouts take the exclusive lock.
+      //holders must not write the bucket, so the bucket version is left alone.
+      __device__ void stall_lock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+
+            LOCK_SPIN_INIT
+
+            while (!lock_layout::try_lock_shared(locks, bucket)){
+               ADD_LOCK_SPIN
+            }
+
+            ADD_PROBE
+            ADD_LOCK_ACQUIRE(bucket)
+
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock_shared(tile_type my_tile, uint64_t bucket){
+
+         #if !LOAD_CHEAP
+
+         if (my_tile.thread_rank() == 0){
+            lock_layout::unlock_shared(locks, bucket);
+            ADD_PROBE
+         }
+
+         my_tile.sync();
+
+         #endif
+
+      }
+
+      __device__ void unlock(tile_type my_tile, uint64_t bucket){
+
+         if (my_tile.thread_rank() == 0){
+            unlock_bucket_one_thread(bucket);
+         }
+
+         my_tile.sync();
+
+      }
+
+
+      __device__ void unlock_bucket_one_thread(uint64_t bucket){
+
+         #if LOAD_CHEAP
+         return;
+         #endif
+
+         hashing_project::helpers::end_bucket_write(versions, bucket);
+
+         lock_layout::unlock(locks, bucket);
+         ADD_PROBE
+
+      }
+
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const uint64_t * data = (const uint64_t *)key;
+         const uint64_t * end = data + (len/8);
+
+         while(data != end)
+         {
+            uint64_t k = *data++;
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = (const unsigned char*)data;
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      __device__ uint64_t get_first_bucket(uint64_t hash){
+         return (hash & BITMASK(32)) % n_buckets;
+      }
+
+      __device__ uint64_t get_second_bucket(uint64_t hash){
+         return (hash >> 32) % n_buckets;
+      }
+
+      __host__ uint64_t get_num_locks(){
+
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t nblocks = host_version->n_buckets;
+
+         cudaFreeHost(host_version);
+
+         return nblocks;
+
+      }
+
+
+      __device__ bucket_type * get_bucket_ptr(uint64_t bucket_addr){
+
+         return &buckets[bucket_addr];
+
+      }
+
+      __device__ md_bucket_type * get_metadata(uint64_t bucket_addr){
+
+         return &metadata[bucket_addr];
+
+      }
+
+
+      __device__ void load_ballots(const tile_type & my_tile, const Key & key, md_bucket_type * md_bucket, ballot_type & bucket_empty, ballot_type & bucket_tombstone, ballot_type & bucket_match){
+
+         #if LARGE_MD_LOAD
+         md_bucket->load_fill_ballots_huge(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+         #else
+         md_bucket->load_fill_ballots(my_tile, key, bucket_empty, bucket_tombstone, bucket_match);
+         #endif
+
+      }
+
+
+      //confirm every tag match in one strided pass - one pair read per match, spread across the tile.
+      __device__ uint64_t count_bucket(const tile_type & my_tile, const Key & key, bucket_type * bucket_ptr, ballot_type bucket_match){
+
+         uint64_t local_count = 0;
+
+         for (uint i = my_tile.thread_rank(); i < bucket_size; i+=my_tile.size()){
+
+            if (bucket_match & SET_BIT_MASK(i)){
+
+               ADD_PROBE
+
+               local_count += (hash_table_load(&bucket_ptr->slots[i].key) == key);
+
+            }
+
+         }
+
+         return cg::reduce(my_tile, local_count, cg::plus<uint64_t>());
+
+      }
+
+
+      //write confirmed matches to out[written...], dropping any past capacity.
+      //returns the number of matches in the bucket.
+      __device__ uint64_t retrieve_bucket(const tile_type & my_tile, const Key & key, bucket_type * bucket_ptr, ballot_type bucket_match, Val * out, uint64_t capacity, uint64_t written){
+
+         uint64_t found = 0;
+
+         for (uint i = my_tile.thread_rank(); i < n_traversals; i+=my_tile.size()){
+
+            bool matched = false;
+
+            Val loaded_val;
+
+            if (i < bucket_size && (bucket_match & SET_BIT_MASK(i))){
+
+               ADD_PROBE
+
+               packed_pair_type loaded_pair = bucket_ptr->load_packed_pair(i);
+
+               matched = (loaded_pair.key == key);
+               loaded_val = loaded_pair.val;
+
+            }
+
+            auto match_ballot = my_tile.ballot(matched);
+
+            if (matched){
+
+               uint64_t my_index = written + found + __popc(match_ballot & ((1U << my_tile.thread_rank())-1));
+
+               if (my_index < capacity) out[my_index] = loaded_val;
+
+            }
+
+            found += __popc(match_ballot);
+
+         }
+
+         return found;
+
+      }
+
+
+      //claim a tag in the emptier candidate, falling back to the other one.
+      __device__ bool insert_dup_internal(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_0, uint64_t bucket_1){
+
+         md_bucket_type * md_bucket_0 = get_metadata(bucket_0);
+         md_bucket_type * md_bucket_1 = get_metadata(bucket_1);
+
+         ballot_type bucket_0_empty;
+         ballot_type bucket_0_tombstone;
+         ballot_type bucket_0_match;
+
+         ballot_type bucket_1_empty;
+         ballot_type bucket_1_tombstone;
+         ballot_type bucket_1_match;
+
+         load_ballots(my_tile, key, md_bucket_0, bucket_0_empty, bucket_0_tombstone, bucket_0_match);
+         load_ballots(my_tile, key, md_bucket_1, bucket_1_empty, bucket_1_tombstone, bucket_1_match);
+
+         uint bucket_0_open = __popcll(bucket_0_empty | bucket_0_tombstone);
+         uint bucket_1_open = __popcll(bucket_1_empty | bucket_1_tombstone);
+
+         if (bucket_1_open > bucket_0_open){
+
+            if (insert_into_bucket(my_tile, key, val, bucket_1, bucket_1_empty, bucket_1_tombstone)) return true;
+
+            return insert_into_bucket(my_tile, key, val, bucket_0, bucket_0_empty, bucket_0_tombstone);
+
+         }
+
+         if (insert_into_bucket(my_tile, key, val, bucket_0, bucket_0_empty, bucket_0_tombstone)) return true;
+
+         return insert_into_bucket(my_tile, key, val, bucket_1, bucket_1_empty, bucket_1_tombstone);
+
+      }
+
+
+      __device__ bool insert_into_bucket(const tile_type & my_tile, const Key & key, const Val & val, uint64_t bucket_index, ballot_type bucket_empty, ballot_type bucket_tombstone){
+
+         md_bucket_type * md_bucket = get_metadata(bucket_index);
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+         int result = md_bucket->match_empty(my_tile, key, bucket_empty);
+
+         if (result == -1){
+            result = md_bucket->match_tombstone(my_tile, key, bucket_tombstone);
+         }
+
+         if (result == -1) return false;
+
+         //tag is claimed, so the slot is ours - readers confirm on the key.
+         if (my_tile.thread_rank() == 0){
+            ADD_PROBE
+            ht_store_packed_pair(&bucket_ptr->slots[result], {key, val});
+            __threadfence();
+         }
+
+         my_tile.sync();
+
+         return true;
+
+      }
+
+
+      __device__ uint64_t count_in_bucket(const tile_type & my_tile, const Key & key, uint64_t bucket_index){
+
+         ballot_type bucket_empty;
+         ballot_type bucket_tombstone;
+         ballot_type bucket_match;
+
+         load_ballots(my_tile, key, get_metadata(bucket_index), bucket_empty, bucket_tombstone, bucket_match);
+
+         if (!bucket_match) return 0;
+
+         return count_bucket(my_tile, key, get_bucket_ptr(bucket_index), bucket_match);
+
+      }
+
+
+      __device__ uint64_t retrieve_in_bucket(const tile_type & my_tile, const Key & key, uint64_t bucket_index, Val * out, uint64_t capacity, uint64_t written){
+
+         ballot_type bucket_empty;
+         ballot_type bucket_tombstone;
+         ballot_type bucket_match;
+
+         load_ballots(my_tile, key, get_metadata(bucket_index), bucket_empty, bucket_tombstone, bucket_match);
+
+         if (!bucket_match) return 0;
+
+         return retrieve_bucket(my_tile, key, get_bucket_ptr(bucket_index), bucket_match, out, capacity, written);
+
+      }
+
+
+      __device__ uint64_t remove_in_bucket(const tile_type & my_tile, const Key & key, uint64_t bucket_index){
+
+         md_bucket_type * md_bucket = get_metadata(bucket_index);
+         bucket_type * bucket_ptr = get_bucket_ptr(bucket_index);
+
+         ballot_type bucket_empty;
+         ballot_type bucket_tombstone;
+         ballot_type bucket_match;
+
+         load_ballots(my_tile, key, md_bucket, bucket_empty, bucket_tombstone, bucket_match);
+
+         uint64_t local_removed = 0;
+
+         for (uint j = my_tile.thread_rank(); j < bucket_size; j+=my_tile.size()){
+
+            if ((bucket_match & SET_BIT_MASK(j)) && gallatin::utils::typed_atomic_write(&bucket_ptr->slots[j].key, key, tombstoneKey)){
+
+               ADD_PROBE
+               md_bucket->set_tombstone(j);
+               local_removed++;
+
+            }
+
+         }
+
+         return cg::reduce(my_tile, local_removed, cg::plus<uint64_t>());
+
+      }
+
+
+      //add one more copy of key. Fails once both candidate buckets are full.
+      __device__ bool insert_dup(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+         uint64_t bucket_1 = get_second_bucket(key_hash);
+
+         stall_lock(my_tile, bucket_0);
+
+         bool return_val = insert_dup_internal(my_tile, key, val, bucket_0, bucket_1);
+
+         unlock(my_tile, bucket_0);
+
+         return return_val;
+
+      }
+
+      //slots are claimed by CAS on the tag, so concurrent insert_dups are safe without the lock.
+      //the lock only orders insert_dup against remove_all.
+      __device__ bool insert_dup_no_lock(const tile_type & my_tile, const Key & key, const Val & val){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+
+         return insert_dup_internal(my_tile, key, val, get_first_bucket(key_hash), get_second_bucket(key_hash));
+
+      }
+
+
+      [[nodiscard]] __device__ uint64_t count(const tile_type & my_tile, const Key & key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+         uint64_t bucket_1 = get_second_bucket(key_hash);
+
+         //count unlocked and re-validate against the version of the key's lock bucket.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, bucket_0, [&](){
+
+            uint64_t n_matches = count_in_bucket(my_tile, key, bucket_0);
+
+            if (bucket_1 != bucket_0) n_matches += count_in_bucket(my_tile, key, bucket_1);
+
+            return n_matches;
+
+         });
+
+      }
+
+
+      //write up to capacity values stored under key into out.
+      //returns the total number of copies, which may exceed capacity.
+      __device__ uint64_t retrieve_all(const tile_type & my_tile, const Key & key, Val * out, uint64_t capacity){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+         uint64_t bucket_1 = get_second_bucket(key_hash);
+
+         //a retry rewrites out from the start.
+         return hashing_project::helpers::optimistic_query(my_tile, versions, bucket_0, [&](){
+
+            uint64_t n_matches = retrieve_in_bucket(my_tile, key, bucket_0, out, capacity, 0);
+
+            if (bucket_1 != bucket_0) n_matches += retrieve_in_bucket(my_tile, key, bucket_1, out, capacity, n_matches);
+
+            return n_matches;
+
+         });
+
+      }
+
+
+      __device__ uint64_t remove_all_no_lock(const tile_type & my_tile, const Key & key){
+
+         uint64_t key_hash = hash(&key, sizeof(Key), seed);
+         uint64_t bucket_0 = get_first_bucket(key_hash);
+         uint64_t bucket_1 = get_second_bucket(key_hash);
+
+         uint64_t n_removed = remove_in_bucket(my_tile, key, bucket_0);
+
+         if (bucket_1 != bucket_0) n_removed += remove_in_bucket(my_tile, key, bucket_1);
+
+         return n_removed;
+
+      }
+
+      //tombstone every copy of key, returns the number removed.
+      __device__ uint64_t remove_all(const tile_type & my_tile, const Key & key){
+
+         uint64_t bucket_0 = get_lock_bucket(my_tile, key);
+
+         stall_lock(my_tile, bucket_0);
+
+         uint64_t n_removed = remove_all_no_lock(my_tile, key);
+
+         unlock(my_tile, bucket_0);
+
+         return n_removed;
+
+      }
+
+
+      //bulk phase 1 - offsets has n_keys+1 entries, keys and offsets are device pointers.
+      //on return offsets[i] is the exclusive prefix sum of the counts, offsets[n_keys] the total.
+      __host__ uint64_t retrieve_count(Key * keys, uint64_t n_keys, uint64_t * offsets){
+
+         cudaMemset(offsets+n_keys, 0, sizeof(uint64_t));
+
+         p2_mm_count_kernel<my_type, Key, partition_size><<<(n_keys*partition_size-1)/256+1,256>>>(this, keys, n_keys, offsets);
+
+         thrust::exclusive_scan(thrust::device, offsets, offsets+n_keys+1, offsets);
+
+         uint64_t total;
+
+         cudaMemcpy(&total, offsets+n_keys, sizeof(uint64_t), cudaMemcpyDeviceToHost);
+
+         return total;
+
+      }
+
+      //bulk phase 2 - values must hold offsets[n_keys]-offsets[0] entries.
+      //keys+i / offsets+i retrieves a batch of the keys into a smaller buffer.
+      __host__ void retrieve_write(Key * keys, uint64_t n_keys, uint64_t * offsets, Val * values){
+
+         p2_mm_write_kernel<my_type, Key, Val, partition_size><<<(n_keys*partition_size-1)/256+1,256>>>(this, keys, n_keys, offsets, values);
+
+         cudaDeviceSynchronize();
+
+      }
+
+      //both phases - values is allocated here and freed by the caller with cudaFree.
+      __host__ uint64_t retrieve(Key * keys, uint64_t n_keys, uint64_t * offsets, Val *& values){
+
+         uint64_t total = retrieve_count(keys, n_keys, offsets);
+
+         values = gallatin::utils::get_device_version<Val>(total > 0 ? total : 1);
+
+         retrieve_write(keys, n_keys, offsets, values);
+
+         return total;
+
+      }
+
+
+      //checkpoint (helpers/checkpoint.cuh): metadata + buckets. Call on a quiescent table.
+      __host__ bool save_checkpoint(std::string path){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         hashing_project::helpers::checkpoint_writer writer;
+
+         bool saved = writer.open(path, hashing_project::helpers::make_checkpoint_header(get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size, host_version->seed, host_version->n_buckets, 0))
+            && hashing_project::helpers::write_device_region(writer, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::write_device_region(writer, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets)
+            && writer.close();
+
+         cudaFreeHost(host_version);
+
+         return saved;
+
+      }
+
+      //restore a table written by save_checkpoint(), one bulk copy per region. Locks and versions start unlocked.
+      //Returns nullptr if the file is missing, truncated or was written by a different table type.
+      static __host__ my_type * load_checkpoint(std::string path){
+
+         hashing_project::helpers::checkpoint_reader reader;
+
+         if (!reader.open(path, get_name(), sizeof(Key), sizeof(Val), partition_size, bucket_size)) return nullptr;
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->n_buckets = reader.header.n_buckets_primary;
+         host_version->seed = reader.header.seed;
+
+         host_version->metadata = gallatin::utils::get_device_version<md_bucket_type>(host_version->n_buckets);
+         host_version->buckets = gallatin::utils::get_device_version<bucket_type>(host_version->n_buckets);
+
+         bool loaded = hashing_project::helpers::read_device_region(reader, host_version->metadata, sizeof(md_bucket_type)*host_version->n_buckets)
+            && hashing_project::helpers::read_device_region(reader, host_version->buckets, sizeof(bucket_type)*host_version->n_buckets);
+
+         if (!loaded){
+
+            cudaFree(host_version->metadata);
+            cudaFree(host_version->buckets);
+            cudaFreeHost(host_version);
+
+            return nullptr;
+
+         }
+
+         host_version->locks = lock_layout::generate_locks(host_version->n_buckets);
+         host_version->versions = hashing_project::helpers::generate_bucket_versions(host_version->n_buckets);
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      __host__ float load(){
+
+         return 0;
+
+      }
+
+      static std::string get_name(){
+         return "p2_hashing_metadata_multimap";
+      }
+
+      __host__ void print_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t capacity = host_version->n_buckets*(sizeof(bucket_type)+sizeof(md_bucket_type)) + lock_layout::get_space_usage(host_version->n_buckets);
+
+         cudaFreeHost(host_version);
+
+         printf("p2_metadata_multimap using %llu bytes\n", capacity);
+
+      }
+
+
+      __host__ void print_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+         uint64_t n_items = get_fill();
+
+         printf("fill: %lu/%lu = %f%%\n", n_items, n_buckets*bucket_size, 100.0*n_items/(n_buckets*bucket_size));
+
+         cudaFreeHost(host_version);
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+
+         uint64_t * n_items;
+
+         cudaMallocManaged((void **)&n_items, sizeof(uint64_t));
+
+         n_items[0] = 0;
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t n_buckets = host_version->n_buckets;
+
+
+         p2_md_get_fill_kernel<my_type, partition_size><<<(n_buckets*partition_size-1)/256+1,256>>>(this, n_buckets, n_items);
+
+         cudaDeviceSynchronize();
+
+         uint64_t return_items = n_items[0];
+
+         cudaFree(n_items);
+         cudaFreeHost(host_version);
+
+         return return_items;
+
+
+      }
+
+      __device__ uint64_t get_bucket_fill(tile_type my_tile, uint64_t bucket){
+
+         ballot_type bucket_empty;
+         ballot_type bucket_tombstone;
+         ballot_type bucket_match;
+
+         load_ballots(my_tile, defaultKey, get_metadata(bucket), bucket_empty, bucket_tombstone, bucket_match);
+
+         return bucket_size-__popcll(bucket_empty)-__popcll(bucket_tombstone);
+
+      }
+
+
+   };
+
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using md_p2_multimap_generic = typename hashing_project::tables::p2_metadata_multimap<Key,
+                                    generate_p2_md_sentinel<Key>(),
+                                    generate_p2_md_tombstone<Key>(0),
+                                    Val,
+                                    generate_p2_md_sentinel<Val>(),
+                                    generate_p2_md_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size>;
+
+
+//same table with a non-default bucket lock layout (helpers/lock_layouts.cuh).
+template <typename Key, typename Val, uint tile_size, uint bucket_size, typename lock_layout>
+using md_p2_multimap_generic_with_locks = typename hashing_project::tables::p2_metadata_multimap<Key,
+                                    generate_p2_md_sentinel<Key>(),
+                                    generate_p2_md_tombstone<Key>(0),
+                                    Val,
+                                    generate_p2_md_sentinel<Val>(),
+                                    generate_p2_md_tombstone<Val>(0),
+                                    tile_size,
+                                    bucket_size,
+                                    lock_layout>;
+
+
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of p2 metadata multimap include guard
@@ -0,0 +1,407 @@
+#ifndef OUR_STRING_KEY_TABLE
+#define OUR_STRING_KEY_TABLE
+
+#include <cooperative_groups.h>
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+
+#include <gallatin/allocators/alloc_utils.cuh>
+
+#include <hashing_project/helpers/ht_load.cuh>
+
+//inner tables for the aliases below.
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+
+
+#include "assert.h"
+#include "stdio.h"
+
+namespace cg = cooperative_groups;
+
+
+//String key mode.
+//Strings are copied once into an append-only arena. The inner table stores
+//(64-bit string hash, arena offset) pairs, so probing costs the same as integer keys
+//and metadata tags come from the hash. The arena is only read on a hash match, to
+//confirm the string.
+//
+//Distinct strings with the same 64-bit hash can't both be stored - the second insert
+//returns false. Removed strings are not reclaimed from the arena.
+
+
+namespace hashing_project {
+
+namespace tables {
+
+
+   //arena layout: [val][len][bytes...], padded to 8 bytes.
+   struct string_record {
+      uint64_t val;
+      uint64_t len;
+   };
+
+
+   template <template<typename, typename, uint, uint> typename inner_table, uint partition_size, uint bucket_size>
+   struct string_key_table {
+
+
+      using my_type = string_key_table<inner_table, partition_size, bucket_size>;
+
+      using tile_type = cg::thread_block_tile<partition_size>;
+
+      using table_type = inner_table<uint64_t, uint64_t, partition_size, bucket_size>;
+
+
+      table_type * table;
+
+      char * arena;
+      uint64_t arena_bytes;
+      uint64_t arena_used;
+
+      uint64_t seed;
+
+
+      static __host__ my_type * generate_on_device(uint64_t cache_capacity, uint64_t ext_arena_bytes, uint64_t ext_seed){
+
+         my_type * host_version = gallatin::utils::get_host_version<my_type>();
+
+         host_version->table = table_type::generate_on_device(cache_capacity, ext_seed);
+
+         host_version->arena = gallatin::utils::get_device_version<char>(ext_arena_bytes);
+         host_version->arena_bytes = ext_arena_bytes;
+
+         //offset 0 is reserved so no record sits at the empty value.
+         host_version->arena_used = sizeof(string_record);
+
+         host_version->seed = ext_seed;
+
+         return gallatin::utils::move_to_device<my_type>(host_version);
+
+      }
+
+      static __host__ void free_on_device(my_type * device_version){
+
+         my_type * host_version = gallatin::utils::move_to_host<my_type>(device_version);
+
+         table_type::free_on_device(host_version->table);
+
+         cudaFree(host_version->arena);
+
+         cudaFreeHost(host_version);
+
+      }
+
+
+      //device-side murmurhash64a
+      __device__ uint64_t hash ( const void * key, int len, uint64_t seed )
+      {
+         const uint64_t m = 0xc6a4a7935bd1e995;
+         const int r = 47;
+
+         uint64_t h = seed ^ (len * m);
+
+         const unsigned char * data = (const unsigned char *)key;
+
+         //strings are not 8-byte aligned, so words are assembled bytewise.
+         for (int i = 0; i+8 <= len; i+=8){
+
+            uint64_t k = 0;
+
+            for (int j = 7; j >= 0; j--){
+               k = (k << 8) | data[i+j];
+            }
+
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+
+            h ^= k;
+            h *= m;
+         }
+
+         const unsigned char * data2 = data + (len & ~7);
+
+         switch(len & 7)
+         {
+            case 7: h ^= (uint64_t)data2[6] << 48;
+            case 6: h ^= (uint64_t)data2[5] << 40;
+            case 5: h ^= (uint64_t)data2[4] << 32;
+            case 4: h ^= (uint64_t)data2[3] << 24;
+            case 3: h ^= (uint64_t)data2[2] << 16;
+            case 2: h ^= (uint64_t)data2[1] << 8;
+            case 1: h ^= (uint64_t)data2[0];
+                        h *= m;
+         };
+
+         h ^= h >> r;
+         h *= m;
+         h ^= h >> r;
+
+         return h;
+      }
+
+
+      //hash of the string, moved off the inner table's sentinel/tombstone/holding keys.
+      __device__ uint64_t get_string_hash(const tile_type & my_tile, const char * str, uint32_t len){
+
+         uint64_t str_hash;
+
+         if (my_tile.thread_rank() == 0){
+
+            str_hash = hash(str, len, seed);
+
+            if (str_hash == 0ULL) str_hash = 1ULL;
+            if (str_hash >= ~1ULL) str_hash -= 2;
+
+         }
+
+         return my_tile.shfl(str_hash, 0);
+
+      }
+
+
+      __device__ string_record * get_record(uint64_t offset){
+         return (string_record *) (arena + offset);
+      }
+
+      __device__ char * get_string(uint64_t offset){
+         return arena + offset + sizeof(string_record);
+      }
+
+
+      //tile-wide byte compare against the arena copy.
+      __device__ bool string_matches(const tile_type & my_tile, uint64_t offset, const char * str, uint32_t len){
+
+         string_record * record = get_record(offset);
+
+         if (record->len != len) return false;
+
+         char * stored = get_string(offset);
+
+         bool mismatch = false;
+
+         for (uint32_t i = my_tile.thread_rank(); i < len; i+=my_tile.size()){
+            mismatch |= (stored[i] != str[i]);
+         }
+
+         return !my_tile.any(mismatch);
+
+      }
+
+
+      __device__ static uint64_t get_record_bytes(uint32_t len){
+         return ((sizeof(string_record) + len - 1)/8+1)*8;
+      }
+
+      //append a record. Returns 0 if the arena is full.
+      //arena_used only advances when the record fits, so a full arena stays at its real usage.
+      __device__ uint64_t append_string(const tile_type & my_tile, const char * str, uint32_t len, uint64_t val){
+
+         uint64_t record_bytes = get_record_bytes(len);
+
+         uint64_t offset;
+
+         if (my_tile.thread_rank() == 0){
+
+            offset = hash_table_load(&arena_used);
+
+            while (true){
+
+               if (offset + record_bytes > arena_bytes){
+                  offset = 0;
+                  break;
+               }
+
+               uint64_t seen = atomicCAS((unsigned long long int *)&arena_used, (unsigned long long int) offset, (unsigned long long int) (offset + record_bytes));
+
+               if (seen == offset) break;
+
+               offset = seen;
+
+            }
+
+            if (offset != 0){
+               string_record * record = get_record(offset);
+               record->val = val;
+               record->len = len;
+            }
+
+         }
+
+         offset = my_tile.shfl(offset, 0);
+
+         if (offset == 0) return 0;
+
+         char * stored = get_string(offset);
+
+         for (uint32_t i = my_tile.thread_rank(); i < len; i+=my_tile.size()){
+            stored[i] = str[i];
+         }
+
+         //record must be visible before the offset is published.
+         __threadfence();
+         my_tile.sync();
+
+         return offset;
+
+      }
+
+      //undo an append whose key could not be stored. The space is returned if nothing was
+      //appended after it - otherwise the record is unreachable, like a removed string.
+      __device__ void rollback_string(const tile_type & my_tile, uint64_t offset, uint32_t len){
+
+         if (my_tile.thread_rank() == 0){
+            atomicCAS((unsigned long long int *)&arena_used, (unsigned long long int) (offset + get_record_bytes(len)), (unsigned long long int) offset);
+         }
+
+         my_tile.sync();
+
+      }
+
+
+      __device__ bool upsert_replace(const tile_type & my_tile, const char * str, uint32_t len, uint64_t val){
+
+         uint64_t str_hash = get_string_hash(my_tile, str, len);
+
+         uint64_t bucket = table->get_lock_bucket(my_tile, str_hash);
+
+         table->stall_lock(my_tile, bucket);
+
+         uint64_t offset;
+
+         bool return_val;
+
+         if (table->find_with_reference_no_lock(my_tile, str_hash, offset)){
+
+            return_val = string_matches(my_tile, offset, str, len);
+
+            if (return_val && my_tile.thread_rank() == 0){
+               ht_store(&get_record(offset)->val, val);
+               __threadfence();
+            }
+
+         } else {
+
+            offset = append_string(my_tile, str, len, val);
+
+            return_val = (offset != 0) && table->upsert_no_lock(my_tile, str_hash, offset);
+
+            //the inner table is full - don't leave the record behind.
+            if (offset != 0 && !return_val) rollback_string(my_tile, offset, len);
+
+         }
+
+         table->unlock(my_tile, bucket);
+
+         return return_val;
+
+      }
+
+
+      [[nodiscard]] __device__ bool find_with_reference(const tile_type & my_tile, const char * str, uint32_t len, uint64_t & val){
+
+         uint64_t str_hash = get_string_hash(my_tile, str, len);
+
+         uint64_t offset;
+
+         if (!table->find_with_reference(my_tile, str_hash, offset)) return false;
+
+         //only touch the arena after a full hash match.
+         if (!string_matches(my_tile, offset, str, len)) return false;
+
+         val = hash_table_load(&get_record(offset)->val);
+
+         return true;
+
+      }
+
+
+      __device__ bool remove(const tile_type & my_tile, const char * str, uint32_t len){
+
+         uint64_t str_hash = get_string_hash(my_tile, str, len);
+
+         uint64_t bucket = table->get_lock_bucket(my_tile, str_hash);
+
+         table->stall_lock(my_tile, bucket);
+
+         uint64_t offset;
+
+         bool return_val = false;
+
+         if (table->find_with_reference_no_lock(my_tile, str_hash, offset) && string_matches(my_tile, offset, str, len)){
+
+            return_val = table->remove_no_lock(my_tile, str_hash);
+
+         }
+
+         table->unlock(my_tile, bucket);
+
+         return return_val;
+
+      }
+
+
+      __host__ uint64_t get_arena_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t used = host_version->arena_used;
+
+         cudaFreeHost(host_version);
+
+         return used;
+
+      }
+
+
+      __host__ float load(){
+
+         return 0;
+
+      }
+
+      static std::string get_name(){
+         return "string_key_" + table_type::get_name();
+      }
+
+      __host__ void print_space_usage(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         host_version->table->print_space_usage();
+
+         printf("string arena using %llu/%llu bytes\n", host_version->arena_used, host_version->arena_bytes);
+
+         cudaFreeHost(host_version);
+
+      }
+
+      __host__ uint64_t get_fill(){
+
+         my_type * host_version = gallatin::utils::copy_to_host<my_type>(this);
+
+         uint64_t fill = host_version->table->get_fill();
+
+         cudaFreeHost(host_version);
+
+         return fill;
+
+      }
+
+
+   };
+
+
+template <uint tile_size, uint bucket_size>
+using string_key_md_double = string_key_table<md_double_generic, tile_size, bucket_size>;
+
+template <uint tile_size, uint bucket_size>
+using string_key_md_p2 = string_key_table<md_p2_generic, tile_size, bucket_size>;
+
+
+} //namespace wrappers
+
+}  // namespace ht_project
+
+#endif //end of string key include guard
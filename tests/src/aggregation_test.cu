@@ -0,0 +1,365 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Duplicate key aggregation benchmark.
+// Runs a batch of upserts against each table with and without warp-level aggregation
+// (helpers/key_aggregation.cuh), for last-writer-wins replace and for additive upserts.
+// Reports throughput and the table ops (= lock acquisitions) saved. The host swiss table
+// is run the same way with block sort aggregation (helpers/host_aggregation.cuh).
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/key_aggregation.cuh>
+#include <hashing_project/helpers/host_aggregation.cuh>
+#include <hashing_project/helpers/zipf.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+
+using replace_agg = hashing_project::helpers::replace_aggregation;
+using add_agg = hashing_project::helpers::add_aggregation<DATA_TYPE, DATA_TYPE>;
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   return vals;
+}
+
+
+//keys drawn from n_keys distinct values. zipfian ranks are hashed so hot keys land in unrelated buckets.
+//+1 keeps keys off the sentinel.
+__host__ uint64_t * generate_keys(uint64_t n_ops, uint64_t n_keys, bool zipfian, double alpha){
+
+   uint64_t * keys;
+
+   if (zipfian){
+      keys = generate_zipfian_values(n_ops, n_keys, alpha);
+   } else {
+      keys = generate_data<uint64_t>(n_ops);
+   }
+
+   for (uint64_t i = 0; i < n_ops; i++){
+
+      uint64_t rank = keys[i] % n_keys;
+
+      keys[i] = hashing_project::host::hash(&rank, sizeof(uint64_t), 42) % (~0ULL - 2) + 1;
+   }
+
+   return keys;
+
+}
+
+
+template <typename ht_type, typename aggregation, uint tile_size, bool aggregate>
+__host__ double run_batch(uint64_t table_capacity, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_ops, uint64_t * n_issued, std::string label){
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   n_issued[0] = 0;
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer batch_timer;
+
+   hashing_project::helpers::batch_upsert<aggregation, tile_size, aggregate>(table, keys, vals, n_ops, n_issued);
+
+   batch_timer.sync_end();
+
+   batch_timer.print_throughput(label.c_str(), n_ops);
+
+   printf("%s: %lu table ops issued, %lu lock acquisitions saved\n", label.c_str(), n_issued[0], n_ops - n_issued[0]);
+
+   ht_type::free_on_device(table);
+
+   return 1.0*n_ops/(batch_timer.elapsed()*1000000);
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void aggregation_test(uint64_t table_capacity, DATA_TYPE * keys, DATA_TYPE * vals, DATA_TYPE * ones, uint64_t n_ops, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   uint64_t * n_issued;
+
+   cudaMallocManaged((void **)&n_issued, sizeof(uint64_t));
+
+
+   double replace_plain = run_batch<ht_type, replace_agg, tile_size, false>(table_capacity, keys, vals, n_ops, n_issued, name + " replace");
+   uint64_t replace_plain_ops = n_issued[0];
+
+   double replace_agg_perf = run_batch<ht_type, replace_agg, tile_size, true>(table_capacity, keys, vals, n_ops, n_issued, name + " replace aggregated");
+   uint64_t replace_agg_ops = n_issued[0];
+
+   double add_plain = run_batch<ht_type, add_agg, tile_size, false>(table_capacity, keys, ones, n_ops, n_issued, name + " add");
+   uint64_t add_plain_ops = n_issued[0];
+
+   double add_agg_perf = run_batch<ht_type, add_agg, tile_size, true>(table_capacity, keys, ones, n_ops, n_issued, name + " add aggregated");
+   uint64_t add_agg_ops = n_issued[0];
+
+
+   myfile << name << ",replace," << std::setprecision(12) << replace_plain << "," << replace_plain_ops << "," << replace_agg_perf << "," << replace_agg_ops << "\n";
+   myfile << name << ",add," << std::setprecision(12) << add_plain << "," << add_plain_ops << "," << add_agg_perf << "," << add_agg_ops << "\n";
+
+   cudaFree(n_issued);
+
+}
+
+
+template <typename aggregation>
+__host__ double run_host_batch(uint64_t table_capacity, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_ops, uint32_t n_threads, bool aggregate, uint64_t & n_issued, std::string label){
+
+   using ht_type = hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>;
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   n_issued = hashing_project::host::host_batch_upsert<aggregation>(table, keys, vals, n_ops, n_threads, aggregate);
+
+   auto end = std::chrono::high_resolution_clock::now();
+
+   double duration = std::chrono::duration<double>(end-start).count();
+
+   printf("%s: %f ops/s, %lu table ops issued, %lu lock acquisitions saved\n", label.c_str(), 1.0*n_ops/duration, n_issued, n_ops - n_issued);
+
+   ht_type::free_on_host(table);
+
+   return 1.0*n_ops/(duration*1000000);
+
+}
+
+
+__host__ void host_aggregation_test(uint64_t table_capacity, DATA_TYPE * keys, DATA_TYPE * vals, DATA_TYPE * ones, uint64_t n_ops, uint32_t n_threads, std::ofstream & myfile){
+
+   using host_replace = hashing_project::host::host_replace_aggregation;
+   using host_add = hashing_project::host::host_add_aggregation<DATA_TYPE, DATA_TYPE>;
+
+   uint64_t replace_plain_ops, replace_agg_ops, add_plain_ops, add_agg_ops;
+
+   double replace_plain = run_host_batch<host_replace>(table_capacity, keys, vals, n_ops, n_threads, false, replace_plain_ops, "host swiss replace");
+   double replace_agg_perf = run_host_batch<host_replace>(table_capacity, keys, vals, n_ops, n_threads, true, replace_agg_ops, "host swiss replace aggregated");
+   double add_plain = run_host_batch<host_add>(table_capacity, keys, ones, n_ops, n_threads, false, add_plain_ops, "host swiss add");
+   double add_agg_perf = run_host_batch<host_add>(table_capacity, keys, ones, n_ops, n_threads, true, add_agg_ops, "host swiss add aggregated");
+
+   myfile << "host_swiss,replace," << std::setprecision(12) << replace_plain << "," << replace_plain_ops << "," << replace_agg_perf << "," << replace_agg_ops << "\n";
+   myfile << "host_swiss,add," << std::setprecision(12) << add_plain << "," << add_plain_ops << "," << add_agg_perf << "," << add_agg_ops << "\n";
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, uint64_t n_ops, bool zipfian, double alpha, uint32_t n_threads){
+
+
+   //distinct keys fill the table to ~85%.
+   uint64_t n_keys = table_capacity*.85;
+
+   DATA_TYPE * host_keys = generate_keys(n_ops, n_keys, zipfian, alpha);
+
+   DATA_TYPE * host_vals;
+   DATA_TYPE * host_ones;
+
+   cudaMallocHost((void **)&host_vals, sizeof(DATA_TYPE)*n_ops);
+   cudaMallocHost((void **)&host_ones, sizeof(DATA_TYPE)*n_ops);
+
+   for (uint64_t i = 0; i < n_ops; i++){
+      host_vals[i] = i;
+      host_ones[i] = 1;
+   }
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_ops);
+   DATA_TYPE * vals = gallatin::utils::get_device_version<DATA_TYPE>(n_ops);
+   DATA_TYPE * ones = gallatin::utils::get_device_version<DATA_TYPE>(n_ops);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_ops, cudaMemcpyHostToDevice);
+   cudaMemcpy(vals, host_vals, sizeof(DATA_TYPE)*n_ops, cudaMemcpyHostToDevice);
+   cudaMemcpy(ones, host_ones, sizeof(DATA_TYPE)*n_ops, cudaMemcpyHostToDevice);
+
+
+   std::string filename = "results/aggregation/";
+
+   if (zipfian){
+      filename += "zipfian_" + std::to_string(alpha) + "_" + table + ".txt";
+   } else {
+      filename += "uniform_" + table + ".txt";
+   }
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,op,plain_throughput,plain_ops,aggregated_throughput,aggregated_ops\n";
+
+
+   if (table == "p2" || table == "all"){
+      aggregation_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      aggregation_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      aggregation_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      aggregation_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      aggregation_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      aggregation_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      aggregation_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, keys, vals, ones, n_ops, myfile);
+   }
+
+   if (table == "host" || table == "all"){
+      host_aggregation_test(table_capacity, host_keys, host_vals, host_ones, n_ops, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+   cudaFree(vals);
+   cudaFree(ones);
+
+   cudaFreeHost(host_keys);
+   cudaFreeHost(host_vals);
+   cudaFreeHost(host_ones);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("aggregation_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2MD double doubleMD iceberg icebergMD hopscotch host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--n_ops", "-n").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of upserts in the batch.");
+
+   program.add_argument("--zipfian", "-z").flag().help("Use zipfian keys. If not keys are uniform random.");
+
+   program.add_argument("--alpha", "-a").scan<'g', double>().help("Alpha value for the zipfian generator.").default_value(.99);
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host table.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_ops = program.get<uint64_t>("--n_ops");
+   auto zipfian = program.get<bool>("--zipfian");
+   auto alpha = program.get<double>("--alpha");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/aggregation")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, n_ops, zipfian, alpha, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
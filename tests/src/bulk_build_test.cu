@@ -0,0 +1,375 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Bulk build benchmark (helpers/bulk_build.cuh).
+// Builds each supported table at --load twice from the same random batch: once with the concurrent
+// upsert_replace fill kernel, once with bulk_build (sort by bucket, lock-free bucket fill, overflow
+// through upsert_replace). Reports both build throughputs, the speedup and the fraction of the batch
+// that overflowed its bucket. Every key is queried after each build and misses are printed.
+// The host swiss table is run the same way with --threads (helpers/host_bulk_build.cuh).
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <atomic>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/bulk_build.cuh>
+#include <hashing_project/helpers/host_bulk_build.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void fill_kernel(ht_type * table, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_keys){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], vals[tid]);
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void missing_kernel(ht_type * table, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_keys, uint64_t * n_missing){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   DATA_TYPE val;
+
+   bool found = table->find_with_reference(my_tile, keys[tid], val);
+
+   if ((!found || val != vals[tid]) && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)n_missing, 1ULL);
+   }
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void bulk_build_test(uint64_t table_capacity, double load, DATA_TYPE * keys, DATA_TYPE * vals, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   uint64_t * n_missing;
+
+   cudaMallocManaged((void **)&n_missing, sizeof(uint64_t)*2);
+
+   n_missing[0] = 0;
+   n_missing[1] = 0;
+
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer insert_timer;
+
+   fill_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, vals, n_keys);
+
+   insert_timer.sync_end();
+
+   missing_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, vals, n_keys, &n_missing[0]);
+
+   cudaDeviceSynchronize();
+
+   ht_type::free_on_device(table);
+
+
+   table = ht_type::generate_on_device(table_capacity, 42);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer bulk_timer;
+
+   auto result = hashing_project::helpers::bulk_build<tile_size>(table, keys, vals, n_keys);
+
+   bulk_timer.sync_end();
+
+   missing_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, vals, n_keys, &n_missing[1]);
+
+   cudaDeviceSynchronize();
+
+   uint64_t n_filled = table->get_fill();
+
+   ht_type::free_on_device(table);
+
+
+   double insert_throughput = n_keys/(insert_timer.elapsed()*1000000);
+   double bulk_throughput = n_keys/(bulk_timer.elapsed()*1000000);
+
+   printf("%s: insert %f M/s, bulk build %f M/s = %fx, %lu placed, %lu overflow (%f), %lu failed, fill %lu / %lu, missing %lu insert / %lu bulk\n", name.c_str(), insert_throughput, bulk_throughput, bulk_throughput/insert_throughput, result.n_placed, result.n_overflow, 1.0*result.n_overflow/n_keys, result.n_failed, n_filled, n_keys, n_missing[0], n_missing[1]);
+
+   myfile << name << "," << load << "," << std::setprecision(12) << insert_throughput << "," << bulk_throughput << "," << bulk_throughput/insert_throughput << "," << result.n_placed << "," << result.n_overflow << "," << result.n_failed << "," << n_missing[0] << "," << n_missing[1] << "\n";
+
+   cudaFree(n_missing);
+
+}
+
+
+template <typename ht_type>
+__host__ void host_bulk_build_test(uint64_t table_capacity, double load, DATA_TYPE * keys, DATA_TYPE * vals, uint32_t n_threads, std::ofstream & myfile){
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   std::atomic<uint64_t> n_missing[2];
+
+   n_missing[0] = 0;
+   n_missing[1] = 0;
+
+   auto check_table = [&](ht_type * table, int run){
+
+      hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+
+         DATA_TYPE val;
+
+         if (!table->find_with_reference(keys[i], val) || val != vals[i]) n_missing[run].fetch_add(1);
+
+      });
+
+   };
+
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   auto insert_start = std::chrono::high_resolution_clock::now();
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], vals[i]);
+   });
+
+   auto insert_end = std::chrono::high_resolution_clock::now();
+
+   check_table(table, 0);
+
+   ht_type::free_on_host(table);
+
+
+   table = ht_type::generate_on_host(table_capacity, 42);
+
+   auto bulk_start = std::chrono::high_resolution_clock::now();
+
+   auto result = hashing_project::host::bulk_build(table, keys, vals, n_keys, n_threads);
+
+   auto bulk_end = std::chrono::high_resolution_clock::now();
+
+   check_table(table, 1);
+
+   ht_type::free_on_host(table);
+
+
+   double insert_throughput = n_keys/(std::chrono::duration<double>(insert_end-insert_start).count()*1000000);
+   double bulk_throughput = n_keys/(std::chrono::duration<double>(bulk_end-bulk_start).count()*1000000);
+
+   printf("%s: insert %f M/s, bulk build %f M/s = %fx, %lu placed, %lu overflow (%f), %lu failed, missing %lu insert / %lu bulk\n", name.c_str(), insert_throughput, bulk_throughput, bulk_throughput/insert_throughput, result.n_placed, result.n_overflow, 1.0*result.n_overflow/n_keys, result.n_failed, n_missing[0].load(), n_missing[1].load());
+
+   myfile << name << "," << load << "," << std::setprecision(12) << insert_throughput << "," << bulk_throughput << "," << bulk_throughput/insert_throughput << "," << result.n_placed << "," << result.n_overflow << "," << result.n_failed << "," << n_missing[0].load() << "," << n_missing[1].load() << "\n";
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, double load, uint32_t n_threads){
+
+
+   uint64_t n_keys = table_capacity*load;
+
+   DATA_TYPE * host_keys = generate_data<DATA_TYPE>(n_keys);
+
+   DATA_TYPE * host_vals;
+
+   cudaMallocHost((void **)&host_vals, sizeof(DATA_TYPE)*n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      host_vals[i] = i+1;
+   }
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+   DATA_TYPE * vals = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+   cudaMemcpy(vals, host_vals, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+
+   std::string filename = "results/bulk_build/" + table + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,load,insert_throughput,bulk_throughput,speedup,placed,overflow,failed,insert_missing,bulk_missing\n";
+
+
+   if (table == "p2" || table == "all"){
+      bulk_build_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, load, keys, vals, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      bulk_build_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, load, keys, vals, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      bulk_build_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, load, keys, vals, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      bulk_build_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, load, keys, vals, myfile);
+   }
+
+   if (table == "host" || table == "all"){
+      host_bulk_build_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, host_vals, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+   cudaFree(vals);
+
+   cudaFreeHost(host_keys);
+   cudaFreeHost(host_vals);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("bulk_build_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 double iceberg cuckoo host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table built from the batch.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host table.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/bulk_build")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, load, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
@@ -52,6 +52,7 @@ namespace fs = std::filesystem;
 #include <hashing_project/tables/cuckoo.cuh>
 
 #include <hashing_project/helpers/zipf.cuh>
+#include <hashing_project/helpers/lock_layouts.cuh>
 #include <cooperative_groups.h>
 
 namespace cg = cooperative_groups;
@@ -65,6 +66,31 @@ using namespace gallatin::allocators;
    #define TEST_BLOCK_SIZE 256
 #endif
 
+//cache tables with reader-writer bucket locks - hits share the bucket, inserts/evictions are exclusive.
+using rw_locks = hashing_project::helpers::rw_bucket_locks<32>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using p2_ext_rw = hashing_project::tables::p2_ext_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using md_p2_rw = hashing_project::tables::md_p2_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using double_rw = hashing_project::tables::double_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using md_double_rw = hashing_project::tables::md_double_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using iht_p2_rw = hashing_project::tables::iht_p2_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using iht_p2_metadata_full_rw = hashing_project::tables::iht_p2_metadata_full_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+template <typename Key, typename Val, uint tile_size, uint bucket_size>
+using chaining_rw = hashing_project::tables::chaining_generic_with_locks<Key, Val, tile_size, bucket_size, rw_locks>;
+
+
 template <typename T>
 __host__ T * generate_uniform(uint64_t nitems){
 
@@ -154,7 +180,7 @@ __global__ void cache_read_kernel(cache_type * cache, uint64_t n_indices, uint64
 //The correctness check is done by treating each allocation as a uint64_t and writing the tid
 // if TID is not what is expected, we know that a double malloc has occurred.
 template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
-__host__ void cache_test(uint64_t host_items, uint64_t n_ops, uint64_t * data_pattern, bool zipfian){
+__host__ void cache_test(uint64_t host_items, uint64_t n_ops, uint64_t * data_pattern, bool zipfian, double alpha, std::string lock_suffix){
 
 
    using cache_type = hashing_project::ht_fifo_cache<hash_table_type, tile_size, bucket_size>;
@@ -178,6 +204,10 @@ __host__ void cache_test(uint64_t host_items, uint64_t n_ops, uint64_t * data_pa
 
    filename += cache_type::get_name();
 
+   if (zipfian) filename += "_" + std::to_string(alpha);
+
+   filename += lock_suffix;
+
    filename += ".txt";
 
    //std::string filename = "results/cache/" + "test" + ".txt";
@@ -258,44 +288,78 @@ __host__ void cache_test(uint64_t host_items, uint64_t n_ops, uint64_t * data_pa
 }
 
 
-__host__ void execute_test(std::string table, uint64_t n_ops, uint64_t host_items, bool zipfian, double alpha){
+__host__ void execute_rw_test(std::string table, uint64_t n_ops, uint64_t host_items, uint64_t * access_data, bool zipfian, double alpha){
+
+   std::string suffix = "_" + rw_locks::get_name();
+
+   if (table == "p2"){
+      cache_test<p2_ext_rw, 8, 32>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+   } else if (table == "p2MD"){
+      cache_test<md_p2_rw, 4, 32>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+   } else if (table == "double"){
+      cache_test<double_rw, 8, 8>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+   } else if (table == "doubleMD"){
+      cache_test<md_double_rw, 4, 32>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+   } else if (table == "iceberg"){
+      cache_test<iht_p2_rw, 8, 32>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+   } else if (table == "icebergMD"){
+      cache_test<iht_p2_metadata_full_rw, 4, 32>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+   } else if (table == "chaining"){
+
+      init_global_allocator(16ULL*1024*1024*1024, 111);
+
+      cache_test<chaining_rw, 4, 8>(host_items, n_ops, access_data, zipfian, alpha, suffix);
+
+      free_global_allocator();
+   } else {
+      throw std::runtime_error("Unknown table");
+   }
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t n_ops, uint64_t host_items, bool zipfian, double alpha, bool use_rw_locks){
 
 
    uint64_t * access_data = generate_data<uint64_t>(n_ops, host_items, zipfian, alpha);
    //auto access_pattern = generate_data<DATA_TYPE>(table_capacity);
 
-   if (table == "p2"){
+   if (use_rw_locks){
 
-      cache_test<hashing_project::tables::p2_ext_generic, 8, 32>(host_items, n_ops, access_data,zipfian);
+      execute_rw_test(table, n_ops, host_items, access_data, zipfian, alpha);
+
+   } else if (table == "p2"){
+
+      cache_test<hashing_project::tables::p2_ext_generic, 8, 32>(host_items, n_ops, access_data, zipfian, alpha, "");
 
       //p2 p2MD double doubleMD iceberg icebergMD cuckoo chaining bght_p2 bght_cuckoo");
 
 
    } else if (table == "p2MD"){
 
-      cache_test<hashing_project::tables::md_p2_generic, 4, 32>(host_items, n_ops, access_data,zipfian);
+      cache_test<hashing_project::tables::md_p2_generic, 4, 32>(host_items, n_ops, access_data, zipfian, alpha, "");
 
    } else if (table == "double"){
-      cache_test<hashing_project::tables::double_generic, 8, 8>(host_items, n_ops, access_data,zipfian);
+      cache_test<hashing_project::tables::double_generic, 8, 8>(host_items, n_ops, access_data, zipfian, alpha, "");
 
    } else if (table == "doubleMD"){
 
-      cache_test<hashing_project::tables::md_double_generic, 4, 32>(host_items, n_ops, access_data,zipfian);
+      cache_test<hashing_project::tables::md_double_generic, 4, 32>(host_items, n_ops, access_data, zipfian, alpha, "");
 
 
    } else if (table == "iceberg"){
 
-      cache_test<hashing_project::tables::iht_p2_generic, 8, 32>(host_items, n_ops, access_data,zipfian);
+      cache_test<hashing_project::tables::iht_p2_generic, 8, 32>(host_items, n_ops, access_data, zipfian, alpha, "");
      
    } else if (table == "icebergMD"){
 
-      cache_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(host_items, n_ops, access_data,zipfian);
+      cache_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(host_items, n_ops, access_data, zipfian, alpha, "");
 
    } else if (table == "chaining"){
 
       init_global_allocator(16ULL*1024*1024*1024, 111);
 
-      cache_test<hashing_project::tables::chaining_generic, 4, 8>(host_items, n_ops, access_data,zipfian);
+      cache_test<hashing_project::tables::chaining_generic, 4, 8>(host_items, n_ops, access_data, zipfian, alpha, "");
 
       free_global_allocator();
    } else {
@@ -327,7 +391,9 @@ int main(int argc, char** argv) {
 
    program.add_argument("--zipfian", "-z").flag().help("Use zipfian values. If not queries are uniform random.");
 
-   program.add_argument("--alpha", "-a").scan<'g', double>().help("Alpha value for the zipfian generator, should be between 0-1.").default_value(.9);
+   program.add_argument("--alpha", "-a").scan<'g', double>().help("Alpha value for the zipfian generator. Values above 1 (e.g. 1.2) concentrate more queries on the hottest keys.").default_value(.9);
+
+   program.add_argument("--rw_locks", "-r").flag().help("Use reader-writer bucket locks so cache hits share the bucket lock.");
 
    try {
     program.parse_args(argc, argv);
@@ -347,6 +413,8 @@ int main(int argc, char** argv) {
 
    double alpha = program.get<double>("--alpha");
 
+   bool use_rw_locks = program.get<bool>("--rw_locks");
+
    // uint64_t host_items;
 
    // uint64_t n_ops;
@@ -382,7 +450,7 @@ int main(int argc, char** argv) {
     //std::cerr << "Failed to create a directory\n";
    }
 
-   execute_test(table, n_queries, host_items, zipfian, alpha);
+   execute_test(table, n_queries, host_items, zipfian, alpha, use_rw_locks);
 
    //uint64_t * access_data = generate_data<uint64_t>(n_ops);
 
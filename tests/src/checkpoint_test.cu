@@ -0,0 +1,490 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Checkpoint benchmark (helpers/checkpoint.cuh).
+// Fills each table to --load with key -> insert index + 1 and times the fill as the re-insertion
+// baseline. The table is saved to --dir, freed and restored with load_checkpoint() twice: once after dropping
+// the file from the page cache (cold, disk bound) and once with it cached (warm).
+// A query kernel then looks up every inserted key in the restored table.
+// Reports fill, save and restore times and the restore speedup over re-insertion.
+// Host swiss, hopscotch and quotient iceberg tables restore by mmap with no copy, so their restore is
+// also timed with the first full query pass, which faults the pages in.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <atomic>
+#include <openssl/rand.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/checkpoint.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_inverted.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+#include <hashing_project/tables/chaining.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/host_tables/hopscotch.cuh>
+#include <hashing_project/host_tables/iceberg_quotient.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void fill_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], tid+1);
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void missing_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * n_missing){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   DATA_TYPE val;
+
+   bool found = table->find_with_reference(my_tile, keys[tid], val);
+
+   if (!found && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)n_missing, 1ULL);
+   }
+
+}
+
+
+//write back and evict the checkpoint from the page cache so the next load reads from disk.
+__host__ void drop_from_page_cache(std::string path){
+
+   int fd = open(path.c_str(), O_RDONLY);
+
+   if (fd < 0) return;
+
+   fdatasync(fd);
+
+   posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+   close(fd);
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void checkpoint_test(uint64_t table_capacity, double load, DATA_TYPE * keys, std::string dir, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   std::string path = dir + "/" + name + ".ckpt";
+
+   uint64_t n_keys = table_capacity*load;
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer fill_timer;
+
+   fill_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, n_keys);
+
+   fill_timer.sync_end();
+
+   uint64_t n_filled = table->get_fill();
+
+   gallatin::utils::timer save_timer;
+
+   bool saved = table->save_checkpoint(path);
+
+   save_timer.sync_end();
+
+   ht_type::free_on_device(table);
+
+   if (!saved){
+      printf("%s save failed\n", name.c_str());
+      return;
+   }
+
+   uint64_t file_bytes = fs::file_size(path);
+
+   double restore_times[2];
+
+   uint64_t n_restored = 0;
+
+   uint64_t * n_missing;
+
+   cudaMallocManaged((void **)&n_missing, sizeof(uint64_t));
+
+   n_missing[0] = 0;
+
+   for (int warm = 0; warm < 2; warm++){
+
+      if (!warm) drop_from_page_cache(path);
+
+      cudaDeviceSynchronize();
+
+      gallatin::utils::timer restore_timer;
+
+      table = ht_type::load_checkpoint(path);
+
+      restore_timer.sync_end();
+
+      restore_times[warm] = restore_timer.elapsed();
+
+      if (table == nullptr){
+         printf("%s load failed\n", name.c_str());
+         cudaFree(n_missing);
+         fs::remove(path);
+         return;
+      }
+
+      if (warm){
+
+         n_restored = table->get_fill();
+
+         missing_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, n_keys, n_missing);
+
+         cudaDeviceSynchronize();
+
+      }
+
+      ht_type::free_on_device(table);
+
+   }
+
+   fs::remove(path);
+
+   double fill_time = fill_timer.elapsed();
+
+   printf("%s: %lu bytes, fill %f ms, save %f ms, restore cold %f ms / warm %f ms = %fx re-insertion, %lu / %lu restored, %lu missing\n", name.c_str(), file_bytes, fill_time*1000, save_timer.elapsed()*1000, restore_times[0]*1000, restore_times[1]*1000, fill_time/restore_times[1], n_restored, n_filled, n_missing[0]);
+
+   myfile << name << "," << load << "," << std::setprecision(12) << fill_time*1000 << "," << save_timer.elapsed()*1000 << "," << restore_times[0]*1000 << "," << restore_times[1]*1000 << "," << fill_time/restore_times[0] << "," << fill_time/restore_times[1] << "," << file_bytes << "," << n_filled << "," << n_restored << "," << n_missing[0] << "\n";
+
+   cudaFree(n_missing);
+
+}
+
+
+template <typename ht_type>
+__host__ void host_checkpoint_test(uint64_t table_capacity, double load, DATA_TYPE * keys, uint32_t n_threads, std::string dir, std::ofstream & myfile){
+
+   std::string name = ht_type::get_name();
+
+   std::string path = dir + "/" + name + ".ckpt";
+
+   uint64_t n_keys = table_capacity*load;
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   auto fill_start = std::chrono::high_resolution_clock::now();
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], (DATA_TYPE) i+1);
+   });
+
+   auto fill_end = std::chrono::high_resolution_clock::now();
+
+   double fill_time = std::chrono::duration<double>(fill_end-fill_start).count();
+
+   uint64_t n_filled = table->get_fill();
+
+   auto save_start = std::chrono::high_resolution_clock::now();
+
+   bool saved = table->save_checkpoint(path);
+
+   auto save_end = std::chrono::high_resolution_clock::now();
+
+   ht_type::free_on_host(table);
+
+   if (!saved){
+      printf("%s save failed\n", name.c_str());
+      return;
+   }
+
+   uint64_t file_bytes = fs::file_size(path);
+
+   //[warm] -> load only, load + first query pass.
+   double restore_times[2];
+   double touch_times[2];
+
+   uint64_t n_restored = 0;
+
+   std::atomic<uint64_t> n_missing(0);
+
+   for (int warm = 0; warm < 2; warm++){
+
+      if (!warm) drop_from_page_cache(path);
+
+      auto restore_start = std::chrono::high_resolution_clock::now();
+
+      table = ht_type::load_checkpoint(path);
+
+      auto restore_end = std::chrono::high_resolution_clock::now();
+
+      if (table == nullptr){
+         printf("%s load failed\n", name.c_str());
+         fs::remove(path);
+         return;
+      }
+
+      n_missing = 0;
+
+      hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+
+         DATA_TYPE val;
+
+         if (!table->find_with_reference(keys[i], val)) n_missing.fetch_add(1);
+
+      });
+
+      auto touch_end = std::chrono::high_resolution_clock::now();
+
+      restore_times[warm] = std::chrono::duration<double>(restore_end-restore_start).count();
+      touch_times[warm] = std::chrono::duration<double>(touch_end-restore_start).count();
+
+      if (warm) n_restored = table->get_fill();
+
+      ht_type::free_on_host(table);
+
+   }
+
+   fs::remove(path);
+
+   printf("%s: %lu bytes, fill %f ms, save %f ms, restore cold %f ms (%f ms with first query pass) / warm %f ms (%f ms) = %fx re-insertion, %lu / %lu restored, %lu missing\n", name.c_str(), file_bytes, fill_time*1000, std::chrono::duration<double>(save_end-save_start).count()*1000, restore_times[0]*1000, touch_times[0]*1000, restore_times[1]*1000, touch_times[1]*1000, fill_time/restore_times[1], n_restored, n_filled, n_missing.load());
+
+   //speedups for the host tables count the query pass that faults the mapping in.
+   myfile << name << "," << load << "," << std::setprecision(12) << fill_time*1000 << "," << std::chrono::duration<double>(save_end-save_start).count()*1000 << "," << touch_times[0]*1000 << "," << touch_times[1]*1000 << "," << fill_time/touch_times[0] << "," << fill_time/touch_times[1] << "," << file_bytes << "," << n_filled << "," << n_restored << "," << n_missing.load() << "\n";
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, double load, uint32_t n_threads, std::string dir){
+
+
+   uint64_t n_keys = table_capacity*load;
+
+   DATA_TYPE * host_keys = generate_data<DATA_TYPE>(n_keys);
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+
+   std::string filename = "results/checkpoint/" + table + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,load,fill_ms,save_ms,restore_cold_ms,restore_warm_ms,speedup_cold,speedup_warm,file_bytes,fill,restored,missing\n";
+
+
+   if (table == "p2" || table == "all"){
+      checkpoint_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "p2_inv" || table == "all"){
+      checkpoint_test<hashing_project::tables::p2_inv_generic, 8, 32>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      checkpoint_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      checkpoint_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      checkpoint_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      checkpoint_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      checkpoint_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      checkpoint_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      checkpoint_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, load, keys, dir, myfile);
+   }
+
+   if (table == "chaining" || table == "all"){
+
+      //chain blocks come from the global allocator, on fill and on load.
+      init_global_allocator(20ULL*1024*1024*1024, 111);
+
+      checkpoint_test<hashing_project::tables::chaining_generic, 4, 8>(table_capacity, load, keys, dir, myfile);
+
+      free_global_allocator();
+
+   }
+
+   if (table == "host" || table == "all"){
+      host_checkpoint_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, dir, myfile);
+      host_checkpoint_test<hashing_project::tables::host_hopscotch_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, dir, myfile);
+      host_checkpoint_test<hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, dir, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+
+   cudaFreeHost(host_keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("checkpoint_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2_inv p2MD double doubleMD iceberg icebergMD cuckoo hopscotch chaining host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table filled before saving.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host tables.");
+
+   program.add_argument("--dir", "-d").default_value(std::string("results/checkpoint")).help("Directory for the checkpoint files, removed after each table.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto n_threads = program.get<uint32_t>("--threads");
+   auto dir = program.get<std::string>("--dir");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/checkpoint")){
+   } else {
+   }
+
+   fs::create_directories(dir);
+
+
+   execute_test(table, table_capacity, load, n_threads, dir);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
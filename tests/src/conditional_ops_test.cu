@@ -0,0 +1,430 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Conditional op benchmark (helpers/conditional_ops.cuh).
+// Preloads part of the key set with key -> key, then runs one pass of each op over every key:
+//   insert_if_absent(key, key)             - succeeds for the keys not preloaded
+//   fetch_add(key, 1)                      - value is now key+1
+//   fetch_or(key, 1 << 40)                 - value is now (key+1) | 1 << 40
+//   compare_exchange(key, that, key)       - value is back to key
+//   erase_if_value(key, key)               - table is empty again
+// Every op after the first should succeed on every key, so the success counts double as a check.
+// Host swiss and hopscotch tables are run the same way (helpers/host_conditional_ops.cuh).
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/conditional_ops.cuh>
+#include <hashing_project/helpers/host_conditional_ops.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_inverted.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/iht_p2_metadata_quotient.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+#include <hashing_project/tables/chaining.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/host_tables/hopscotch.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+//conditional_ops_seqlock_test builds this file with STABLE_HT_LOCKLESS_QUERY=1.
+#if STABLE_HT_LOCKLESS_QUERY
+#define RESULTS_DIR "results/conditional_ops_seqlock"
+#else
+#define RESULTS_DIR "results/conditional_ops"
+#endif
+
+#define OR_BIT (1ULL << 40)
+
+
+enum conditional_op {
+   INSERT_IF_ABSENT,
+   FETCH_ADD,
+   FETCH_OR,
+   COMPARE_EXCHANGE,
+   ERASE_IF_VALUE
+};
+
+static const char * op_names[] = {"insert_if_absent", "fetch_add", "fetch_or", "compare_exchange", "erase_if_value"};
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keys stay below OR_BIT so the or is visible, +1 keeps them off the sentinel.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (OR_BIT - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void preload_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], keys[tid]);
+
+}
+
+
+template <typename ht_type, uint tile_size, conditional_op op>
+__global__ void op_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * n_succeeded){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   DATA_TYPE key = keys[tid];
+
+   DATA_TYPE old_val;
+
+   bool succeeded;
+
+   if (op == INSERT_IF_ABSENT){
+      succeeded = hashing_project::helpers::insert_if_absent(my_tile, table, key, key);
+   } else if (op == FETCH_ADD){
+      succeeded = hashing_project::helpers::fetch_add(my_tile, table, key, (DATA_TYPE) 1, old_val) && old_val == key;
+   } else if (op == FETCH_OR){
+      succeeded = hashing_project::helpers::fetch_or(my_tile, table, key, (DATA_TYPE) OR_BIT, old_val) && old_val == key+1;
+   } else if (op == COMPARE_EXCHANGE){
+      succeeded = hashing_project::helpers::compare_exchange(my_tile, table, key, (DATA_TYPE) ((key+1) | OR_BIT), key, old_val);
+   } else {
+      succeeded = hashing_project::helpers::erase_if_value(my_tile, table, key, key);
+   }
+
+   if (succeeded && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)n_succeeded, 1ULL);
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size, conditional_op op>
+__host__ double run_op(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * n_succeeded){
+
+   n_succeeded[0] = 0;
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer op_timer;
+
+   op_kernel<ht_type, tile_size, op><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, n_keys, n_succeeded);
+
+   op_timer.sync_end();
+
+   op_timer.print_throughput(op_names[op], n_keys);
+
+   printf("%s: %lu / %lu succeeded\n", op_names[op], n_succeeded[0], n_keys);
+
+   return 1.0*n_keys/(op_timer.elapsed()*1000000);
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void conditional_test(uint64_t table_capacity, DATA_TYPE * keys, uint64_t n_keys, uint64_t n_preload, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   uint64_t * n_succeeded;
+
+   cudaMallocManaged((void **)&n_succeeded, sizeof(uint64_t));
+
+   preload_kernel<ht_type, tile_size><<<(n_preload*tile_size-1)/256+1,256>>>(table, keys, n_preload);
+
+   cudaDeviceSynchronize();
+
+   double throughput[5];
+   uint64_t successes[5];
+
+   throughput[0] = run_op<ht_type, tile_size, INSERT_IF_ABSENT>(table, keys, n_keys, n_succeeded);
+   successes[0] = n_succeeded[0];
+
+   throughput[1] = run_op<ht_type, tile_size, FETCH_ADD>(table, keys, n_keys, n_succeeded);
+   successes[1] = n_succeeded[0];
+
+   throughput[2] = run_op<ht_type, tile_size, FETCH_OR>(table, keys, n_keys, n_succeeded);
+   successes[2] = n_succeeded[0];
+
+   throughput[3] = run_op<ht_type, tile_size, COMPARE_EXCHANGE>(table, keys, n_keys, n_succeeded);
+   successes[3] = n_succeeded[0];
+
+   throughput[4] = run_op<ht_type, tile_size, ERASE_IF_VALUE>(table, keys, n_keys, n_succeeded);
+   successes[4] = n_succeeded[0];
+
+   for (int i = 0; i < 5; i++){
+      myfile << name << "," << op_names[i] << "," << std::setprecision(12) << throughput[i] << "," << successes[i] << "," << n_keys << "\n";
+   }
+
+   cudaFree(n_succeeded);
+
+   ht_type::free_on_device(table);
+
+}
+
+
+template <typename ht_type>
+__host__ void host_conditional_test(uint64_t table_capacity, DATA_TYPE * keys, uint64_t n_keys, uint64_t n_preload, uint32_t n_threads, std::ofstream & myfile){
+
+   std::string name = ht_type::get_name();
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   hashing_project::host::parallel_for(n_threads, n_preload, [&](uint64_t i){
+      table->upsert_replace(keys[i], keys[i]);
+   });
+
+   for (int op = 0; op < 5; op++){
+
+      std::atomic<uint64_t> n_succeeded(0);
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+
+         DATA_TYPE key = keys[i];
+         DATA_TYPE old_val;
+
+         bool succeeded;
+
+         if (op == INSERT_IF_ABSENT){
+            succeeded = hashing_project::host::insert_if_absent(table, key, key);
+         } else if (op == FETCH_ADD){
+            succeeded = hashing_project::host::fetch_add(table, key, (DATA_TYPE) 1, old_val) && old_val == key;
+         } else if (op == FETCH_OR){
+            succeeded = hashing_project::host::fetch_or(table, key, (DATA_TYPE) OR_BIT, old_val) && old_val == key+1;
+         } else if (op == COMPARE_EXCHANGE){
+            succeeded = hashing_project::host::compare_exchange(table, key, (DATA_TYPE) ((key+1) | OR_BIT), key, old_val);
+         } else {
+            succeeded = hashing_project::host::erase_if_value(table, key, key);
+         }
+
+         if (succeeded) n_succeeded.fetch_add(1, std::memory_order_relaxed);
+
+      });
+
+      auto end = std::chrono::high_resolution_clock::now();
+
+      double duration = std::chrono::duration<double>(end-start).count();
+
+      printf("%s %s: %f ops/s, %lu / %lu succeeded\n", name.c_str(), op_names[op], n_keys/duration, n_succeeded.load(), n_keys);
+
+      myfile << name << "," << op_names[op] << "," << std::setprecision(12) << 1.0*n_keys/(duration*1000000) << "," << n_succeeded.load() << "," << n_keys << "\n";
+
+   }
+
+   ht_type::free_on_host(table);
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, uint32_t n_threads){
+
+
+   //every key fits (85% load), about 60% of them are preloaded.
+   uint64_t n_keys = table_capacity*.85;
+   uint64_t n_preload = table_capacity*.5;
+
+   DATA_TYPE * host_keys = generate_data<DATA_TYPE>(n_keys);
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+
+   std::string filename = RESULTS_DIR "/" + table + "_" + std::to_string(table_capacity) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,op,throughput,succeeded,n_ops\n";
+
+
+   if (table == "p2" || table == "all"){
+      conditional_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "p2_inv" || table == "all"){
+      conditional_test<hashing_project::tables::p2_inv_generic, 8, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      conditional_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      conditional_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      conditional_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      conditional_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      conditional_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "icebergQuotient" || table == "all"){
+      conditional_test<hashing_project::tables::iht_p2_metadata_quotient_generic, 4, 32>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      conditional_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      conditional_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "chaining" || table == "all"){
+      conditional_test<hashing_project::tables::chaining_generic, 4, 8>(table_capacity, keys, n_keys, n_preload, myfile);
+   }
+
+   if (table == "host" || table == "all"){
+      host_conditional_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, host_keys, n_keys, n_preload, n_threads, myfile);
+      host_conditional_test<hashing_project::tables::host_hopscotch_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, host_keys, n_keys, n_preload, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+
+   cudaFreeHost(host_keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("conditional_ops_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2_inv p2MD double doubleMD iceberg icebergMD icebergQuotient cuckoo hopscotch chaining host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host tables.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory(RESULTS_DIR)){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
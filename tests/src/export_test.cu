@@ -0,0 +1,466 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Export benchmark (helpers/table_export.cuh).
+// Fills each table to --load with key -> insert index + 1, then exports every live pair into dense
+// key / value arrays, unsorted and sorted by key. A verify kernel queries each exported pair back.
+// Bandwidth counts each exported pair read once and written once (a lower bound on the traffic),
+// reported in GB/s and as a fraction of the device's peak memory bandwidth.
+// Host swiss, hopscotch and quotient iceberg tables are run the same way (helpers/host_table_export.cuh),
+// with a parallel memcpy of the output size as the host reference bandwidth.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/table_export.cuh>
+#include <hashing_project/helpers/host_table_export.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_inverted.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/iht_p2_metadata_quotient.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+#include <hashing_project/tables/chaining.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/host_tables/hopscotch.cuh>
+#include <hashing_project/host_tables/iceberg_quotient.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void fill_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], tid+1);
+
+}
+
+
+//every exported pair must be in the table with the same value.
+template <typename ht_type, uint tile_size>
+__global__ void verify_kernel(ht_type * table, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_pairs, uint64_t * n_mismatches){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_pairs) return;
+
+   DATA_TYPE val;
+
+   bool found = table->find_with_reference(my_tile, keys[tid], val);
+
+   if ((!found || val != vals[tid]) && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)n_mismatches, 1ULL);
+   }
+
+}
+
+
+__global__ void sorted_check_kernel(DATA_TYPE * keys, uint64_t n_pairs, uint64_t * n_unsorted){
+
+   uint64_t tid = gallatin::utils::get_tid();
+
+   if (tid+1 >= n_pairs) return;
+
+   if (keys[tid] >= keys[tid+1]) atomicAdd((unsigned long long int *)n_unsorted, 1ULL);
+
+}
+
+
+//bytes/s from the memory clock and bus width, x2 for DDR.
+__host__ double get_peak_bandwidth(){
+
+   int device;
+   cudaGetDevice(&device);
+
+   int memory_clock_khz;
+   int bus_width_bits;
+
+   cudaDeviceGetAttribute(&memory_clock_khz, cudaDevAttrMemoryClockRate, device);
+   cudaDeviceGetAttribute(&bus_width_bits, cudaDevAttrGlobalMemoryBusWidth, device);
+
+   return 2.0*memory_clock_khz*1000*(bus_width_bits/8);
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void export_test(uint64_t table_capacity, double load, DATA_TYPE * keys, double peak_bandwidth, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   fill_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, n_keys);
+
+   cudaDeviceSynchronize();
+
+   uint64_t n_filled = table->get_fill();
+
+   DATA_TYPE * keys_out = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+   DATA_TYPE * vals_out = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   uint64_t * n_errors;
+
+   cudaMallocManaged((void **)&n_errors, sizeof(uint64_t)*2);
+
+   for (int sorted = 0; sorted < 2; sorted++){
+
+      cudaDeviceSynchronize();
+
+      gallatin::utils::timer export_timer;
+
+      uint64_t n_exported = hashing_project::helpers::export_pairs<tile_size>(table, keys_out, vals_out, n_keys, sorted);
+
+      export_timer.sync_end();
+
+      double duration = export_timer.elapsed();
+
+      if (n_exported > n_keys){
+         printf("%s export failed: %lu pairs do not fit\n", name.c_str(), n_exported);
+         continue;
+      }
+
+      n_errors[0] = 0;
+      n_errors[1] = 0;
+
+      verify_kernel<ht_type, tile_size><<<(n_exported*tile_size-1)/256+1,256>>>(table, keys_out, vals_out, n_exported, &n_errors[0]);
+
+      if (sorted){
+         sorted_check_kernel<<<(n_exported-1)/256+1,256>>>(keys_out, n_exported, &n_errors[1]);
+      }
+
+      cudaDeviceSynchronize();
+
+      double bandwidth = 2.0*n_exported*(sizeof(DATA_TYPE)*2)/duration;
+
+      printf("%s export%s: %lu / %lu pairs, %f GB/s = %f of peak, %lu mismatches, %lu out of order\n", name.c_str(), sorted ? " sorted" : "", n_exported, n_filled, bandwidth/1e9, bandwidth/peak_bandwidth, n_errors[0], n_errors[1]);
+
+      myfile << name << "," << load << "," << sorted << "," << std::setprecision(12) << 1.0*n_exported/(duration*1000000) << "," << bandwidth/1e9 << "," << bandwidth/peak_bandwidth << "," << n_filled << "," << n_exported << "," << n_errors[0] << "," << n_errors[1] << "\n";
+
+   }
+
+   cudaFree(n_errors);
+   cudaFree(keys_out);
+   cudaFree(vals_out);
+
+   ht_type::free_on_device(table);
+
+}
+
+
+//host reference bandwidth - parallel memcpy of n_bytes, counted as read + write.
+__host__ double host_copy_bandwidth(uint64_t n_bytes, uint32_t n_threads){
+
+   std::vector<char> src(n_bytes, 1);
+   std::vector<char> dst(n_bytes);
+
+   uint64_t chunk = 1ULL << 20;
+
+   uint64_t n_chunks = (n_bytes-1)/chunk+1;
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   hashing_project::host::parallel_for(n_threads, n_chunks, [&](uint64_t i){
+
+      uint64_t offset = i*chunk;
+
+      std::memcpy(dst.data()+offset, src.data()+offset, std::min(chunk, n_bytes-offset));
+
+   });
+
+   auto end = std::chrono::high_resolution_clock::now();
+
+   return 2.0*n_bytes/std::chrono::duration<double>(end-start).count();
+
+}
+
+
+template <typename ht_type>
+__host__ void host_export_test(uint64_t table_capacity, double load, DATA_TYPE * keys, uint32_t n_threads, std::ofstream & myfile){
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], (DATA_TYPE) i+1);
+   });
+
+   uint64_t n_filled = table->get_fill();
+
+   std::vector<DATA_TYPE> keys_out(n_keys);
+   std::vector<DATA_TYPE> vals_out(n_keys);
+
+   double reference_bandwidth = host_copy_bandwidth(n_keys*sizeof(DATA_TYPE)*2, n_threads);
+
+   for (int sorted = 0; sorted < 2; sorted++){
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      uint64_t n_exported = hashing_project::host::export_pairs(table, keys_out.data(), vals_out.data(), n_keys, sorted, n_threads);
+
+      auto end = std::chrono::high_resolution_clock::now();
+
+      double duration = std::chrono::duration<double>(end-start).count();
+
+      if (n_exported > n_keys){
+         printf("%s export failed: %lu pairs do not fit\n", name.c_str(), n_exported);
+         continue;
+      }
+
+      std::atomic<uint64_t> n_mismatches(0);
+      std::atomic<uint64_t> n_unsorted(0);
+
+      hashing_project::host::parallel_for(n_threads, n_exported, [&](uint64_t i){
+
+         DATA_TYPE val;
+
+         if (!table->find_with_reference(keys_out[i], val) || val != vals_out[i]) n_mismatches.fetch_add(1);
+
+         if (sorted && i+1 < n_exported && keys_out[i] >= keys_out[i+1]) n_unsorted.fetch_add(1);
+
+      });
+
+      double bandwidth = 2.0*n_exported*(sizeof(DATA_TYPE)*2)/duration;
+
+      printf("%s export%s: %lu / %lu pairs, %f GB/s = %f of memcpy, %lu mismatches, %lu out of order\n", name.c_str(), sorted ? " sorted" : "", n_exported, n_filled, bandwidth/1e9, bandwidth/reference_bandwidth, n_mismatches.load(), n_unsorted.load());
+
+      myfile << name << "," << load << "," << sorted << "," << std::setprecision(12) << 1.0*n_exported/(duration*1000000) << "," << bandwidth/1e9 << "," << bandwidth/reference_bandwidth << "," << n_filled << "," << n_exported << "," << n_mismatches.load() << "," << n_unsorted.load() << "\n";
+
+   }
+
+   ht_type::free_on_host(table);
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, double load, uint32_t n_threads){
+
+
+   double peak_bandwidth = get_peak_bandwidth();
+
+
+   uint64_t n_keys = table_capacity*load;
+
+   DATA_TYPE * host_keys = generate_data<DATA_TYPE>(n_keys);
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+
+   std::string filename = "results/export/" + table + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,load,sorted,throughput,bandwidth_gb,bandwidth_fraction,fill,exported,mismatches,out_of_order\n";
+
+
+   if (table == "p2" || table == "all"){
+      export_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "p2_inv" || table == "all"){
+      export_test<hashing_project::tables::p2_inv_generic, 8, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      export_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      export_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      export_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      export_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      export_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "icebergQuotient" || table == "all"){
+      export_test<hashing_project::tables::iht_p2_metadata_quotient_generic, 4, 32>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      export_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      export_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "chaining" || table == "all"){
+      export_test<hashing_project::tables::chaining_generic, 4, 8>(table_capacity, load, keys, peak_bandwidth, myfile);
+   }
+
+   if (table == "host" || table == "all"){
+      host_export_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, myfile);
+      host_export_test<hashing_project::tables::host_hopscotch_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, myfile);
+      host_export_test<hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+
+   cudaFreeHost(host_keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("export_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2_inv p2MD double doubleMD iceberg icebergMD icebergQuotient cuckoo hopscotch chaining host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table filled before exporting.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host tables.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/export")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, load, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
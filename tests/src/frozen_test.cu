@@ -0,0 +1,431 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Frozen snapshot benchmark.
+// Fills a live metadata table, freezes it, and compares:
+// 1. device query throughput of the live table vs the frozen snapshot (hits and misses).
+// 2. host query throughput of the same snapshot after to_host().
+// 3. bytes per key of both layouts, and save/load time of the snapshot file.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/frozen_table.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define DATA_TYPE uint64_t
+
+
+#define LARGE_MD_LOAD 1
+#define LARGE_BUCKET_MODS 0
+
+
+//frozen layout - 8 pairs is one 128 byte line, one pair per thread of the tile.
+#define FROZEN_TILE 8
+#define FROZEN_BUCKET 8
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void frozen_insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   if (!table->upsert_replace(my_tile, my_key, my_key+1)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//misses[1] counts keys not found, misses[2] found keys with the wrong value.
+//query_buffer holds inserted keys followed by fresh ones, so only the first n_present should hit.
+template <typename ht_type, uint tile_size>
+__global__ void frozen_query_kernel(ht_type * table, DATA_TYPE * query_buffer, uint64_t n_keys, uint64_t n_present, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = query_buffer[tid];
+   DATA_TYPE my_val;
+
+   bool found = table->find_with_reference(my_tile, my_key, my_val);
+
+   #if MEASURE_FAILS
+   if (my_tile.thread_rank() == 0){
+
+      if (tid < n_present && !found){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      } else if (found && my_val != my_key+1){
+         atomicAdd((unsigned long long int *)&misses[2], 1ULL);
+      }
+
+   }
+   #endif
+
+}
+
+
+template <template<typename, typename, uint, uint> typename live_table_type, uint tile_size, uint bucket_size>
+__host__ void frozen_test(uint64_t n_indices, DATA_TYPE * access_pattern, uint32_t n_threads, std::string name){
+
+
+   using live_table = live_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   using frozen_table = hashing_project::tables::frozen_generic<DATA_TYPE, DATA_TYPE, FROZEN_TILE, FROZEN_BUCKET>;
+
+   //host copy keeps the device bucket layout.
+   using host_table = typename frozen_table::host_type;
+
+
+   std::string filename = "results/frozen/" + name + ".txt";
+
+   std::ofstream myfile;
+   myfile.open (filename.c_str());
+   myfile << "table,n_keys,live_bytes_per_key,frozen_bytes_per_key,live_query,frozen_query,live_miss_query,frozen_miss_query,host_query,freeze,save,load\n";
+
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*3);
+
+   cudaDeviceSynchronize();
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+
+   double lf = .9;
+
+   uint64_t items_to_insert = lf*n_indices;
+
+   //access_pattern holds 2*n_indices keys - the second half is never inserted.
+   DATA_TYPE * device_data = gallatin::utils::get_device_version<DATA_TYPE>(2*items_to_insert);
+
+   cudaMemcpy(device_data, access_pattern, sizeof(DATA_TYPE)*items_to_insert, cudaMemcpyHostToDevice);
+   cudaMemcpy(device_data+items_to_insert, access_pattern+n_indices, sizeof(DATA_TYPE)*items_to_insert, cudaMemcpyHostToDevice);
+
+   cudaDeviceSynchronize();
+
+
+   live_table * table = live_table::generate_on_device(n_indices, 42);
+
+   frozen_insert_kernel<live_table, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   cudaDeviceSynchronize();
+
+   uint64_t n_live = table->get_fill();
+
+   live_table * host_live = gallatin::utils::copy_to_host<live_table>(table);
+
+   uint64_t live_bytes = host_live->n_buckets*(sizeof(typename live_table::bucket_type)+sizeof(typename live_table::md_bucket_type)) + (host_live->n_buckets-1)/8+1;
+
+   cudaFreeHost(host_live);
+
+
+   gallatin::utils::timer live_query_timer;
+
+   frozen_query_kernel<live_table, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, items_to_insert, misses);
+
+   live_query_timer.sync_end();
+
+   gallatin::utils::timer live_miss_timer;
+
+   frozen_query_kernel<live_table, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data+items_to_insert, items_to_insert, 0, misses);
+
+   live_miss_timer.sync_end();
+
+   printf("Live misses: insert %lu query %lu incorrect %lu\n", misses[0], misses[1], misses[2]);
+
+   misses[1] = 0;
+   misses[2] = 0;
+
+
+   gallatin::utils::timer freeze_timer;
+
+   frozen_table * frozen = frozen_table::freeze(table, 42);
+
+   freeze_timer.sync_end();
+
+   live_table::free_on_device(table);
+
+   frozen->print_fill();
+   frozen->print_space_usage();
+
+
+   gallatin::utils::timer frozen_query_timer;
+
+   frozen_query_kernel<frozen_table, FROZEN_TILE><<<(items_to_insert*FROZEN_TILE-1)/256+1,256>>>(frozen, device_data, items_to_insert, items_to_insert, misses);
+
+   frozen_query_timer.sync_end();
+
+   gallatin::utils::timer frozen_miss_timer;
+
+   frozen_query_kernel<frozen_table, FROZEN_TILE><<<(items_to_insert*FROZEN_TILE-1)/256+1,256>>>(frozen, device_data+items_to_insert, items_to_insert, 0, misses);
+
+   frozen_miss_timer.sync_end();
+
+   printf("Frozen misses: query %lu incorrect %lu\n", misses[1], misses[2]);
+
+   double frozen_bytes_per_key = frozen->get_bytes_per_key();
+
+
+   //host queries on the same snapshot.
+   host_table * host_frozen = frozen->to_host();
+
+   std::atomic<uint64_t> host_misses{0};
+
+   hashing_project::host::timer host_query_timer;
+
+   hashing_project::host::parallel_for(n_threads, items_to_insert, [&](uint64_t tid){
+
+      DATA_TYPE my_val;
+
+      if (!host_frozen->find_with_reference(access_pattern[tid], my_val) || my_val != access_pattern[tid]+1){
+         host_misses.fetch_add(1, std::memory_order_relaxed);
+      }
+
+   });
+
+   host_query_timer.sync_end();
+
+   printf("Host frozen misses: %lu\n", host_misses.load());
+
+   host_table::free_on_host(host_frozen);
+
+
+   //serialize and reload on the device.
+   std::string snapshot_file = "results/frozen/" + name + ".snapshot";
+
+   gallatin::utils::timer save_timer;
+
+   bool saved = frozen->save_checkpoint(snapshot_file);
+
+   save_timer.sync_end();
+
+   frozen_table::free_on_device(frozen);
+
+   gallatin::utils::timer load_timer;
+
+   frozen = frozen_table::load_checkpoint(snapshot_file);
+
+   load_timer.sync_end();
+
+   if (!saved || frozen == nullptr){
+
+      printf("Failed to round trip %s\n", snapshot_file.c_str());
+
+   } else {
+
+      frozen_query_kernel<frozen_table, FROZEN_TILE><<<(items_to_insert*FROZEN_TILE-1)/256+1,256>>>(frozen, device_data, items_to_insert, items_to_insert, misses);
+
+      cudaDeviceSynchronize();
+
+      printf("Reloaded misses: query %lu incorrect %lu\n", misses[1], misses[2]);
+
+      frozen_table::free_on_device(frozen);
+
+   }
+
+   fs::remove(snapshot_file);
+
+
+   printf("%s: live %f bytes/key, frozen %f bytes/key\n", name.c_str(), 1.0*live_bytes/n_live, frozen_bytes_per_key);
+
+   live_query_timer.print_throughput("Live queried", items_to_insert);
+   frozen_query_timer.print_throughput("Frozen queried", items_to_insert);
+   live_miss_timer.print_throughput("Live missed", items_to_insert);
+   frozen_miss_timer.print_throughput("Frozen missed", items_to_insert);
+   host_query_timer.print_throughput("Host frozen queried", items_to_insert);
+
+   myfile << live_table::get_name() << "," << n_live << "," << std::setprecision(12)
+          << 1.0*live_bytes/n_live << ","
+          << frozen_bytes_per_key << ","
+          << 1.0*items_to_insert/(live_query_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(frozen_query_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(live_miss_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(frozen_miss_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(host_query_timer.elapsed()*1000000) << ","
+          << freeze_timer.elapsed() << ","
+          << save_timer.elapsed() << ","
+          << load_timer.elapsed() << "\n";
+
+   myfile.close();
+
+
+   cudaFree(device_data);
+   cudaFree(misses);
+
+   cudaDeviceSynchronize();
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, uint32_t n_threads){
+
+
+   auto access_pattern = generate_data<DATA_TYPE>(2*table_capacity);
+
+   if (table == "doubleMD"){
+
+      frozen_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, access_pattern, n_threads, "doubleMD");
+
+   } else if (table == "p2MD"){
+
+      frozen_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, access_pattern, n_threads, "p2MD");
+
+   } else {
+      throw std::runtime_error("Unknown table");
+   }
+
+
+   cudaFreeHost(access_pattern);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("frozen_test");
+
+   program.add_argument("--table", "-t")
+   .required()
+   .help("Specify table type. Options [doubleMD p2MD]");
+
+   program.add_argument("--capacity", "-c").required().scan<'u', uint64_t>().help("Number of slots in the table. Default is 100,000,000");
+
+   program.add_argument("--threads")
+   .default_value((uint32_t) hashing_project::host::get_default_n_threads())
+   .scan<'u', uint32_t>()
+   .help("Host threads for the host snapshot queries.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   std::cout << "Running frozen test with table " << table << " and " << table_capacity << " slots." << std::endl;
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/frozen")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, n_threads);
+
+
+   return 0;
+
+}
@@ -0,0 +1,468 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Hot key cache benchmark - YCSB workload C (100% reads) over zipfian keys.
+// The table is loaded with n_keys distinct keys. Lookups are then run plain, and again with the
+// per-block shared memory hot cache (helpers/hot_key_cache.cuh). The hot set comes from a space
+// saving sketch fed by sampled lookups of a short warmup run. The host swiss table is run the same
+// way with a per-thread cache (helpers/host_hot_cache.cuh).
+// The cache validates entries with bucket versions, so this test enables STABLE_HT_LOCKLESS_QUERY.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#define STABLE_HT_LOCKLESS_QUERY 1
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <thread>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/hot_key_cache.cuh>
+#include <hashing_project/helpers/host_hot_cache.cuh>
+#include <hashing_project/helpers/zipf.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define DATA_TYPE uint64_t
+
+//hot pairs per block / per host thread.
+#define HOT_CACHE_ENTRIES 32
+
+//counters in the heavy hitter sketch.
+#define SKETCH_COUNTERS 256
+
+//one lookup in SAMPLE_RATE feeds the sketch.
+#define SAMPLE_RATE 64
+
+
+using sketch_type = hashing_project::helpers::space_saving_sketch<DATA_TYPE, SKETCH_COUNTERS>;
+
+
+//key for zipfian rank r - hashed so hot keys land in unrelated buckets, +1 keeps keys off the sentinel.
+__host__ __device__ DATA_TYPE rank_to_key(uint64_t rank){
+
+   rank ^= rank >> 33;
+   rank *= 0xff51afd7ed558ccdULL;
+   rank ^= rank >> 33;
+   rank *= 0xc4ceb9fe1a85ec53ULL;
+   rank ^= rank >> 33;
+
+   return rank % (~0ULL - 2) + 1;
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void load_kernel(ht_type * table, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   DATA_TYPE key = rank_to_key(tid);
+
+   if (!table->upsert_replace(my_tile, key, key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//persistent blocks so the cache fill is paid once per block, not once per 256 lookups.
+template <typename ht_type, uint tile_size, bool use_cache>
+__global__ void ycsb_c_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_ops, DATA_TYPE * hot_keys, uint n_hot, sketch_type * sketch, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   __shared__ hashing_project::helpers::block_hot_cache<DATA_TYPE, DATA_TYPE, HOT_CACHE_ENTRIES> hot_cache;
+
+   if (use_cache){
+
+      hot_cache.fill(my_tile, table, hot_keys, n_hot);
+
+      __syncthreads();
+
+   }
+
+   uint64_t n_tiles = (uint64_t) gridDim.x*blockDim.x/tile_size;
+
+   for (uint64_t tid = gallatin::utils::get_tile_tid(my_tile); tid < n_ops; tid += n_tiles){
+
+      DATA_TYPE key = keys[tid];
+
+      DATA_TYPE val;
+
+      bool found;
+
+      if (use_cache){
+         found = hot_cache.find_with_reference(my_tile, table, key, val);
+      } else {
+         found = table->find_with_reference(my_tile, key, val);
+      }
+
+      if (my_tile.thread_rank() == 0){
+
+         if (sketch != nullptr && tid % SAMPLE_RATE == 0) sketch->offer(key);
+
+         #if MEASURE_FAILS
+         if (!found || val != key) atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+         #endif
+
+      }
+
+   }
+
+}
+
+
+__host__ uint64_t get_persistent_blocks(){
+
+   int device;
+   int n_sms;
+
+   cudaGetDevice(&device);
+   cudaDeviceGetAttribute(&n_sms, cudaDevAttrMultiProcessorCount, device);
+
+   return 8ULL*n_sms;
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void hot_cache_test(uint64_t table_capacity, uint64_t n_keys, DATA_TYPE * keys, uint64_t n_ops, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*2);
+
+   misses[0] = 0;
+   misses[1] = 0;
+
+   sketch_type * sketch = sketch_type::generate_on_device();
+
+   DATA_TYPE * hot_keys = gallatin::utils::get_device_version<DATA_TYPE>(HOT_CACHE_ENTRIES);
+
+   cudaDeviceSynchronize();
+
+   load_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, n_keys, misses);
+
+   cudaDeviceSynchronize();
+
+   uint64_t n_blocks = get_persistent_blocks();
+
+
+   gallatin::utils::timer plain_timer;
+
+   ycsb_c_kernel<ht_type, tile_size, false><<<n_blocks,256>>>(table, keys, n_ops, hot_keys, 0, nullptr, misses);
+
+   plain_timer.sync_end();
+
+   plain_timer.print_throughput("YCSB-C plain", n_ops);
+
+
+   //warmup - 1% of the run feeds the sketch.
+   ycsb_c_kernel<ht_type, tile_size, false><<<n_blocks,256>>>(table, keys, n_ops/100, hot_keys, 0, sketch, misses);
+
+   cudaDeviceSynchronize();
+
+   uint n_hot = sketch->publish(hot_keys, HOT_CACHE_ENTRIES);
+
+
+   gallatin::utils::timer cache_timer;
+
+   ycsb_c_kernel<ht_type, tile_size, true><<<n_blocks,256>>>(table, keys, n_ops, hot_keys, n_hot, sketch, misses);
+
+   cache_timer.sync_end();
+
+   cache_timer.print_throughput("YCSB-C hot cache", n_ops);
+
+
+   printf("%s: %lu failed loads, %lu failed lookups, %u hot keys\n", name.c_str(), misses[0], misses[1], n_hot);
+
+   myfile << name << "," << std::setprecision(12) << 1.0*n_ops/(plain_timer.elapsed()*1000000) << "," << 1.0*n_ops/(cache_timer.elapsed()*1000000) << "\n";
+
+   cudaFree(hot_keys);
+
+   sketch_type::free_on_device(sketch);
+
+   ht_type::free_on_device(table);
+
+   cudaFree(misses);
+
+}
+
+
+//per-thread caches - each thread fills its own from the shared sketch.
+__host__ void host_hot_cache_test(uint64_t table_capacity, uint64_t n_keys, DATA_TYPE * keys, uint64_t n_ops, uint32_t n_threads, std::ofstream & myfile){
+
+   using ht_type = hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>;
+
+   using host_sketch_type = hashing_project::host::host_space_saving_sketch<DATA_TYPE, SKETCH_COUNTERS>;
+   using host_cache_type = hashing_project::host::host_hot_cache<DATA_TYPE, DATA_TYPE, HOT_CACHE_ENTRIES>;
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(rank_to_key(i), rank_to_key(i));
+   });
+
+   host_sketch_type * sketch = new host_sketch_type();
+
+   std::atomic<uint64_t> misses(0);
+
+   auto run = [&](uint64_t run_ops, bool use_cache, host_sketch_type * run_sketch){
+
+      std::vector<std::thread> workers;
+
+      uint64_t ops_per_thread = (run_ops-1)/n_threads+1;
+
+      std::vector<DATA_TYPE> hot_keys;
+
+      if (use_cache) hot_keys = sketch->get_hot_keys(HOT_CACHE_ENTRIES);
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      for (uint32_t t = 0; t < n_threads; t++){
+
+         workers.emplace_back([&, t](){
+
+            host_cache_type * hot_cache = new host_cache_type();
+
+            if (use_cache) hot_cache->fill(table, hot_keys);
+
+            uint64_t end = std::min(run_ops, (t+1)*ops_per_thread);
+
+            for (uint64_t i = t*ops_per_thread; i < end; i++){
+
+               DATA_TYPE val;
+
+               bool found = use_cache ? hot_cache->find_with_reference(table, keys[i], val) : table->find_with_reference(keys[i], val);
+
+               if (run_sketch != nullptr && i % SAMPLE_RATE == 0) run_sketch->offer(keys[i]);
+
+               if (!found || val != keys[i]) misses.fetch_add(1, std::memory_order_relaxed);
+
+            }
+
+            delete hot_cache;
+
+         });
+
+      }
+
+      for (auto & worker : workers){
+         worker.join();
+      }
+
+      auto end = std::chrono::high_resolution_clock::now();
+
+      return std::chrono::duration<double>(end-start).count();
+
+   };
+
+   double plain_duration = run(n_ops, false, nullptr);
+
+   printf("YCSB-C host plain: %f ops/s\n", n_ops/plain_duration);
+
+   run(n_ops/100, false, sketch);
+
+   double cache_duration = run(n_ops, true, sketch);
+
+   printf("YCSB-C host hot cache: %f ops/s\n", n_ops/cache_duration);
+
+   printf("%s: %lu failed lookups\n", ht_type::get_name().c_str(), misses.load());
+
+   myfile << ht_type::get_name() << "," << std::setprecision(12) << 1.0*n_ops/(plain_duration*1000000) << "," << 1.0*n_ops/(cache_duration*1000000) << "\n";
+
+   delete sketch;
+
+   ht_type::free_on_host(table);
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, uint64_t n_ops, double alpha, uint32_t n_threads){
+
+
+   //distinct keys fill the table to ~85%.
+   uint64_t n_keys = table_capacity*.85;
+
+   uint64_t * host_keys = generate_zipfian_values(n_ops, n_keys, alpha);
+
+   for (uint64_t i = 0; i < n_ops; i++){
+      host_keys[i] = rank_to_key(host_keys[i] % n_keys);
+   }
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_ops);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_ops, cudaMemcpyHostToDevice);
+
+
+   std::string filename = "results/hot_cache/ycsb_c_" + std::to_string(alpha) + "_" + table + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,plain,hot_cache\n";
+
+
+   if (table == "p2" || table == "all"){
+      hot_cache_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      hot_cache_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      hot_cache_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      hot_cache_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      hot_cache_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      hot_cache_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      hot_cache_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      hot_cache_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, n_keys, keys, n_ops, myfile);
+   }
+
+   if (table == "host" || table == "all"){
+      host_hot_cache_test(table_capacity, n_keys, host_keys, n_ops, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+
+   cudaFreeHost(host_keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("hot_cache_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2MD double doubleMD iceberg icebergMD cuckoo hopscotch host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--n_ops", "-n").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of lookups.");
+
+   program.add_argument("--alpha", "-a").scan<'g', double>().help("Alpha value for the zipfian generator.").default_value(1.2);
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host table.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_ops = program.get<uint64_t>("--n_ops");
+   auto alpha = program.get<double>("--alpha");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/hot_cache")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, n_ops, alpha, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
@@ -0,0 +1,303 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Huge page benchmark (helpers/host_pages.cuh).
+// For each page policy (base, thp, 2mb, 1gb):
+//  - probe: --size bytes from host_alloc, random 8 byte reads from --threads threads,
+//  - table: a host swiss table generated under the policy, filled to --load, then random finds.
+// Reports throughput, the speedup over base pages, the backing each allocation actually got after
+// fallbacks, the THP bytes in use, and dTLB load misses per op from perf_event_open when the kernel
+// allows it (-1 otherwise).
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <assert.h>
+#include <chrono>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_pages.cuh>
+#include <hashing_project/helpers/host_perf.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+
+
+#define DATA_TYPE uint64_t
+
+
+template <typename T>
+__host__ std::vector<T> generate_data(uint64_t nitems){
+
+
+   std::vector<T> vals(nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals.data() + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+struct page_result {
+
+   double throughput;
+
+   //dTLB load misses per op, -1 if perf is unavailable.
+   double tlb_misses;
+
+};
+
+
+//run func under the dTLB miss counter, returns ops/s and misses/op.
+template <typename func_type>
+__host__ page_result measure(uint64_t n_ops, func_type func){
+
+   std::unique_ptr<hashing_project::host::perf_counter> tlb_misses(hashing_project::host::perf_counter::dtlb_load_misses());
+
+   tlb_misses->start();
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   func();
+
+   auto end = std::chrono::high_resolution_clock::now();
+
+   tlb_misses->stop();
+
+   page_result result;
+
+   result.throughput = n_ops/std::chrono::duration<double>(end-start).count();
+
+   result.tlb_misses = tlb_misses->is_valid() ? 1.0*tlb_misses->read_count()/n_ops : -1;
+
+   return result;
+
+}
+
+
+__host__ void probe_test(hashing_project::host::page_policy policy, uint64_t n_bytes, uint64_t n_probes, uint32_t n_threads, page_result & base, std::ofstream & myfile){
+
+   uint64_t n_items = n_bytes/sizeof(uint64_t);
+
+   uint64_t * items = hashing_project::host::host_alloc_typed<uint64_t>(n_items, policy);
+
+   //first touch from the workers, as the tables do.
+   hashing_project::host::parallel_for(n_threads, n_items, [&](uint64_t i){
+      items[i] = i;
+   });
+
+   std::atomic<uint64_t> checksum(0);
+
+   uint64_t probes_per_thread = (n_probes-1)/n_threads+1;
+
+   page_result result = measure(probes_per_thread*n_threads, [&](){
+
+      hashing_project::host::parallel_for(n_threads, n_threads, [&](uint64_t thread){
+
+         uint64_t state = hashing_project::host::hash(&thread, sizeof(uint64_t), 42);
+
+         uint64_t sum = 0;
+
+         for (uint64_t i = 0; i < probes_per_thread; i++){
+
+            //xorshift64
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+
+            sum += items[state % n_items];
+
+         }
+
+         checksum.fetch_add(sum);
+
+      });
+
+   });
+
+   hashing_project::host::page_policy backing = hashing_project::host::get_host_page_backing(items);
+
+   uint64_t thp_bytes = hashing_project::host::get_thp_bytes();
+
+   hashing_project::host::host_free(items);
+
+   if (policy == hashing_project::host::page_policy::base_pages) base = result;
+
+   printf("probe %s (backed by %s, thp %lu MB): %f M/s = %fx, dTLB misses/op %f, checksum %lu\n", hashing_project::host::get_page_policy_name(policy), hashing_project::host::get_page_policy_name(backing), thp_bytes >> 20, result.throughput/1000000, result.throughput/base.throughput, result.tlb_misses, checksum.load());
+
+   myfile << "probe," << hashing_project::host::get_page_policy_name(policy) << "," << hashing_project::host::get_page_policy_name(backing) << "," << n_bytes << "," << thp_bytes << "," << std::setprecision(12) << result.throughput << "," << result.throughput/base.throughput << "," << result.tlb_misses << "," << base.tlb_misses << "\n";
+
+}
+
+
+template <typename ht_type>
+__host__ void table_test(hashing_project::host::page_policy policy, uint64_t table_capacity, double load, uint32_t n_threads, std::vector<DATA_TYPE> & keys, page_result & base, std::ofstream & myfile){
+
+   uint64_t n_keys = table_capacity*load;
+
+   hashing_project::host::set_host_page_policy(policy);
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], i+1);
+   });
+
+   std::atomic<uint64_t> n_missing(0);
+
+   page_result result = measure(n_keys, [&](){
+
+      hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+
+         //stride through the batch so consecutive finds hit unrelated buckets.
+         uint64_t index = (i*0x9E3779B97F4A7C15ULL) % n_keys;
+
+         DATA_TYPE val;
+
+         if (!table->find_with_reference(keys[index], val) || val != index+1) n_missing.fetch_add(1);
+
+      });
+
+   });
+
+   uint64_t thp_bytes = hashing_project::host::get_thp_bytes();
+
+   ht_type::free_on_host(table);
+
+   hashing_project::host::set_host_page_policy(hashing_project::host::page_policy::base_pages);
+
+   if (policy == hashing_project::host::page_policy::base_pages) base = result;
+
+   printf("%s %s (thp %lu MB): find %f M/s = %fx, dTLB misses/op %f, missing %lu\n", ht_type::get_name().c_str(), hashing_project::host::get_page_policy_name(policy), thp_bytes >> 20, result.throughput/1000000, result.throughput/base.throughput, result.tlb_misses, n_missing.load());
+
+   //the table's arrays are not exposed - thp_bytes shows what they got.
+   myfile << ht_type::get_name() << "," << hashing_project::host::get_page_policy_name(policy) << "," << "-" << "," << table_capacity << "," << thp_bytes << "," << std::setprecision(12) << result.throughput << "," << result.throughput/base.throughput << "," << result.tlb_misses << "," << base.tlb_misses << "\n";
+
+}
+
+
+__host__ void execute_test(uint64_t n_bytes, uint64_t n_probes, uint64_t table_capacity, double load, uint32_t n_threads){
+
+
+   std::vector<DATA_TYPE> keys = generate_data<DATA_TYPE>(table_capacity*load);
+
+
+   std::string filename = "results/huge_pages/" + std::to_string(n_bytes) + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + "_" + std::to_string(n_threads) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "test,policy,backing,bytes,thp_bytes,throughput,speedup,tlb_misses_per_op,base_tlb_misses_per_op\n";
+
+
+   hashing_project::host::page_policy policies[4] = {hashing_project::host::page_policy::base_pages, hashing_project::host::page_policy::transparent, hashing_project::host::page_policy::huge_2mb, hashing_project::host::page_policy::huge_1gb};
+
+   page_result probe_base;
+
+   for (auto policy : policies){
+      probe_test(policy, n_bytes, n_probes, n_threads, probe_base, myfile);
+   }
+
+   page_result table_base;
+
+   for (auto policy : policies){
+      table_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(policy, table_capacity, load, n_threads, keys, table_base, myfile);
+   }
+
+   myfile.close();
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("huge_page_test");
+
+   program.add_argument("--size", "-s").scan<'u', uint64_t>().default_value((uint64_t) (8ULL << 30)).help("Bytes in the random probe array.");
+
+   program.add_argument("--probes", "-p").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Random reads into the probe array.");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the host table.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table filled before the finds.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto n_bytes = program.get<uint64_t>("--size");
+   auto n_probes = program.get<uint64_t>("--probes");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/huge_pages")){
+   } else {
+   }
+
+
+   execute_test(n_bytes, n_probes, table_capacity, load, n_threads);
+
+
+   return 0;
+
+}
@@ -0,0 +1,562 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Large value benchmark.
+// Compares two ways of storing 64-256 byte values:
+// 1. large_value_table: table-owned value slab, slots hold handles.
+// 2. caller array: the table maps key -> index and the caller keeps the rows.
+// Both are measured on insert, gather (query + row copy), and delete + reclaim.
+// The slab table also replaces every key once between gather and delete, using its replace headroom.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/large_value_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define DATA_TYPE uint64_t
+
+
+#define LARGE_MD_LOAD 1
+#define LARGE_BUCKET_MODS 0
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   return vals;
+}
+
+
+//value rows are derived from the key so gathers can be checked.
+__device__ uint64_t row_word(uint64_t key, uint i){
+   return key*(i+1);
+}
+
+
+//large value table kernels
+
+template <typename ht_type, typename row_type, uint tile_size>
+__global__ void slab_insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   row_type row;
+
+   uint64_t * row_words = (uint64_t *) &row;
+
+   for (uint i = 0; i < sizeof(row_type)/8; i++){
+      row_words[i] = row_word(my_key, i);
+   }
+
+   if (!table->upsert_replace(my_tile, my_key, row)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, typename row_type, uint tile_size>
+__global__ void slab_gather_kernel(ht_type * table, DATA_TYPE * insert_buffer, row_type * output, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   row_type * stored = table->find_value(my_tile, my_key);
+
+   if (stored == nullptr){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+
+      return;
+
+   }
+
+   uint4 * dst = (uint4 *) &output[tid];
+   uint4 * src = (uint4 *) stored;
+
+   for (uint i = my_tile.thread_rank(); i < sizeof(row_type)/16; i+=my_tile.size()){
+      dst[i] = src[i];
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void slab_remove_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   if (!table->remove(my_tile, my_key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[2], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//caller array kernels - table maps key -> row index, rows live in a flat array.
+
+template <typename ht_type, typename row_type, uint tile_size>
+__global__ void array_insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, row_type * rows, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   //row index is the position in the batch - caller-side bookkeeping the slab removes.
+   uint64_t * row_words = (uint64_t *) &rows[tid];
+
+   for (uint i = my_tile.thread_rank(); i < sizeof(row_type)/8; i+=my_tile.size()){
+      row_words[i] = row_word(my_key, i);
+   }
+
+   __threadfence();
+   my_tile.sync();
+
+   if (!table->upsert_replace(my_tile, my_key, tid)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, typename row_type, uint tile_size>
+__global__ void array_gather_kernel(ht_type * table, DATA_TYPE * insert_buffer, row_type * rows, row_type * output, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+   DATA_TYPE my_index;
+
+   if (!table->find_with_reference(my_tile, my_key, my_index)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+
+      return;
+
+   }
+
+   uint4 * dst = (uint4 *) &output[tid];
+   uint4 * src = (uint4 *) &rows[my_index];
+
+   for (uint i = my_tile.thread_rank(); i < sizeof(row_type)/16; i+=my_tile.size()){
+      dst[i] = src[i];
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void array_remove_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   if (!table->remove(my_tile, my_key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[2], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename row_type>
+__global__ void check_gather_kernel(DATA_TYPE * insert_buffer, row_type * output, uint64_t n_keys, uint64_t * misses){
+
+   uint64_t tid = gallatin::utils::get_tid();
+
+   if (tid >= n_keys) return;
+
+   uint64_t * row_words = (uint64_t *) &output[tid];
+
+   for (uint i = 0; i < sizeof(row_type)/8; i++){
+
+      if (row_words[i] != row_word(insert_buffer[tid], i)){
+         atomicAdd((unsigned long long int *)&misses[3], 1ULL);
+         return;
+      }
+
+   }
+
+}
+
+
+//fill to lf, gather, delete + reclaim, then refill to check reclaimed rows are reused.
+template <template<typename, uint, uint, uint> typename large_table_type, template<typename, typename, uint, uint> typename index_table_type, uint value_bytes, uint tile_size, uint bucket_size>
+__host__ void large_value_test(uint64_t n_indices, DATA_TYPE * access_pattern, std::ofstream & myfile){
+
+
+   using slab_table = large_table_type<DATA_TYPE, value_bytes, tile_size, bucket_size>;
+
+   using index_table = index_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   using row_type = hashing_project::helpers::value_row<value_bytes>;
+
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*4);
+
+   cudaDeviceSynchronize();
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+   misses[3] = 0;
+
+   double lf = .85;
+
+   uint64_t items_to_insert = lf*n_indices;
+
+   DATA_TYPE * device_data = gallatin::utils::get_device_version<DATA_TYPE>(items_to_insert);
+
+   cudaMemcpy(device_data, access_pattern, sizeof(DATA_TYPE)*items_to_insert, cudaMemcpyHostToDevice);
+
+   row_type * output = gallatin::utils::get_device_version<row_type>(items_to_insert);
+
+   cudaDeviceSynchronize();
+
+
+
+   //value slab, with headroom for one replace of every key.
+   slab_table * table = slab_table::generate_on_device(n_indices, 42, items_to_insert);
+
+   gallatin::utils::timer slab_insert_timer;
+
+   slab_insert_kernel<slab_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   slab_insert_timer.sync_end();
+
+   gallatin::utils::timer slab_gather_timer;
+
+   slab_gather_kernel<slab_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, output, items_to_insert, misses);
+
+   slab_gather_timer.sync_end();
+
+   check_gather_kernel<row_type><<<(items_to_insert-1)/256+1,256>>>(device_data, output, items_to_insert, misses);
+
+   //replace every key - each needs a second row, which the headroom covers without a reclaim().
+   slab_insert_kernel<slab_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   slab_gather_kernel<slab_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, output, items_to_insert, misses);
+
+   check_gather_kernel<row_type><<<(items_to_insert-1)/256+1,256>>>(device_data, output, items_to_insert, misses);
+
+   gallatin::utils::timer slab_remove_timer;
+
+   slab_remove_kernel<slab_table, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   table->reclaim();
+
+   slab_remove_timer.sync_end();
+
+   //every row was reclaimed, so a second fill must succeed in full.
+   slab_insert_kernel<slab_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   cudaDeviceSynchronize();
+
+   slab_table::free_on_device(table);
+
+   printf("Slab misses: insert %lu gather %lu remove %lu incorrect %lu\n", misses[0], misses[1], misses[2], misses[3]);
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+   misses[3] = 0;
+
+
+
+   //caller array
+   index_table * idx_table = index_table::generate_on_device(n_indices, 42);
+
+   row_type * rows = gallatin::utils::get_device_version<row_type>(items_to_insert);
+
+   gallatin::utils::timer array_insert_timer;
+
+   array_insert_kernel<index_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(idx_table, device_data, rows, items_to_insert, misses);
+
+   array_insert_timer.sync_end();
+
+   gallatin::utils::timer array_gather_timer;
+
+   array_gather_kernel<index_table, row_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(idx_table, device_data, rows, output, items_to_insert, misses);
+
+   array_gather_timer.sync_end();
+
+   check_gather_kernel<row_type><<<(items_to_insert-1)/256+1,256>>>(device_data, output, items_to_insert, misses);
+
+   gallatin::utils::timer array_remove_timer;
+
+   array_remove_kernel<index_table, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(idx_table, device_data, items_to_insert, misses);
+
+   array_remove_timer.sync_end();
+
+   cudaDeviceSynchronize();
+
+   index_table::free_on_device(idx_table);
+
+   printf("Array misses: insert %lu gather %lu remove %lu incorrect %lu\n", misses[0], misses[1], misses[2], misses[3]);
+
+
+   slab_gather_timer.print_throughput("Slab gathered", items_to_insert);
+   array_gather_timer.print_throughput("Array gathered", items_to_insert);
+
+   myfile << slab_table::get_name() << "," << value_bytes << "," << std::setprecision(12)
+          << 1.0*items_to_insert/(slab_insert_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(slab_gather_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(slab_remove_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(array_insert_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(array_gather_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(array_remove_timer.elapsed()*1000000) << "\n";
+
+
+   cudaFree(rows);
+   cudaFree(output);
+   cudaFree(device_data);
+   cudaFree(misses);
+
+   cudaDeviceSynchronize();
+
+}
+
+
+template <template<typename, uint, uint, uint> typename large_table_type, template<typename, typename, uint, uint> typename index_table_type, uint tile_size, uint bucket_size>
+__host__ void large_value_all_sizes(uint64_t n_indices, DATA_TYPE * access_pattern, std::string name){
+
+
+   std::string filename = "results/large_value/" + name + ".txt";
+
+   std::ofstream myfile;
+   myfile.open (filename.c_str());
+   myfile << "table,value_bytes,slab_insert,slab_gather,slab_remove,array_insert,array_gather,array_remove\n";
+
+   large_value_test<large_table_type, index_table_type, 64, tile_size, bucket_size>(n_indices, access_pattern, myfile);
+   large_value_test<large_table_type, index_table_type, 128, tile_size, bucket_size>(n_indices, access_pattern, myfile);
+   large_value_test<large_table_type, index_table_type, 256, tile_size, bucket_size>(n_indices, access_pattern, myfile);
+
+   myfile.close();
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity){
+
+
+   auto access_pattern = generate_data<DATA_TYPE>(table_capacity);
+
+   if (table == "doubleMD"){
+
+      large_value_all_sizes<hashing_project::tables::large_value_md_double, hashing_project::tables::md_double_generic, 4, 32>(table_capacity, access_pattern, "doubleMD");
+
+   } else if (table == "p2MD"){
+
+      large_value_all_sizes<hashing_project::tables::large_value_md_p2, hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, access_pattern, "p2MD");
+
+   } else {
+      throw std::runtime_error("Unknown table");
+   }
+
+
+   cudaFreeHost(access_pattern);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("large_value_test");
+
+   program.add_argument("--table", "-t")
+   .required()
+   .help("Specify table type. Options [doubleMD p2MD]");
+
+   program.add_argument("--capacity", "-c").required().scan<'u', uint64_t>().help("Number of slots in the table. Default is 100,000,000");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+
+
+   std::cout << "Running large value test with table " << table << " and " << table_capacity << " slots." << std::endl;
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/large_value")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity);
+
+
+   return 0;
+
+}
@@ -54,6 +54,9 @@ namespace fs = std::filesystem;
 #include <hashing_project/tables/iht_p2_metadata_full.cuh>
 #include <hashing_project/tables/cuckoo.cuh>
 #include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+#include <hashing_project/tables/double_hashing_set.cuh>
+#include <hashing_project/tables/double_hashing_metadata_set.cuh>
 
 
 
@@ -141,8 +144,54 @@ __host__ T * generate_clipped_data(uint64_t nitems, uint64_t cutoff){
 }
 
 
-template <typename ht_type, uint tile_size>
-__global__ void insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+//32-bit keys for --key-bits 32.
+//random 32-bit keys would collide (birthday bound) at benchmark sizes, so keys are a
+//bijective mix (murmur3 fmix32) of a counter - unique, well spread, and sentinel/tombstone free.
+__host__ uint32_t * generate_data_32(uint64_t nitems){
+
+   uint32_t * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(uint32_t)*nitems);
+
+   uint32_t counter = 1;
+
+   for (uint64_t i = 0; i < nitems; i++){
+
+      uint32_t key;
+
+      do {
+
+         key = counter++;
+
+         key ^= key >> 16;
+         key *= 0x85ebca6b;
+         key ^= key >> 13;
+         key *= 0xc2b2ae35;
+         key ^= key >> 16;
+
+      } while (key == 0U || key >= ~1U);
+
+      vals[i] = key;
+
+   }
+
+   return vals;
+}
+
+
+//suffix so 32-bit runs don't overwrite the 64-bit result files.
+template <typename data_type>
+__host__ std::string key_bits_suffix(){
+
+   if (sizeof(data_type) == 4) return "_32";
+
+   return "";
+
+}
+
+
+template <typename ht_type, uint tile_size, typename data_type = DATA_TYPE>
+__global__ void insert_kernel(ht_type * table, data_type * insert_buffer, uint64_t n_keys, uint64_t * misses){
 
 
    auto thread_block = cg::this_thread_block();
@@ -159,7 +208,7 @@ __global__ void insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64
    // }
 
 
-   uint64_t my_key = insert_buffer[tid];
+   data_type my_key = insert_buffer[tid];
 
    if (!table->upsert_replace(my_tile, my_key, my_key)){
 
@@ -192,8 +241,8 @@ __global__ void insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64
 
 }
 
-template <typename ht_type, uint tile_size>
-__global__ void remove_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+template <typename ht_type, uint tile_size, typename data_type = DATA_TYPE>
+__global__ void remove_kernel(ht_type * table, data_type * insert_buffer, uint64_t n_keys, uint64_t * misses){
 
 
    auto thread_block = cg::this_thread_block();
@@ -210,7 +259,7 @@ __global__ void remove_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64
    // }
 
 
-   uint64_t my_key = insert_buffer[tid];
+   data_type my_key = insert_buffer[tid];
 
    if (!table->remove(my_tile, my_key)){
 
@@ -233,8 +282,8 @@ __global__ void remove_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64
 
 
 
-template <typename ht_type, uint tile_size>
-__global__ void query_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+template <typename ht_type, uint tile_size, typename data_type = DATA_TYPE>
+__global__ void query_kernel(ht_type * table, data_type * insert_buffer, uint64_t n_keys, uint64_t * misses){
 
 
    auto thread_block = cg::this_thread_block();
@@ -251,8 +300,8 @@ __global__ void query_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_
    // }
 
 
-   DATA_TYPE my_key = insert_buffer[tid];
-   DATA_TYPE my_val;
+   data_type my_key = insert_buffer[tid];
+   data_type my_val;
 
 
 
@@ -287,12 +336,12 @@ __global__ void query_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_
 }
 
 
-template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
-__host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size, typename data_type = DATA_TYPE>
+__host__ void lf_test(uint64_t n_indices, data_type * access_pattern){
 
 
 
-   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+   using ht_type = hash_table_type<data_type, data_type, tile_size, bucket_size>;
 
 
    //generate table and buffers
@@ -316,7 +365,7 @@ __host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
       std::string filename = "results/lf_probe/";
    #endif
 
-   filename = filename + ht_type::get_name() + ".txt";
+   filename = filename + ht_type::get_name() + key_bits_suffix<data_type>() + ".txt";
 
 
    //printf("Writing to %s\n", filename.c_str());
@@ -335,7 +384,7 @@ __host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
       std::string filename = "results/lf/";
    #endif
 
-   filename = filename + ht_type::get_name() + ".txt";
+   filename = filename + ht_type::get_name() + key_bits_suffix<data_type>() + ".txt";
 
 
    //printf("Writing to %s\n", filename.c_str());
@@ -367,16 +416,16 @@ __host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
 
       uint64_t items_to_insert = lf*n_indices;
 
-      DATA_TYPE * device_data = gallatin::utils::get_device_version<DATA_TYPE>(items_to_insert);
+      data_type * device_data = gallatin::utils::get_device_version<data_type>(items_to_insert);
 
       //set original buffer
-      cudaMemcpy(device_data, access_pattern, sizeof(DATA_TYPE)*items_to_insert, cudaMemcpyHostToDevice);
+      cudaMemcpy(device_data, access_pattern, sizeof(data_type)*items_to_insert, cudaMemcpyHostToDevice);
 
       cudaDeviceSynchronize();
 
       gallatin::utils::timer insert_timer;
 
-      insert_kernel<ht_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+      insert_kernel<ht_type, tile_size, data_type><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
 
       insert_timer.sync_end();
 
@@ -388,7 +437,7 @@ __host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
 
       gallatin::utils::timer query_timer;
 
-      query_kernel<ht_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+      query_kernel<ht_type, tile_size, data_type><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
 
       query_timer.sync_end();
 
@@ -400,7 +449,7 @@ __host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
 
       gallatin::utils::timer remove_timer;
       
-      remove_kernel<ht_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+      remove_kernel<ht_type, tile_size, data_type><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
 
       remove_timer.sync_end();
 
@@ -465,6 +514,209 @@ __host__ void lf_test(uint64_t n_indices, DATA_TYPE * access_pattern){
 
 }
 
+//key-only kernels for the set tables - same traffic as the map kernels, minus the values.
+template <typename ht_type, uint tile_size, typename data_type = DATA_TYPE>
+__global__ void set_insert_kernel(ht_type * table, data_type * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   data_type my_key = insert_buffer[tid];
+
+   if (!table->insert(my_tile, my_key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+      
+   }
+
+
+}
+
+template <typename ht_type, uint tile_size, typename data_type = DATA_TYPE>
+__global__ void set_query_kernel(ht_type * table, data_type * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   data_type my_key = insert_buffer[tid];
+
+   if (!table->contains(my_tile, my_key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+      
+   }
+
+
+}
+
+template <typename ht_type, uint tile_size, typename data_type = DATA_TYPE>
+__global__ void set_remove_kernel(ht_type * table, data_type * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   data_type my_key = insert_buffer[tid];
+
+   if (!table->erase(my_tile, my_key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+
+         atomicAdd((unsigned long long int *)&misses[2], 1ULL);
+      }
+      #endif
+      
+   }
+
+
+}
+
+
+//lf_test for the set tables - output files have the same format so sets and maps plot together.
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size, typename data_type = DATA_TYPE>
+__host__ void lf_test_set(uint64_t n_indices, data_type * access_pattern){
+
+
+   using ht_type = hash_table_type<data_type, data_type, tile_size, bucket_size>;
+
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*4);
+
+   cudaDeviceSynchronize();
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+   misses[3] = 0;
+
+
+   #if COUNT_PROBES
+
+   std::string filename = "results/lf_probe/";
+
+   #else
+
+   std::string filename = "results/lf/";
+
+   #endif
+
+   filename = filename + ht_type::get_name() + key_bits_suffix<data_type>() + ".txt";
+
+   std::ofstream myfile;
+   myfile.open (filename.c_str());
+   myfile << "lf,insert,query,remove\n";
+
+
+   for (int i = 1; i < 19; i++){
+
+      double lf = .05*i;
+
+      ht_type * table = ht_type::generate_on_device(n_indices, 42);
+
+      helpers::get_num_probes();
+
+      uint64_t items_to_insert = lf*n_indices;
+
+      data_type * device_data = gallatin::utils::get_device_version<data_type>(items_to_insert);
+
+      cudaMemcpy(device_data, access_pattern, sizeof(data_type)*items_to_insert, cudaMemcpyHostToDevice);
+
+      cudaDeviceSynchronize();
+
+      gallatin::utils::timer insert_timer;
+
+      set_insert_kernel<ht_type, tile_size, data_type><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+      insert_timer.sync_end();
+
+      uint64_t insert_probes = helpers::get_num_probes();
+
+      cudaDeviceSynchronize();
+
+
+      gallatin::utils::timer query_timer;
+
+      set_query_kernel<ht_type, tile_size, data_type><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+      query_timer.sync_end();
+
+      uint64_t query_probes = helpers::get_num_probes();
+
+      cudaDeviceSynchronize();
+
+
+      gallatin::utils::timer remove_timer;
+      
+      set_remove_kernel<ht_type, tile_size, data_type><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+      remove_timer.sync_end();
+
+      uint64_t remove_probes = helpers::get_num_probes();
+
+      cudaDeviceSynchronize();
+
+
+      cudaFree(device_data);
+
+      ht_type::free_on_device(table);
+
+      #if COUNT_PROBES
+    
+      myfile << lf << "," << std::setprecision(12) << 1.0*insert_probes/items_to_insert << "," << 1.0*query_probes/items_to_insert << "," << 1.0*remove_probes/items_to_insert << "\n";
+
+      #else
+
+      myfile << lf << "," << std::setprecision(12) << 1.0*items_to_insert/(insert_timer.elapsed()*1000000) << "," << 1.0*items_to_insert/(query_timer.elapsed()*1000000) << "," << 1.0*items_to_insert/(remove_timer.elapsed()*1000000) << "\n";
+
+      #endif
+
+      cudaDeviceSynchronize();
+
+   }
+
+   myfile.close();
+ 
+   cudaFree(misses);
+   cudaDeviceSynchronize();
+
+}
+
 template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
 __host__ void lf_test_combo_cuckoo(uint64_t n_indices, DATA_TYPE * access_pattern){
 
@@ -1001,6 +1253,45 @@ __host__ void execute_test(std::string table, uint64_t table_capacity){
       lf_test<hashing_project::tables::chaining_generic, 4, 8>(table_capacity, access_pattern);
 
       free_global_allocator();
+   } else if (table == "doubleSet"){
+
+      lf_test_set<hashing_project::tables::double_set_generic, 8, 8>(table_capacity, access_pattern);
+
+   } else if (table == "doubleMDSet"){
+
+      lf_test_set<hashing_project::tables::md_double_set_generic, 4, 32>(table_capacity, access_pattern);
+
+   } else if (table == "p2Set"){
+
+      lf_test_set<hashing_project::tables::p2_set_generic, 8, 32>(table_capacity, access_pattern);
+
+   } else if (table == "p2MDSet"){
+
+      lf_test_set<hashing_project::tables::md_p2_set_generic, 4, 32>(table_capacity, access_pattern);
+
+   } else if (table == "set_compare"){
+
+      //key-only sets vs the maps they are derived from.
+      lf_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, access_pattern);
+      lf_test_set<hashing_project::tables::double_set_generic, 8, 8>(table_capacity, access_pattern);
+      lf_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, access_pattern);
+      lf_test_set<hashing_project::tables::md_double_set_generic, 4, 32>(table_capacity, access_pattern);
+      lf_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, access_pattern);
+      lf_test_set<hashing_project::tables::p2_set_generic, 8, 32>(table_capacity, access_pattern);
+      lf_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, access_pattern);
+      lf_test_set<hashing_project::tables::md_p2_set_generic, 4, 32>(table_capacity, access_pattern);
+
+   } else if (table == "hopscotch"){
+
+      lf_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, access_pattern);
+
+   } else if (table == "hopscotch_compare"){
+
+      //bounded-neighborhood queries vs the metadata probing tables.
+      lf_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, access_pattern);
+      lf_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, access_pattern);
+      lf_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, access_pattern);
+
    } else {
       throw std::runtime_error("Unknown table");
    }
@@ -1012,6 +1303,70 @@ __host__ void execute_test(std::string table, uint64_t table_capacity){
 
 
 
+//32-bit keys and values - pairs are 8 bytes, so buckets hold twice the pairs per cache line.
+__host__ void execute_test_32(std::string table, uint64_t table_capacity){
+
+
+   auto access_pattern = generate_data_32(table_capacity);
+
+   if (table == "p2"){
+
+      lf_test<hashing_project::tables::p2_ext_generic, 8, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "p2MD"){
+
+      lf_test<hashing_project::tables::md_p2_generic, 4, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "double"){
+
+      lf_test<hashing_project::tables::double_generic, 8, 8, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "doubleMD"){
+
+      lf_test<hashing_project::tables::md_double_generic, 4, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "iceberg"){
+
+      lf_test<hashing_project::tables::iht_p2_generic, 8, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "icebergMD"){
+
+      lf_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "cuckoo"){
+
+      lf_test<hashing_project::tables::cuckoo_generic, 4, 8, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "hopscotch"){
+
+      lf_test<hashing_project::tables::hopscotch_generic, 4, 8, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "doubleSet"){
+
+      lf_test_set<hashing_project::tables::double_set_generic, 8, 8, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "doubleMDSet"){
+
+      lf_test_set<hashing_project::tables::md_double_set_generic, 4, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "p2Set"){
+
+      lf_test_set<hashing_project::tables::p2_set_generic, 8, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else if (table == "p2MDSet"){
+
+      lf_test_set<hashing_project::tables::md_p2_set_generic, 4, 32, uint32_t>(table_capacity, access_pattern);
+
+   } else {
+      throw std::runtime_error("Unknown table for 32-bit keys");
+   }
+
+
+   cudaFreeHost(access_pattern);
+}
+
+
+
 int main(int argc, char** argv) {
 
 
@@ -1023,10 +1378,15 @@ int main(int argc, char** argv) {
 
    program.add_argument("--table", "-t")
    .required()
-   .help("Specify table type. Options [p2 p2MD double doubleMD iceberg icebergMD cuckoo chaining");
+   .help("Specify table type. Options [p2 p2MD double doubleMD iceberg icebergMD cuckoo chaining hopscotch hopscotch_compare doubleSet doubleMDSet p2Set p2MDSet set_compare");
 
    program.add_argument("--capacity", "-c").required().scan<'u', uint64_t>().help("Number of slots in the table. Default is 100,000,000");
 
+   program.add_argument("--key-bits")
+   .default_value((uint32_t) 64)
+   .scan<'u', uint32_t>()
+   .help("Key and value width, 64 or 32. 32-bit mode supports [p2 p2MD double doubleMD iceberg icebergMD cuckoo hopscotch doubleSet doubleMDSet p2Set p2MDSet].");
+
    try {
     program.parse_args(argc, argv);
    }
@@ -1038,6 +1398,13 @@ int main(int argc, char** argv) {
 
    auto table = program.get<std::string>("--table");
    auto table_capacity = program.get<uint64_t>("--capacity");
+   auto key_bits = program.get<uint32_t>("--key-bits");
+
+   if (key_bits != 32 && key_bits != 64){
+    std::cerr << "--key-bits must be 32 or 64, got " << key_bits << std::endl;
+    std::cerr << program;
+    return 1;
+   }
 
    // uint64_t table_capacity;
 
@@ -1098,7 +1465,11 @@ int main(int argc, char** argv) {
    #endif
 
 
-   execute_test(table, table_capacity);
+   if (key_bits == 32){
+      execute_test_32(table, table_capacity);
+   } else {
+      execute_test(table, table_capacity);
+   }
 
 
 
@@ -0,0 +1,371 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Lock contention report.
+// Upserts then queries a stream of uniform or zipfian keys and reports, per table and phase,
+// lock acquires, contended acquires and failed attempts (helpers/lock_counters.cuh).
+// The per-bucket heatmap of the upsert phase is written next to the results so hot buckets can be plotted.
+// Throughput here includes the counter atomics - use lock_test / lf_test for clean numbers.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#define MEASURE_LOCKS 1
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/lock_counters.cuh>
+#include <hashing_project/helpers/zipf.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define DATA_TYPE uint64_t
+
+
+
+template <typename ht_type, uint tile_size>
+__global__ void upsert_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_ops, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_ops) return;
+
+   if (!table->upsert_replace(my_tile, keys[tid], tid)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void query_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_ops, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_ops) return;
+
+   DATA_TYPE val;
+
+   if (!table->find_with_reference(my_tile, keys[tid], val)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   return vals;
+}
+
+
+//keys drawn from n_keys distinct values. zipfian ranks are hashed so hot keys land in unrelated buckets.
+//+1 keeps keys off the sentinel.
+__host__ uint64_t * generate_keys(uint64_t n_ops, uint64_t n_keys, bool zipfian, double alpha){
+
+   uint64_t * keys;
+
+   if (zipfian){
+      keys = generate_zipfian_values(n_ops, n_keys, alpha);
+   } else {
+      keys = generate_data<uint64_t>(n_ops);
+   }
+
+   for (uint64_t i = 0; i < n_ops; i++){
+
+      uint64_t rank = keys[i] % n_keys;
+
+      keys[i] = hashing_project::host::hash(&rank, sizeof(uint64_t), 42) % (~0ULL - 2) + 1;
+   }
+
+   return keys;
+
+}
+
+
+__host__ void write_counts(std::ofstream & myfile, std::string table, std::string phase, double throughput){
+
+   auto counts = hashing_project::helpers::get_lock_counts();
+
+   printf("%s %s: %lu acquires, %lu contended, %lu failed attempts, %f failed per acquire\n", table.c_str(), phase.c_str(), counts.acquires, counts.contended, counts.failed, counts.spins_per_acquire());
+
+   myfile << table << "," << phase << "," << std::setprecision(12) << throughput << "," << counts.acquires << "," << counts.contended << "," << counts.failed << "," << counts.spins_per_acquire() << "\n";
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void contention_test(uint64_t table_capacity, DATA_TYPE * keys, uint64_t n_ops, std::ofstream & myfile, std::string heatmap_prefix){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*2);
+
+   misses[0] = 0;
+   misses[1] = 0;
+
+   //heatmap wraps, so one cell per bucket is an upper bound for every table here.
+   hashing_project::helpers::enable_lock_heatmap((table_capacity-1)/bucket_size+1);
+
+   //drop anything counted during construction.
+   hashing_project::helpers::get_lock_counts();
+
+   cudaDeviceSynchronize();
+
+
+   gallatin::utils::timer upsert_timer;
+
+   upsert_kernel<ht_type, tile_size><<<(n_ops*tile_size-1)/256+1,256>>>(table, keys, n_ops, misses);
+
+   upsert_timer.sync_end();
+
+   upsert_timer.print_throughput("Upserted", n_ops);
+
+   write_counts(myfile, name, "upsert", 1.0*n_ops/(upsert_timer.elapsed()*1000000));
+
+   hashing_project::helpers::dump_lock_heatmap(heatmap_prefix + name + "_upsert.txt");
+
+
+   gallatin::utils::timer query_timer;
+
+   query_kernel<ht_type, tile_size><<<(n_ops*tile_size-1)/256+1,256>>>(table, keys, n_ops, misses);
+
+   query_timer.sync_end();
+
+   query_timer.print_throughput("Queried", n_ops);
+
+   write_counts(myfile, name, "query", 1.0*n_ops/(query_timer.elapsed()*1000000));
+
+   hashing_project::helpers::dump_lock_heatmap(heatmap_prefix + name + "_query.txt");
+
+
+   printf("%s: %lu failed upserts, %lu failed queries\n", name.c_str(), misses[0], misses[1]);
+
+   hashing_project::helpers::disable_lock_heatmap();
+
+   ht_type::free_on_device(table);
+
+   cudaFree(misses);
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, uint64_t n_ops, bool zipfian, double alpha){
+
+
+   //distinct keys fill the table to ~85%.
+   uint64_t n_keys = table_capacity*.85;
+
+   auto host_keys = generate_keys(n_ops, n_keys, zipfian, alpha);
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_ops);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_ops, cudaMemcpyHostToDevice);
+
+   cudaFreeHost(host_keys);
+
+
+   std::string run_name;
+
+   if (zipfian){
+      run_name = "zipfian_" + std::to_string(alpha) + "_" + std::to_string(table_capacity);
+   } else {
+      run_name = "uniform_" + std::to_string(table_capacity);
+   }
+
+   fs::create_directory("results/lock_contention/" + run_name);
+
+   std::string heatmap_prefix = "results/lock_contention/" + run_name + "/";
+
+   std::ofstream myfile;
+   myfile.open("results/lock_contention/" + run_name + "_" + table + ".txt");
+
+   myfile << "table,phase,throughput,acquires,contended,failed,failed_per_acquire\n";
+
+
+   if (table == "p2" || table == "all"){
+      contention_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      contention_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "double" || table == "all"){
+      contention_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      contention_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      contention_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      contention_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      contention_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      contention_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, keys, n_ops, myfile, heatmap_prefix);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("lock_contention_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2MD double doubleMD iceberg icebergMD cuckoo hopscotch]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--n_ops", "-n").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of upserts, then queries.");
+
+   program.add_argument("--zipfian", "-z").flag().help("Use zipfian keys. If not keys are uniform random.");
+
+   program.add_argument("--alpha", "-a").scan<'g', double>().help("Alpha value for the zipfian generator.").default_value(.99);
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_ops = program.get<uint64_t>("--n_ops");
+   auto zipfian = program.get<bool>("--zipfian");
+   auto alpha = program.get<double>("--alpha");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/lock_contention")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, n_ops, zipfian, alpha);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
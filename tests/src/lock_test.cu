@@ -1,46 +1,48 @@
 /*
  * ============================================================================
  *
- *        Authors:  
+ *        Authors:
  *                  Hunter McCoy <hjmccoy@lbl.gov
  *
  * ============================================================================
  */
 
+// Lock layout contention benchmark.
+// 1. raw lock throughput: every op locks one bucket, touches its 120 bytes of data and unlocks.
+//    Compared for the in-bucket lock word and each layout in helpers/lock_layouts.cuh.
+// 2. table throughput: upserts into the p2 metadata table instantiated with each layout.
+// Accesses are uniform or zipfian (--zipfian / --alpha), so hot buckets drive the contention.
 
 
-#define COUNT_PROBES 1
+#define COUNT_PROBES 0
 
-#include <gallatin/allocators/global_allocator.cuh>
+#define LOAD_CHEAP 0
 
-#include <gallatin/allocators/timer.cuh>
+#include <argparse/argparse.hpp>
 
-#include <warpcore/single_value_hash_table.cuh>
-#include <gallatin/allocators/timer.cuh>
-
-#include <bght/p2bht.hpp>
+#include <gallatin/allocators/global_allocator.cuh>
 
-#include <hashing_project/cache.cuh>
+#include <gallatin/allocators/timer.cuh>
 
 #include <stdio.h>
 #include <iostream>
+#include <fstream>
 #include <assert.h>
 #include <chrono>
 #include <openssl/rand.h>
 
+#include <filesystem>
 
-#include <hashing_project/table_wrappers/p2_wrapper.cuh>
-#include <hashing_project/table_wrappers/dummy_ht.cuh>
-#include <hashing_project/table_wrappers/iht_wrapper.cuh>
-#include <hashing_project/table_wrappers/warpcore_wrapper.cuh>
+namespace fs = std::filesystem;
 
-#include <iostream>
-#include <locale>
 
+#include <hashing_project/helpers/lock_layouts.cuh>
+#include <hashing_project/helpers/zipf.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
 
-//thrust stuff.
-#include <thrust/shuffle.h>
-#include <thrust/random.h>
+#include <iostream>
+#include <locale>
 
 #include <cooperative_groups.h>
 
@@ -52,18 +54,18 @@ using namespace gallatin::allocators;
 
 #define MEASURE_FAILS 1
 
-#define MEASURE_INDEPENDENT 1
-
 
 #define DATA_TYPE uint64_t
 
 
+//fixed pool size for the striped layout.
+#define LOCK_TEST_STRIPES 4096
 
 
 
 struct lock_bucket
 {
-   
+
    uint64_t lock;
 
    uint64_t data[15];
@@ -90,10 +92,31 @@ __global__ void init_buckets(lock_bucket * buckets, uint64_t n_buckets){
 }
 
 
+//critical section shared by every variant - read the bucket, write one word.
+template <uint32_t tile_size>
+__device__ void touch_bucket(cg::thread_block_tile<tile_size> & my_tile, lock_bucket * my_bucket, uint64_t tid){
+
+   if (my_tile.thread_rank() < 15){
+
+
+      uint64_t data = gallatin::utils::ld_acq(&my_bucket->data[my_tile.thread_rank()]);
+
+
+      if (my_tile.thread_rank() == 0){
+
+         gallatin::utils::typed_atomic_write(&my_bucket->data[0], data, tid);
+      }
+
+
+   }
+
+}
+
+
 template <uint32_t tile_size>
 __global__ void test_locks_internal(uint64_t * accesses, uint64_t n_ops, lock_bucket * buckets, uint64_t n_buckets){
 
-   
+
    auto thread_block = cg::this_thread_block();
 
    cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
@@ -116,35 +139,23 @@ __global__ void test_locks_internal(uint64_t * accesses, uint64_t n_ops, lock_bu
 
    my_tile.sync();
 
-
-   if (my_tile.thread_rank() < 15){
-
-
-      uint64_t data = gallatin::utils::ld_acq(&my_bucket->data[my_tile.thread_rank()]);
-   
-
-      if (my_tile.thread_rank() == 0){
-
-         gallatin::utils::typed_atomic_write(&my_bucket->data[0], data, tid);
-      }
-
-
-   }
-
-
+   touch_bucket(my_tile, my_bucket, tid);
 
    my_tile.sync();
 
-   atomicAnd((unsigned long long int *)&my_bucket->lock, (unsigned long long int) ~SET_BIT_MASK(0));
+   if (my_tile.thread_rank() == 0){
+      atomicAnd((unsigned long long int *)&my_bucket->lock, (unsigned long long int) ~SET_BIT_MASK(0));
+   }
 
 
 }
 
 
-template <uint32_t tile_size>
-__global__ void test_locks_external(uint64_t * accesses, uint64_t n_ops, lock_bucket * buckets, uint64_t n_buckets, uint64_t * locks){
+//external lock array in any of the table layouts.
+template <typename lock_layout, uint32_t tile_size>
+__global__ void test_locks_layout(uint64_t * accesses, uint64_t n_ops, lock_bucket * buckets, uint64_t n_buckets, typename lock_layout::lock_type * locks){
+
 
-   
    auto thread_block = cg::this_thread_block();
 
    cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
@@ -164,42 +175,51 @@ __global__ void test_locks_external(uint64_t * accesses, uint64_t n_ops, lock_bu
 
    if (my_tile.thread_rank() == 0){
 
-      uint64_t high = my_bucket_addr/64;
-      uint64_t low = my_bucket_addr % 64;
-
-      while (atomicOr((unsigned long long int *)&locks[high], (unsigned long long int) SET_BIT_MASK(low)) & SET_BIT_MASK(low));
+      while (!lock_layout::try_lock(locks, my_bucket_addr));
 
    }
 
    my_tile.sync();
 
+   touch_bucket(my_tile, my_bucket, tid);
 
-   if (my_tile.thread_rank() < 15){
+   my_tile.sync();
 
+   if (my_tile.thread_rank() == 0){
+      lock_layout::unlock(locks, my_bucket_addr);
+   }
 
-      uint64_t data = gallatin::utils::ld_acq(&my_bucket->data[my_tile.thread_rank()]);
-   
+}
 
-      if (my_tile.thread_rank() == 0){
 
-         gallatin::utils::typed_atomic_write(&my_bucket->data[0], data, tid);
-      }
+template <typename ht_type, uint tile_size>
+__global__ void upsert_contention_kernel(ht_type * table, uint64_t * accesses, uint64_t n_ops, uint64_t key_range, uint64_t * misses){
 
 
-   }
+   auto thread_block = cg::this_thread_block();
 
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
 
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
 
-   my_tile.sync();
+   if (tid >= n_ops) return;
+
+   //+1 keeps keys off the sentinel.
+   DATA_TYPE my_key = accesses[tid] % key_range + 1;
 
-   uint64_t high = my_bucket_addr/64;
-   uint64_t low = my_bucket_addr % 64;
+   if (!table->upsert_replace(my_tile, my_key, tid)){
 
-   //if old is 0, SET_BIT_MASK & 0 is 0 - loop exit.
-   atomicAnd((unsigned long long int *)&locks[high], (unsigned long long int) ~SET_BIT_MASK(low));
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
 
 }
 
+
 template <typename T>
 __host__ T * generate_data(uint64_t nitems){
 
@@ -234,39 +254,32 @@ __host__ T * generate_data(uint64_t nitems){
 }
 
 
-//generate data within the range from 0, cutoff
-//modulus any keys which exceed the range.
-//this generates a random list of keys to operate on.
-template <typename T>
-__host__ T * generate_clipped_data(uint64_t nitems, uint64_t cutoff){
-
+//zipfian ranks are 1..n_buckets, rank 1 hottest. Scatter the ranks so hot buckets are not neighbors -
+//otherwise the packed layout would look worse only because the hottest buckets share a word by construction.
+__host__ uint64_t * generate_access_pattern(uint64_t n_ops, uint64_t n_buckets, bool zipfian, double alpha){
 
-   T * host_data = generate_data<T>(nitems);
-
-   for (uint64_t i =0; i < nitems; i++){
-      host_data[i] = host_data[i] % cutoff;
-   }
+   if (!zipfian) return generate_data<uint64_t>(n_ops);
 
+   uint64_t * ranks = generate_zipfian_values(n_ops, n_buckets, alpha);
 
-   return host_data;
-
-
-}
+   uint64_t * accesses;
 
+   cudaMallocHost((void **)&accesses, sizeof(uint64_t)*n_ops);
 
+   for (uint64_t i = 0; i < n_ops; i++){
+      accesses[i] = hashing_project::host::hash(&ranks[i], sizeof(uint64_t), 42);
+   }
 
+   cudaFreeHost(ranks);
 
+   return accesses;
 
-//stolen shamelessy from https://stackoverflow.com/questions/43482488/how-to-format-a-number-with-thousands-separator-in-c-c
-// struct separate_thousands : std::numpunct<char> {
-//     char_type do_thousands_sep() const override { return ','; }  // separate with commas
-//     string_type do_grouping() const override { return "\3"; } // groups of 3 digit
-// };
+}
 
 
 
 template <uint tile_size>
-__host__ void internal_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops){
+__host__ double internal_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops){
 
 
    lock_bucket * buckets = gallatin::utils::get_device_version<lock_bucket>(n_buckets);
@@ -281,23 +294,21 @@ __host__ void internal_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint
 
    lock_timer.sync_end();
 
-   lock_timer.print_throughput("Internal Operated", n_ops);
+   lock_timer.print_throughput("In-bucket locks operated", n_ops);
 
    cudaFree(buckets);
 
-
-}
+   return 1.0*n_ops/(lock_timer.elapsed()*1000000);
 
 
-template <uint tile_size>
-__host__ void external_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops){
+}
 
 
-   uint64_t n_locks = (n_buckets-1)/64+1;
+template <typename lock_layout, uint tile_size>
+__host__ double layout_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops){
 
-   uint64_t * locks = gallatin::utils::get_device_version<uint64_t>(n_locks);
 
-   cudaMemset(locks, 0, sizeof(uint64_t)*n_locks);
+   auto locks = lock_layout::generate_locks(n_buckets);
 
    lock_bucket * buckets = gallatin::utils::get_device_version<lock_bucket>(n_buckets);
 
@@ -307,64 +318,164 @@ __host__ void external_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint
 
    gallatin::utils::timer lock_timer;
 
-   test_locks_external<tile_size><<<(n_ops*tile_size-1)/256+1,256>>>(access_pattern, n_ops, buckets, n_buckets, locks);
+   test_locks_layout<lock_layout, tile_size><<<(n_ops*tile_size-1)/256+1,256>>>(access_pattern, n_ops, buckets, n_buckets, locks);
 
    lock_timer.sync_end();
 
-   lock_timer.print_throughput("External Operated", n_ops);
+   std::string label = lock_layout::get_name() + " locks operated";
+
+   lock_timer.print_throughput(label.c_str(), n_ops);
 
    cudaFree(buckets);
-   cudaFree(locks);
+   lock_layout::free_locks(locks);
 
-}
+   return 1.0*n_ops/(lock_timer.elapsed()*1000000);
 
+}
 
 
 template <uint tile_size>
-__host__ void test_both(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops){
+__host__ void test_layouts(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops, std::ofstream & myfile){
 
    printf("Tile size: %u\n", tile_size);
-   internal_test<tile_size>(n_buckets, access_pattern, n_ops);
-   external_test<tile_size>(n_buckets, access_pattern, n_ops);
+
+   myfile << tile_size << "," << std::setprecision(12)
+          << internal_test<tile_size>(n_buckets, access_pattern, n_ops) << ","
+          << layout_test<hashing_project::helpers::packed_bucket_locks, tile_size>(n_buckets, access_pattern, n_ops) << ","
+          << layout_test<hashing_project::helpers::sector_bucket_locks<32>, tile_size>(n_buckets, access_pattern, n_ops) << ","
+          << layout_test<hashing_project::helpers::sector_bucket_locks<128>, tile_size>(n_buckets, access_pattern, n_ops) << ","
+          << layout_test<hashing_project::helpers::striped_bucket_locks<LOCK_TEST_STRIPES>, tile_size>(n_buckets, access_pattern, n_ops) << "\n";
 
 }
 
-int main(int argc, char** argv) {
 
-   uint64_t n_buckets;
+//table sized to n_buckets buckets, keys drawn from half the slots so the table never fills.
+template <typename lock_layout>
+__host__ double table_test(uint64_t n_buckets, DATA_TYPE * access_pattern, uint64_t n_ops){
+
+   using ht_type = hashing_project::tables::md_p2_generic_with_locks<uint64_t, uint64_t, 4, 32, lock_layout>;
+
+   ht_type * table = ht_type::generate_on_device(n_buckets*32, 42);
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t));
+
+   misses[0] = 0;
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer upsert_timer;
+
+   upsert_contention_kernel<ht_type, 4><<<(n_ops*4-1)/256+1,256>>>(table, access_pattern, n_ops, n_buckets*16, misses);
+
+   upsert_timer.sync_end();
+
+   std::string label = "p2MD " + lock_layout::get_name() + " upserted";
+
+   upsert_timer.print_throughput(label.c_str(), n_ops);
+
+   printf("%s: %lu failed upserts\n", lock_layout::get_name().c_str(), misses[0]);
+
+   table->print_space_usage();
+
+   ht_type::free_on_device(table);
+
+   cudaFree(misses);
+
+   return 1.0*n_ops/(upsert_timer.elapsed()*1000000);
+
+}
+
+
+__host__ void execute_test(uint64_t n_buckets, uint64_t n_ops, bool zipfian, double alpha){
+
+
+   auto host_pattern = generate_access_pattern(n_ops, n_buckets, zipfian, alpha);
+
+   //device copy - the kernels should contend on locks, not on PCIe reads of the pattern.
+   DATA_TYPE * access_pattern = gallatin::utils::get_device_version<DATA_TYPE>(n_ops);
+
+   cudaMemcpy(access_pattern, host_pattern, sizeof(DATA_TYPE)*n_ops, cudaMemcpyHostToDevice);
+
+   cudaFreeHost(host_pattern);
 
-   uint64_t n_rounds;
 
+   std::string filename = "results/lock_test/";
 
-   if (argc < 2){
-      n_buckets = 1000000;
+   if (zipfian){
+      filename += "zipfian_" + std::to_string(alpha) + "_" + std::to_string(n_buckets) + ".txt";
    } else {
-      n_buckets = std::stoull(argv[1]);
+      filename += "uniform_" + std::to_string(n_buckets) + ".txt";
    }
 
-   if (argc < 3){
-      n_rounds = 1000;
-   } else {
-      n_rounds = std::stoull(argv[2]);
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+
+   myfile << "tile_size,in_bucket,packed,sector_32,sector_128,striped_" << LOCK_TEST_STRIPES << "\n";
+
+   test_layouts<1>(n_buckets, access_pattern, n_ops, myfile);
+   test_layouts<2>(n_buckets, access_pattern, n_ops, myfile);
+   test_layouts<4>(n_buckets, access_pattern, n_ops, myfile);
+   test_layouts<8>(n_buckets, access_pattern, n_ops, myfile);
+   test_layouts<16>(n_buckets, access_pattern, n_ops, myfile);
+   test_layouts<32>(n_buckets, access_pattern, n_ops, myfile);
+
+
+   myfile << "table,packed,sector_32,sector_128,striped_" << LOCK_TEST_STRIPES << "\n";
+
+   myfile << "p2MD," << std::setprecision(12)
+          << table_test<hashing_project::helpers::packed_bucket_locks>(n_buckets, access_pattern, n_ops) << ","
+          << table_test<hashing_project::helpers::sector_bucket_locks<32>>(n_buckets, access_pattern, n_ops) << ","
+          << table_test<hashing_project::helpers::sector_bucket_locks<128>>(n_buckets, access_pattern, n_ops) << ","
+          << table_test<hashing_project::helpers::striped_bucket_locks<LOCK_TEST_STRIPES>>(n_buckets, access_pattern, n_ops) << "\n";
+
+   myfile.close();
+
+   cudaFree(access_pattern);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("lock_test");
+
+   program.add_argument("--buckets", "-b").scan<'u', uint64_t>().default_value((uint64_t) 1000000).help("Number of lock buckets.");
+
+   program.add_argument("--n_ops", "-n").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of lock acquisitions / upserts.");
+
+   program.add_argument("--zipfian", "-z").flag().help("Use zipfian bucket accesses. If not accesses are uniform random.");
+
+   program.add_argument("--alpha", "-a").scan<'g', double>().help("Alpha value for the zipfian generator.").default_value(.99);
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
    }
 
-   auto access_pattern = generate_data<DATA_TYPE>(n_rounds);
-   
-   //auto access_pattern = generate_clipped_data<uint64_t>(table_capacity+replacement_items, table_capacity);
-   
-   test_both<1>(n_buckets, access_pattern, n_rounds);
-   test_both<2>(n_buckets, access_pattern, n_rounds);
-   test_both<4>(n_buckets, access_pattern, n_rounds);
-   test_both<8>(n_buckets, access_pattern, n_rounds);
-   test_both<16>(n_buckets, access_pattern, n_rounds);
-   test_both<32>(n_buckets, access_pattern, n_rounds);
-   //p2
+   auto n_buckets = program.get<uint64_t>("--buckets");
+   auto n_ops = program.get<uint64_t>("--n_ops");
+   auto zipfian = program.get<bool>("--zipfian");
+   auto alpha = program.get<double>("--alpha");
 
 
-   cudaFreeHost(access_pattern);
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/lock_test")){
+   } else {
+   }
 
-   //cache_test<hashing_project::wrappers::p2_wrapper, 32>(host_items, cache_items, n_ops);
 
+   execute_test(n_buckets, n_ops, zipfian, alpha);
 
 
    cudaDeviceReset();
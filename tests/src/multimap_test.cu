@@ -0,0 +1,658 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Multimap correctness test (tables/double_hashing_metadata_multimap.cuh,
+// tables/p2_hashing_metadata_multimap.cuh, host_tables/swiss_multimap.cuh).
+// --keys distinct keys get --copies copies each, inserted concurrently. Copy j of key i has value
+// i*copies+j+1. Then:
+//   count                        - every key reports copies
+//   retrieve_all                 - every key returns exactly its copies' values
+//   retrieve_count / write       - offsets[i] is i*copies and each range holds key i's values
+//   remove_all                   - returns copies, and count is 0 afterwards
+// A heavy key check then inserts one key many times into an empty table, one copy at a time:
+//   double / host swiss          - 4*bucket_size copies, all of which must be stored
+//   p2                           - 2*bucket_size+8 copies. Only the key's two buckets hold copies, so the
+//                                  first 2*bucket_size (bucket_size if both candidates are the same bucket)
+//                                  succeed and every later insert fails. The stored copies must survive,
+//                                  remove_all must free them, and a new copy must fit again afterwards.
+// Every check prints its error count and asserts it is 0.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <assert.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+
+#include <hashing_project/tables/double_hashing_metadata_multimap.cuh>
+#include <hashing_project/tables/p2_hashing_metadata_multimap.cuh>
+#include <hashing_project/host_tables/swiss_multimap.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+//tables are sized so the copies fill this fraction of the slots.
+#define MULTIMAP_LOAD .5
+
+//extra copies offered to the p2 multimap past its 2*bucket_size cap.
+#define MULTIMAP_EXTRA_COPIES 8
+
+
+//keys are 1..n_keys - distinct, and never the sentinel or tombstone.
+__host__ DATA_TYPE * generate_keys(uint64_t n_keys){
+
+   DATA_TYPE * keys;
+
+   cudaMallocHost((void **)&keys, sizeof(DATA_TYPE)*n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      keys[i] = i+1;
+   }
+
+   return keys;
+
+}
+
+
+//one tile per (key, copy) - copies of the same key race each other.
+template <typename ht_type, uint tile_size>
+__global__ void multimap_insert_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t n_copies, uint64_t * errors){
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys*n_copies) return;
+
+   if (!table->insert_dup(my_tile, keys[tid/n_copies], tid+1)){
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&errors[0], 1ULL);
+      }
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void multimap_count_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t expected, uint64_t * errors){
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   if (table->count(my_tile, keys[tid]) != expected){
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&errors[0], 1ULL);
+      }
+
+   }
+
+}
+
+
+//key i writes its values to values[i*n_copies, (i+1)*n_copies).
+template <typename ht_type, uint tile_size>
+__global__ void multimap_retrieve_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t n_copies, DATA_TYPE * values, uint64_t * errors){
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   if (table->retrieve_all(my_tile, keys[tid], values+tid*n_copies, n_copies) != n_copies){
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&errors[0], 1ULL);
+      }
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void multimap_remove_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t n_copies, uint64_t * errors){
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   if (table->remove_all(my_tile, keys[tid]) != n_copies){
+
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&errors[0], 1ULL);
+      }
+
+   }
+
+}
+
+
+//single tile - inserts copies 1..n_copies of key in order.
+//results: [0] copies stored, [1] index of the first failed insert (n_copies if none),
+//[2] count, [3] retrieve_all total, [4] remove_all, [5] count after remove, [6] reinsert succeeded,
+//[7] both candidate buckets are the same (p2 only).
+template <typename ht_type, uint tile_size>
+__global__ void multimap_heavy_kernel(ht_type * table, DATA_TYPE key, uint64_t n_copies, DATA_TYPE * values, uint64_t * results){
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid != 0) return;
+
+   uint64_t n_stored = 0;
+   uint64_t first_failure = n_copies;
+
+   for (uint64_t i = 0; i < n_copies; i++){
+
+      if (table->insert_dup(my_tile, key, i+1)){
+         n_stored++;
+      } else if (first_failure == n_copies){
+         first_failure = i;
+      }
+
+   }
+
+   uint64_t n_counted = table->count(my_tile, key);
+
+   uint64_t n_retrieved = table->retrieve_all(my_tile, key, values, n_copies);
+
+   uint64_t n_removed = table->remove_all(my_tile, key);
+
+   uint64_t n_left = table->count(my_tile, key);
+
+   bool reinserted = table->insert_dup(my_tile, key, n_copies+1);
+
+   if (my_tile.thread_rank() == 0){
+
+      results[0] = n_stored;
+      results[1] = first_failure;
+      results[2] = n_counted;
+      results[3] = n_retrieved;
+      results[4] = n_removed;
+      results[5] = n_left;
+      results[6] = reinserted;
+      results[7] = 0;
+
+   }
+
+}
+
+
+template <typename ht_type>
+__global__ void multimap_same_bucket_kernel(ht_type * table, DATA_TYPE key, uint64_t * results){
+
+   uint64_t tid = gallatin::utils::get_tid();
+
+   if (tid != 0) return;
+
+   uint64_t key_hash = table->hash(&key, sizeof(DATA_TYPE), table->seed);
+
+   results[7] = (table->get_first_bucket(key_hash) == table->get_second_bucket(key_hash));
+
+}
+
+
+//values[i*n_copies, (i+1)*n_copies) should be a permutation of key i's values.
+__host__ uint64_t check_values(DATA_TYPE * values, const uint64_t * offsets, uint64_t n_keys, uint64_t n_copies){
+
+   uint64_t n_wrong = 0;
+
+   std::vector<DATA_TYPE> key_values(n_copies);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+
+      uint64_t start = (offsets == nullptr) ? i*n_copies : offsets[i];
+
+      std::copy(values+start, values+start+n_copies, key_values.begin());
+
+      std::sort(key_values.begin(), key_values.end());
+
+      for (uint64_t j = 0; j < n_copies; j++){
+
+         if (key_values[j] != i*n_copies+j+1){
+            n_wrong++;
+            break;
+         }
+
+      }
+
+   }
+
+   return n_wrong;
+
+}
+
+
+__host__ uint64_t check_offsets(const uint64_t * offsets, uint64_t n_keys, uint64_t n_copies){
+
+   uint64_t n_wrong = 0;
+
+   for (uint64_t i = 0; i <= n_keys; i++){
+      if (offsets[i] != i*n_copies) n_wrong++;
+   }
+
+   return n_wrong;
+
+}
+
+
+__host__ void report_multimap(std::string label, std::string check, uint64_t n_errors){
+
+   printf("%s %s: %lu errors\n", label.c_str(), check.c_str(), n_errors);
+
+   assert(n_errors == 0);
+
+}
+
+
+//heavy key results, see multimap_heavy_kernel. expected is how many copies fit.
+__host__ void report_heavy(std::string label, uint64_t * results, uint64_t n_copies, uint64_t expected, DATA_TYPE * values){
+
+   uint64_t n_wrong = 0;
+
+   std::vector<DATA_TYPE> stored(values, values+std::min(results[3], n_copies));
+
+   std::sort(stored.begin(), stored.end());
+
+   for (uint64_t i = 0; i < stored.size(); i++){
+      if (stored[i] != i+1) n_wrong++;
+   }
+
+   printf("%s heavy key: %lu of %lu copies stored (expected %lu), first failure %lu, count %lu, retrieved %lu, removed %lu, left %lu, reinsert %lu, wrong values %lu\n",
+          label.c_str(), results[0], n_copies, expected, results[1], results[2], results[3], results[4], results[5], results[6], n_wrong);
+
+   //failures only start once the key is full, and never store a copy afterwards.
+   assert(results[0] == expected);
+   assert(results[1] == expected);
+   assert(results[2] == expected && results[3] == expected);
+   assert(n_wrong == 0);
+   assert(results[4] == expected && results[5] == 0);
+   assert(results[6] == 1);
+
+}
+
+
+//capped - the table holds at most 2*bucket_size copies of a key (p2).
+template <template<typename, typename, uint, uint> typename multimap_type, uint tile_size, uint bucket_size, bool capped>
+__host__ void multimap_test_device(DATA_TYPE * access_pattern, uint64_t n_keys, uint64_t n_copies){
+
+
+   using ht_type = multimap_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string label = ht_type::get_name();
+
+   uint64_t n_pairs = n_keys*n_copies;
+
+   ht_type * table = ht_type::generate_on_device(n_pairs/MULTIMAP_LOAD, 42);
+
+   DATA_TYPE * device_keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(device_keys, access_pattern, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+   uint64_t * errors;
+
+   cudaMallocManaged((void **)&errors, sizeof(uint64_t));
+
+   DATA_TYPE * values;
+
+   cudaMallocManaged((void **)&values, sizeof(DATA_TYPE)*n_pairs);
+
+   uint64_t * offsets;
+
+   cudaMallocManaged((void **)&offsets, sizeof(uint64_t)*(n_keys+1));
+
+   cudaDeviceSynchronize();
+
+
+   errors[0] = 0;
+
+   gallatin::utils::timer insert_timer;
+
+   multimap_insert_kernel<ht_type, tile_size><<<(n_pairs*tile_size-1)/256+1,256>>>(table, device_keys, n_keys, n_copies, errors);
+
+   insert_timer.sync_end();
+
+   insert_timer.print_throughput("Inserted", n_pairs);
+
+   report_multimap(label, "insert_dup failures", errors[0]);
+
+
+   errors[0] = 0;
+
+   multimap_count_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_keys, n_keys, n_copies, errors);
+
+   cudaDeviceSynchronize();
+
+   report_multimap(label, "count", errors[0]);
+
+
+   errors[0] = 0;
+
+   multimap_retrieve_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_keys, n_keys, n_copies, values, errors);
+
+   cudaDeviceSynchronize();
+
+   report_multimap(label, "retrieve_all totals", errors[0]);
+
+   report_multimap(label, "retrieve_all values", check_values(values, nullptr, n_keys, n_copies));
+
+
+   cudaMemset(values, 0, sizeof(DATA_TYPE)*n_pairs);
+
+   gallatin::utils::timer retrieve_timer;
+
+   uint64_t total = table->retrieve_count(device_keys, n_keys, offsets);
+
+   table->retrieve_write(device_keys, n_keys, offsets, values);
+
+   retrieve_timer.sync_end();
+
+   retrieve_timer.print_throughput("Retrieved", n_pairs);
+
+   report_multimap(label, "retrieve_count total", total != n_pairs);
+
+   report_multimap(label, "retrieve_count offsets", check_offsets(offsets, n_keys, n_copies));
+
+   report_multimap(label, "retrieve_write values", check_values(values, offsets, n_keys, n_copies));
+
+
+   errors[0] = 0;
+
+   gallatin::utils::timer remove_timer;
+
+   multimap_remove_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_keys, n_keys, n_copies, errors);
+
+   remove_timer.sync_end();
+
+   remove_timer.print_throughput("Removed", n_pairs);
+
+   report_multimap(label, "remove_all", errors[0]);
+
+   errors[0] = 0;
+
+   multimap_count_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_keys, n_keys, 0, errors);
+
+   cudaDeviceSynchronize();
+
+   report_multimap(label, "count after remove_all", errors[0]);
+
+   report_multimap(label, "retrieve_count after remove_all", table->retrieve_count(device_keys, n_keys, offsets));
+
+   ht_type::free_on_device(table);
+
+
+   //heavy key in a fresh table.
+   uint64_t heavy_copies = capped ? 2*bucket_size+MULTIMAP_EXTRA_COPIES : 4*bucket_size;
+
+   table = ht_type::generate_on_device(bucket_size*1024, 42);
+
+   uint64_t * results;
+
+   cudaMallocManaged((void **)&results, sizeof(uint64_t)*8);
+
+   DATA_TYPE * heavy_values;
+
+   cudaMallocManaged((void **)&heavy_values, sizeof(DATA_TYPE)*heavy_copies);
+
+   cudaDeviceSynchronize();
+
+   multimap_heavy_kernel<ht_type, tile_size><<<1,256>>>(table, access_pattern[0], heavy_copies, heavy_values, results);
+
+   if constexpr (capped){
+      multimap_same_bucket_kernel<ht_type><<<1,256>>>(table, access_pattern[0], results);
+   }
+
+   cudaDeviceSynchronize();
+
+   uint64_t expected = capped ? (results[7] ? bucket_size : 2*bucket_size) : heavy_copies;
+
+   report_heavy(label, results, heavy_copies, expected, heavy_values);
+
+   ht_type::free_on_device(table);
+
+
+   cudaFree(results);
+   cudaFree(heavy_values);
+   cudaFree(offsets);
+   cudaFree(values);
+   cudaFree(errors);
+   cudaFree(device_keys);
+
+}
+
+
+template <uint bucket_size>
+__host__ void multimap_test_host(DATA_TYPE * access_pattern, uint64_t n_keys, uint64_t n_copies, uint32_t n_threads){
+
+
+   using ht_type = hashing_project::tables::host_swiss_multimap_generic<DATA_TYPE, DATA_TYPE, 1, bucket_size>;
+
+   std::string label = ht_type::get_name() + "_" + std::to_string(bucket_size);
+
+   uint64_t n_pairs = n_keys*n_copies;
+
+   ht_type * table = ht_type::generate_on_host(n_pairs/MULTIMAP_LOAD, 42);
+
+   std::atomic<uint64_t> errors {0};
+
+
+   hashing_project::host::timer insert_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_pairs, [&](uint64_t tid){
+      if (!table->insert_dup(access_pattern[tid/n_copies], tid+1)) errors++;
+   });
+
+   insert_timer.sync_end();
+
+   insert_timer.print_throughput("Inserted", n_pairs);
+
+   report_multimap(label, "insert_dup failures", errors.load());
+
+
+   errors = 0;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      if (table->count(access_pattern[tid]) != n_copies) errors++;
+   });
+
+   report_multimap(label, "count", errors.load());
+
+
+   std::vector<DATA_TYPE> values(n_pairs);
+
+   errors = 0;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      if (table->retrieve_all(access_pattern[tid], values.data()+tid*n_copies, n_copies) != n_copies) errors++;
+   });
+
+   report_multimap(label, "retrieve_all totals", errors.load());
+
+   report_multimap(label, "retrieve_all values", check_values(values.data(), nullptr, n_keys, n_copies));
+
+
+   std::fill(values.begin(), values.end(), 0);
+
+   std::vector<uint64_t> offsets(n_keys+1);
+
+   hashing_project::host::timer retrieve_timer;
+
+   uint64_t total = table->retrieve_count(access_pattern, n_keys, offsets.data(), n_threads);
+
+   table->retrieve_write(access_pattern, n_keys, offsets.data(), values.data(), n_threads);
+
+   retrieve_timer.sync_end();
+
+   retrieve_timer.print_throughput("Retrieved", n_pairs);
+
+   report_multimap(label, "retrieve_count total", total != n_pairs);
+
+   report_multimap(label, "retrieve_count offsets", check_offsets(offsets.data(), n_keys, n_copies));
+
+   report_multimap(label, "retrieve_write values", check_values(values.data(), offsets.data(), n_keys, n_copies));
+
+
+   errors = 0;
+
+   hashing_project::host::timer remove_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      if (table->remove_all(access_pattern[tid]) != n_copies) errors++;
+   });
+
+   remove_timer.sync_end();
+
+   remove_timer.print_throughput("Removed", n_pairs);
+
+   report_multimap(label, "remove_all", errors.load());
+
+   errors = 0;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      if (table->count(access_pattern[tid]) != 0) errors++;
+   });
+
+   report_multimap(label, "count after remove_all", errors.load());
+
+   report_multimap(label, "retrieve_count after remove_all", table->retrieve_count(access_pattern, n_keys, offsets.data(), n_threads));
+
+   ht_type::free_on_host(table);
+
+
+   //heavy key in a fresh table - no cap, every copy must be stored.
+   uint64_t heavy_copies = 4*bucket_size;
+
+   table = ht_type::generate_on_host(bucket_size*1024, 42);
+
+   DATA_TYPE key = access_pattern[0];
+
+   uint64_t results[8] = {0, heavy_copies, 0, 0, 0, 0, 0, 0};
+
+   std::vector<DATA_TYPE> heavy_values(heavy_copies);
+
+   for (uint64_t i = 0; i < heavy_copies; i++){
+
+      if (table->insert_dup(key, i+1)){
+         results[0]++;
+      } else if (results[1] == heavy_copies){
+         results[1] = i;
+      }
+
+   }
+
+   results[2] = table->count(key);
+   results[3] = table->retrieve_all(key, heavy_values.data(), heavy_copies);
+   results[4] = table->remove_all(key);
+   results[5] = table->count(key);
+   results[6] = table->insert_dup(key, heavy_copies+1);
+
+   report_heavy(label, results, heavy_copies, heavy_copies, heavy_values.data());
+
+   ht_type::free_on_host(table);
+
+}
+
+
+__host__ void execute_test(uint64_t n_keys, uint64_t n_copies, uint32_t n_threads){
+
+
+   auto access_pattern = generate_keys(n_keys);
+
+
+   multimap_test_device<hashing_project::tables::md_double_multimap_generic, 4, 32, false>(access_pattern, n_keys, n_copies);
+
+   multimap_test_device<hashing_project::tables::md_p2_multimap_generic, 4, 32, true>(access_pattern, n_keys, n_copies);
+
+   multimap_test_host<16>(access_pattern, n_keys, n_copies, n_threads);
+   multimap_test_host<32>(access_pattern, n_keys, n_copies, n_threads);
+
+
+   cudaFreeHost(access_pattern);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("multimap_test");
+
+   program.add_argument("--keys", "-k").default_value((uint64_t) 100000).scan<'u', uint64_t>().help("Number of distinct keys.");
+
+   program.add_argument("--copies").default_value((uint64_t) 8).scan<'u', uint64_t>().help("Copies of each key. The p2 multimap needs this well under 2*bucket_size.");
+
+   program.add_argument("--threads")
+   .default_value((uint32_t) hashing_project::host::get_default_n_threads())
+   .scan<'u', uint32_t>()
+   .help("Host threads for the host multimap.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto n_keys = program.get<uint64_t>("--keys");
+   auto n_copies = program.get<uint64_t>("--copies");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   std::cout << "Running multimap test with " << n_keys << " keys and " << n_copies << " copies." << std::endl;
+
+
+   execute_test(n_keys, n_copies, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
@@ -0,0 +1,742 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Quotient iceberg benchmark.
+// Gives the full-key iceberg table and the quotiented iceberg table the same memory budget,
+// inserts until 95% of each table's slots are offered, and records:
+// 1. keys stored, bytes per key and insert/query/remove throughput of each table.
+// 2. a frontyard sweep that recovers every quotiented key and queries it back.
+// The host quotient table is compared with the host swiss table the same way.
+// 3. a spill check on the device and host quotient tables: fill one frontyard bucket so its last key
+//    spills to the backyard, remove a frontyard key, re-upsert the spilled key, then remove it -
+//    the key must be gone afterwards, not resurface from a stale backyard copy.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <vector>
+#include <unordered_map>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/iht_p2_metadata_quotient.cuh>
+#include <hashing_project/host_tables/iceberg_quotient.cuh>
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define DATA_TYPE uint64_t
+
+
+#define LARGE_MD_LOAD 1
+#define LARGE_BUCKET_MODS 0
+
+
+//fraction of each table's slots offered as keys.
+#define QUOTIENT_OFFERED_FILL .95
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void quotient_insert_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   if (!table->upsert_replace(my_tile, my_key, my_key+1)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//misses[1] counts wrong answers - inserts that failed are expected to miss.
+template <typename ht_type, uint tile_size>
+__global__ void quotient_query_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+   DATA_TYPE my_val;
+
+   if (table->find_with_reference(my_tile, my_key, my_val)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0 && my_val != my_key+1){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void quotient_remove_kernel(ht_type * table, DATA_TYPE * insert_buffer, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   DATA_TYPE my_key = insert_buffer[tid];
+
+   if (!table->remove(my_tile, my_key)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[2], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//one tile per frontyard slot - recover the key from (bucket, tag, remainder) and query it back.
+template <typename ht_type, uint tile_size, uint bucket_size>
+__global__ void quotient_recover_kernel(ht_type * table, uint64_t n_buckets_primary, uint64_t * recovered, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_buckets_primary*bucket_size) return;
+
+
+   DATA_TYPE my_key = table->get_frontyard_key(tid/bucket_size, tid % bucket_size);
+
+   if (my_key == 0) return;
+
+   DATA_TYPE my_val;
+
+   bool found = table->find_with_reference(my_tile, my_key, my_val);
+
+   if (my_tile.thread_rank() == 0){
+
+      atomicAdd((unsigned long long int *)recovered, 1ULL);
+
+      if (!found || my_val != my_key+1){
+         atomicAdd((unsigned long long int *)&misses[3], 1ULL);
+      }
+
+   }
+
+}
+
+
+template <typename ht_type>
+__global__ void quotient_bucket_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * buckets){
+
+   uint64_t tid = gallatin::utils::get_tid();
+
+   if (tid >= n_keys) return;
+
+   buckets[tid] = table->get_first_bucket(table->permute_key(keys[tid]));
+
+}
+
+
+//one tile replays the spill sequence on keys that share a frontyard bucket. keys[n_keys-1] overflows
+//the bucket, so after keys[0] is removed the re-upsert must find the backyard copy instead of taking
+//the freed frontyard slot.
+template <typename ht_type, uint tile_size>
+__global__ void quotient_spill_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * errors){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid != 0) return;
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      table->upsert_replace(my_tile, keys[i], keys[i]+1);
+   }
+
+   DATA_TYPE spilled = keys[n_keys-1];
+
+   DATA_TYPE my_val;
+
+   bool removed_front = table->remove(my_tile, keys[0]);
+
+   table->upsert_replace(my_tile, spilled, spilled+2);
+
+   bool found_new = table->find_with_reference(my_tile, spilled, my_val) && my_val == spilled+2;
+
+   bool removed = table->remove(my_tile, spilled);
+
+   bool resurfaced = table->find_with_reference(my_tile, spilled, my_val);
+
+   if (my_tile.thread_rank() == 0){
+      errors[0] = !removed_front;
+      errors[1] = !found_new;
+      errors[2] = !removed;
+      errors[3] = resurfaced;
+   }
+
+}
+
+
+//bucket_size+1 keys that share a frontyard bucket, skipping the sentinel / tombstone keys. Empty if none do.
+__host__ std::vector<DATA_TYPE> select_shared_bucket(DATA_TYPE * keys, uint64_t * buckets, uint64_t n_keys, uint bucket_size){
+
+   std::unordered_map<uint64_t, std::vector<DATA_TYPE>> by_bucket;
+
+   for (uint64_t i = 0; i < n_keys; i++){
+
+      if (keys[i] == 0 || keys[i] >= ~0ULL-1) continue;
+
+      std::vector<DATA_TYPE> & shared = by_bucket[buckets[i]];
+
+      shared.push_back(keys[i]);
+
+      if (shared.size() == bucket_size+1) return shared;
+
+   }
+
+   return std::vector<DATA_TYPE>();
+
+}
+
+
+__host__ void report_spill(std::string label, uint64_t * errors){
+
+   if (errors[0] || errors[1] || errors[2] || errors[3]){
+      printf("%s spill check FAILED: frontyard remove %lu, re-upsert lookup %lu, remove %lu, resurfaced %lu\n", label.c_str(), errors[0], errors[1], errors[2], errors[3]);
+   } else {
+      printf("%s spill check passed\n", label.c_str());
+   }
+
+   assert(errors[0] == 0 && errors[1] == 0 && errors[2] == 0 && errors[3] == 0);
+
+}
+
+
+template <uint tile_size, uint bucket_size>
+__host__ void quotient_spill_test_device(DATA_TYPE * access_pattern, uint64_t n_keys){
+
+
+   using quotient_table = hashing_project::tables::iht_p2_metadata_quotient_generic<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   //smallest table - QUOTIENT_MIN_FRONT_BUCKETS frontyard buckets, so a random key set shares buckets.
+   quotient_table * table = quotient_table::generate_on_device(bucket_size*QUOTIENT_MIN_FRONT_BUCKETS, 42);
+
+   DATA_TYPE * device_keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(device_keys, access_pattern, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+   uint64_t * buckets;
+
+   cudaMallocManaged((void **)&buckets, sizeof(uint64_t)*n_keys);
+
+   quotient_bucket_kernel<quotient_table><<<(n_keys-1)/256+1,256>>>(table, device_keys, n_keys, buckets);
+
+   cudaDeviceSynchronize();
+
+   std::vector<DATA_TYPE> shared = select_shared_bucket(access_pattern, buckets, n_keys, bucket_size);
+
+   assert(shared.size() == bucket_size+1);
+
+   cudaMemcpy(device_keys, shared.data(), sizeof(DATA_TYPE)*shared.size(), cudaMemcpyHostToDevice);
+
+   uint64_t * errors;
+
+   cudaMallocManaged((void **)&errors, sizeof(uint64_t)*4);
+
+   quotient_spill_kernel<quotient_table, tile_size><<<1,256>>>(table, device_keys, shared.size(), errors);
+
+   cudaDeviceSynchronize();
+
+   report_spill(quotient_table::get_name(), errors);
+
+   cudaFree(errors);
+   cudaFree(buckets);
+   cudaFree(device_keys);
+
+   quotient_table::free_on_device(table);
+
+}
+
+
+template <uint bucket_size>
+__host__ void quotient_spill_test_host(DATA_TYPE * access_pattern, uint64_t n_keys){
+
+
+   using quotient_table = hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, bucket_size>;
+
+   quotient_table * table = quotient_table::generate_on_host(bucket_size*HOST_ICEBERG_MIN_FRONT_BUCKETS, 42);
+
+   std::vector<uint64_t> buckets(n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      buckets[i] = table->get_first_bucket(table->permute_key(access_pattern[i]));
+   }
+
+   std::vector<DATA_TYPE> shared = select_shared_bucket(access_pattern, buckets.data(), n_keys, bucket_size);
+
+   assert(shared.size() == bucket_size+1);
+
+   for (DATA_TYPE key : shared){
+      table->upsert_replace(key, key+1);
+   }
+
+   DATA_TYPE spilled = shared.back();
+
+   DATA_TYPE my_val;
+
+   uint64_t errors[4];
+
+   errors[0] = !table->remove(shared[0]);
+
+   table->upsert_replace(spilled, spilled+2);
+
+   errors[1] = !(table->find_with_reference(spilled, my_val) && my_val == spilled+2);
+
+   errors[2] = !table->remove(spilled);
+
+   errors[3] = table->find_with_reference(spilled, my_val);
+
+   report_spill(quotient_table::get_name() + "_" + std::to_string(bucket_size), errors);
+
+   quotient_table::free_on_host(table);
+
+}
+
+
+//offer QUOTIENT_OFFERED_FILL of the table's slots, then query and remove them all.
+template <typename ht_type, uint tile_size, uint bucket_size>
+__host__ void quotient_run_device(std::string label, ht_type * table, uint64_t table_bytes, uint64_t n_slots, DATA_TYPE * device_data, std::ofstream & myfile){
+
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*4);
+
+   cudaDeviceSynchronize();
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+   misses[3] = 0;
+
+   uint64_t items_to_insert = n_slots*QUOTIENT_OFFERED_FILL;
+
+
+   gallatin::utils::timer insert_timer;
+
+   quotient_insert_kernel<ht_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   insert_timer.sync_end();
+
+   uint64_t n_stored = table->get_fill();
+
+   gallatin::utils::timer query_timer;
+
+   quotient_query_kernel<ht_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   query_timer.sync_end();
+
+   gallatin::utils::timer remove_timer;
+
+   quotient_remove_kernel<ht_type, tile_size><<<(items_to_insert*tile_size-1)/256+1,256>>>(table, device_data, items_to_insert, misses);
+
+   remove_timer.sync_end();
+
+   cudaDeviceSynchronize();
+
+   printf("%s: %lu bytes, %lu slots, %lu of %lu keys stored, %f bytes per key\n", label.c_str(), table_bytes, n_slots, n_stored, items_to_insert, 1.0*table_bytes/n_stored);
+   printf("%s misses: insert %lu incorrect %lu remove %lu\n", label.c_str(), misses[0], misses[1], misses[2]);
+
+   insert_timer.print_throughput("Inserted", items_to_insert);
+   query_timer.print_throughput("Queried", items_to_insert);
+   remove_timer.print_throughput("Removed", items_to_insert);
+
+   myfile << label << "," << table_bytes << "," << n_slots << "," << n_stored << "," << std::setprecision(12)
+          << 1.0*table_bytes/n_stored << ","
+          << 1.0*items_to_insert/(insert_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(query_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(remove_timer.elapsed()*1000000) << "\n";
+
+   cudaFree(misses);
+
+}
+
+
+template <uint tile_size, uint bucket_size>
+__host__ void quotient_test_device(uint64_t table_capacity, DATA_TYPE * access_pattern, std::ofstream & myfile){
+
+
+   using full_table = hashing_project::tables::iht_p2_metadata_full_generic<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   using quotient_table = hashing_project::tables::iht_p2_metadata_quotient_generic<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+
+   //full table sets the memory budget.
+   full_table * full = full_table::generate_on_device(table_capacity, 42);
+
+   full_table * host_full = gallatin::utils::copy_to_host<full_table>(full);
+
+   uint64_t full_slots = (host_full->n_buckets_primary+host_full->n_buckets_alt)*bucket_size;
+
+   uint64_t full_bytes = host_full->n_buckets_primary*(sizeof(typename full_table::frontyard_bucket_type)+sizeof(typename full_table::md_bucket_type)) + (host_full->n_buckets_primary-1)/8+1;
+
+   full_bytes += host_full->n_buckets_alt*(sizeof(typename full_table::backyard_bucket_type)+sizeof(typename full_table::md_bucket_type));
+
+   cudaFreeHost(host_full);
+
+
+   //size the quotient table to the same budget from its per-slot cost.
+   double quotient_slot_bytes = (METADATA_FULL_FRONT_TOTAL_RATIO*(sizeof(typename quotient_table::frontyard_bucket_type)+sizeof(typename quotient_table::md_bucket_type))
+                                 + (1.0-METADATA_FULL_FRONT_TOTAL_RATIO)*(sizeof(typename quotient_table::backyard_bucket_type)+sizeof(typename quotient_table::backyard_md_bucket_type)))/bucket_size;
+
+   uint64_t quotient_capacity = full_bytes/quotient_slot_bytes;
+
+   quotient_table * quotient = quotient_table::generate_on_device(quotient_capacity, 42);
+
+   quotient_table * host_quotient = gallatin::utils::copy_to_host<quotient_table>(quotient);
+
+   uint64_t quotient_slots = (host_quotient->n_buckets_primary+host_quotient->n_buckets_alt)*bucket_size;
+
+   uint64_t n_buckets_primary = host_quotient->n_buckets_primary;
+
+   cudaFreeHost(host_quotient);
+
+   uint64_t quotient_bytes = quotient->get_space_usage();
+
+
+   uint64_t max_items = std::max(full_slots, quotient_slots);
+
+   DATA_TYPE * device_data = gallatin::utils::get_device_version<DATA_TYPE>(max_items);
+
+   cudaMemcpy(device_data, access_pattern, sizeof(DATA_TYPE)*max_items, cudaMemcpyHostToDevice);
+
+   cudaDeviceSynchronize();
+
+
+   quotient_run_device<full_table, tile_size, bucket_size>(full_table::get_name(), full, full_bytes, full_slots, device_data, myfile);
+
+   full_table::free_on_device(full);
+
+
+   //refill after the remove pass so the recovery sweep sees a loaded table.
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*4);
+
+   uint64_t * recovered;
+
+   cudaMallocManaged((void **)&recovered, sizeof(uint64_t));
+
+   cudaDeviceSynchronize();
+
+   misses[0] = 0;
+   misses[3] = 0;
+   recovered[0] = 0;
+
+   quotient_run_device<quotient_table, tile_size, bucket_size>(quotient_table::get_name(), quotient, quotient_bytes, quotient_slots, device_data, myfile);
+
+   quotient_insert_kernel<quotient_table, tile_size><<<((uint64_t)(quotient_slots*QUOTIENT_OFFERED_FILL)*tile_size-1)/256+1,256>>>(quotient, device_data, quotient_slots*QUOTIENT_OFFERED_FILL, misses);
+
+   quotient_recover_kernel<quotient_table, tile_size, bucket_size><<<(n_buckets_primary*bucket_size*tile_size-1)/256+1,256>>>(quotient, n_buckets_primary, recovered, misses);
+
+   cudaDeviceSynchronize();
+
+   printf("Recovered %lu frontyard keys, %lu incorrect\n", recovered[0], misses[3]);
+
+   quotient_table::free_on_device(quotient);
+
+   cudaFree(recovered);
+   cudaFree(misses);
+   cudaFree(device_data);
+
+   cudaDeviceSynchronize();
+
+}
+
+
+template <typename ht_type>
+__host__ void quotient_run_host(std::string label, ht_type * table, uint64_t table_bytes, uint64_t n_slots, DATA_TYPE * access_pattern, uint32_t n_threads, std::ofstream & myfile){
+
+
+   uint64_t items_to_insert = n_slots*QUOTIENT_OFFERED_FILL;
+
+   std::atomic<uint64_t> incorrect{0};
+
+
+   hashing_project::host::timer insert_timer;
+
+   hashing_project::host::parallel_for(n_threads, items_to_insert, [&](uint64_t tid){
+      table->upsert_replace(access_pattern[tid], access_pattern[tid]+1);
+   });
+
+   insert_timer.sync_end();
+
+   uint64_t n_stored = table->get_fill();
+
+   hashing_project::host::timer query_timer;
+
+   hashing_project::host::parallel_for(n_threads, items_to_insert, [&](uint64_t tid){
+
+      DATA_TYPE my_val;
+
+      if (table->find_with_reference(access_pattern[tid], my_val) && my_val != access_pattern[tid]+1){
+         incorrect.fetch_add(1, std::memory_order_relaxed);
+      }
+
+   });
+
+   query_timer.sync_end();
+
+   hashing_project::host::timer remove_timer;
+
+   hashing_project::host::parallel_for(n_threads, items_to_insert, [&](uint64_t tid){
+      table->remove(access_pattern[tid]);
+   });
+
+   remove_timer.sync_end();
+
+   printf("%s: %lu bytes, %lu slots, %lu of %lu keys stored, %f bytes per key, %lu incorrect\n", label.c_str(), table_bytes, n_slots, n_stored, items_to_insert, 1.0*table_bytes/n_stored, incorrect.load());
+
+   insert_timer.print_throughput("Inserted", items_to_insert);
+   query_timer.print_throughput("Queried", items_to_insert);
+   remove_timer.print_throughput("Removed", items_to_insert);
+
+   myfile << label << "," << table_bytes << "," << n_slots << "," << n_stored << "," << std::setprecision(12)
+          << 1.0*table_bytes/n_stored << ","
+          << 1.0*items_to_insert/(insert_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(query_timer.elapsed()*1000000) << ","
+          << 1.0*items_to_insert/(remove_timer.elapsed()*1000000) << "\n";
+
+}
+
+
+__host__ void quotient_test_host(uint64_t table_capacity, DATA_TYPE * access_pattern, uint32_t n_threads, std::ofstream & myfile){
+
+
+   using swiss_table = hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>;
+
+   using quotient_table = hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 32>;
+
+
+   swiss_table * swiss = swiss_table::generate_on_host(table_capacity, 42);
+
+   uint64_t swiss_slots = swiss->n_groups*16;
+
+   uint64_t swiss_bytes = swiss->n_groups*(sizeof(typename swiss_table::group_type)+16*sizeof(typename swiss_table::packed_pair_type)) + swiss->locks.get_space_usage();
+
+   quotient_run_host<swiss_table>(swiss_table::get_name(), swiss, swiss_bytes, swiss_slots, access_pattern, n_threads, myfile);
+
+   swiss_table::free_on_host(swiss);
+
+
+   //grow the quotient table until it fills the swiss table's budget.
+   quotient_table * quotient = quotient_table::generate_on_host(table_capacity, 42);
+
+   uint64_t quotient_capacity = table_capacity*swiss_bytes/quotient->get_space_usage();
+
+   quotient_table::free_on_host(quotient);
+
+   quotient = quotient_table::generate_on_host(quotient_capacity, 42);
+
+   uint64_t quotient_slots = (quotient->n_buckets_primary+quotient->n_buckets_alt)*32;
+
+   quotient_run_host<quotient_table>(quotient_table::get_name(), quotient, quotient->get_space_usage(), quotient_slots, access_pattern, n_threads, myfile);
+
+   quotient_table::free_on_host(quotient);
+
+}
+
+
+__host__ void execute_test(uint64_t table_capacity, uint32_t n_threads){
+
+
+   //quotient tables get up to ~1.3x the slots of the baseline at the same budget,
+   //and small tables are rounded up to QUOTIENT_MIN_FRONT_BUCKETS frontyard buckets.
+   uint64_t n_keys = std::max(table_capacity*2, 2*QUOTIENT_MIN_FRONT_BUCKETS*32);
+
+   auto access_pattern = generate_data<DATA_TYPE>(n_keys);
+
+
+   std::string filename = "results/quotient/iceberg.txt";
+
+   std::ofstream myfile;
+   myfile.open (filename.c_str());
+   myfile << "table,bytes,slots,keys_stored,bytes_per_key,insert,query,remove\n";
+
+   quotient_test_device<4, 32>(table_capacity, access_pattern, myfile);
+
+   myfile.close();
+
+
+   filename = "results/quotient/host.txt";
+
+   myfile.open (filename.c_str());
+   myfile << "table,bytes,slots,keys_stored,bytes_per_key,insert,query,remove\n";
+
+   quotient_test_host(table_capacity, access_pattern, n_threads, myfile);
+
+   myfile.close();
+
+
+   quotient_spill_test_device<4, 32>(access_pattern, n_keys);
+
+   quotient_spill_test_host<16>(access_pattern, n_keys);
+   quotient_spill_test_host<32>(access_pattern, n_keys);
+
+
+   cudaFreeHost(access_pattern);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("quotient_test");
+
+   program.add_argument("--capacity", "-c").required().scan<'u', uint64_t>().help("Number of slots in the full-key table. The quotient table gets the same number of bytes.");
+
+   program.add_argument("--threads")
+   .default_value((uint32_t) hashing_project::host::get_default_n_threads())
+   .scan<'u', uint32_t>()
+   .help("Host threads for the host tables.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   std::cout << "Running quotient test with " << table_capacity << " slots." << std::endl;
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/quotient")){
+   } else {
+   }
+
+
+   execute_test(table_capacity, n_threads);
+
+
+   return 0;
+
+}
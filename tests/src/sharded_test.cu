@@ -0,0 +1,242 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Sharded table benchmark (host_tables/sharded_table.cuh).
+// For each host table, --load * capacity pairs go through upsert_batch / find_batch on a
+// host_sharded_table of 1, 2, 4, ... up to --shards shards with the same total capacity and --threads.
+// Reports throughput per shard count, the speedup over one shard, the largest shard's fill over the
+// mean, and misses (every key is checked against its value in input order).
+// With --numa the shards are spread over the NUMA nodes, generated and run on threads pinned to their
+// node (helpers/host_numa.cuh), and each shard count also prints per-node throughput.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <assert.h>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/helpers/host_numa.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/host_tables/hopscotch.cuh>
+#include <hashing_project/host_tables/iceberg_quotient.cuh>
+#include <hashing_project/host_tables/sharded_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+
+
+#define DATA_TYPE uint64_t
+
+
+template <typename T>
+__host__ std::vector<T> generate_data(uint64_t nitems){
+
+
+   std::vector<T> vals(nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals.data() + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type>
+__host__ void sharded_test(uint64_t table_capacity, double load, uint32_t max_shards, uint32_t n_threads, bool numa, std::vector<DATA_TYPE> & keys, std::vector<DATA_TYPE> & vals, std::ofstream & myfile){
+
+   using sharded_type = hashing_project::tables::host_sharded_table<ht_type>;
+
+   std::string name = sharded_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   std::unique_ptr<bool[]> inserted(new bool[n_keys]);
+   std::unique_ptr<bool[]> found(new bool[n_keys]);
+
+   std::vector<DATA_TYPE> vals_out(n_keys);
+
+   double base_upsert = 0;
+   double base_find = 0;
+
+   for (uint32_t n_shards = 1; n_shards <= max_shards; n_shards *= 2){
+
+      sharded_type * table = sharded_type::generate_on_host(table_capacity, 42, n_shards, numa);
+
+      auto upsert_start = std::chrono::high_resolution_clock::now();
+
+      uint64_t n_inserted = table->upsert_batch(keys.data(), vals.data(), n_keys, inserted.get(), n_threads);
+
+      auto upsert_end = std::chrono::high_resolution_clock::now();
+
+      auto find_start = std::chrono::high_resolution_clock::now();
+
+      uint64_t n_found = table->find_batch(keys.data(), vals_out.data(), found.get(), n_keys, n_threads);
+
+      auto find_end = std::chrono::high_resolution_clock::now();
+
+      uint64_t n_missing = 0;
+
+      for (uint64_t i = 0; i < n_keys; i++){
+         if (inserted[i] && (!found[i] || vals_out[i] != vals[i])) n_missing++;
+      }
+
+      double imbalance = table->get_shard_imbalance();
+
+      if (numa) table->print_node_counters();
+
+      sharded_type::free_on_host(table);
+
+
+      double upsert_throughput = n_keys/(std::chrono::duration<double>(upsert_end-upsert_start).count()*1000000);
+      double find_throughput = n_keys/(std::chrono::duration<double>(find_end-find_start).count()*1000000);
+
+      if (n_shards == 1){
+         base_upsert = upsert_throughput;
+         base_find = find_throughput;
+      }
+
+      printf("%s %u shards: upsert %f M/s = %fx, find %f M/s = %fx, imbalance %f, %lu / %lu inserted, %lu found, missing %lu\n", name.c_str(), n_shards, upsert_throughput, upsert_throughput/base_upsert, find_throughput, find_throughput/base_find, imbalance, n_inserted, n_keys, n_found, n_missing);
+
+      myfile << name << "," << n_shards << "," << n_threads << "," << numa << "," << load << "," << std::setprecision(12) << upsert_throughput << "," << find_throughput << "," << upsert_throughput/base_upsert << "," << find_throughput/base_find << "," << imbalance << "," << n_inserted << "," << n_missing << "\n";
+
+   }
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, double load, uint32_t max_shards, uint32_t n_threads, bool numa){
+
+
+   uint64_t n_keys = table_capacity*load;
+
+   std::vector<DATA_TYPE> keys = generate_data<DATA_TYPE>(n_keys);
+
+   std::vector<DATA_TYPE> vals(n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      vals[i] = i+1;
+   }
+
+
+   std::string filename = "results/sharded/" + table + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + "_" + std::to_string(max_shards) + "_" + std::to_string(n_threads) + (numa ? "_numa" : "") + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,shards,threads,numa,load,upsert_throughput,find_throughput,upsert_speedup,find_speedup,imbalance,inserted,missing\n";
+
+
+   if (table == "swiss" || table == "all"){
+      sharded_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, max_shards, n_threads, numa, keys, vals, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      sharded_test<hashing_project::tables::host_hopscotch_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, max_shards, n_threads, numa, keys, vals, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      sharded_test<hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, max_shards, n_threads, numa, keys, vals, myfile);
+   }
+
+   myfile.close();
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("sharded_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify host table type. Options [all swiss hopscotch iceberg]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Total number of slots over all shards.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table inserted.");
+
+   program.add_argument("--shards", "-s").scan<'u', uint32_t>().default_value((uint32_t) 16).help("Largest shard count - runs 1, 2, 4, ... up to this.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads shared by the shards.");
+
+   program.add_argument("--numa").flag().help("Place shards on NUMA nodes and pin their threads.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto max_shards = program.get<uint32_t>("--shards");
+   auto n_threads = program.get<uint32_t>("--threads");
+   auto numa = program.get<bool>("--numa");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/sharded")){
+   } else {
+   }
+
+
+   if (numa){
+      hashing_project::host::numa_topology::detect().print();
+   }
+
+   execute_test(table, table_capacity, load, max_shards, n_threads, numa);
+
+
+   return 0;
+
+}
@@ -46,6 +46,8 @@ namespace fs = std::filesystem;
 #include <hashing_project/tables/iht_p2_metadata_full.cuh>
 #include <hashing_project/tables/cuckoo.cuh>
 #include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing_metadata_multimap.cuh>
+#include <hashing_project/tables/p2_hashing_metadata_multimap.cuh>
 #include <cooperative_groups.h>
 
 #include <hashing_project/helpers/tensor_contraction.cuh>
@@ -118,6 +120,35 @@ __host__ void execute_test(std::string table, std::string input_file, uint64_t n
       double second = tensor_contraction_nips_013<hashing_project::tables::chaining_generic, 4, 8>(input_file, n_indices_output);
 
       printf("%s %f %f\n", table.c_str(), first, second);
+   } else if (table == "doubleMM"){
+
+      double first = tensor_contraction_multimap<1, hashing_project::tables::md_double_multimap_generic, 4, 32>(input_file, n_indices_output);
+
+      double second = tensor_contraction_multimap<3, hashing_project::tables::md_double_multimap_generic, 4, 32>(input_file, n_indices_output);
+
+      printf("%s %f %f\n", table.c_str(), first, second);
+   } else if (table == "p2MM"){
+
+      //all copies of a key share 2 buckets - heavy contraction keys will report failed inserts.
+      double first = tensor_contraction_multimap<1, hashing_project::tables::md_p2_multimap_generic, 4, 32>(input_file, n_indices_output);
+
+      double second = tensor_contraction_multimap<3, hashing_project::tables::md_p2_multimap_generic, 4, 32>(input_file, n_indices_output);
+
+      printf("%s %f %f\n", table.c_str(), first, second);
+   } else if (table == "multimap_compare"){
+
+      //cuckoo_vector per key vs duplicate keys, same table family and accumulator.
+      double vector_first = tensor_contraction_nips_2<hashing_project::tables::md_double_generic, 4, 32>(input_file, n_indices_output);
+
+      double vector_second = tensor_contraction_nips_013<hashing_project::tables::md_double_generic, 4, 32>(input_file, n_indices_output);
+
+      double mm_first = tensor_contraction_multimap<1, hashing_project::tables::md_double_multimap_generic, 4, 32>(input_file, n_indices_output);
+
+      double mm_second = tensor_contraction_multimap<3, hashing_project::tables::md_double_multimap_generic, 4, 32>(input_file, n_indices_output);
+
+      printf("doubleMD %f %f\n", vector_first, vector_second);
+      printf("doubleMM %f %f\n", mm_first, mm_second);
+      printf("speedup %f %f\n", vector_first/mm_first, vector_second/mm_second);
    } else {
       throw std::runtime_error("Unknown table");
    }
@@ -136,7 +167,7 @@ int main(int argc, char** argv) {
 
    program.add_argument("--table", "-t")
    .required()
-   .help("Specify table type. Options [p2 p2MD double doubleMD iceberg icebergMD cuckoo chaining bght_p2 bght_cuckoo");
+   .help("Specify table type. Options [p2 p2MD double doubleMD iceberg icebergMD cuckoo chaining bght_p2 bght_cuckoo doubleMM p2MM multimap_compare");
 
    program.add_argument("--tensor", "-r")
    .required()
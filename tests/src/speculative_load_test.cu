@@ -0,0 +1,440 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Speculative p2 loading benchmark.
+// Fills each power-of-two-choice table to a target load, then runs positive and negative queries
+// through find_with_reference (bucket 0, then bucket 1) and find_with_reference_speculative (both
+// buckets fetched up front). Throughput is measured over the whole batch. Latency is measured as
+// cycles per query for a single tile issuing its queries back to back.
+// The host iceberg table (p2 backyard) is run the same way with software prefetches.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/p2_hashing_inverted.cuh>
+
+#include <hashing_project/host_tables/iceberg_quotient.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define DATA_TYPE uint64_t
+
+//queries timed by the single tile latency kernel.
+#define LATENCY_QUERIES 100000
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //+1 keeps keys off the sentinel.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void insert_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   if (!table->upsert_replace(my_tile, keys[tid], keys[tid])){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//positive queries must find key == val, negative queries must miss.
+template <typename ht_type, uint tile_size, bool speculative, bool positive>
+__device__ bool checked_query(const cg::thread_block_tile<tile_size> & my_tile, ht_type * table, DATA_TYPE key){
+
+   DATA_TYPE val;
+
+   bool found;
+
+   if (speculative){
+      found = table->find_with_reference_speculative(my_tile, key, val);
+   } else {
+      found = table->find_with_reference(my_tile, key, val);
+   }
+
+   if (positive) return found && val == key;
+
+   return !found;
+
+}
+
+
+template <typename ht_type, uint tile_size, bool speculative, bool positive>
+__global__ void query_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   bool correct = checked_query<ht_type, tile_size, speculative, positive>(my_tile, table, keys[tid]);
+
+   #if MEASURE_FAILS
+   if (!correct && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+   }
+   #endif
+
+}
+
+
+//one tile, queries back to back - measures the round trips per query rather than throughput.
+template <typename ht_type, uint tile_size, bool speculative, bool positive>
+__global__ void latency_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * cycles){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   if (gallatin::utils::get_tile_tid(my_tile) != 0) return;
+
+   uint64_t n_correct = 0;
+
+   long long int start = clock64();
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      n_correct += checked_query<ht_type, tile_size, speculative, positive>(my_tile, table, keys[i]);
+   }
+
+   long long int end = clock64();
+
+   if (my_tile.thread_rank() == 0){
+      cycles[0] = end - start;
+      cycles[1] = n_correct;
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size, bool speculative, bool positive>
+__host__ void run_queries(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * misses, std::string label, double load, std::ofstream & myfile){
+
+   misses[1] = 0;
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer query_timer;
+
+   query_kernel<ht_type, tile_size, speculative, positive><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, n_keys, misses);
+
+   query_timer.sync_end();
+
+   query_timer.print_throughput(label.c_str(), n_keys);
+
+   uint64_t n_latency = std::min<uint64_t>(n_keys, LATENCY_QUERIES);
+
+   latency_kernel<ht_type, tile_size, speculative, positive><<<1,tile_size>>>(table, keys, n_latency, misses+2);
+
+   cudaDeviceSynchronize();
+
+   double cycles_per_query = 1.0*misses[2]/n_latency;
+
+   printf("%s: %f cycles per query, %lu incorrect\n", label.c_str(), cycles_per_query, misses[1] + (n_latency - misses[3]));
+
+   myfile << ht_type::get_name() << "," << load << "," << (positive ? "positive" : "negative") << "," << (speculative ? "speculative" : "sequential") << "," << std::setprecision(12) << 1.0*n_keys/(query_timer.elapsed()*1000000) << "," << cycles_per_query << "\n";
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void speculative_test(uint64_t table_capacity, double load, DATA_TYPE * keys, DATA_TYPE * negative_keys, uint64_t n_queries, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   uint64_t n_keys = table_capacity*load;
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*4);
+
+   misses[0] = 0;
+
+   DATA_TYPE * dev_keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+   DATA_TYPE * dev_negative_keys = gallatin::utils::get_device_version<DATA_TYPE>(n_queries);
+
+   cudaMemcpy(dev_keys, keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+   cudaMemcpy(dev_negative_keys, negative_keys, sizeof(DATA_TYPE)*n_queries, cudaMemcpyHostToDevice);
+
+   insert_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, dev_keys, n_keys, misses);
+
+   cudaDeviceSynchronize();
+
+   printf("%s at %f load: %lu failed inserts\n", ht_type::get_name().c_str(), load, misses[0]);
+
+   uint64_t n_positive = std::min(n_keys, n_queries);
+
+   run_queries<ht_type, tile_size, false, true>(table, dev_keys, n_positive, misses, "Positive sequential", load, myfile);
+   run_queries<ht_type, tile_size, true, true>(table, dev_keys, n_positive, misses, "Positive speculative", load, myfile);
+   run_queries<ht_type, tile_size, false, false>(table, dev_negative_keys, n_queries, misses, "Negative sequential", load, myfile);
+   run_queries<ht_type, tile_size, true, false>(table, dev_negative_keys, n_queries, misses, "Negative speculative", load, myfile);
+
+   cudaFree(dev_keys);
+   cudaFree(dev_negative_keys);
+
+   cudaFree(misses);
+
+   ht_type::free_on_device(table);
+
+}
+
+
+template <bool speculative, bool positive>
+__host__ void run_host_queries(hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 32> * table, DATA_TYPE * keys, uint64_t n_keys, uint32_t n_threads, double load, std::ofstream & myfile){
+
+   std::string label = std::string("Host ") + (positive ? "positive " : "negative ") + (speculative ? "speculative" : "sequential");
+
+   std::atomic<uint64_t> incorrect(0);
+
+   auto query = [&](uint64_t i){
+
+      DATA_TYPE val;
+
+      bool found = speculative ? table->find_with_reference_speculative(keys[i], val) : table->find_with_reference(keys[i], val);
+
+      if (positive ? (!found || val != keys[i]) : found) incorrect.fetch_add(1, std::memory_order_relaxed);
+
+   };
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   hashing_project::host::parallel_for(n_threads, n_keys, query);
+
+   auto end = std::chrono::high_resolution_clock::now();
+
+   double duration = std::chrono::duration<double>(end-start).count();
+
+   //single thread pass for latency.
+   uint64_t n_latency = std::min<uint64_t>(n_keys, LATENCY_QUERIES);
+
+   auto latency_start = std::chrono::high_resolution_clock::now();
+
+   for (uint64_t i = 0; i < n_latency; i++){
+      query(i);
+   }
+
+   auto latency_end = std::chrono::high_resolution_clock::now();
+
+   double ns_per_query = std::chrono::duration<double, std::nano>(latency_end-latency_start).count()/n_latency;
+
+   printf("%s: %f ops/s, %f ns per query, %lu incorrect\n", label.c_str(), n_keys/duration, ns_per_query, incorrect.load());
+
+   myfile << table->get_name() << "," << load << "," << (positive ? "positive" : "negative") << "," << (speculative ? "speculative" : "sequential") << "," << std::setprecision(12) << 1.0*n_keys/(duration*1000000) << "," << ns_per_query << "\n";
+
+}
+
+
+__host__ void host_speculative_test(uint64_t table_capacity, double load, DATA_TYPE * keys, DATA_TYPE * negative_keys, uint64_t n_queries, uint32_t n_threads, std::ofstream & myfile){
+
+   using ht_type = hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 32>;
+
+   uint64_t n_keys = table_capacity*load;
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], keys[i]);
+   });
+
+   uint64_t n_positive = std::min(n_keys, n_queries);
+
+   run_host_queries<false, true>(table, keys, n_positive, n_threads, load, myfile);
+   run_host_queries<true, true>(table, keys, n_positive, n_threads, load, myfile);
+   run_host_queries<false, false>(table, negative_keys, n_queries, n_threads, load, myfile);
+   run_host_queries<true, false>(table, negative_keys, n_queries, n_threads, load, myfile);
+
+   ht_type::free_on_host(table);
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, uint64_t n_queries, std::vector<double> loads, uint32_t n_threads){
+
+
+   DATA_TYPE * keys = generate_data<DATA_TYPE>(table_capacity);
+
+   DATA_TYPE * negative_keys = generate_data<DATA_TYPE>(n_queries);
+
+
+   std::string filename = "results/speculative/" + table + "_" + std::to_string(table_capacity) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   //latency is cycles per query on device, ns per query on host.
+   myfile << "table,load,queries,probe,throughput,latency\n";
+
+
+   for (double load : loads){
+
+      if (table == "p2" || table == "all"){
+         speculative_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, load, keys, negative_keys, n_queries, myfile);
+      }
+
+      if (table == "p2MD" || table == "all"){
+         speculative_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, load, keys, negative_keys, n_queries, myfile);
+      }
+
+      if (table == "p2_inv" || table == "all"){
+         speculative_test<hashing_project::tables::p2_inv_generic, 8, 32>(table_capacity, load, keys, negative_keys, n_queries, myfile);
+      }
+
+      if (table == "host" || table == "all"){
+         host_speculative_test(table_capacity, load, keys, negative_keys, n_queries, n_threads, myfile);
+      }
+
+   }
+
+   myfile.close();
+
+   cudaFreeHost(keys);
+   cudaFreeHost(negative_keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("speculative_load_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2MD p2_inv host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--n_queries", "-n").scan<'u', uint64_t>().default_value((uint64_t) 10000000).help("Number of positive and of negative queries.");
+
+   program.add_argument("--low_load").scan<'g', double>().default_value(.5).help("Low load factor.");
+
+   program.add_argument("--high_load").scan<'g', double>().default_value(.9).help("High load factor.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host table.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto n_queries = program.get<uint64_t>("--n_queries");
+   auto low_load = program.get<double>("--low_load");
+   auto high_load = program.get<double>("--high_load");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/speculative")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, n_queries, {low_load, high_load}, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
@@ -0,0 +1,461 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Streaming ingest benchmark (helpers/streaming_ingest.cuh).
+// Ingests --load * capacity host-resident pairs into each table, end to end including the transfer:
+//  - split: one cudaMemcpy of the whole batch, then one insert kernel (the lf_test / ycsb_test path),
+//  - stream: stream_ingest with --chunk pairs per chunk over --buffers streams, from pinned input,
+//  - stream pageable: the same from pageable input, staged through pinned buffers.
+// Every key is queried after each streamed ingest and misses are printed.
+// The host swiss table compares generate-then-insert against stream_ingest with the same generator
+// as the producer (helpers/host_streaming_ingest.cuh).
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <atomic>
+#include <cstring>
+#include <vector>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/streaming_ingest.cuh>
+#include <hashing_project/helpers/host_streaming_ingest.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_inverted.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+#include <hashing_project/tables/chaining.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void fill_kernel(ht_type * table, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_keys){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], vals[tid]);
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void missing_kernel(ht_type * table, DATA_TYPE * keys, DATA_TYPE * vals, uint64_t n_keys, uint64_t * n_missing){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   DATA_TYPE val;
+
+   bool found = table->find_with_reference(my_tile, keys[tid], val);
+
+   if ((!found || val != vals[tid]) && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)n_missing, 1ULL);
+   }
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void streaming_ingest_test(uint64_t table_capacity, double load, DATA_TYPE * host_keys, DATA_TYPE * host_vals, uint64_t chunk_size, uint n_buffers, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   uint64_t * n_missing;
+
+   cudaMallocManaged((void **)&n_missing, sizeof(uint64_t)*2);
+
+   n_missing[0] = 0;
+   n_missing[1] = 0;
+
+
+   //split: whole batch resident on the device before the insert starts.
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+   DATA_TYPE * vals = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer split_timer;
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+   cudaMemcpy(vals, host_vals, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+   fill_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, vals, n_keys);
+
+   split_timer.sync_end();
+
+   ht_type::free_on_device(table);
+
+
+   //stream from pinned input.
+   table = ht_type::generate_on_device(table_capacity, 42);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer stream_timer;
+
+   uint64_t n_streamed = hashing_project::helpers::stream_ingest<tile_size>(table, host_keys, host_vals, n_keys, chunk_size, n_buffers);
+
+   stream_timer.sync_end();
+
+   missing_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, vals, n_keys, &n_missing[0]);
+
+   cudaDeviceSynchronize();
+
+   ht_type::free_on_device(table);
+
+
+   //stream from pageable input.
+   std::vector<DATA_TYPE> pageable_keys(host_keys, host_keys+n_keys);
+   std::vector<DATA_TYPE> pageable_vals(host_vals, host_vals+n_keys);
+
+   table = ht_type::generate_on_device(table_capacity, 42);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer pageable_timer;
+
+   uint64_t n_pageable = hashing_project::helpers::stream_ingest<tile_size>(table, pageable_keys.data(), pageable_vals.data(), n_keys, chunk_size, n_buffers);
+
+   pageable_timer.sync_end();
+
+   missing_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, vals, n_keys, &n_missing[1]);
+
+   cudaDeviceSynchronize();
+
+   ht_type::free_on_device(table);
+
+   cudaFree(keys);
+   cudaFree(vals);
+
+
+   double split_throughput = n_keys/(split_timer.elapsed()*1000000);
+   double stream_throughput = n_keys/(stream_timer.elapsed()*1000000);
+   double pageable_throughput = n_keys/(pageable_timer.elapsed()*1000000);
+
+   printf("%s: split %f M/s, stream %f M/s = %fx, stream pageable %f M/s = %fx, %lu / %lu / %lu inserted, missing %lu / %lu\n", name.c_str(), split_throughput, stream_throughput, stream_throughput/split_throughput, pageable_throughput, pageable_throughput/split_throughput, n_streamed, n_pageable, n_keys, n_missing[0], n_missing[1]);
+
+   myfile << name << "," << load << "," << chunk_size << "," << n_buffers << "," << std::setprecision(12) << split_throughput << "," << stream_throughput << "," << pageable_throughput << "," << stream_throughput/split_throughput << "," << n_streamed << "," << n_pageable << "," << n_missing[0] << "," << n_missing[1] << "\n";
+
+   cudaFree(n_missing);
+
+}
+
+
+//stands in for parsing / reading the input - a splitmix64 stream seeded by position.
+__host__ void produce_pairs(uint64_t start, uint64_t n_chunk, DATA_TYPE * keys, DATA_TYPE * vals){
+
+   for (uint64_t i = 0; i < n_chunk; i++){
+
+      uint64_t z = (start + i + 1) * 0x9E3779B97F4A7C15ULL;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      z = z ^ (z >> 31);
+
+      keys[i] = z % (~0ULL - 2) + 1;
+      vals[i] = start + i + 1;
+
+   }
+
+}
+
+
+template <typename ht_type>
+__host__ void host_streaming_ingest_test(uint64_t table_capacity, double load, uint64_t chunk_size, uint32_t n_threads, std::ofstream & myfile){
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+
+   //split: generate everything, then insert.
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   auto split_start = std::chrono::high_resolution_clock::now();
+
+   std::vector<DATA_TYPE> keys(n_keys);
+   std::vector<DATA_TYPE> vals(n_keys);
+
+   uint64_t n_chunks = (n_keys-1)/chunk_size+1;
+
+   //same producer, same chunking, one chunk at a time before any insert.
+   for (uint64_t chunk = 0; chunk < n_chunks; chunk++){
+
+      uint64_t start = chunk*chunk_size;
+
+      produce_pairs(start, std::min(chunk_size, n_keys-start), keys.data()+start, vals.data()+start);
+
+   }
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], vals[i]);
+   });
+
+   auto split_end = std::chrono::high_resolution_clock::now();
+
+   ht_type::free_on_host(table);
+
+
+   table = ht_type::generate_on_host(table_capacity, 42);
+
+   auto stream_start = std::chrono::high_resolution_clock::now();
+
+   uint64_t n_streamed = hashing_project::host::stream_ingest<DATA_TYPE, DATA_TYPE>(table, n_keys, produce_pairs, chunk_size, n_threads);
+
+   auto stream_end = std::chrono::high_resolution_clock::now();
+
+   std::atomic<uint64_t> n_missing(0);
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+
+      DATA_TYPE val;
+
+      if (!table->find_with_reference(keys[i], val) || val != vals[i]) n_missing.fetch_add(1);
+
+   });
+
+   ht_type::free_on_host(table);
+
+
+   double split_throughput = n_keys/(std::chrono::duration<double>(split_end-split_start).count()*1000000);
+   double stream_throughput = n_keys/(std::chrono::duration<double>(stream_end-stream_start).count()*1000000);
+
+   printf("%s: split %f M/s, stream %f M/s = %fx, %lu / %lu inserted, missing %lu\n", name.c_str(), split_throughput, stream_throughput, stream_throughput/split_throughput, n_streamed, n_keys, n_missing.load());
+
+   myfile << name << "," << load << "," << chunk_size << "," << 2 << "," << std::setprecision(12) << split_throughput << "," << stream_throughput << "," << 0 << "," << stream_throughput/split_throughput << "," << n_streamed << "," << 0 << "," << n_missing.load() << "," << 0 << "\n";
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, double load, uint64_t chunk_size, uint n_buffers, uint32_t n_threads){
+
+
+   uint64_t n_keys = table_capacity*load;
+
+   DATA_TYPE * host_keys = generate_data<DATA_TYPE>(n_keys);
+
+   DATA_TYPE * host_vals;
+
+   cudaMallocHost((void **)&host_vals, sizeof(DATA_TYPE)*n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+      host_vals[i] = i+1;
+   }
+
+
+   std::string filename = "results/streaming_ingest/" + table + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + "_" + std::to_string(chunk_size) + "_" + std::to_string(n_buffers) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,load,chunk,buffers,split_throughput,stream_throughput,pageable_throughput,speedup,streamed,pageable_streamed,missing,pageable_missing\n";
+
+
+   if (table == "p2" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "p2_inv" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::p2_inv_generic, 8, 32>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      streaming_ingest_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+   }
+
+   if (table == "chaining" || table == "all"){
+
+      init_global_allocator(20ULL*1024*1024*1024, 111);
+
+      streaming_ingest_test<hashing_project::tables::chaining_generic, 4, 8>(table_capacity, load, host_keys, host_vals, chunk_size, n_buffers, myfile);
+
+      free_global_allocator();
+
+   }
+
+   if (table == "host" || table == "all"){
+      host_streaming_ingest_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, chunk_size, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFreeHost(host_keys);
+   cudaFreeHost(host_vals);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("streaming_ingest_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2_inv p2MD double doubleMD iceberg icebergMD cuckoo hopscotch chaining host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table ingested.");
+
+   program.add_argument("--chunk").scan<'u', uint64_t>().default_value((uint64_t) (1ULL << 22)).help("Pairs per streamed chunk.");
+
+   program.add_argument("--buffers", "-b").scan<'u', uint>().default_value((uint) 3).help("Device buffers / streams in flight.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host table.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto chunk_size = program.get<uint64_t>("--chunk");
+   auto n_buffers = program.get<uint>("--buffers");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/streaming_ingest")){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, load, chunk_size, n_buffers, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
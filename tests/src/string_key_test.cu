@@ -0,0 +1,606 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// String key benchmark.
+// Loads a word list (one key per line) from a local file and measures insert, query and
+// delete throughput of the string key tables. The same words are also run through
+// the inner table as pre-hashed 64-bit integer keys, so the cost of the arena
+// (copy on insert, compare on hit) can be read off directly.
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <string_view>
+#include <unordered_set>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/string_key_table.cuh>
+
+#include <hashing_project/helpers/host_utils.cuh>
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/host_tables/string_table.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define MEASURE_FAILS 1
+
+
+#define LARGE_MD_LOAD 1
+#define LARGE_BUCKET_MODS 0
+
+
+//flattened word list - word i is chars[offsets[i], offsets[i+1]).
+struct word_list {
+
+   std::vector<char> chars;
+   std::vector<uint64_t> offsets;
+
+   uint64_t n_words(){
+      return offsets.size()-1;
+   }
+
+   std::string_view get_word(uint64_t i){
+      return std::string_view(chars.data() + offsets[i], offsets[i+1]-offsets[i]);
+   }
+
+};
+
+
+//read one word per line, drop empty lines and duplicates.
+__host__ word_list load_words(std::string filename, uint64_t max_words){
+
+   std::ifstream word_file(filename);
+
+   if (!word_file.is_open()){
+      throw std::runtime_error("Could not open word list " + filename);
+   }
+
+   word_list words;
+
+   words.offsets.push_back(0);
+
+   std::unordered_set<std::string> seen;
+
+   std::string line;
+
+   while (std::getline(word_file, line) && words.n_words() < max_words){
+
+      if (!line.empty() && line.back() == '\r') line.pop_back();
+
+      if (line.empty() || !seen.insert(line).second) continue;
+
+      words.chars.insert(words.chars.end(), line.begin(), line.end());
+      words.offsets.push_back(words.chars.size());
+
+   }
+
+   return words;
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void string_insert_kernel(ht_type * table, char * chars, uint64_t * offsets, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   if (!table->upsert_replace(my_tile, chars + offsets[tid], offsets[tid+1]-offsets[tid], tid)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[0], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void string_query_kernel(ht_type * table, char * chars, uint64_t * offsets, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   uint64_t my_val;
+
+   if (!table->find_with_reference(my_tile, chars + offsets[tid], offsets[tid+1]-offsets[tid], my_val) || my_val != tid){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void string_remove_kernel(ht_type * table, char * chars, uint64_t * offsets, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+
+   if (!table->remove(my_tile, chars + offsets[tid], offsets[tid+1]-offsets[tid])){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[2], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+//integer baseline - the same words, pre-hashed on the host.
+
+template <typename ht_type, uint tile_size>
+__global__ void int_insert_kernel(ht_type * table, uint64_t * keys, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], tid);
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void int_query_kernel(ht_type * table, uint64_t * keys, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   uint64_t my_val;
+
+   if (!table->find_with_reference(my_tile, keys[tid], my_val)){
+
+      #if MEASURE_FAILS
+      if (my_tile.thread_rank() == 0){
+         atomicAdd((unsigned long long int *)&misses[1], 1ULL);
+      }
+      #endif
+
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__global__ void int_remove_kernel(ht_type * table, uint64_t * keys, uint64_t n_keys, uint64_t * misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->remove(my_tile, keys[tid]);
+
+}
+
+
+template <template<typename, typename, uint, uint> typename inner_table, uint tile_size, uint bucket_size>
+__host__ void string_key_test(word_list & words, std::ofstream & myfile){
+
+
+   using ht_type = hashing_project::tables::string_key_table<inner_table, tile_size, bucket_size>;
+
+   using int_type = inner_table<uint64_t, uint64_t, tile_size, bucket_size>;
+
+
+   uint64_t n_keys = words.n_words();
+
+   //words fill the table to ~85%.
+   uint64_t capacity = n_keys*100/85+1;
+
+   uint64_t arena_bytes = words.chars.size() + n_keys*(sizeof(hashing_project::tables::string_record)+8) + 64;
+
+
+   uint64_t * misses;
+
+   cudaMallocManaged((void **)&misses, sizeof(uint64_t)*3);
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+
+
+   char * device_chars = gallatin::utils::get_device_version<char>(words.chars.size());
+   uint64_t * device_offsets = gallatin::utils::get_device_version<uint64_t>(n_keys+1);
+
+   cudaMemcpy(device_chars, words.chars.data(), words.chars.size(), cudaMemcpyHostToDevice);
+   cudaMemcpy(device_offsets, words.offsets.data(), sizeof(uint64_t)*(n_keys+1), cudaMemcpyHostToDevice);
+
+
+   std::vector<uint64_t> int_keys(n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+
+      std::string_view word = words.get_word(i);
+
+      uint64_t key = hashing_project::host::hash(word.data(), word.size(), 42);
+
+      if (key == 0ULL) key = 1ULL;
+      if (key >= ~1ULL) key -= 2;
+
+      int_keys[i] = key;
+   }
+
+   uint64_t * device_keys = gallatin::utils::get_device_version<uint64_t>(n_keys);
+
+   cudaMemcpy(device_keys, int_keys.data(), sizeof(uint64_t)*n_keys, cudaMemcpyHostToDevice);
+
+   cudaDeviceSynchronize();
+
+
+   //string keys
+   ht_type * table = ht_type::generate_on_device(capacity, arena_bytes, 42);
+
+   gallatin::utils::timer insert_timer;
+
+   string_insert_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_chars, device_offsets, n_keys, misses);
+
+   insert_timer.sync_end();
+
+   gallatin::utils::timer query_timer;
+
+   string_query_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_chars, device_offsets, n_keys, misses);
+
+   query_timer.sync_end();
+
+   gallatin::utils::timer remove_timer;
+
+   string_remove_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, device_chars, device_offsets, n_keys, misses);
+
+   remove_timer.sync_end();
+
+   printf("String misses: insert %lu query %lu remove %lu, arena %lu bytes\n", misses[0], misses[1], misses[2], table->get_arena_usage());
+
+   ht_type::free_on_device(table);
+
+
+   //integer baseline
+   int_type * int_table = int_type::generate_on_device(capacity, 42);
+
+   gallatin::utils::timer int_insert_timer;
+
+   int_insert_kernel<int_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(int_table, device_keys, n_keys, misses);
+
+   int_insert_timer.sync_end();
+
+   gallatin::utils::timer int_query_timer;
+
+   int_query_kernel<int_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(int_table, device_keys, n_keys, misses);
+
+   int_query_timer.sync_end();
+
+   gallatin::utils::timer int_remove_timer;
+
+   int_remove_kernel<int_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(int_table, device_keys, n_keys, misses);
+
+   int_remove_timer.sync_end();
+
+   int_type::free_on_device(int_table);
+
+
+   myfile << ht_type::get_name() << "," << n_keys << "," << std::setprecision(12)
+          << 1.0*n_keys/(insert_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(query_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(remove_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(int_insert_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(int_query_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(int_remove_timer.elapsed()*1000000) << "\n";
+
+
+   cudaFree(device_chars);
+   cudaFree(device_offsets);
+   cudaFree(device_keys);
+   cudaFree(misses);
+
+   cudaDeviceSynchronize();
+
+}
+
+
+template <uint bucket_size>
+__host__ void string_key_test_host(word_list & words, uint32_t n_threads, std::ofstream & myfile){
+
+
+   using ht_type = hashing_project::tables::host_string_key_swiss<bucket_size>;
+
+   using int_type = hashing_project::tables::host_swiss_generic<uint64_t, uint64_t, 1, bucket_size>;
+
+
+   uint64_t n_keys = words.n_words();
+
+   uint64_t capacity = n_keys*100/85+1;
+
+   uint64_t arena_bytes = words.chars.size() + n_keys*(sizeof(hashing_project::tables::host_string_record)+8) + 64;
+
+   std::atomic<uint64_t> misses[3];
+
+   misses[0] = 0;
+   misses[1] = 0;
+   misses[2] = 0;
+
+
+   std::vector<uint64_t> int_keys(n_keys);
+
+   for (uint64_t i = 0; i < n_keys; i++){
+
+      std::string_view word = words.get_word(i);
+
+      uint64_t key = hashing_project::host::hash(word.data(), word.size(), 42);
+
+      if (key == 0ULL) key = 1ULL;
+      if (key >= ~1ULL) key -= 2;
+
+      int_keys[i] = key;
+   }
+
+
+   ht_type * table = ht_type::generate_on_host(capacity, arena_bytes, 42);
+
+   hashing_project::host::timer insert_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+
+      if (!table->upsert_replace(words.get_word(tid), tid)){
+         #if MEASURE_FAILS
+         misses[0]++;
+         #endif
+      }
+
+   });
+
+   insert_timer.sync_end();
+
+   hashing_project::host::timer query_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+
+      uint64_t my_val;
+
+      if (!table->find_with_reference(words.get_word(tid), my_val) || my_val != tid){
+         #if MEASURE_FAILS
+         misses[1]++;
+         #endif
+      }
+
+   });
+
+   query_timer.sync_end();
+
+   hashing_project::host::timer remove_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+
+      if (!table->remove(words.get_word(tid))){
+         #if MEASURE_FAILS
+         misses[2]++;
+         #endif
+      }
+
+   });
+
+   remove_timer.sync_end();
+
+   printf("Host string misses: insert %lu query %lu remove %lu\n", misses[0].load(), misses[1].load(), misses[2].load());
+
+   ht_type::free_on_host(table);
+
+
+   int_type * int_table = int_type::generate_on_host(capacity, 42);
+
+   hashing_project::host::timer int_insert_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      int_table->upsert_replace(int_keys[tid], tid);
+   });
+
+   int_insert_timer.sync_end();
+
+   hashing_project::host::timer int_query_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      uint64_t my_val;
+      if (!int_table->find_with_reference(int_keys[tid], my_val)) misses[1]++;
+   });
+
+   int_query_timer.sync_end();
+
+   hashing_project::host::timer int_remove_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t tid){
+      int_table->remove(int_keys[tid]);
+   });
+
+   int_remove_timer.sync_end();
+
+   int_type::free_on_host(int_table);
+
+
+   myfile << ht_type::get_name() << "," << n_keys << "," << std::setprecision(12)
+          << 1.0*n_keys/(insert_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(query_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(remove_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(int_insert_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(int_query_timer.elapsed()*1000000) << ","
+          << 1.0*n_keys/(int_remove_timer.elapsed()*1000000) << "\n";
+
+}
+
+
+__host__ void execute_test(std::string table, word_list & words, uint32_t n_threads){
+
+
+   std::string filename = "results/string_keys/" + table + ".txt";
+
+   std::ofstream myfile;
+   myfile.open (filename.c_str());
+   myfile << "table,n_keys,string_insert,string_query,string_remove,int_insert,int_query,int_remove\n";
+
+   if (table == "doubleMD"){
+
+      string_key_test<hashing_project::tables::md_double_generic, 4, 32>(words, myfile);
+
+   } else if (table == "p2MD"){
+
+      string_key_test<hashing_project::tables::md_p2_generic, 4, 32>(words, myfile);
+
+   } else if (table == "swiss"){
+
+      string_key_test_host<16>(words, n_threads, myfile);
+
+   } else {
+      throw std::runtime_error("Unknown table");
+   }
+
+   myfile.close();
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("string_key_test");
+
+   program.add_argument("--table", "-t")
+   .required()
+   .help("Specify table type. Options [doubleMD p2MD swiss]");
+
+   program.add_argument("--file", "-f")
+   .required()
+   .help("Word list, one key per line. Duplicate lines are skipped.");
+
+   program.add_argument("--max-words")
+   .default_value((uint64_t) 100000000ULL)
+   .scan<'u', uint64_t>()
+   .help("Maximum number of words to load.");
+
+   program.add_argument("--threads")
+   .default_value((uint32_t) hashing_project::host::get_default_n_threads())
+   .scan<'u', uint32_t>()
+   .help("Number of host threads for host tables (swiss). Defaults to all hardware threads.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto filename = program.get<std::string>("--file");
+   auto max_words = program.get<uint64_t>("--max-words");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   word_list words = load_words(filename, max_words);
+
+   std::cout << "Running string key test with table " << table << " and " << words.n_words() << " words from " << filename << std::endl;
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory("results/string_keys")){
+   } else {
+   }
+
+
+   execute_test(table, words, n_threads);
+
+
+   return 0;
+
+}
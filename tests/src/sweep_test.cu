@@ -0,0 +1,493 @@
+/*
+ * ============================================================================
+ *
+ *        Authors:
+ *                  Hunter McCoy <hjmccoy@lbl.gov
+ *
+ * ============================================================================
+ */
+
+// Table sweep benchmark (helpers/table_sweep.cuh).
+// Fills each table to --load with key -> insert index + 1 (a stand-in timestamp), then:
+//   for_each                 - counts the live pairs, should match get_fill()
+//   erase_if(val <= cutoff)  - expires the older half while a query kernel reads the newer half
+//                              on a second stream. Every survivor must stay visible.
+//   for_each                 - recount, should equal inserted - erased
+// Sweep throughput is reported in sweep buckets/s, so low loads show the metadata-first skip.
+// Host swiss, hopscotch and quotient iceberg tables are run the same way (helpers/host_table_sweep.cuh).
+
+
+#define COUNT_PROBES 0
+
+#define LOAD_CHEAP 0
+
+#include <argparse/argparse.hpp>
+
+#include <gallatin/allocators/global_allocator.cuh>
+
+#include <gallatin/allocators/timer.cuh>
+
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <openssl/rand.h>
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+
+#include <hashing_project/helpers/table_sweep.cuh>
+#include <hashing_project/helpers/host_table_sweep.cuh>
+#include <hashing_project/helpers/host_utils.cuh>
+
+#include <hashing_project/tables/p2_hashing_external.cuh>
+#include <hashing_project/tables/p2_hashing_inverted.cuh>
+#include <hashing_project/tables/p2_hashing_metadata.cuh>
+#include <hashing_project/tables/double_hashing.cuh>
+#include <hashing_project/tables/double_hashing_metadata.cuh>
+#include <hashing_project/tables/iht_p2.cuh>
+#include <hashing_project/tables/iht_p2_metadata_full.cuh>
+#include <hashing_project/tables/iht_p2_metadata_quotient.cuh>
+#include <hashing_project/tables/cuckoo.cuh>
+#include <hashing_project/tables/hopscotch.cuh>
+#include <hashing_project/tables/chaining.cuh>
+
+#include <hashing_project/host_tables/swiss_table.cuh>
+#include <hashing_project/host_tables/hopscotch.cuh>
+#include <hashing_project/host_tables/iceberg_quotient.cuh>
+
+#include <iostream>
+#include <locale>
+
+#include <cooperative_groups.h>
+
+namespace cg = cooperative_groups;
+
+using namespace gallatin::allocators;
+
+
+
+#define DATA_TYPE uint64_t
+
+//sweep_seqlock_test builds this file with STABLE_HT_LOCKLESS_QUERY=1.
+#if STABLE_HT_LOCKLESS_QUERY
+#define RESULTS_DIR "results/sweep_seqlock"
+#else
+#define RESULTS_DIR "results/sweep"
+#endif
+
+//striped counters so the count functor doesn't serialize on one address.
+#define SWEEP_COUNTERS 1024
+
+
+template <typename T>
+__host__ T * generate_data(uint64_t nitems){
+
+
+   //malloc space
+
+   T * vals;
+
+   cudaMallocHost((void **)&vals, sizeof(T)*nitems);
+
+
+   //          100,000,000
+   uint64_t cap = 100000000ULL;
+
+   for (uint64_t to_fill = 0; to_fill < nitems; to_fill+=0){
+
+      uint64_t togen = (nitems - to_fill > cap) ? cap : nitems - to_fill;
+
+
+      RAND_bytes((unsigned char *) (vals + to_fill), togen * sizeof(T));
+
+
+
+      to_fill += togen;
+
+   }
+
+   //keep keys off the sentinel and tombstones.
+   for (uint64_t i = 0; i < nitems; i++){
+      vals[i] = vals[i] % (~0ULL - 2) + 1;
+   }
+
+   return vals;
+}
+
+
+struct count_functor {
+
+   uint64_t * counters;
+
+   __device__ void operator()(const DATA_TYPE & key, const DATA_TYPE & val) const {
+      atomicAdd((unsigned long long int *)&counters[key % SWEEP_COUNTERS], 1ULL);
+   }
+
+};
+
+
+struct expire_functor {
+
+   DATA_TYPE cutoff;
+
+   __host__ __device__ bool operator()(const DATA_TYPE & key, const DATA_TYPE & val) const {
+      return val <= cutoff;
+   }
+
+};
+
+
+template <typename ht_type, uint tile_size>
+__global__ void fill_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   table->upsert_replace(my_tile, keys[tid], tid+1);
+
+}
+
+
+//reads keys that erase_if must not touch.
+template <typename ht_type, uint tile_size>
+__global__ void survivor_query_kernel(ht_type * table, DATA_TYPE * keys, uint64_t n_keys, uint64_t * n_misses){
+
+
+   auto thread_block = cg::this_thread_block();
+
+   cg::thread_block_tile<tile_size> my_tile = cg::tiled_partition<tile_size>(thread_block);
+
+   uint64_t tid = gallatin::utils::get_tile_tid(my_tile);
+
+   if (tid >= n_keys) return;
+
+   DATA_TYPE val;
+
+   if (!table->find_with_reference(my_tile, keys[tid], val) && my_tile.thread_rank() == 0){
+      atomicAdd((unsigned long long int *)n_misses, 1ULL);
+   }
+
+}
+
+
+template <typename ht_type, uint tile_size>
+__host__ uint64_t count_pairs(ht_type * table, uint64_t * counters, double & throughput){
+
+   cudaMemset(counters, 0, sizeof(uint64_t)*SWEEP_COUNTERS);
+
+   cudaDeviceSynchronize();
+
+   gallatin::utils::timer sweep_timer;
+
+   hashing_project::helpers::for_each<tile_size>(table, count_functor{counters});
+
+   sweep_timer.sync_end();
+
+   throughput = 1.0*table->get_n_sweep_buckets()/(sweep_timer.elapsed()*1000000);
+
+   uint64_t n_pairs = 0;
+
+   for (uint64_t i = 0; i < SWEEP_COUNTERS; i++){
+      n_pairs += counters[i];
+   }
+
+   return n_pairs;
+
+}
+
+
+template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
+__host__ void sweep_test(uint64_t table_capacity, double load, DATA_TYPE * keys, std::ofstream & myfile){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, tile_size, bucket_size>;
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   //insert indices 1..cutoff expire, the rest survive.
+   uint64_t cutoff = n_keys/2;
+
+   ht_type * table = ht_type::generate_on_device(table_capacity, 42);
+
+   uint64_t * counters;
+
+   cudaMallocManaged((void **)&counters, sizeof(uint64_t)*SWEEP_COUNTERS);
+
+   uint64_t * n_misses;
+
+   cudaMallocManaged((void **)&n_misses, sizeof(uint64_t));
+
+   n_misses[0] = 0;
+
+   fill_kernel<ht_type, tile_size><<<(n_keys*tile_size-1)/256+1,256>>>(table, keys, n_keys);
+
+   cudaDeviceSynchronize();
+
+   uint64_t n_filled = table->get_fill();
+
+   double for_each_throughput;
+
+   uint64_t n_seen = count_pairs<ht_type, tile_size>(table, counters, for_each_throughput);
+
+   printf("%s for_each: %lu / %lu pairs, %f M buckets/s\n", name.c_str(), n_seen, n_filled, for_each_throughput);
+
+
+   cudaStream_t query_stream;
+   cudaStreamCreate(&query_stream);
+
+   uint64_t n_survivors = n_keys - cutoff;
+
+   gallatin::utils::timer erase_timer;
+
+   survivor_query_kernel<ht_type, tile_size><<<(n_survivors*tile_size-1)/256+1,256,0,query_stream>>>(table, keys+cutoff, n_survivors, n_misses);
+
+   uint64_t n_erased = hashing_project::helpers::erase_if<tile_size>(table, expire_functor{cutoff});
+
+   erase_timer.sync_end();
+
+   cudaStreamDestroy(query_stream);
+
+   double erase_throughput = 1.0*table->get_n_sweep_buckets()/(erase_timer.elapsed()*1000000);
+
+   printf("%s erase_if: %lu erased, %lu survivor misses during sweep, %f M buckets/s\n", name.c_str(), n_erased, n_misses[0], erase_throughput);
+
+
+   double recount_throughput;
+
+   uint64_t n_left = count_pairs<ht_type, tile_size>(table, counters, recount_throughput);
+
+   printf("%s after erase: %lu pairs left, expected %lu\n", name.c_str(), n_left, n_seen - n_erased);
+
+   myfile << name << "," << load << "," << std::setprecision(12) << for_each_throughput << "," << erase_throughput << "," << recount_throughput << "," << n_filled << "," << n_seen << "," << n_erased << "," << n_left << "," << n_misses[0] << "\n";
+
+   cudaFree(counters);
+   cudaFree(n_misses);
+
+   ht_type::free_on_device(table);
+
+}
+
+
+template <typename ht_type>
+__host__ uint64_t host_count_pairs(ht_type * table, uint32_t n_threads, double & throughput){
+
+   std::atomic<uint64_t> n_pairs(0);
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   hashing_project::host::for_each(table, [&](const DATA_TYPE & key, const DATA_TYPE & val){
+      n_pairs.fetch_add(1, std::memory_order_relaxed);
+   }, n_threads);
+
+   auto end = std::chrono::high_resolution_clock::now();
+
+   throughput = 1.0*table->get_n_sweep_buckets()/(std::chrono::duration<double>(end-start).count()*1000000);
+
+   return n_pairs.load();
+
+}
+
+
+template <typename ht_type>
+__host__ void host_sweep_test(uint64_t table_capacity, double load, DATA_TYPE * keys, uint32_t n_threads, std::ofstream & myfile){
+
+   std::string name = ht_type::get_name();
+
+   uint64_t n_keys = table_capacity*load;
+
+   uint64_t cutoff = n_keys/2;
+
+   ht_type * table = ht_type::generate_on_host(table_capacity, 42);
+
+   hashing_project::host::parallel_for(n_threads, n_keys, [&](uint64_t i){
+      table->upsert_replace(keys[i], (DATA_TYPE) i+1);
+   });
+
+   uint64_t n_filled = table->get_fill();
+
+   double for_each_throughput;
+
+   uint64_t n_seen = host_count_pairs(table, n_threads, for_each_throughput);
+
+   printf("%s for_each: %lu / %lu pairs, %f M buckets/s\n", name.c_str(), n_seen, n_filled, for_each_throughput);
+
+
+   //one reader thread checks the survivors while the sweep runs.
+   std::atomic<bool> sweep_done(false);
+   std::atomic<uint64_t> n_misses(0);
+
+   std::thread reader([&](){
+
+      DATA_TYPE val;
+
+      for (uint64_t i = cutoff; i < n_keys && !sweep_done.load(); i++){
+         if (!table->find_with_reference(keys[i], val)) n_misses.fetch_add(1);
+      }
+
+   });
+
+   auto start = std::chrono::high_resolution_clock::now();
+
+   uint64_t n_erased = hashing_project::host::erase_if(table, expire_functor{cutoff}, n_threads);
+
+   auto end = std::chrono::high_resolution_clock::now();
+
+   sweep_done = true;
+
+   reader.join();
+
+   double erase_throughput = 1.0*table->get_n_sweep_buckets()/(std::chrono::duration<double>(end-start).count()*1000000);
+
+   printf("%s erase_if: %lu erased, %lu survivor misses during sweep, %f M buckets/s\n", name.c_str(), n_erased, n_misses.load(), erase_throughput);
+
+
+   double recount_throughput;
+
+   uint64_t n_left = host_count_pairs(table, n_threads, recount_throughput);
+
+   printf("%s after erase: %lu pairs left, expected %lu\n", name.c_str(), n_left, n_seen - n_erased);
+
+   myfile << name << "," << load << "," << std::setprecision(12) << for_each_throughput << "," << erase_throughput << "," << recount_throughput << "," << n_filled << "," << n_seen << "," << n_erased << "," << n_left << "," << n_misses.load() << "\n";
+
+   ht_type::free_on_host(table);
+
+}
+
+
+__host__ void execute_test(std::string table, uint64_t table_capacity, double load, uint32_t n_threads){
+
+
+   uint64_t n_keys = table_capacity*load;
+
+   DATA_TYPE * host_keys = generate_data<DATA_TYPE>(n_keys);
+
+   DATA_TYPE * keys = gallatin::utils::get_device_version<DATA_TYPE>(n_keys);
+
+   cudaMemcpy(keys, host_keys, sizeof(DATA_TYPE)*n_keys, cudaMemcpyHostToDevice);
+
+
+   std::string filename = RESULTS_DIR "/" + table + "_" + std::to_string(table_capacity) + "_" + std::to_string((int) (load*100)) + ".txt";
+
+   std::ofstream myfile;
+   myfile.open(filename.c_str());
+
+   myfile << "table,load,for_each_throughput,erase_if_throughput,recount_throughput,fill,seen,erased,left,survivor_misses\n";
+
+
+   if (table == "p2" || table == "all"){
+      sweep_test<hashing_project::tables::p2_ext_generic, 8, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "p2_inv" || table == "all"){
+      sweep_test<hashing_project::tables::p2_inv_generic, 8, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "p2MD" || table == "all"){
+      sweep_test<hashing_project::tables::md_p2_generic, 4, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "double" || table == "all"){
+      sweep_test<hashing_project::tables::double_generic, 8, 8>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "doubleMD" || table == "all"){
+      sweep_test<hashing_project::tables::md_double_generic, 4, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "iceberg" || table == "all"){
+      sweep_test<hashing_project::tables::iht_p2_generic, 8, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "icebergMD" || table == "all"){
+      sweep_test<hashing_project::tables::iht_p2_metadata_full_generic, 4, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "icebergQuotient" || table == "all"){
+      sweep_test<hashing_project::tables::iht_p2_metadata_quotient_generic, 4, 32>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "cuckoo" || table == "all"){
+      sweep_test<hashing_project::tables::cuckoo_generic, 4, 8>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "hopscotch" || table == "all"){
+      sweep_test<hashing_project::tables::hopscotch_generic, 4, 8>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "chaining" || table == "all"){
+      sweep_test<hashing_project::tables::chaining_generic, 4, 8>(table_capacity, load, keys, myfile);
+   }
+
+   if (table == "host" || table == "all"){
+      host_sweep_test<hashing_project::tables::host_swiss_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, myfile);
+      host_sweep_test<hashing_project::tables::host_hopscotch_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, myfile);
+      host_sweep_test<hashing_project::tables::host_iht_p2_quotient_generic<DATA_TYPE, DATA_TYPE, 1, 16>>(table_capacity, load, host_keys, n_threads, myfile);
+   }
+
+   myfile.close();
+
+   cudaFree(keys);
+
+   cudaFreeHost(host_keys);
+
+}
+
+
+int main(int argc, char** argv) {
+
+
+   argparse::ArgumentParser program("sweep_test");
+
+   program.add_argument("--table", "-t").default_value(std::string("all")).help("Specify table type. Options [all p2 p2_inv p2MD double doubleMD iceberg icebergMD icebergQuotient cuckoo hopscotch chaining host]");
+
+   program.add_argument("--capacity", "-c").scan<'u', uint64_t>().default_value((uint64_t) 100000000).help("Number of slots in the table.");
+
+   program.add_argument("--load", "-l").scan<'g', double>().default_value(.85).help("Fraction of the table filled before sweeping.");
+
+   program.add_argument("--threads").scan<'u', uint32_t>().default_value(hashing_project::host::get_default_n_threads()).help("Number of threads for the host tables.");
+
+   try {
+    program.parse_args(argc, argv);
+   }
+   catch (const std::exception& err) {
+    std::cerr << err.what() << std::endl;
+    std::cerr << program;
+    return 1;
+   }
+
+   auto table = program.get<std::string>("--table");
+   auto table_capacity = program.get<uint64_t>("--capacity");
+   auto load = program.get<double>("--load");
+   auto n_threads = program.get<uint32_t>("--threads");
+
+
+   if(fs::create_directory("results")){
+   } else {
+   }
+
+   if(fs::create_directory(RESULTS_DIR)){
+   } else {
+   }
+
+
+   execute_test(table, table_capacity, load, n_threads);
+
+
+   cudaDeviceReset();
+   return 0;
+
+}
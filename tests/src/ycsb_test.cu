@@ -56,6 +56,8 @@ namespace fs = std::filesystem;
 #include <hashing_project/tables/cuckoo.cuh>
 #include <hashing_project/tables/double_hashing_metadata.cuh>
 
+#include <hashing_project/host_tables/swiss_table.cuh>
+
 
 
 #include <iostream>
@@ -787,6 +789,85 @@ __host__ void lf_test(ycsb_load_type load_data, ycsb_load_type run_data, std::st
 
 
 
+//host backend version of the ycsb test - same load/run phases using host threads.
+template <template<typename, typename, uint, uint> typename hash_table_type, uint bucket_size>
+__host__ void ycsb_test_host(ycsb_load_type load_data, ycsb_load_type run_data, std::string source_filename, uint32_t n_threads){
+
+
+   using ht_type = hash_table_type<DATA_TYPE, DATA_TYPE, 1, bucket_size>;
+
+   std::atomic<uint64_t> misses[2];
+
+   misses[0] = 0;
+   misses[1] = 0;
+
+   std::string filename = "results/ycsb/"+source_filename + "/" + ht_type::get_name() + ".txt";
+
+   printf("Writing to %s\n", filename.c_str());
+
+   std::ofstream myfile;
+   myfile.open (filename.c_str());
+   myfile << "insert,query\n";
+
+
+   uint64_t items_to_insert = load_data.n_items;
+   uint64_t n_queries = run_data.n_items;
+
+   ht_type * table = ht_type::generate_on_host(items_to_insert*1.2, 42);
+
+
+   auto ycsb_op = [&](ycsb_load_type & data, uint64_t tid){
+
+      if (data.is_insert[tid]){
+
+         if (!table->upsert_replace(data.keys[tid], data.values[tid])){
+            #if MEASURE_FAILS
+            misses[0]++;
+            #endif
+         }
+
+      } else {
+
+         DATA_TYPE my_val;
+
+         if (!table->find_with_reference(data.keys[tid], my_val)){
+            #if MEASURE_FAILS
+            misses[1]++;
+            #endif
+         }
+
+      }
+
+   };
+
+
+   hashing_project::host::timer insert_timer;
+
+   hashing_project::host::parallel_for(n_threads, items_to_insert, [&](uint64_t tid){ ycsb_op(load_data, tid); });
+
+   insert_timer.sync_end();
+
+
+   hashing_project::host::timer query_timer;
+
+   hashing_project::host::parallel_for(n_threads, n_queries, [&](uint64_t tid){ ycsb_op(run_data, tid); });
+
+   query_timer.sync_end();
+
+
+   ht_type::free_on_host(table);
+
+   myfile << std::setprecision(12) << 1.0*items_to_insert/(insert_timer.elapsed()*1000000) << "," << 1.0*n_queries/(query_timer.elapsed()*1000000) << "\n";
+
+   std::cout << std::setprecision(12) << 1.0*items_to_insert/(insert_timer.elapsed()*1000000) << "," << 1.0*n_queries/(query_timer.elapsed()*1000000) << "\n";
+
+   printf("Misses: %lu %lu\n", misses[0].load(), misses[1].load());
+
+   myfile.close();
+
+}
+
+
 template <template<typename, typename, uint, uint> typename hash_table_type, uint tile_size, uint bucket_size>
 __host__ void lf_test_cuckoo(ycsb_load_type load_data, ycsb_load_type run_data, std::string source_filename, bool cheap, bool cheap_insert){
 
@@ -1234,7 +1315,7 @@ __host__ void lf_test_BGHT(uint64_t n_indices, DATA_TYPE * access_pattern, std::
 
 
 
-__host__ void execute_test(std::string table, std::string filename, bool cheap, bool cheap_insert){
+__host__ void execute_test(std::string table, std::string filename, bool cheap, bool cheap_insert, uint32_t n_threads){
 
    std::string load_fname = "../../caching/traces/" + filename+"-load.txt";
    std::string run_fname = "../../caching/traces/" +filename+"-run.txt";
@@ -1291,6 +1372,10 @@ __host__ void execute_test(std::string table, std::string filename, bool cheap,
       lf_test<hashing_project::tables::chaining_generic, 4, 8>(load_data, run_data, filename, cheap, cheap_insert);
 
       free_global_allocator();
+   } else if (table == "swiss"){
+
+      ycsb_test_host<hashing_project::tables::host_swiss_generic, 16>(load_data, run_data, filename, n_threads);
+
    } else {
       throw std::runtime_error("Unknown table");
    }
@@ -1313,7 +1398,7 @@ int main(int argc, char** argv) {
 
    program.add_argument("--table", "-t")
    .required()
-   .help("Specify table type. Options [p2 p2inv p2MD double doubleMD iceberg icebergMD cuckoo chaining bght_p2 bght_cuckoo");
+   .help("Specify table type. Options [p2 p2inv p2MD double doubleMD iceberg icebergMD cuckoo chaining bght_p2 bght_cuckoo swiss");
 
    //program.add_argument("--capacity", "-c").required().scan<'u', uint64_t>().help("Number of slots in the table. Default is 100,000,000");
 
@@ -1328,6 +1413,11 @@ int main(int argc, char** argv) {
    .help("fast upsert for YCSB")
    .flag();
 
+   program.add_argument("--threads")
+   .default_value((uint32_t) hashing_project::host::get_default_n_threads())
+   .scan<'u', uint32_t>()
+   .help("Number of host threads used by host tables (swiss)");
+
    try {
     program.parse_args(argc, argv);
    }
@@ -1339,6 +1429,7 @@ int main(int argc, char** argv) {
 
    auto table = program.get<std::string>("--table");
    auto filename = program.get<std::string>("--filename");
+   auto n_threads = program.get<uint32_t>("--threads");
 
    bool cheap = false;
    if (program["--cheap"] == true){
@@ -1392,7 +1483,7 @@ int main(int argc, char** argv) {
 
    fs::create_directory("results/ycsb_probe/"+filename);
 
-   execute_test(table, filename, cheap, cheap_insert);
+   execute_test(table, filename, cheap, cheap_insert, n_threads);
 
 
 